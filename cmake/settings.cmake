@@ -27,6 +27,11 @@ set(MYSQL_ROUTER_INI "mysqlrouter.ini"
 option(ENABLE_TESTS "Enable Tests" NO)
 option(WITH_STATIC "Enable static linkage of external libraries" NO)
 option(GPL "Produce GNU GPLv2 source and binaries" YES)
+option(WITH_DEBUG_LOGGING "Compile log messages of level DEBUG used on hot paths" YES)
+
+if(NOT WITH_DEBUG_LOGGING)
+  add_definitions(-DLOGGER_NO_DEBUG)
+endif()
 
 # MySQL Harness
 set(HARNESS_NAME "mysqlrouter" CACHE STRING "Name of Harness")
@@ -77,6 +77,10 @@ function(ADD_HARNESS_PLUGIN NAME)
       SUFFIX ".so")
   endif()
 
+  # Messages logged by the plugin are in a domain named after it
+  set_property(TARGET ${NAME} APPEND PROPERTY
+    COMPILE_DEFINITIONS "MYSQL_ROUTER_LOG_DOMAIN=\"${NAME}\"")
+
   # Declare the interface directory for this plugin, if present. It
   # will be used both when compiling the plugin as well as as for any
   # dependent targets.
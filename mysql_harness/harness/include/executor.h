@@ -0,0 +1,190 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_EXECUTOR_INCLUDED
+#define MYSQL_HARNESS_EXECUTOR_INCLUDED
+
+#include "harness_export.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mysql_harness {
+
+/**
+ * Pool of threads running short tasks of plugins, and timers.
+ *
+ * @ingroup Loader
+ *
+ * The harness creates one executor which plugins get through
+ * `AppInfo::executor`, so that the process runs a bounded number of
+ * threads instead of one per plugin activity.
+ *
+ * Tasks are queued per owner, normally the name of the plugin posting
+ * them, and idle workers take tasks from the owners in turn so that a
+ * plugin posting many tasks does not starve the others. Tasks posted by a
+ * task go to the queue of the worker running it, which runs them last in
+ * first out; idle workers steal from these queues, oldest first.
+ *
+ * Timers run their task on the workers once due. Periodic timers are
+ * rescheduled once their task ended, so that a task never runs twice at
+ * the same time.
+ *
+ * Tasks must not block for long: they would hold a worker which other
+ * plugins need. Long running activities, like accepting connections,
+ * keep their own threads.
+ */
+class HARNESS_EXPORT Executor {
+ public:
+  using Task = std::function<void()>;
+  using Clock = std::chrono::steady_clock;
+  using TimerId = uint64_t;
+
+  /** @brief Activity of an owner of tasks */
+  struct OwnerStats {
+    std::string owner;
+    /** @brief Tasks waiting in the queue of the owner */
+    size_t queued;
+    /** @brief Tasks of the owner which ran */
+    uint64_t executed;
+    /** @brief Timers of the owner not cancelled nor expired */
+    size_t timers;
+  };
+
+  /**
+   * Constructor; starts the workers and the timer thread.
+   *
+   * @param threads number of workers; 0 for one per processor (minimum 2)
+   */
+  explicit Executor(size_t threads = 0);
+
+  /** @brief Destructor; stops the executor (see stop()) */
+  ~Executor();
+
+  Executor(const Executor&) = delete;
+  Executor& operator=(const Executor&) = delete;
+
+  /** @brief Returns the number of workers */
+  size_t thread_count() const noexcept {
+    return workers_.size();
+  }
+
+  /**
+   * Queues a task.
+   *
+   * @param owner name of the plugin posting the task
+   * @param task task to run
+   * @throws std::runtime_error when the executor was stopped
+   */
+  void post(const std::string& owner, Task task);
+
+  /**
+   * Runs a task once after a delay.
+   *
+   * @return identifier of the timer, to cancel it
+   */
+  TimerId schedule_after(const std::string& owner, Clock::duration delay, Task task);
+
+  /**
+   * Runs a task periodically; the first time after one period.
+   *
+   * The period is counted from the end of the previous run.
+   *
+   * @return identifier of the timer, to cancel it
+   */
+  TimerId schedule_every(const std::string& owner, Clock::duration period, Task task);
+
+  /**
+   * Cancels a timer.
+   *
+   * When the task of the timer is running, waits for it to end, unless
+   * called from the task itself. Once returned, the task of the timer will
+   * not run anymore. Cancelling a timer which expired does nothing.
+   */
+  void cancel(TimerId id);
+
+  /** @brief Returns the activity of each owner */
+  std::vector<OwnerStats> stats() const;
+
+  /**
+   * Stops the timers and the workers.
+   *
+   * Tasks already queued run before the workers exit. Timers not expired
+   * are dropped.
+   */
+  void stop();
+
+ private:
+  struct Entry;
+  struct OwnerQueue;
+  struct Worker;
+
+  struct Timer {
+    OwnerQueue *owner;
+    std::shared_ptr<Task> task;
+    Clock::duration period;  // zero for timers running once
+    bool running;
+    bool cancelled;
+    std::thread::id thread;  // running the task
+  };
+
+  /** @brief Maximum number of owners of tasks */
+  static const size_t kMaxOwners = 64;
+
+  OwnerQueue *get_owner(const std::string& name);
+  void push(OwnerQueue *owner, Task task);
+  bool take(Worker *self, Entry *entry);
+  void run_worker(Worker *self);
+  void run_timers();
+  void run_timer(TimerId id);
+  TimerId schedule(OwnerQueue *owner, Clock::duration delay, Clock::duration period,
+                   Task task);
+
+  std::vector<std::unique_ptr<Worker>> workers_;
+
+  // Owners are only added; workers read them without locking
+  std::unique_ptr<OwnerQueue> owners_[kMaxOwners];
+  std::atomic<size_t> owner_count_{0};
+  std::mutex owners_mutex_;
+
+  // Tasks queued in all queues; workers park when there are none
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  size_t pending_ = 0;
+  bool stopping_ = false;
+
+  mutable std::mutex timers_mutex_;
+  std::condition_variable timers_cond_;
+  std::map<TimerId, Timer> timers_;
+  std::multimap<Clock::time_point, TimerId> deadlines_;
+  TimerId next_timer_id_ = 1;
+  bool stopping_timers_ = false;
+  std::thread timer_thread_;
+};
+
+} // namespace mysql_harness
+
+#endif /* MYSQL_HARNESS_EXECUTOR_INCLUDED */
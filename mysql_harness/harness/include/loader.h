@@ -18,20 +18,26 @@
 #define MYSQL_HARNESS_LOADER_INCLUDED
 
 #include "mysql/harness/config_parser.h"
+#include "mysql/harness/executor.h"
 #include "mysql/harness/filesystem.h"
 #include "mysql/harness/plugin.h"
 
 #include "harness_export.h"
 
+#include <chrono>
+#include <condition_variable>
 #include <exception>
 #include <future>
 #include <istream>
 #include <list>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <queue>
 #include <set>
 #include <string>
 #include <thread>
+#include <vector>
 
 namespace mysql_harness {
 
@@ -102,7 +108,9 @@ class LoaderConfig : public Config {
  * a chance to perform initialization. This step is only executed if
  * the plugin structure defines an `init` function. Note that it is
  * guaranteed that the init function of a plugin is called *after* the
- * `init` function of all plugins it requires have been called.
+ * `init` function of all plugins it requires have been called. The
+ * `init` functions of plugins that do not depend on each other can be
+ * called concurrently, from different threads.
  *
  * After all plugins have been successfully initialized, a thread is
  * created for each plugin that have a non-NULL `start` field in the
@@ -139,6 +147,8 @@ class HARNESS_EXPORT Loader {
          const AssocT& defaults = AssocT(),
          const SeqT& reserved = SeqT())
       : config_(defaults, reserved, Config::allow_keys),
+        defaults_(defaults.begin(), defaults.end()),
+        reserved_(reserved.begin(), reserved.end()),
         program_(program) {}
 
   /** @overload */
@@ -222,6 +232,54 @@ class HARNESS_EXPORT Loader {
    */
   void start();
 
+  /**
+   * Time each plugin took to initialize.
+   *
+   * Plugins are initialized level by level over their dependencies:
+   * the plugins whose required plugins are all initialized are
+   * initialized concurrently. The time taken by the loader to
+   * initialize the plugins is therefore the time of the slowest chain
+   * of dependencies, rather than the sum of the times below.
+   *
+   * @return Time taken by the `init` function of each plugin
+   * initialized, by plugin name.
+   */
+  std::map<std::string, std::chrono::steady_clock::duration>
+  init_times() const;
+
+  /**
+   * Reload the configuration of running plugins.
+   *
+   * The configuration entries given to read() are read again and the
+   * sections are compared with the running ones:
+   *
+   * - Sections that were removed are stopped.
+   * - Sections that were added are started.
+   * - Sections with changed options are given to the `reload` function
+   *   of their plugin, or restarted using the `stop` and `start`
+   *   functions when the plugin cannot apply the changes in place.
+   *   Sections whose changes the plugin rejects keep running with their
+   *   previous options.
+   *
+   * Changes to the default section are ignored. Nothing is changed
+   * when the configuration cannot be read or needs a plugin that is
+   * not loaded.
+   *
+   * On POSIX systems, the configuration is reloaded when the process
+   * receives SIGHUP while the plugins are running.
+   *
+   * The harness keeps running while the reload stops and starts
+   * sections, even when all running sections are stopped.
+   *
+   * @return Sections whose changes could not be applied since their
+   * plugin rejected them, can neither reload nor restart them, or since
+   * the plugins stopped running meanwhile.
+   *
+   * @exception bad_section Thrown if the configuration is not correct.
+   * @exception std::runtime_error Thrown if the plugins stopped running.
+   */
+  std::list<Config::SectionKey> reload();
+
   /**
    * Return true if we are logging to a file, false if we are logging
    * to console instead.
@@ -253,6 +311,26 @@ class HARNESS_EXPORT Loader {
   void start_all();
   void stop_all();
   void deinit_all();
+  void init_plugin(const std::string& plugin_key);
+
+  /**
+   * Start a thread running the start function of a section.
+   *
+   * @return false if the plugins are not running anymore.
+   */
+  bool start_session(const ConfigSection* section);
+
+  /**
+   * Configuration the running sections belong to.
+   */
+  LoaderConfig& running_config();
+
+  /**
+   * Apply the configuration read again to the running sections.
+   *
+   * @see reload()
+   */
+  std::list<Config::SectionKey> reload_sections();
 
   /**
    * Topological sort of all plugins and their dependencies.
@@ -309,6 +387,22 @@ class HARNESS_EXPORT Loader {
    */
   LoaderConfig config_;
 
+  /**
+   * Defaults and reserved words the configuration was created with,
+   * and the entries read, to read the configuration again on reload.
+   */
+  std::map<std::string, std::string> defaults_;
+  std::vector<std::string> reserved_;
+  std::vector<Path> config_paths_;
+  std::string logger_level_;
+
+  /**
+   * Configurations read on reload. Kept as the sections of running
+   * plugins point into them.
+   */
+  std::list<std::unique_ptr<LoaderConfig>> reloaded_configs_;
+  std::mutex reload_mutex_;
+
   /**
    * Map of all plugins (without key name).
    */
@@ -322,18 +416,32 @@ class HARNESS_EXPORT Loader {
   std::queue<size_t> done_sessions_;
   std::mutex done_mutex_;
   std::condition_variable done_cond_;
+  size_t running_sessions_ = 0;
+  bool accepting_sessions_ = true;
 
   /**
    * Initialization order.
    */
   std::list<std::string> order_;
 
+  /**
+   * Time taken by the init function of each plugin.
+   */
+  std::map<std::string, std::chrono::steady_clock::duration> init_times_;
+  mutable std::mutex init_times_mutex_;
+
   std::string logging_folder_;
   std::string plugin_folder_;
   std::string runtime_folder_;
   std::string config_folder_;
   std::string program_;
   AppInfo appinfo_;
+
+  /**
+   * Executor shared by the plugins, created with the application
+   * information. Destroyed before the configuration which tasks may use.
+   */
+  std::unique_ptr<Executor> executor_;
 };
 
 } // namespace mysql_harness
@@ -0,0 +1,323 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_MPMC_QUEUE_INCLUDED
+#define MYSQL_HARNESS_MPMC_QUEUE_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace mysql_harness {
+
+/**
+ * Bounded thread-safe queue allowing multiple producers and consumers.
+ *
+ * The queue is a ring of cells, each with a sequence number telling
+ * whether it can be written or read for a given position (Dmitry Vyukov's
+ * bounded MPMC queue). Producers and consumers claim positions with
+ * compare-and-swap and never take a lock, nor allocate memory, in
+ * `try_push()` and `try_pop()`. Cells and the positions are on cache
+ * lines of their own to avoid false sharing.
+ *
+ * The blocking `push()` and `pop()` retry for a while, spinning then
+ * yielding, before parking the thread on a condition variable. Threads
+ * are only notified when some are parked.
+ */
+template <class T>
+class mpmc_queue {
+ public:
+  using size_type = std::size_t;
+
+  /**
+   * Constructor.
+   *
+   * @param capacity maximum number of elements; rounded up to a power of 2
+   */
+  explicit mpmc_queue(size_type capacity) {
+    size_type size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+
+    // Memory of `new` is not aligned on cache lines before C++17
+    buffer_.reset(new char[size * kCellSize + kCacheLineSize]);
+    auto address = reinterpret_cast<std::uintptr_t>(buffer_.get());
+    cells_ = buffer_.get() + (kCacheLineSize - address % kCacheLineSize) % kCacheLineSize;
+    for (size_type i = 0; i < size; ++i) {
+      new (cell(i)) Cell;
+      cell(i)->sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  mpmc_queue(const mpmc_queue&) = delete;
+  mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+  ~mpmc_queue() {
+    size_type head = enqueue_pos_.load(std::memory_order_relaxed);
+    for (size_type pos = dequeue_pos_.load(std::memory_order_relaxed); pos != head; ++pos) {
+      cell(pos)->value()->~T();
+    }
+  }
+
+  /** @brief Returns the maximum number of elements */
+  size_type capacity() const noexcept {
+    return mask_ + 1;
+  }
+
+  /**
+   * Get the number of elements in the queue.
+   *
+   * @note The number is approximate when other threads use the queue.
+   */
+  size_type size() const noexcept {
+    size_type tail = dequeue_pos_.load(std::memory_order_relaxed);
+    size_type head = enqueue_pos_.load(std::memory_order_relaxed);
+    return head >= tail ? head - tail : 0;
+  }
+
+  /** @brief Check if the queue is empty; approximate like size() */
+  bool empty() const noexcept {
+    return size() == 0;
+  }
+
+  /**
+   * Adds an element unless the queue is full.
+   *
+   * @return false when the queue is full; the value is then left as is
+   */
+  bool try_push(const T& value) {
+    return try_emplace(value);
+  }
+
+  /** @overload */
+  bool try_push(T&& value) {
+    return try_emplace(std::move(value));
+  }
+
+  /** @brief Adds an element, waiting while the queue is full */
+  void push(const T& value) {
+    wait([&]{ return try_emplace(value); }, &not_full_, nullptr);
+  }
+
+  /** @overload */
+  void push(T&& value) {
+    wait([&]{ return try_emplace(std::move(value)); }, &not_full_, nullptr);
+  }
+
+  /**
+   * Removes the oldest element unless the queue is empty.
+   *
+   * @return false when the queue is empty
+   */
+  bool try_pop(T* result) {
+    size_type pos = dequeue_pos_.load(std::memory_order_relaxed);
+    Cell *slot;
+    for (;;) {
+      slot = cell(pos);
+      size_type sequence = slot->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+      if (diff == 0) {
+        if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = dequeue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    T *value = slot->value();
+    *result = std::move(*value);
+    value->~T();
+    slot->sequence.store(pos + mask_ + 1, std::memory_order_release);
+    wake(&not_full_);
+    return true;
+  }
+
+  /** @brief Removes the oldest element, waiting while the queue is empty */
+  bool pop(T* result) {
+    wait([&]{ return try_pop(result); }, &not_empty_, nullptr);
+    return true;
+  }
+
+  /**
+   * Removes the oldest element, waiting at most the given time while the
+   * queue is empty.
+   *
+   * @return false when the queue stayed empty
+   */
+  template <class Rep, class Period>
+  bool pop(T* result, const std::chrono::duration<Rep, Period>& rel_time) {
+    auto deadline = std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(rel_time);
+    return wait([&]{ return try_pop(result); }, &not_empty_, &deadline);
+  }
+
+ private:
+  /** @brief Attempts spinning before yielding the processor */
+  static const int kSpinCount = 64;
+
+  /** @brief Attempts, including spinning ones, before parking */
+  static const int kYieldCount = 128;
+
+  /** @brief Size of cache lines of common processors */
+  static const size_type kCacheLineSize = 64;
+
+  struct Cell {
+    T *value() {
+      return reinterpret_cast<T*>(&storage);
+    }
+
+    std::atomic<size_type> sequence;
+    typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+  };
+
+  /** @brief Space used by a cell; a multiple of cache lines */
+  static const size_type kCellSize =
+      (sizeof(Cell) + kCacheLineSize - 1) / kCacheLineSize * kCacheLineSize;
+
+  Cell *cell(size_type pos) noexcept {
+    return reinterpret_cast<Cell*>(cells_ + (pos & mask_) * kCellSize);
+  }
+
+  /** @brief Threads parked waiting for elements or free cells */
+  struct Waiters {
+    std::atomic<int> count{0};
+    // Stepped by wake(), so that parked threads see they were woken up
+    std::atomic<uint64_t> epoch{0};
+    std::mutex mutex;
+    std::condition_variable cond;
+  };
+
+  template <class U>
+  bool try_emplace(U&& value) {
+    size_type pos = enqueue_pos_.load(std::memory_order_relaxed);
+    Cell *slot;
+    for (;;) {
+      slot = cell(pos);
+      size_type sequence = slot->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos);
+      if (diff == 0) {
+        if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = enqueue_pos_.load(std::memory_order_relaxed);
+      }
+    }
+
+    new (&slot->storage) T(std::forward<U>(value));
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    wake(&not_empty_);
+    return true;
+  }
+
+  /**
+   * Calls `attempt` until it succeeds: spinning, then yielding, then
+   * parked on `waiters` until woken up or the deadline (if any) passed.
+   *
+   * @return false when the deadline passed
+   */
+  template <class Attempt>
+  bool wait(Attempt attempt, Waiters *waiters,
+            const std::chrono::steady_clock::time_point *deadline) {
+    for (int i = 0; i < kYieldCount; ++i) {
+      if (attempt()) {
+        return true;
+      }
+      if (i >= kSpinCount) {
+        std::this_thread::yield();
+      }
+    }
+
+    // Attempts are never made holding the mutex of the waiters: a
+    // successful attempt wakes up the other side, taking its mutex.
+    for (;;) {
+      // The fence pairs with the one in wake(): either the waking thread
+      // sees the count, or the attempt below sees its change.
+      waiters->count.fetch_add(1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      uint64_t epoch = waiters->epoch.load(std::memory_order_acquire);
+      if (attempt()) {
+        waiters->count.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+      }
+
+      bool woken;
+      {
+        std::unique_lock<std::mutex> lock(waiters->mutex);
+        auto was_woken = [waiters, epoch] {
+          return waiters->epoch.load(std::memory_order_relaxed) != epoch;
+        };
+        if (deadline == nullptr) {
+          waiters->cond.wait(lock, was_woken);
+          woken = true;
+        } else {
+          woken = waiters->cond.wait_until(lock, *deadline, was_woken);
+        }
+      }
+      waiters->count.fetch_sub(1, std::memory_order_relaxed);
+      if (!woken) {
+        return attempt();
+      }
+    }
+  }
+
+  // Wakes up a thread parked on `waiters`, if any
+  void wake(Waiters *waiters) {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiters->count.load(std::memory_order_relaxed) > 0) {
+      // Parked threads check the epoch and wait holding the mutex;
+      // stepping it under the mutex makes sure the notification is not
+      // sent in between
+      {
+        std::lock_guard<std::mutex> lock(waiters->mutex);
+        waiters->epoch.fetch_add(1, std::memory_order_release);
+      }
+      waiters->cond.notify_one();
+    }
+  }
+
+  std::unique_ptr<char[]> buffer_;
+  char *cells_;
+  size_type mask_;
+  // Positions are on cache lines of their own
+  char padding0_[kCacheLineSize];
+  std::atomic<size_type> enqueue_pos_{0};
+  char padding1_[kCacheLineSize];
+  std::atomic<size_type> dequeue_pos_{0};
+  char padding2_[kCacheLineSize];
+  Waiters not_empty_;
+  Waiters not_full_;
+};
+
+}
+
+#endif /* MYSQL_HARNESS_MPMC_QUEUE_INCLUDED */
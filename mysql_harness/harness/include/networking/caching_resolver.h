@@ -0,0 +1,179 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_NETWORKING_CACHING_RESOLVER_INCLUDED
+#define MYSQL_HARNESS_NETWORKING_CACHING_RESOLVER_INCLUDED
+
+#include "harness_export.h"
+#include "networking/ip_address.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace mysql_harness {
+
+/**
+ * Thread-safe cache of resolved hostnames.
+ *
+ * Hostnames are resolved by a small pool of threads owned by the cache,
+ * so that callers never run a lookup themselves. The addresses are kept
+ * for a positive TTL, and failed lookups for a negative TTL, during which
+ * callers get the cached answer without waiting.
+ *
+ * Entries asked for since they were resolved are resolved again in the
+ * background after three quarters of their TTL, so that names in use
+ * do not expire. When such a refresh fails, the addresses are kept until
+ * they expire.
+ *
+ * Only callers asking for a name which is not cached, or expired, wait
+ * for its lookup; concurrent callers wait for the same lookup.
+ *
+ * @note Entries are never removed: the cache is meant for the limited set
+ * of names a process connects to, like the destinations of routes.
+ */
+class HARNESS_EXPORT CachingResolver {
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Function resolving a name, throwing an exception when it fails.
+   *
+   * It is called by the threads of the cache.
+   */
+  using Lookup = std::function<std::vector<IPAddress>(const std::string &name)>;
+
+  /** @brief Activity of the cache */
+  struct Stats {
+    /** @brief Names found in the cache */
+    uint64_t hits;
+    /** @brief Names found in the cache as failing to resolve */
+    uint64_t negative_hits;
+    /** @brief Names not found in the cache, or expired */
+    uint64_t misses;
+    /** @brief Lookups done in the background for names in use */
+    uint64_t refreshes;
+    /** @brief Lookups which ended, including failed ones */
+    uint64_t lookups;
+    /** @brief Lookups which failed */
+    uint64_t failures;
+    /** @brief Callers which stopped waiting for a lookup */
+    uint64_t timeouts;
+    /** @brief Names in the cache */
+    size_t entries;
+  };
+
+  /**
+   * Constructor.
+   *
+   * The threads are started with the first lookup.
+   *
+   * @param threads number of threads resolving names
+   * @param positive_ttl time addresses are kept
+   * @param negative_ttl time failures are kept
+   * @param lookup function resolving names; resolves with
+   * Resolver::hostname() when empty
+   */
+  explicit CachingResolver(size_t threads = 2,
+                           Clock::duration positive_ttl = std::chrono::seconds(60),
+                           Clock::duration negative_ttl = std::chrono::seconds(5),
+                           Lookup lookup = nullptr);
+
+  /** @brief Destructor; stops the threads (see stop()) */
+  ~CachingResolver();
+
+  CachingResolver(const CachingResolver&) = delete;
+  CachingResolver& operator=(const CachingResolver&) = delete;
+
+  /**
+   * Resolves a hostname to one or more IP addresses.
+   *
+   * @param name hostname to resolve
+   * @param timeout maximum time waiting for the name to be resolved
+   * @return the addresses of the name
+   * @throws std::invalid_argument when the name could not be resolved
+   * @throws std::system_error with `std::errc::timed_out` when the
+   * lookup did not end within timeout
+   * @throws std::runtime_error when the cache was stopped
+   */
+  std::vector<IPAddress> hostname(const std::string &name, Clock::duration timeout);
+
+  /**
+   * Resolves a hostname in the background unless cached.
+   *
+   * The name is refreshed as if it was asked for.
+   */
+  void prefetch(const std::string &name);
+
+  /**
+   * Sets the time resolved names are kept.
+   *
+   * Applies to names resolved from now on.
+   */
+  void set_ttl(Clock::duration positive_ttl, Clock::duration negative_ttl);
+
+  /** @brief Returns the activity of the cache */
+  Stats stats() const;
+
+  /**
+   * Stops the threads.
+   *
+   * Waits for the running lookups to end. Callers waiting for a lookup
+   * get an error.
+   */
+  void stop();
+
+ private:
+  struct Entry {
+    std::vector<IPAddress> addresses;
+    std::string error;  // failed lookup, when not empty
+    Clock::time_point expires;
+    Clock::time_point refresh;
+    uint64_t generation = 0;  // completed lookups
+    bool used = false;  // asked for since resolved
+    bool queued = false;  // lookup queued or running
+  };
+
+  void queue(const std::string &name, Entry *entry);
+  Clock::time_point queue_refreshes(Clock::time_point now);
+  void run_worker();
+
+  const size_t threads_;
+  Lookup lookup_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable work_cond_;  // lookups queued, or refreshes due
+  std::condition_variable done_cond_;  // lookup completed
+  Clock::duration positive_ttl_;
+  Clock::duration negative_ttl_;
+  std::map<std::string, Entry> entries_;
+  std::deque<std::string> queue_;
+  Stats stats_;
+  bool stopping_ = false;
+  std::vector<std::thread> workers_;
+};
+
+} // namespace mysql_harness
+
+#endif // MYSQL_HARNESS_NETWORKING_CACHING_RESOLVER_INCLUDED
@@ -0,0 +1,176 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_TIMER_WHEEL_INCLUDED
+#define MYSQL_HARNESS_TIMER_WHEEL_INCLUDED
+
+#include "harness_export.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace mysql_harness {
+
+/**
+ * Hierarchical timer wheel for large numbers of coarse timeouts.
+ *
+ * @ingroup Loader
+ *
+ * Time is counted in ticks of fixed length. Timers are kept in lists,
+ * one per slot of 4 wheels of 256 slots: the first wheel has a slot per
+ * tick, the next ones a slot per 256 slots of the previous wheel. Arming
+ * and cancelling a timer is linking it in, or unlinking it from, a list.
+ * When the first wheel completes a turn, the timers of the next slot of
+ * the second wheel are moved down to the first wheel, and so on.
+ *
+ * Timers are owned by the caller and linked in place: arming, cancelling
+ * and expiring timers never allocates memory.
+ *
+ * The wheel does not run threads: advance() must be called periodically,
+ * ideally every tick, by a single thread at a time. It runs the callbacks
+ * of the expired timers.
+ */
+class HARNESS_EXPORT TimerWheel {
+ private:
+  // Timers are in circular lists, with a sentinel link
+  struct Link {
+    Link *prev = this;
+    Link *next = this;
+  };
+
+ public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * Timer, which can be armed on one wheel at a time.
+   *
+   * The wheel must outlive the timers armed on it.
+   */
+  class HARNESS_EXPORT Timer : private Link {
+   public:
+    /**
+     * Constructor.
+     *
+     * @param callback called on expiry, by the thread calling advance()
+     */
+    explicit Timer(std::function<void()> callback)
+        : callback_(std::move(callback)) {}
+
+    /** @brief Destructor; cancels the timer (see TimerWheel::cancel()) */
+    ~Timer();
+
+    Timer(const Timer&) = delete;
+    Timer& operator=(const Timer&) = delete;
+
+   private:
+    friend class TimerWheel;
+
+    enum class State { kIdle, kArmed, kExpired, kRunning };
+
+    uint64_t expires_ = 0;  // tick
+    State state_ = State::kIdle;
+    // Set while the timer is not idle
+    std::atomic<TimerWheel*> wheel_{nullptr};
+    std::function<void()> callback_;
+  };
+
+  /**
+   * Constructor.
+   *
+   * @param tick length of ticks, the precision of the timers
+   */
+  explicit TimerWheel(Clock::duration tick);
+
+  TimerWheel(const TimerWheel&) = delete;
+  TimerWheel& operator=(const TimerWheel&) = delete;
+
+  /**
+   * Arms a timer, or re-arms it when already armed.
+   *
+   * The timer expires on the first tick at or after the delay, and at
+   * most 2^32 ticks later. The callback of a timer can re-arm it.
+   *
+   * @param timer timer to arm
+   * @param delay time from now after which the timer expires
+   * @param now current time
+   */
+  void arm(Timer *timer, Clock::duration delay, Clock::time_point now = Clock::now());
+
+  /**
+   * Cancels a timer.
+   *
+   * When the callback of the timer is running, waits for it to end,
+   * unless called from the callback itself. Once returned, the callback
+   * will not be called unless the timer is armed again.
+   *
+   * @return true when the timer was armed and did not expire
+   */
+  bool cancel(Timer *timer);
+
+  /**
+   * Expires the timers due at the given time and runs their callbacks.
+   */
+  void advance(Clock::time_point now = Clock::now());
+
+  /**
+   * Returns the time the wheel advanced to.
+   *
+   * This does not read the clock and can be used to measure time in
+   * ticks cheaply, e.g. on every packet.
+   */
+  Clock::time_point now() const noexcept {
+    return origin_ + tick_ * static_cast<Clock::rep>(current_.load(std::memory_order_relaxed));
+  }
+
+  /** @brief Returns the number of armed timers */
+  size_t size() const noexcept {
+    return size_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  static const int kLevels = 4;
+  static const int kSlotBits = 8;
+  static const uint64_t kSlots = 1 << kSlotBits;
+  static const uint64_t kSlotMask = kSlots - 1;
+  static const uint64_t kMaxTicks = uint64_t(1) << (kLevels * kSlotBits);
+
+  static void link(Link *head, Link *link) noexcept;
+  static void unlink(Link *link) noexcept;
+
+  void insert(Timer *timer) noexcept;
+  void cascade(int level) noexcept;
+
+  const Clock::duration tick_;
+  const Clock::time_point origin_;
+
+  std::mutex mutex_;
+  std::condition_variable cond_;  // callback ended
+  std::atomic<uint64_t> current_{0};
+  std::atomic<size_t> size_{0};
+  std::thread::id advancing_thread_;
+  Link slots_[kLevels][kSlots];
+  Link expired_;  // timers expired by advance(), callback not run yet
+};
+
+} // namespace mysql_harness
+
+#endif /* MYSQL_HARNESS_TIMER_WHEEL_INCLUDED */
@@ -0,0 +1,364 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "executor.h"
+
+#include <deque>
+#include <stdexcept>
+
+namespace mysql_harness {
+
+struct Executor::Entry {
+  OwnerQueue *owner;
+  Task task;
+};
+
+struct Executor::OwnerQueue {
+  explicit OwnerQueue(const std::string& owner_name) : name(owner_name) {}
+
+  const std::string name;
+  std::mutex mutex;
+  std::deque<Task> tasks;
+  std::atomic<uint64_t> executed{0};
+};
+
+struct Executor::Worker {
+  Executor *executor;
+  std::thread thread;
+  // Tasks posted by the tasks run by this worker
+  std::mutex mutex;
+  std::deque<Entry> local;
+  // Owner to take a task from first, for fairness
+  size_t next_owner = 0;
+};
+
+namespace {
+
+// Worker running on the current thread, if any
+thread_local void *current_worker = nullptr;
+
+// Runs a task; tasks are not supposed to throw, and when they do, the
+// exception must not end the worker or leave a timer running
+void run_task(const std::function<void()>& task) noexcept {
+  try {
+    task();
+  } catch (...) {
+  }
+}
+
+}
+
+Executor::Executor(size_t threads) {
+  if (threads == 0) {
+    threads = std::max<size_t>(std::thread::hardware_concurrency(), 2);
+  }
+
+  for (size_t i = 0; i < threads; ++i) {
+    workers_.emplace_back(new Worker);
+    workers_.back()->executor = this;
+    workers_.back()->next_owner = i;
+  }
+  // Started once all workers exist, as they steal from each other
+  for (auto& worker : workers_) {
+    Worker *self = worker.get();
+    self->thread = std::thread([this, self] { run_worker(self); });
+  }
+  timer_thread_ = std::thread([this] { run_timers(); });
+}
+
+Executor::~Executor() {
+  stop();
+}
+
+void Executor::post(const std::string& owner, Task task) {
+  push(get_owner(owner), std::move(task));
+}
+
+Executor::TimerId Executor::schedule_after(const std::string& owner,
+                                           Clock::duration delay, Task task) {
+  return schedule(get_owner(owner), delay, Clock::duration::zero(), std::move(task));
+}
+
+Executor::TimerId Executor::schedule_every(const std::string& owner,
+                                           Clock::duration period, Task task) {
+  if (period <= Clock::duration::zero()) {
+    throw std::invalid_argument("Period of timer must be positive");
+  }
+  return schedule(get_owner(owner), period, period, std::move(task));
+}
+
+void Executor::cancel(TimerId id) {
+  std::unique_lock<std::mutex> lock(timers_mutex_);
+  auto it = timers_.find(id);
+  if (it == timers_.end()) {
+    return;
+  }
+
+  Timer& timer = it->second;
+  if (timer.running && timer.thread != std::this_thread::get_id()) {
+    // run_timer() removes the timer once its task ended
+    timer.cancelled = true;
+    timers_cond_.wait(lock, [this, id] { return timers_.count(id) == 0; });
+  } else {
+    // The deadline left, if any, is ignored by run_timers()
+    timers_.erase(it);
+  }
+}
+
+std::vector<Executor::OwnerStats> Executor::stats() const {
+  std::vector<OwnerStats> result;
+  size_t count = owner_count_.load(std::memory_order_acquire);
+  for (size_t i = 0; i < count; ++i) {
+    OwnerQueue *owner = owners_[i].get();
+    std::lock_guard<std::mutex> lock(owner->mutex);
+    result.push_back({owner->name, owner->tasks.size(),
+                      owner->executed.load(std::memory_order_relaxed), 0});
+  }
+
+  for (auto& worker : workers_) {
+    std::lock_guard<std::mutex> lock(worker->mutex);
+    for (auto& entry : worker->local) {
+      for (size_t i = 0; i < count; ++i) {
+        if (owners_[i].get() == entry.owner) {
+          ++result[i].queued;
+        }
+      }
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(timers_mutex_);
+  for (auto& timer : timers_) {
+    for (size_t i = 0; i < count; ++i) {
+      if (owners_[i].get() == timer.second.owner) {
+        ++result[i].timers;
+      }
+    }
+  }
+  return result;
+}
+
+void Executor::stop() {
+  {
+    std::lock_guard<std::mutex> lock(timers_mutex_);
+    stopping_timers_ = true;
+  }
+  timers_cond_.notify_all();
+  if (timer_thread_.joinable()) {
+    timer_thread_.join();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  cond_.notify_all();
+  for (auto& worker : workers_) {
+    if (worker->thread.joinable()) {
+      worker->thread.join();
+    }
+  }
+}
+
+Executor::OwnerQueue *Executor::get_owner(const std::string& name) {
+  std::lock_guard<std::mutex> lock(owners_mutex_);
+  size_t count = owner_count_.load(std::memory_order_relaxed);
+  for (size_t i = 0; i < count; ++i) {
+    if (owners_[i]->name == name) {
+      return owners_[i].get();
+    }
+  }
+
+  if (count == kMaxOwners) {
+    throw std::runtime_error("Too many owners of tasks: " + name);
+  }
+  owners_[count].reset(new OwnerQueue(name));
+  owner_count_.store(count + 1, std::memory_order_release);
+  return owners_[count].get();
+}
+
+void Executor::push(OwnerQueue *owner, Task task) {
+  auto *self = static_cast<Worker*>(current_worker);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_ && (self == nullptr || self->executor != this)) {
+      throw std::runtime_error("Executor stopped");
+    }
+  }
+
+  if (self != nullptr && self->executor == this) {
+    std::lock_guard<std::mutex> lock(self->mutex);
+    self->local.push_back({owner, std::move(task)});
+  } else {
+    std::lock_guard<std::mutex> lock(owner->mutex);
+    owner->tasks.push_back(std::move(task));
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++pending_;
+  }
+  cond_.notify_one();
+}
+
+bool Executor::take(Worker *self, Entry *entry) {
+  bool found = false;
+
+  // Most recent task posted by the tasks of this worker first, as its
+  // data is likely still in the cache
+  {
+    std::lock_guard<std::mutex> lock(self->mutex);
+    if (!self->local.empty()) {
+      *entry = std::move(self->local.back());
+      self->local.pop_back();
+      found = true;
+    }
+  }
+
+  // Then the owners in turn
+  size_t count = owner_count_.load(std::memory_order_acquire);
+  for (size_t i = 0; !found && i < count; ++i) {
+    OwnerQueue *owner = owners_[(self->next_owner + i) % count].get();
+    std::lock_guard<std::mutex> lock(owner->mutex);
+    if (!owner->tasks.empty()) {
+      entry->owner = owner;
+      entry->task = std::move(owner->tasks.front());
+      owner->tasks.pop_front();
+      self->next_owner += i + 1;
+      found = true;
+    }
+  }
+
+  // Then the oldest task of another worker
+  for (size_t i = 0; !found && i < workers_.size(); ++i) {
+    Worker *other = workers_[i].get();
+    if (other == self) {
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(other->mutex);
+    if (!other->local.empty()) {
+      *entry = std::move(other->local.front());
+      other->local.pop_front();
+      found = true;
+    }
+  }
+
+  if (found) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    --pending_;
+  }
+  return found;
+}
+
+void Executor::run_worker(Worker *self) {
+  current_worker = self;
+  for (;;) {
+    Entry entry;
+    if (take(self, &entry)) {
+      run_task(entry.task);
+      entry.owner->executed.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    cond_.wait(lock, [this] { return pending_ > 0 || stopping_; });
+    if (pending_ == 0 && stopping_) {
+      break;
+    }
+  }
+  current_worker = nullptr;
+}
+
+void Executor::run_timers() {
+  std::unique_lock<std::mutex> lock(timers_mutex_);
+  while (!stopping_timers_) {
+    if (deadlines_.empty()) {
+      timers_cond_.wait(lock);
+      continue;
+    }
+
+    auto first = deadlines_.begin();
+    if (first->first > Clock::now()) {
+      timers_cond_.wait_until(lock, first->first);
+      continue;
+    }
+
+    TimerId id = first->second;
+    deadlines_.erase(first);
+    auto it = timers_.find(id);
+    if (it == timers_.end()) {
+      continue;  // cancelled
+    }
+
+    OwnerQueue *owner = it->second.owner;
+    lock.unlock();
+    push(owner, [this, id] { run_timer(id); });
+    lock.lock();
+  }
+}
+
+void Executor::run_timer(TimerId id) {
+  std::shared_ptr<Task> task;
+  {
+    std::lock_guard<std::mutex> lock(timers_mutex_);
+    auto it = timers_.find(id);
+    if (it == timers_.end()) {
+      return;
+    }
+    it->second.running = true;
+    it->second.thread = std::this_thread::get_id();
+    task = it->second.task;
+  }
+
+  run_task(*task);
+
+  {
+    std::lock_guard<std::mutex> lock(timers_mutex_);
+    auto it = timers_.find(id);
+    if (it == timers_.end()) {
+      return;  // cancelled by the task
+    }
+
+    Timer& timer = it->second;
+    if (timer.cancelled || timer.period == Clock::duration::zero() || stopping_timers_) {
+      timers_.erase(it);
+    } else {
+      timer.running = false;
+      deadlines_.emplace(Clock::now() + timer.period, id);
+    }
+  }
+  // Wakes up the timer thread for the new deadline, and cancel()
+  timers_cond_.notify_all();
+}
+
+Executor::TimerId Executor::schedule(OwnerQueue *owner, Clock::duration delay,
+                                     Clock::duration period, Task task) {
+  std::lock_guard<std::mutex> lock(timers_mutex_);
+  if (stopping_timers_) {
+    throw std::runtime_error("Executor stopped");
+  }
+
+  TimerId id = next_timer_id_++;
+  timers_[id] = {owner, std::make_shared<Task>(std::move(task)), period, false, false,
+                 std::thread::id()};
+  auto deadline = deadlines_.emplace(Clock::now() + delay, id);
+  if (deadline == deadlines_.begin()) {
+    timers_cond_.notify_all();
+  }
+  return id;
+}
+
+} // namespace mysql_harness
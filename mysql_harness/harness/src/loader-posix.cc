@@ -21,13 +21,29 @@
 #include "filesystem.h"
 
 #include <dlfcn.h>
+#include <signal.h>
 #include <unistd.h>
 
 #include <cassert>
+#include <cstring>
+#include <iostream>
 #include <sstream>
 
 namespace mysql_harness {
 
+namespace {
+
+// Signal handlers only write to a pipe, read by the reload thread
+int g_reload_pipe[2] = {-1, -1};
+
+void on_reload_signal(int) {
+  char command = 'r';
+  auto written = write(g_reload_pipe[1], &command, 1);
+  (void)written;
+}
+
+}
+
 ////////////////////////////////////////////////////////////////
 // class Loader
 
@@ -35,7 +51,55 @@ void Loader::start() {
   for (auto& name : available())
     load(name.first, name.second);
   init_all();
-  start_all();
+
+  // The configuration is reloaded on SIGHUP while the plugins run. Only
+  // one loader at a time handles the signal.
+  std::thread reload_thread;
+  struct sigaction previous_hup;
+  if (g_reload_pipe[0] == -1 && pipe(g_reload_pipe) == 0) {
+    reload_thread = std::thread([this] {
+      char command;
+      while (::read(g_reload_pipe[0], &command, 1) == 1 && command == 'r') {
+        try {
+          for (auto& section : reload())
+            std::cerr << program_ << ": changes to section '" << section.first
+                      << (section.second.empty() ? "" : ":") << section.second
+                      << "' need a restart" << std::endl;
+        } catch (const std::exception& exc) {
+          std::cerr << program_ << ": reloading configuration failed: "
+                    << exc.what() << std::endl;
+        }
+      }
+    });
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    action.sa_handler = on_reload_signal;
+    sigaction(SIGHUP, &action, &previous_hup);
+  }
+
+  std::exception_ptr except;
+  try {
+    start_all();
+  } catch (...) {
+    except = std::current_exception();
+  }
+
+  if (reload_thread.joinable()) {
+    sigaction(SIGHUP, &previous_hup, nullptr);
+    char command = 'q';
+    auto written = write(g_reload_pipe[1], &command, 1);
+    (void)written;
+    reload_thread.join();
+    close(g_reload_pipe[0]);
+    close(g_reload_pipe[1]);
+    g_reload_pipe[0] = g_reload_pipe[1] = -1;
+  }
+
+  if (except)
+    std::rethrow_exception(except);
 }
 
 ////////////////////////////////////////////////////////////////
@@ -30,9 +30,13 @@
 #include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <future>
 #include <map>
 #include <set>
 #include <sstream>
+#include <stdexcept>
 #include <string>
 #include <system_error>
 #include <thread>
@@ -48,6 +52,39 @@ using std::ostringstream;
 
 namespace mysql_harness {
 
+/** @brief Maximum value of the executor_threads option */
+static const size_t kMaxExecutorThreads = 1024;
+
+/** @brief Minor ABI version from which plugins have a reload function */
+static const uint32_t kReloadAbiVersion = 0x0103;
+
+namespace {
+
+// Returns the reload function of a plugin, which older plugins do not
+// have in their plugin structure
+int (*get_reload(const Plugin* plugin))(const ConfigSection*) {
+  if ((plugin->abi_version & 0xFF) < (kReloadAbiVersion & 0xFF))
+    return nullptr;
+  return plugin->reload;
+}
+
+// Compares the values of the options of two sections, with the
+// variables and defaults applied
+bool same_options(const ConfigSection& first, const ConfigSection& second) {
+  for (auto& option : first.get_options()) {
+    if (!second.has(option.first) ||
+        second.get(option.first) != first.get(option.first))
+      return false;
+  }
+  for (auto& option : second.get_options()) {
+    if (!first.has(option.first))
+      return false;
+  }
+  return true;
+}
+
+}
+
 void LoaderConfig::fill_and_check() {
   // Set the default value of library for all sections that do not
   // have the library set.
@@ -196,6 +233,7 @@ std::list<Config::SectionKey> Loader::available() const {
 
 void Loader::read(const Path& path) {
   config_.read(path);
+  config_paths_.push_back(path);
 
   // This means it is checked after each file load, which might
   // require changes in the future if checks that cover the entire
@@ -215,63 +253,160 @@ void Loader::setup_info() {
   appinfo_.config_folder = config_folder_.c_str();
   appinfo_.config = &config_;
   appinfo_.program = program_.c_str();
+
+  if (!executor_) {
+    size_t threads = 0;
+    if (config_.has_default("executor_threads")) {
+      std::string value = config_.get_default("executor_threads");
+      char *rest;
+      threads = strtoul(value.c_str(), &rest, 10);
+      if (value.empty() || *rest != '\0' || threads > kMaxExecutorThreads)
+        throw bad_option("option executor_threads needs value between 0 and " +
+                         std::to_string(kMaxExecutorThreads) + " inclusive, was '" +
+                         value + "'");
+    }
+    executor_.reset(new Executor(threads));
+  }
+  appinfo_.executor = executor_.get();
 }
 
 void Loader::init_all() {
   if (!topsort())
     throw std::logic_error("Circular dependencies in plugins");
 
+  // The level of a plugin is one more than the highest level of the
+  // plugins it requires, so the plugins of a level can be initialized
+  // at the same time once the previous levels are.
+  std::map<std::string, size_t> plugin_levels;
+  std::vector<std::vector<std::string>> levels;
   for (const std::string& plugin_key : reverse(order_)) {
-    PluginInfo &info = plugins_.at(plugin_key);
-    if (info.plugin->init && info.plugin->init(&appinfo_))
-      throw std::runtime_error("Plugin init failed");
+    Plugin *plugin = plugins_.at(plugin_key).plugin;
+    size_t level = 0;
+    for (auto required : make_range(plugin->requires, plugin->requires_length)) {
+      if (required != nullptr)
+        level = std::max(level, plugin_levels.at(Designator(required).plugin) + 1);
+    }
+    plugin_levels[plugin_key] = level;
+    if (levels.size() <= level)
+      levels.resize(level + 1);
+    levels[level].push_back(plugin_key);
   }
+
+  for (const auto& level : levels) {
+    // A plugin alone on its level is initialized by this thread
+    auto policy = level.size() > 1 ? std::launch::async : std::launch::deferred;
+    std::vector<std::future<void>> inits;
+    for (const std::string& plugin_key : level)
+      inits.push_back(std::async(policy, &Loader::init_plugin, this, plugin_key));
+
+    // All initializations of the level are waited for before the first
+    // error is thrown
+    std::exception_ptr except;
+    for (auto& init : inits) {
+      try {
+        init.get();
+      } catch (...) {
+        if (!except)
+          except = std::current_exception();
+      }
+    }
+    if (except)
+      std::rethrow_exception(except);
+  }
+}
+
+void Loader::init_plugin(const std::string& plugin_key) {
+  PluginInfo &info = plugins_.at(plugin_key);
+  auto started = std::chrono::steady_clock::now();
+  std::exception_ptr except;
+  int result = 0;
+  try {
+    if (info.plugin->init)
+      result = info.plugin->init(&appinfo_);
+  } catch (...) {
+    except = std::current_exception();
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(init_times_mutex_);
+    init_times_[plugin_key] = std::chrono::steady_clock::now() - started;
+  }
+
+  if (except)
+    std::rethrow_exception(except);
+  if (result)
+    throw std::runtime_error("Plugin init failed");
+}
+
+std::map<std::string, std::chrono::steady_clock::duration>
+Loader::init_times() const {
+  std::lock_guard<std::mutex> lock(init_times_mutex_);
+  return init_times_;
+}
+
+bool Loader::start_session(const ConfigSection* section) {
+  void (*fptr)(const ConfigSection*) = plugins_.at(section->name).plugin->start;
+  assert(fptr);
+  auto dispatch = [section, fptr, this](size_t position)
+      -> std::exception_ptr {
+    std::exception_ptr eptr;
+    try {
+      fptr(section);
+    } catch (...) {
+      eptr = std::current_exception();
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(done_mutex_);
+      done_sessions_.push(position);
+    }
+
+    done_cond_.notify_all();
+    return eptr;
+  };
+
+  // Sessions are also started on reload, by another thread
+  std::lock_guard<std::mutex> lock(done_mutex_);
+  if (!accepting_sessions_)
+    return false;
+  std::future<std::exception_ptr> fut =
+      std::async(std::launch::async, dispatch, sessions_.size());
+  sessions_.push_back(std::move(fut));
+  ++running_sessions_;
+  return true;
 }
 
 void Loader::start_all() {
   // Start all the threads
-  int stoppable_jobs = 0;
   for (const ConfigSection* section : config_.sections()) {
     PluginInfo& plugin = plugins_.at(section->name);
-    void (*fptr)(const ConfigSection*) = plugin.plugin->start;
-    if (fptr) {
-      auto dispatch = [section, fptr, this](size_t position)
-          -> std::exception_ptr {
-        std::exception_ptr eptr;
-        try {
-          fptr(section);
-        } catch (...) {
-          eptr = std::current_exception();
-        }
-
-        {
-          std::lock_guard<std::mutex> lock(done_mutex_);
-          done_sessions_.push(position);
-        }
-
-        done_cond_.notify_all();
-        return eptr;
-      };
-      std::future<std::exception_ptr> fut =
-          std::async(std::launch::async, dispatch, sessions_.size());
-      sessions_.push_back(std::move(fut));
-      if (plugin.plugin->stop == nullptr)
-        ++stoppable_jobs;
-    }
+    if (plugin.plugin->start)
+      start_session(section);
   }
 
+  // Wait for all sessions, including the ones started on reload
   std::exception_ptr except;
-  while (stoppable_jobs-- > 0) {
-    std::unique_lock<std::mutex> lock(done_mutex_);
-    done_cond_.wait(lock, [this]{ return done_sessions_.size() > 0; });
+  std::unique_lock<std::mutex> lock(done_mutex_);
+  while (running_sessions_ > 0) {
+    done_cond_.wait(lock, [this]{
+      return done_sessions_.size() > 0 || running_sessions_ == 0;
+    });
+    if (done_sessions_.empty())
+      continue;
     auto idx = done_sessions_.front();
     done_sessions_.pop();
-    std::exception_ptr eptr = sessions_[idx].get();
+    --running_sessions_;
+    std::future<std::exception_ptr> fut = std::move(sessions_[idx]);
+    lock.unlock();
+    std::exception_ptr eptr = fut.get();
     if (eptr && !except) {
       stop_all();
       except = eptr;
     }
+    lock.lock();
   }
+  accepting_sessions_ = false;
+  lock.unlock();
 
   // We just throw the first exception that was raised. If there are
   // other exceptions, they are ignored.
@@ -280,7 +415,8 @@ void Loader::start_all() {
 }
 
 void Loader::stop_all() {
-  for (auto&& section : config_.sections()) {
+  std::lock_guard<std::mutex> lock(reload_mutex_);
+  for (auto&& section : running_config().sections()) {
     PluginInfo& plugin = plugins_.at(section->name);
     void (*fptr)(const ConfigSection*) = plugin.plugin->stop;
     if (fptr) {
@@ -289,6 +425,119 @@ void Loader::stop_all() {
   }
 }
 
+LoaderConfig& Loader::running_config() {
+  if (reloaded_configs_.empty())
+    return config_;
+  return *reloaded_configs_.back();
+}
+
+std::list<Config::SectionKey> Loader::reload() {
+  std::lock_guard<std::mutex> lock(reload_mutex_);
+
+  // The reload counts as a running session, so that start_all() does not
+  // return when the last sections are stopped before being started again
+  {
+    std::lock_guard<std::mutex> done_lock(done_mutex_);
+    if (!accepting_sessions_)
+      throw std::runtime_error("Plugins are not running");
+    ++running_sessions_;
+  }
+  auto end_reload = [this] {
+    {
+      std::lock_guard<std::mutex> done_lock(done_mutex_);
+      --running_sessions_;
+    }
+    done_cond_.notify_all();
+  };
+
+  std::list<Config::SectionKey> not_applied;
+  try {
+    not_applied = reload_sections();
+  } catch (...) {
+    end_reload();
+    throw;
+  }
+  end_reload();
+  return not_applied;
+}
+
+std::list<Config::SectionKey> Loader::reload_sections() {
+  std::unique_ptr<LoaderConfig> config(
+      new LoaderConfig(defaults_, reserved_, Config::allow_keys));
+  for (const Path& path : config_paths_) {
+    config->read(path);
+    config->fill_and_check();
+  }
+  if (!logger_level_.empty() && !config->has("logger")) {
+    auto&& section = config->add("logger");
+    section.add("library", "logger");
+    section.add("level", logger_level_);
+  }
+
+  // Plugins are only loaded on start
+  for (const ConfigSection* section : config->sections()) {
+    if (!is_loaded(section->name)) {
+      std::ostringstream buffer;
+      buffer << "Section '" << section->name
+             << (section->key.empty() ? "" : ":") << section->key
+             << "' needs plugin '" << section->name
+             << "' which is not loaded";
+      throw bad_section(buffer.str());
+    }
+  }
+
+  std::list<Config::SectionKey> not_applied;
+  const LoaderConfig& running = running_config();
+  for (const ConfigSection* section : running.sections()) {
+    if (config->has(section->name, section->key))
+      continue;
+    Plugin* plugin = plugins_.at(section->name).plugin;
+    if (plugin->start && plugin->stop)
+      plugin->stop(section);
+    else
+      not_applied.emplace_back(section->name, section->key);
+  }
+
+  for (const ConfigSection* section : config->sections()) {
+    Plugin* plugin = plugins_.at(section->name).plugin;
+    if (!running.has(section->name, section->key)) {
+      if (!plugin->start || !start_session(section))
+        not_applied.emplace_back(section->name, section->key);
+      continue;
+    }
+
+    const ConfigSection& previous = running.get(section->name, section->key);
+    if (same_options(previous, *section))
+      continue;
+
+    int (*reload_fptr)(const ConfigSection*) = get_reload(plugin);
+    int reloaded = reload_fptr ? reload_fptr(section) : 1;
+    if (reloaded == 0)
+      continue;
+    if (reloaded < 0) {
+      // Rejected: the section keeps running with the previous options
+      ConfigSection& kept = config->get(section->name, section->key);
+      kept.clear();
+      kept.update(previous);
+      not_applied.emplace_back(section->name, section->key);
+      continue;
+    }
+    if (plugin->start && plugin->stop) {
+      plugin->stop(&previous);
+      if (!start_session(section))
+        not_applied.emplace_back(section->name, section->key);
+    } else {
+      not_applied.emplace_back(section->name, section->key);
+    }
+  }
+
+  // Sections of the previous configurations may still be in use by
+  // plugins that did not stop yet, so they are kept
+  reloaded_configs_.push_back(std::move(config));
+  appinfo_.config = reloaded_configs_.back().get();
+  return not_applied;
+}
+
 void Loader::deinit_all() {
   for (auto& name : order_) {
     PluginInfo& info = plugins_.at(name);
@@ -350,6 +599,7 @@ bool Loader::visit(const std::string& designator,
 }
 
 void Loader::add_logger(const std::string& default_level) {
+  logger_level_ = default_level;
   if (!config_.has("logger")) {
     auto&& section = config_.add("logger");
     section.add("library", "logger");
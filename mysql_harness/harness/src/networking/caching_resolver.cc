@@ -0,0 +1,221 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "networking/caching_resolver.h"
+#include "networking/resolver.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+
+namespace mysql_harness {
+
+CachingResolver::CachingResolver(size_t threads, Clock::duration positive_ttl,
+                                 Clock::duration negative_ttl, Lookup lookup)
+    : threads_(std::max<size_t>(threads, 1)), lookup_(std::move(lookup)),
+      positive_ttl_(positive_ttl), negative_ttl_(negative_ttl), stats_() {
+  if (!lookup_) {
+    lookup_ = [](const std::string &name) {
+      return Resolver().hostname(name);
+    };
+  }
+}
+
+CachingResolver::~CachingResolver() {
+  stop();
+}
+
+std::vector<IPAddress> CachingResolver::hostname(const std::string &name,
+                                                 Clock::duration timeout) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (stopping_) {
+    throw std::runtime_error("resolver stopped");
+  }
+
+  Entry &entry = entries_[name];
+  auto now = Clock::now();
+  if (entry.generation > 0 && now < entry.expires) {
+    entry.used = true;
+    if (now >= entry.refresh && !entry.queued) {
+      ++stats_.refreshes;
+      queue(name, &entry);
+    }
+    if (entry.error.empty()) {
+      ++stats_.hits;
+      return entry.addresses;
+    }
+    ++stats_.negative_hits;
+    throw std::invalid_argument(entry.error);
+  }
+
+  ++stats_.misses;
+  uint64_t generation = entry.generation;
+  queue(name, &entry);
+  if (!done_cond_.wait_until(lock, now + timeout, [this, &entry, generation] {
+        return stopping_ || entry.generation != generation;
+      })) {
+    ++stats_.timeouts;
+    throw std::system_error(std::make_error_code(std::errc::timed_out),
+                            "resolving '" + name + "' timed out");
+  }
+  if (stopping_) {
+    throw std::runtime_error("resolver stopped");
+  }
+
+  entry.used = true;
+  if (!entry.error.empty()) {
+    throw std::invalid_argument(entry.error);
+  }
+  return entry.addresses;
+}
+
+void CachingResolver::prefetch(const std::string &name) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (stopping_) {
+    return;
+  }
+
+  Entry &entry = entries_[name];
+  entry.used = true;
+  if (entry.generation == 0 || Clock::now() >= entry.refresh) {
+    queue(name, &entry);
+  }
+}
+
+void CachingResolver::set_ttl(Clock::duration positive_ttl,
+                              Clock::duration negative_ttl) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  positive_ttl_ = positive_ttl;
+  negative_ttl_ = negative_ttl;
+}
+
+CachingResolver::Stats CachingResolver::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats result = stats_;
+  result.entries = entries_.size();
+  return result;
+}
+
+void CachingResolver::stop() {
+  std::vector<std::thread> workers;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+    queue_.clear();
+    workers.swap(workers_);
+  }
+  work_cond_.notify_all();
+  done_cond_.notify_all();
+  for (auto &worker : workers) {
+    worker.join();
+  }
+}
+
+void CachingResolver::queue(const std::string &name, Entry *entry) {
+  if (entry->queued) {
+    return;
+  }
+  entry->queued = true;
+  queue_.push_back(name);
+
+  // Threads are started on demand, so that unused caches cost nothing
+  if (workers_.empty()) {
+    for (size_t i = 0; i < threads_; ++i) {
+      workers_.emplace_back(&CachingResolver::run_worker, this);
+    }
+  }
+  work_cond_.notify_one();
+}
+
+CachingResolver::Clock::time_point CachingResolver::queue_refreshes(Clock::time_point now) {
+  auto next = Clock::time_point::max();
+  for (auto &it : entries_) {
+    Entry &entry = it.second;
+    if (entry.queued || entry.generation == 0) {
+      continue;
+    }
+    if (entry.refresh > now) {
+      next = std::min(next, entry.refresh);
+    } else if (entry.used) {
+      ++stats_.refreshes;
+      entry.queued = true;
+      queue_.push_back(it.first);
+    }
+  }
+  return next;
+}
+
+void CachingResolver::run_worker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (!stopping_) {
+    if (queue_.empty()) {
+      auto next = queue_refreshes(Clock::now());
+      if (queue_.empty()) {
+        if (next == Clock::time_point::max()) {
+          work_cond_.wait(lock);
+        } else {
+          work_cond_.wait_until(lock, next);
+        }
+        continue;
+      }
+    }
+
+    std::string name = std::move(queue_.front());
+    queue_.pop_front();
+    lock.unlock();
+
+    std::vector<IPAddress> addresses;
+    std::string error;
+    try {
+      addresses = lookup_(name);
+      if (addresses.empty()) {
+        error = "no address found for " + name;
+      }
+    } catch (const std::exception &exc) {
+      error = exc.what();
+    }
+
+    lock.lock();
+    ++stats_.lookups;
+    Entry &entry = entries_[name];
+    auto now = Clock::now();
+    if (error.empty()) {
+      entry.addresses = std::move(addresses);
+      entry.error.clear();
+      entry.expires = now + positive_ttl_;
+      entry.refresh = now + positive_ttl_ * 3 / 4;
+      entry.used = false;
+    } else if (entry.error.empty() && entry.generation > 0 && now < entry.expires) {
+      // Failed refresh; the addresses are kept until they expire, trying
+      // again meanwhile
+      ++stats_.failures;
+      entry.refresh = std::min(entry.expires, now + negative_ttl_);
+    } else {
+      ++stats_.failures;
+      entry.addresses.clear();
+      entry.error = std::move(error);
+      entry.expires = now + negative_ttl_;
+      entry.refresh = now + negative_ttl_ * 3 / 4;
+      entry.used = false;
+    }
+    ++entry.generation;
+    entry.queued = false;
+    done_cond_.notify_all();
+  }
+}
+
+} // namespace mysql_harness
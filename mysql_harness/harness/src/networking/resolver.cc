@@ -25,6 +25,7 @@
 #  include <sys/socket.h>
 #endif
 #include <algorithm>
+#include <cstring>
 #include <string>
 #include <sys/types.h>
 #include <vector>
@@ -42,7 +43,8 @@ std::vector<IPAddress> Resolver::hostname(const char *name) const {
   hints.ai_family = AF_UNSPEC;
   hints.ai_socktype = SOCK_STREAM;
 
-  if (auto err = getaddrinfo(name, nullptr, &hints, &result) != 0) {
+  int err = getaddrinfo(name, nullptr, &hints, &result);
+  if (err != 0) {
     throw std::invalid_argument(std::string("hostname resolve failed for ")
                                 + name + ": " + gai_strerror(err));
   }
@@ -60,6 +62,7 @@ std::vector<IPAddress> Resolver::hostname(const char *name) const {
         IPv6Address(((struct sockaddr_in6*)res->ai_addr)->sin6_addr.s6_addr));
     }
   }
+  freeaddrinfo(result);
 
   return result_ips;
 }
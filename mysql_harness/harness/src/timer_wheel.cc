@@ -0,0 +1,174 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "timer_wheel.h"
+
+#include <stdexcept>
+
+namespace mysql_harness {
+
+TimerWheel::Timer::~Timer() {
+  TimerWheel *wheel = wheel_.load();
+  if (wheel != nullptr) {
+    wheel->cancel(this);
+  }
+}
+
+TimerWheel::TimerWheel(Clock::duration tick)
+    : tick_(tick), origin_(Clock::now()) {
+  if (tick <= Clock::duration::zero()) {
+    throw std::invalid_argument("Tick of timer wheel must be positive");
+  }
+}
+
+void TimerWheel::arm(Timer *timer, Clock::duration delay, Clock::time_point now) {
+  // Rounded up, so that timers never expire early
+  auto due = now + delay - origin_;
+  uint64_t expires = 0;
+  if (due > Clock::duration::zero()) {
+    expires = static_cast<uint64_t>((due + tick_ - Clock::duration(1)) / tick_);
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  uint64_t current = current_.load(std::memory_order_relaxed);
+  if (expires <= current) {
+    expires = current + 1;
+  } else if (expires - current >= kMaxTicks) {
+    expires = current + kMaxTicks - 1;
+  }
+
+  if (timer->state_ == Timer::State::kArmed || timer->state_ == Timer::State::kExpired) {
+    unlink(timer);
+  }
+  if (timer->state_ != Timer::State::kArmed) {
+    size_.fetch_add(1, std::memory_order_relaxed);
+  }
+  timer->expires_ = expires;
+  timer->state_ = Timer::State::kArmed;
+  timer->wheel_.store(this);
+  insert(timer);
+}
+
+bool TimerWheel::cancel(Timer *timer) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  switch (timer->state_) {
+    case Timer::State::kArmed:
+      size_.fetch_sub(1, std::memory_order_relaxed);
+      // fallthrough
+    case Timer::State::kExpired:
+      unlink(timer);
+      timer->state_ = Timer::State::kIdle;
+      timer->wheel_.store(nullptr);
+      return true;
+    case Timer::State::kRunning:
+      if (advancing_thread_ != std::this_thread::get_id()) {
+        cond_.wait(lock, [timer] { return timer->state_ != Timer::State::kRunning; });
+        // Re-armed by its callback
+        if (timer->state_ != Timer::State::kIdle) {
+          lock.unlock();
+          return cancel(timer);
+        }
+      }
+      return false;
+    case Timer::State::kIdle:
+      break;
+  }
+  return false;
+}
+
+void TimerWheel::advance(Clock::time_point now) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  uint64_t target = static_cast<uint64_t>((now - origin_) / tick_);
+  uint64_t current = current_.load(std::memory_order_relaxed);
+
+  while (current < target) {
+    ++current;
+    current_.store(current, std::memory_order_relaxed);
+
+    // Moves down the timers of the next slot of each wheel which
+    // completed a turn, the highest wheel first
+    for (int level = kLevels - 1; level > 0; --level) {
+      if ((current & ((uint64_t(1) << (level * kSlotBits)) - 1)) == 0) {
+        cascade(level);
+      }
+    }
+
+    Link *slot = &slots_[0][current & kSlotMask];
+    while (slot->next != slot) {
+      auto *timer = static_cast<Timer*>(slot->next);
+      unlink(timer);
+      link(&expired_, timer);
+      timer->state_ = Timer::State::kExpired;
+      size_.fetch_sub(1, std::memory_order_relaxed);
+    }
+  }
+
+  // Callbacks may arm and cancel timers, which cancel() can take out of
+  // the expired list meanwhile
+  advancing_thread_ = std::this_thread::get_id();
+  while (expired_.next != &expired_) {
+    auto *timer = static_cast<Timer*>(expired_.next);
+    unlink(timer);
+    timer->state_ = Timer::State::kRunning;
+
+    lock.unlock();
+    timer->callback_();
+    lock.lock();
+
+    if (timer->state_ == Timer::State::kRunning) {
+      timer->state_ = Timer::State::kIdle;
+      timer->wheel_.store(nullptr);
+    }
+    cond_.notify_all();
+  }
+  advancing_thread_ = std::thread::id();
+}
+
+void TimerWheel::link(Link *head, Link *link) noexcept {
+  link->prev = head->prev;
+  link->next = head;
+  head->prev->next = link;
+  head->prev = link;
+}
+
+void TimerWheel::unlink(Link *link) noexcept {
+  link->prev->next = link->next;
+  link->next->prev = link->prev;
+  link->prev = link;
+  link->next = link;
+}
+
+void TimerWheel::insert(Timer *timer) noexcept {
+  uint64_t delta = timer->expires_ - current_.load(std::memory_order_relaxed);
+  int level = 0;
+  while (level < kLevels - 1 && delta >= (uint64_t(1) << ((level + 1) * kSlotBits))) {
+    ++level;
+  }
+  link(&slots_[level][(timer->expires_ >> (level * kSlotBits)) & kSlotMask], timer);
+}
+
+void TimerWheel::cascade(int level) noexcept {
+  uint64_t current = current_.load(std::memory_order_relaxed);
+  Link *slot = &slots_[level][(current >> (level * kSlotBits)) & kSlotMask];
+  while (slot->next != slot) {
+    auto *timer = static_cast<Timer*>(slot->next);
+    unlink(timer);
+    insert(timer);
+  }
+}
+
+} // namespace mysql_harness
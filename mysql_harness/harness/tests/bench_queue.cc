@@ -0,0 +1,129 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/*
+ * Compares the throughput and latency of mysql_harness::queue and
+ * mysql_harness::mpmc_queue with as many producers as consumers.
+ *
+ * Usage: bench_queue [elements per run]
+ *
+ * Each element is the time it was pushed at; consumers measure the time
+ * it spent in the queue.
+ */
+
+#include "mpmc_queue.h"
+#include "queue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using std::chrono::steady_clock;
+
+namespace {
+
+const size_t kMPMCCapacity = 1024;
+
+int64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      steady_clock::now().time_since_epoch()).count();
+}
+
+struct Result {
+  double seconds;
+  std::vector<int64_t> latencies;
+};
+
+// Runs producers and consumers on the queue; pushing 0 stops a consumer
+template <class Queue>
+Result run(Queue *queue, int threads, size_t elements) {
+  size_t per_producer = elements / static_cast<size_t>(threads);
+  std::vector<std::vector<int64_t>> latencies(static_cast<size_t>(threads));
+  std::vector<std::thread> producers;
+  std::vector<std::thread> consumers;
+
+  auto start = steady_clock::now();
+  for (int i = 0; i < threads; ++i) {
+    auto *measured = &latencies[static_cast<size_t>(i)];
+    measured->reserve(per_producer * 2);
+    consumers.emplace_back([queue, measured] {
+      int64_t pushed;
+      while (queue->pop(&pushed) && pushed != 0) {
+        measured->push_back(now_ns() - pushed);
+      }
+    });
+    producers.emplace_back([queue, per_producer] {
+      for (size_t j = 0; j < per_producer; ++j) {
+        queue->push(now_ns());
+      }
+    });
+  }
+  for (auto &producer : producers)
+    producer.join();
+  for (int i = 0; i < threads; ++i)
+    queue->push(0);
+  for (auto &consumer : consumers)
+    consumer.join();
+
+  Result result;
+  result.seconds = std::chrono::duration<double>(steady_clock::now() - start).count();
+  for (auto &measured : latencies)
+    result.latencies.insert(result.latencies.end(), measured.begin(), measured.end());
+  std::sort(result.latencies.begin(), result.latencies.end());
+  return result;
+}
+
+void report(const char *name, int threads, const Result &result) {
+  const auto &latencies = result.latencies;
+  auto percentile = [&latencies](double p) {
+    return latencies.empty() ? 0 :
+        latencies[static_cast<size_t>(p * static_cast<double>(latencies.size() - 1))];
+  };
+  printf("%-12s %7d %14.0f %10lld %10lld %12lld\n", name, threads,
+         static_cast<double>(latencies.size()) / result.seconds,
+         static_cast<long long>(percentile(0.5)),
+         static_cast<long long>(percentile(0.99)),
+         static_cast<long long>(percentile(0.999)));
+  fflush(stdout);
+}
+
+}
+
+int main(int argc, char *argv[]) {
+  size_t elements = 1 << 20;
+  if (argc > 1) {
+    elements = static_cast<size_t>(strtoul(argv[1], nullptr, 10));
+  }
+
+  printf("%-12s %7s %14s %10s %10s %12s\n", "queue", "threads", "elements/s",
+         "p50 ns", "p99 ns", "p99.9 ns");
+  for (int threads = 1; threads <= 32; threads *= 2) {
+    {
+      mysql_harness::queue<int64_t> queue;
+      report("queue", threads, run(&queue, threads, elements));
+    }
+    {
+      mysql_harness::mpmc_queue<int64_t> queue(kMPMCCapacity);
+      report("mpmc_queue", threads, run(&queue, threads, elements));
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,38 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef STOPPABLE_INCLUDED
+#define STOPPABLE_INCLUDED
+
+#if defined(_MSC_VER) && defined(stoppable_EXPORTS)
+/* We are building this library */
+#  define STOPPABLE_API __declspec(dllexport)
+#elif defined(_MSC_VER)
+#  define STOPPABLE_API __declspec(dllimport)
+#else
+#  define STOPPABLE_API
+#endif
+
+extern "C" {
+  /** @brief Returns the number of sections running */
+  int STOPPABLE_API stoppable_running();
+
+  /** @brief Returns the number of times sections were started */
+  int STOPPABLE_API stoppable_started();
+}
+
+#endif /* STOPPABLE_INCLUDED */
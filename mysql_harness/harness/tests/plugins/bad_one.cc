@@ -56,5 +56,6 @@ extern "C" {
     deinit,
     nullptr,  // start
     nullptr,  // stop
+    nullptr,  // reload
   };
 }
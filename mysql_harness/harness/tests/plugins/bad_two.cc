@@ -57,5 +57,6 @@ extern "C" {
     deinit,
     nullptr,  // start
     nullptr,  // stop
+    nullptr,  // reload
   };
 }
@@ -41,7 +41,6 @@ using mysql_harness::Plugin;
 
 extern "C" {
   extern void EXAMPLE_IMPORT do_magic();
-  extern void EXAMPLE_IMPORT log_info(const char *, ...);
 }
 
 
@@ -75,6 +74,7 @@ extern "C" {
   deinit,
   start,    // start
   nullptr,  // stop
+  nullptr,  // reload
 };
 
 }
@@ -70,5 +70,6 @@ extern "C" {
   nullptr,  // deinit
   start,    // start
   nullptr,  // stop
+  nullptr,  // reload
 };
 }
@@ -0,0 +1,114 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mysql/harness/plugin.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+using mysql_harness::ARCHITECTURE_DESCRIPTOR;
+using mysql_harness::AppInfo;
+using mysql_harness::PLUGIN_ABI_VERSION;
+using mysql_harness::Plugin;
+
+#if defined(_MSC_VER) && defined(rendezvous_EXPORTS)
+/* We are building this library */
+#  define RENDEZVOUS_API __declspec(dllexport)
+#else
+#  define RENDEZVOUS_API
+#endif
+
+// The plugins rendezvous_one and rendezvous_two wait for each other in
+// init(), which only succeeds when they are initialized at the same time.
+// Initializing them one after the other would deadlock; instead, init()
+// fails after a while. The plugin rendezvous_after requires both and
+// fails unless they finished their initialization.
+static std::mutex g_mutex;
+static std::condition_variable g_cond;
+static int g_arrived = 0;
+static int g_finished = 0;
+
+static int rendezvous(const AppInfo*) {
+  std::unique_lock<std::mutex> lock(g_mutex);
+  ++g_arrived;
+  g_cond.notify_all();
+  if (!g_cond.wait_for(lock, std::chrono::seconds(10), []{ return g_arrived >= 2; }))
+    return 1;
+  ++g_finished;
+  return 0;
+}
+
+static int after(const AppInfo*) {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_finished == 2 ? 0 : 1;
+}
+
+static const char* after_requires[] = {
+  "rendezvous_one",
+  "rendezvous_two",
+};
+
+extern "C" {
+  Plugin RENDEZVOUS_API rendezvous_one = {
+  PLUGIN_ABI_VERSION,
+  ARCHITECTURE_DESCRIPTOR,
+  "A plugin initialized together with rendezvous_two",
+  VERSION_NUMBER(1, 0, 0),
+  0,
+  nullptr,
+  0,
+  nullptr,
+  rendezvous,  // init
+  nullptr,     // deinit
+  nullptr,     // start
+  nullptr,     // stop
+  nullptr,     // reload
+};
+
+  Plugin RENDEZVOUS_API rendezvous_two = {
+  PLUGIN_ABI_VERSION,
+  ARCHITECTURE_DESCRIPTOR,
+  "A plugin initialized together with rendezvous_one",
+  VERSION_NUMBER(1, 0, 0),
+  0,
+  nullptr,
+  0,
+  nullptr,
+  rendezvous,  // init
+  nullptr,     // deinit
+  nullptr,     // start
+  nullptr,     // stop
+  nullptr,     // reload
+};
+
+  Plugin RENDEZVOUS_API rendezvous_after = {
+  PLUGIN_ABI_VERSION,
+  ARCHITECTURE_DESCRIPTOR,
+  "A plugin initialized after rendezvous_one and rendezvous_two",
+  VERSION_NUMBER(1, 0, 0),
+  sizeof(after_requires) / sizeof(*after_requires),
+  after_requires,
+  0,
+  nullptr,
+  after,    // init
+  nullptr,  // deinit
+  nullptr,  // start
+  nullptr,  // stop
+  nullptr,  // reload
+};
+}
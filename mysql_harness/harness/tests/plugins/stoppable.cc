@@ -0,0 +1,99 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "stoppable.h"
+
+#include "mysql/harness/config_parser.h"
+#include "mysql/harness/plugin.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+
+using mysql_harness::ARCHITECTURE_DESCRIPTOR;
+using mysql_harness::ConfigSection;
+using mysql_harness::PLUGIN_ABI_VERSION;
+using mysql_harness::Plugin;
+
+// Sections run until stopped; stopping waits for the section to end,
+// like stopping routes does. Sections are known by key, since the loader
+// stops them using the section of the running configuration.
+static std::mutex g_mutex;
+static std::condition_variable g_cond;
+static std::set<std::string> g_stopping;
+static int g_running = 0;
+static int g_started = 0;
+
+extern "C" int STOPPABLE_API stoppable_running() {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_running;
+}
+
+extern "C" int STOPPABLE_API stoppable_started() {
+  std::lock_guard<std::mutex> lock(g_mutex);
+  return g_started;
+}
+
+static void start(const ConfigSection* section) {
+  std::unique_lock<std::mutex> lock(g_mutex);
+  ++g_running;
+  ++g_started;
+  g_cond.wait(lock, [section]{ return g_stopping.count(section->key) > 0; });
+  g_stopping.erase(section->key);
+  --g_running;
+  g_cond.notify_all();
+}
+
+static void stop(const ConfigSection* section) {
+  std::unique_lock<std::mutex> lock(g_mutex);
+  g_stopping.insert(section->key);
+  g_cond.notify_all();
+  g_cond.wait(lock, [section]{ return g_stopping.count(section->key) == 0; });
+  lock.unlock();
+
+  // Slow to return, giving the harness time to see the section ended
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+}
+
+// Values which are not numbers are rejected; other changes need a restart
+static int reload(const ConfigSection* section) {
+  auto value = section->get("value");
+  if (value.empty() || value.find_first_not_of("0123456789") != std::string::npos)
+    return -1;
+  return 1;
+}
+
+extern "C" {
+  Plugin STOPPABLE_API stoppable = {
+  PLUGIN_ABI_VERSION,
+  ARCHITECTURE_DESCRIPTOR,
+  "A plugin running until stopped",
+  VERSION_NUMBER(1, 0, 0),
+  0,
+  nullptr,
+  0,
+  nullptr,
+  nullptr,  // init
+  nullptr,  // deinit
+  start,    // start
+  stop,     // stop
+  reload,   // reload
+};
+}
@@ -0,0 +1,216 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "networking/caching_resolver.h"
+
+////////////////////////////////////////
+// Test system include files
+#include "test/helpers.h"
+
+////////////////////////////////////////
+// Third-party include files
+#include "gmock/gmock.h"
+
+////////////////////////////////////////
+// Standard include files
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+using mysql_harness::CachingResolver;
+using mysql_harness::IPAddress;
+
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+using testing::Contains;
+using testing::ElementsAre;
+using testing::Eq;
+
+class TestCachingResolver : public ::testing::Test {
+ protected:
+  // Resolves names starting with "bad" as failing, others to an address
+  // counting the lookups of the name
+  std::vector<IPAddress> lookup(const std::string &name) {
+    std::this_thread::sleep_for(delay);
+    std::lock_guard<std::mutex> lock(mutex);
+    ++lookups;
+    if (name.compare(0, 3, "bad") == 0 || failing) {
+      throw std::invalid_argument("hostname resolve failed for " + name);
+    }
+    return {IPAddress("10.0.0." + std::to_string(lookups.load()))};
+  }
+
+  CachingResolver::Lookup fake() {
+    return [this](const std::string &name) { return lookup(name); };
+  }
+
+  // Waits until a condition holds, giving up after 10 seconds
+  template<typename Condition>
+  static bool wait_for(Condition condition) {
+    auto deadline = std::chrono::steady_clock::now() + seconds(10);
+    while (!condition()) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+    return true;
+  }
+
+  std::mutex mutex;
+  std::atomic<int> lookups{0};
+  std::atomic<bool> failing{false};
+  milliseconds delay{0};
+};
+
+TEST_F(TestCachingResolver, Hit) {
+  CachingResolver resolver(2, seconds(60), seconds(5), fake());
+
+  EXPECT_THAT(resolver.hostname("db1", seconds(5)), ElementsAre(IPAddress("10.0.0.1")));
+  EXPECT_THAT(resolver.hostname("db1", seconds(5)), ElementsAre(IPAddress("10.0.0.1")));
+  EXPECT_THAT(resolver.hostname("db2", seconds(5)), ElementsAre(IPAddress("10.0.0.2")));
+
+  auto stats = resolver.stats();
+  EXPECT_THAT(stats.misses, Eq(2U));
+  EXPECT_THAT(stats.hits, Eq(1U));
+  EXPECT_THAT(stats.entries, Eq(2U));
+  EXPECT_THAT(lookups.load(), Eq(2));
+}
+
+TEST_F(TestCachingResolver, NegativeHit) {
+  CachingResolver resolver(2, seconds(60), seconds(60), fake());
+
+  EXPECT_THROW(resolver.hostname("bad", seconds(5)), std::invalid_argument);
+  EXPECT_THROW(resolver.hostname("bad", seconds(5)), std::invalid_argument);
+
+  auto stats = resolver.stats();
+  EXPECT_THAT(stats.misses, Eq(1U));
+  EXPECT_THAT(stats.negative_hits, Eq(1U));
+  EXPECT_THAT(stats.failures, Eq(1U));
+  EXPECT_THAT(lookups.load(), Eq(1));
+}
+
+TEST_F(TestCachingResolver, Expires) {
+  CachingResolver resolver(1, milliseconds(0), milliseconds(0), fake());
+
+  EXPECT_THAT(resolver.hostname("db1", seconds(5)), ElementsAre(IPAddress("10.0.0.1")));
+  EXPECT_THAT(resolver.hostname("db1", seconds(5)), ElementsAre(IPAddress("10.0.0.2")));
+  EXPECT_THAT(resolver.stats().misses, Eq(2U));
+}
+
+TEST_F(TestCachingResolver, ConcurrentMissesShareLookup) {
+  delay = milliseconds(100);
+  CachingResolver resolver(4, seconds(60), seconds(5), fake());
+
+  std::vector<std::thread> threads;
+  std::atomic<int> resolved{0};
+  for (int i = 0; i < 8; ++i) {
+    threads.emplace_back([&resolver, &resolved] {
+      if (resolver.hostname("db1", seconds(5)).size() == 1) {
+        ++resolved;
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  EXPECT_THAT(resolved.load(), Eq(8));
+  EXPECT_THAT(lookups.load(), Eq(1));
+}
+
+TEST_F(TestCachingResolver, Timeout) {
+  delay = milliseconds(300);
+  CachingResolver resolver(1, seconds(60), seconds(5), fake());
+
+  try {
+    resolver.hostname("db1", milliseconds(10));
+    FAIL() << "Expected timeout";
+  } catch (const std::system_error &exc) {
+    EXPECT_TRUE(exc.code() == std::errc::timed_out);
+  }
+  EXPECT_THAT(resolver.stats().timeouts, Eq(1U));
+
+  // The lookup went on, and the name is cached once it ended
+  EXPECT_THAT(resolver.hostname("db1", seconds(5)), ElementsAre(IPAddress("10.0.0.1")));
+  EXPECT_THAT(lookups.load(), Eq(1));
+}
+
+TEST_F(TestCachingResolver, RefreshInBackground) {
+  CachingResolver resolver(1, seconds(2), seconds(5), fake());
+
+  // Asked for, it is refreshed before it expires
+  EXPECT_THAT(resolver.hostname("db1", seconds(5)), ElementsAre(IPAddress("10.0.0.1")));
+  ASSERT_TRUE(wait_for([&resolver] { return resolver.stats().lookups == 2; }));
+
+  EXPECT_THAT(resolver.hostname("db1", seconds(5)), ElementsAre(IPAddress("10.0.0.2")));
+  auto stats = resolver.stats();
+  EXPECT_THAT(stats.misses, Eq(1U));
+  EXPECT_THAT(stats.refreshes, Eq(1U));
+}
+
+TEST_F(TestCachingResolver, FailedRefreshKeepsAddresses) {
+  CachingResolver resolver(1, seconds(2), milliseconds(50), fake());
+
+  resolver.hostname("db1", seconds(5));
+  failing = true;
+  ASSERT_TRUE(wait_for([&resolver] { return resolver.stats().failures >= 1; }));
+  EXPECT_THAT(resolver.hostname("db1", seconds(5)), ElementsAre(IPAddress("10.0.0.1")));
+
+  // Once expired, the failure is cached
+  ASSERT_TRUE(wait_for([&resolver] {
+    try {
+      resolver.hostname("db1", seconds(5));
+      return false;
+    } catch (const std::invalid_argument &) {
+      return true;
+    }
+  }));
+  EXPECT_THROW(resolver.hostname("db1", seconds(5)), std::invalid_argument);
+}
+
+TEST_F(TestCachingResolver, Prefetch) {
+  CachingResolver resolver(1, seconds(60), seconds(5), fake());
+
+  resolver.prefetch("db1");
+  resolver.prefetch("db1");
+  ASSERT_TRUE(wait_for([&resolver] { return resolver.stats().lookups == 1; }));
+  EXPECT_THAT(resolver.hostname("db1", seconds(5)), ElementsAre(IPAddress("10.0.0.1")));
+  EXPECT_THAT(resolver.stats().misses, Eq(0U));
+  EXPECT_THAT(lookups.load(), Eq(1));
+}
+
+TEST_F(TestCachingResolver, Stop) {
+  CachingResolver resolver(1, seconds(60), seconds(5), fake());
+
+  resolver.stop();
+  EXPECT_THROW(resolver.hostname("db1", seconds(5)), std::runtime_error);
+}
+
+TEST(TestCachingResolverLookup, Localhost) {
+  CachingResolver resolver;
+
+  // Some systems have both IPv4 and IPv6 for 'localhost'
+  auto result = resolver.hostname("localhost", seconds(10));
+  EXPECT_THAT(result, testing::AnyOf(Contains(IPAddress("127.0.0.1")),
+                                     Contains(IPAddress("::1"))));
+}
@@ -0,0 +1,204 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "executor.h"
+
+////////////////////////////////////////
+// Test system include files
+#include "test/helpers.h"
+
+////////////////////////////////////////
+// Third-party include files
+#include "gmock/gmock.h"
+
+////////////////////////////////////////
+// Standard include files
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+using mysql_harness::Executor;
+
+using std::chrono::milliseconds;
+
+using testing::Eq;
+using testing::Ge;
+
+namespace {
+
+// Waits for a condition set by tasks, at most a few seconds
+template <class Predicate>
+bool wait_for(Predicate predicate) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+  while (!predicate()) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  return true;
+}
+
+}
+
+TEST(TestExecutor, ThreadCount) {
+  EXPECT_THAT(Executor(3).thread_count(), Eq(3U));
+  EXPECT_THAT(Executor().thread_count(), Ge(2U));
+}
+
+TEST(TestExecutor, PostRunsTasks) {
+  Executor executor(4);
+  std::atomic<int> count{0};
+  for (int i = 0 ; i < 1000 ; ++i)
+    executor.post("test", [&count]{ ++count; });
+  EXPECT_TRUE(wait_for([&count]{ return count == 1000; }));
+}
+
+TEST(TestExecutor, StopRunsQueuedTasks) {
+  std::atomic<int> count{0};
+  {
+    Executor executor(2);
+    for (int i = 0 ; i < 100 ; ++i)
+      executor.post("test", [&count]{ ++count; });
+  }
+  EXPECT_THAT(count.load(), Eq(100));
+}
+
+TEST(TestExecutor, PostAfterStopThrows) {
+  Executor executor(1);
+  executor.stop();
+  EXPECT_THROW(executor.post("test", []{}), std::runtime_error);
+  EXPECT_THROW(executor.schedule_after("test", milliseconds(1), []{}),
+               std::runtime_error);
+}
+
+TEST(TestExecutor, TasksPostedByTasks) {
+  Executor executor(2);
+  std::atomic<int> count{0};
+  executor.post("test", [&executor, &count]{
+    for (int i = 0 ; i < 100 ; ++i)
+      executor.post("test", [&count]{ ++count; });
+  });
+  EXPECT_TRUE(wait_for([&count]{ return count == 100; }));
+}
+
+TEST(TestExecutor, OwnersAreServedInTurn) {
+  // With one worker blocked on the first task, the task of the second
+  // owner must run before the remaining ones of the first owner.
+  Executor executor(1);
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool released = false;
+  std::atomic<int> first_done{0};
+  std::atomic<int> first_done_before_second{-1};
+
+  executor.post("first", [&]{
+    std::unique_lock<std::mutex> lock(mutex);
+    cond.wait(lock, [&released]{ return released; });
+  });
+  for (int i = 0 ; i < 10 ; ++i)
+    executor.post("first", [&first_done]{ ++first_done; });
+  executor.post("second", [&]{ first_done_before_second = first_done.load(); });
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    released = true;
+  }
+  cond.notify_all();
+  EXPECT_TRUE(wait_for([&]{ return first_done == 10; }));
+  EXPECT_THAT(first_done_before_second.load(), Eq(0));
+}
+
+TEST(TestExecutor, ScheduleAfter) {
+  Executor executor(2);
+  std::atomic<bool> done{false};
+  auto start = std::chrono::steady_clock::now();
+  std::chrono::steady_clock::time_point ran;
+  executor.schedule_after("test", milliseconds(50), [&]{
+    ran = std::chrono::steady_clock::now();
+    done = true;
+  });
+  EXPECT_TRUE(wait_for([&done]{ return done.load(); }));
+  EXPECT_GE(ran - start, milliseconds(50));
+
+  // Expired timers are not listed anymore
+  EXPECT_TRUE(wait_for([&executor]{ return executor.stats()[0].timers == 0; }));
+}
+
+TEST(TestExecutor, ScheduleEveryAndCancel) {
+  Executor executor(2);
+  std::atomic<int> count{0};
+  auto id = executor.schedule_every("test", milliseconds(5), [&count]{ ++count; });
+  EXPECT_THROW(executor.schedule_every("test", milliseconds(0), []{}),
+               std::invalid_argument);
+
+  EXPECT_TRUE(wait_for([&count]{ return count >= 3; }));
+  executor.cancel(id);
+  int cancelled_at = count;
+  std::this_thread::sleep_for(milliseconds(50));
+  EXPECT_THAT(count.load(), Eq(cancelled_at));
+}
+
+TEST(TestExecutor, CancelWaitsForRunningTask) {
+  Executor executor(2);
+  std::atomic<bool> started{false};
+  std::atomic<bool> finished{false};
+  auto id = executor.schedule_after("test", milliseconds(1), [&]{
+    started = true;
+    std::this_thread::sleep_for(milliseconds(50));
+    finished = true;
+  });
+  EXPECT_TRUE(wait_for([&started]{ return started.load(); }));
+  executor.cancel(id);
+  EXPECT_TRUE(finished);
+}
+
+TEST(TestExecutor, CancelFromTask) {
+  Executor executor(2);
+  std::atomic<int> count{0};
+  std::atomic<Executor::TimerId> id{0};
+  id = executor.schedule_every("test", milliseconds(1), [&]{
+    while (id == 0)
+      std::this_thread::yield();
+    ++count;
+    executor.cancel(id);
+  });
+  std::this_thread::sleep_for(milliseconds(50));
+  EXPECT_THAT(count.load(), Eq(1));
+}
+
+TEST(TestExecutor, Stats) {
+  Executor executor(1);
+  std::atomic<int> count{0};
+  executor.post("first", [&count]{ ++count; });
+  executor.post("second", [&count]{ ++count; });
+  executor.post("second", [&count]{ ++count; });
+  executor.schedule_after("second", std::chrono::hours(1), []{});
+  EXPECT_TRUE(wait_for([&count]{ return count == 3; }));
+
+  auto stats = executor.stats();
+  ASSERT_THAT(stats.size(), Eq(2U));
+  EXPECT_THAT(stats[0].owner, Eq("first"));
+  EXPECT_TRUE(wait_for([&executor]{ return executor.stats()[1].executed == 2; }));
+  stats = executor.stats();
+  EXPECT_THAT(stats[0].executed, Eq(1U));
+  EXPECT_THAT(stats[1].owner, Eq("second"));
+  EXPECT_THAT(stats[1].queued, Eq(0U));
+  EXPECT_THAT(stats[1].timers, Eq(1U));
+}
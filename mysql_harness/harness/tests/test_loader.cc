@@ -25,6 +25,7 @@
 ////////////////////////////////////////
 // Test plugin include files
 #include "magic.h"
+#include "stoppable.h"
 
 ////////////////////////////////////////
 // Test system include files
@@ -37,10 +38,17 @@
 ////////////////////////////////////////
 // Standard include files
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
 #include <cstdlib>
 #include <cstring>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 using std::cout;
@@ -135,6 +143,210 @@ TEST(TestStart, StartFailure) {
   EXPECT_THROW(loader.start(), bad_suki);
 }
 
+class TestReload : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    std::map<std::string, std::string> params;
+    params["program"] = "harness";
+    params["prefix"] = g_here.c_str();
+
+    // A copy of the configuration, which the tests change
+    std::ifstream input(g_here.join("data/tests-start-1.cfg").str());
+    config.assign(std::istreambuf_iterator<char>(input),
+                  std::istreambuf_iterator<char>());
+    path = g_here.join("data/tests-reload.cfg");
+    write_config();
+
+    loader.reset(new Loader("harness", params));
+    loader->read(path);
+    for (auto& name : loader->available())
+      loader->load(name.first, name.second);
+  }
+
+  virtual void TearDown() {
+    loader.reset();
+    std::remove(path.c_str());
+  }
+
+  void write_config() {
+    std::ofstream output(path.str());
+    output << config;
+  }
+
+  std::string config;
+  Path path;
+  std::unique_ptr<Loader> loader;
+};
+
+TEST_F(TestReload, Unchanged) {
+  EXPECT_TRUE(loader->reload().empty());
+}
+
+TEST_F(TestReload, PluginNotLoaded) {
+  config += "\n[example:one]\nlibrary = example\n";
+  write_config();
+  EXPECT_THROW(loader->reload(), bad_section);
+}
+
+TEST_F(TestReload, ChangeNeedsRestart) {
+  // The magic plugin can neither reload nor stop its section
+  config.replace(config.find("It is some kind of magic"), 24, "Magic changed");
+  write_config();
+  auto not_applied = loader->reload();
+  ASSERT_EQ(1U, not_applied.size());
+  EXPECT_EQ("magic", not_applied.front().first);
+
+  // Not reported again
+  EXPECT_TRUE(loader->reload().empty());
+}
+
+// Waits for a condition for up to 10 seconds
+template <class Condition>
+static bool wait_for(Condition condition) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!condition()) {
+    if (std::chrono::steady_clock::now() > deadline)
+      return false;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return true;
+}
+
+class TestReloadRunning : public TestReload {
+ protected:
+  virtual void SetUp() {
+    TestReload::SetUp();
+
+    // Only the stoppable plugin has sections to run
+    config.erase(config.find("[magic]"));
+    config += "[stoppable]\nvalue = 1\n";
+    write_config();
+
+    std::map<std::string, std::string> params;
+    params["program"] = "harness";
+    params["prefix"] = g_here.c_str();
+    loader.reset(new Loader("harness", params));
+    loader->read(path);
+
+    starter = std::thread([this]{
+      try {
+        loader->start();
+      } catch (...) {
+        failed = true;
+      }
+      started = false;
+    });
+    ASSERT_TRUE(wait_for([]{ return stoppable_running() == 1; }));
+  }
+
+  virtual void TearDown() {
+    if (starter.joinable()) {
+      // Stops the sections still running
+      config.erase(config.find("[stoppable]"));
+      write_config();
+      loader->reload();
+      starter.join();
+    }
+    TestReload::TearDown();
+  }
+
+  std::thread starter;
+  std::atomic<bool> started{true};
+  std::atomic<bool> failed{false};
+};
+
+TEST_F(TestReloadRunning, RestartOnlySection) {
+  int starts = stoppable_started();
+
+  // Stopped before started again: the harness keeps running meanwhile
+  config.replace(config.find("value = 1"), 9, "value = 2");
+  write_config();
+  EXPECT_TRUE(loader->reload().empty());
+  EXPECT_TRUE(wait_for([starts]{
+    return stoppable_started() == starts + 1 && stoppable_running() == 1;
+  }));
+  EXPECT_TRUE(started);
+}
+
+TEST_F(TestReloadRunning, RejectedChange) {
+  int starts = stoppable_started();
+
+  config.replace(config.find("value = 1"), 9, "value = x");
+  write_config();
+  auto not_applied = loader->reload();
+  ASSERT_EQ(1U, not_applied.size());
+  EXPECT_EQ("stoppable", not_applied.front().first);
+  EXPECT_EQ(starts, stoppable_started());
+  EXPECT_EQ(1, stoppable_running());
+
+  // The previous options are kept, so the change is reported again
+  EXPECT_EQ(1U, loader->reload().size());
+
+  config.replace(config.find("value = x"), 9, "value = 2");
+  write_config();
+  EXPECT_TRUE(loader->reload().empty());
+  EXPECT_TRUE(wait_for([starts]{
+    return stoppable_started() == starts + 1 && stoppable_running() == 1;
+  }));
+  EXPECT_TRUE(started);
+}
+
+TEST_F(TestReloadRunning, RemoveAndAdd) {
+  int starts = stoppable_started();
+
+  config.replace(config.find("[stoppable]"), 11, "[stoppable:other]");
+  write_config();
+  EXPECT_TRUE(loader->reload().empty());
+  EXPECT_TRUE(wait_for([starts]{
+    return stoppable_started() == starts + 1 && stoppable_running() == 1;
+  }));
+  EXPECT_TRUE(started);
+
+  // Once the last section is removed, the harness stops
+  config.erase(config.find("[stoppable:other]"));
+  write_config();
+  EXPECT_TRUE(loader->reload().empty());
+  starter.join();
+  EXPECT_FALSE(failed);
+  EXPECT_EQ(0, stoppable_running());
+
+  // Nothing to reload once stopped
+  EXPECT_THROW(loader->reload(), std::runtime_error);
+}
+
+TEST(TestStart, InitTimes) {
+  std::map<std::string, std::string> params;
+  params["program"] = "harness";
+  params["prefix"] = g_here.c_str();
+
+  // Initialized before the start of the magic plugin fails
+  Loader loader("harness", params);
+  loader.read(g_here.join("data/tests-start-1.cfg"));
+  EXPECT_THROW(loader.start(), bad_suki);
+
+  auto init_times = loader.init_times();
+  EXPECT_EQ(2U, init_times.size());
+  EXPECT_EQ(1U, init_times.count("logger"));
+  EXPECT_EQ(1U, init_times.count("magic"));
+}
+
+TEST(TestStart, InitConcurrently) {
+  std::map<std::string, std::string> params;
+  params["program"] = "harness";
+  params["prefix"] = g_here.c_str();
+
+  // The rendezvous plugins fail to initialize unless the pair is
+  // initialized at the same time, and the plugin requiring them only
+  // after both finished
+  Loader loader("harness", params);
+  loader.read(g_here.join("data/tests-init-1.cfg"));
+  EXPECT_NO_THROW(loader.start());
+
+  auto init_times = loader.init_times();
+  EXPECT_EQ(4U, init_times.size());
+  EXPECT_EQ(1U, init_times.count("rendezvous_after"));
+}
+
 const char *bad_cfgs[] = {
   "data/tests-bad-1.cfg",
   "data/tests-bad-2.cfg",
@@ -0,0 +1,224 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "mpmc_queue.h"
+
+////////////////////////////////////////
+// Test system include files
+#include "test/helpers.h"
+
+////////////////////////////////////////
+// Third-party include files
+#include "gmock/gmock.h"
+
+////////////////////////////////////////
+// Standard include files
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using mysql_harness::mpmc_queue;
+
+using std::chrono::milliseconds;
+using std::thread;
+
+using testing::Eq;
+
+TEST(TestMPMCQueue, CapacityIsPowerOfTwo) {
+  EXPECT_THAT(mpmc_queue<int>(1).capacity(), Eq(2U));
+  EXPECT_THAT(mpmc_queue<int>(8).capacity(), Eq(8U));
+  EXPECT_THAT(mpmc_queue<int>(100).capacity(), Eq(128U));
+}
+
+TEST(TestMPMCQueue, FirstInFirstOut) {
+  mpmc_queue<int> my_queue(16);
+  for (int i = 0 ; i < 10 ; ++i)
+    my_queue.push(i);
+  EXPECT_THAT(my_queue.size(), Eq(10U));
+
+  for (int i = 0 ; i < 10 ; ++i) {
+    int value = -1;
+    EXPECT_TRUE(my_queue.pop(&value));
+    EXPECT_THAT(value, Eq(i));
+  }
+  EXPECT_TRUE(my_queue.empty());
+}
+
+TEST(TestMPMCQueue, TryPushFull) {
+  mpmc_queue<int> my_queue(4);
+  for (int i = 0 ; i < 4 ; ++i)
+    EXPECT_TRUE(my_queue.try_push(i));
+  EXPECT_FALSE(my_queue.try_push(4));
+
+  int value;
+  EXPECT_TRUE(my_queue.try_pop(&value));
+  EXPECT_THAT(value, Eq(0));
+  EXPECT_TRUE(my_queue.try_push(4));
+}
+
+TEST(TestMPMCQueue, TryPopEmpty) {
+  mpmc_queue<int> my_queue(4);
+  int value = 42;
+  EXPECT_FALSE(my_queue.try_pop(&value));
+  EXPECT_THAT(value, Eq(42));
+}
+
+TEST(TestMPMCQueue, PopTimeout) {
+  mpmc_queue<int> my_queue(4);
+  int value;
+  auto start = std::chrono::steady_clock::now();
+  EXPECT_FALSE(my_queue.pop(&value, milliseconds(50)));
+  EXPECT_GE(std::chrono::steady_clock::now() - start, milliseconds(50));
+}
+
+TEST(TestMPMCQueue, PopWaitsForPush) {
+  mpmc_queue<int> my_queue(4);
+  thread producer([&my_queue]{
+    std::this_thread::sleep_for(milliseconds(50));
+    my_queue.push(7);
+  });
+  int value = 0;
+  EXPECT_TRUE(my_queue.pop(&value));
+  EXPECT_THAT(value, Eq(7));
+  producer.join();
+}
+
+TEST(TestMPMCQueue, PushWaitsForPop) {
+  mpmc_queue<int> my_queue(2);
+  my_queue.push(1);
+  my_queue.push(2);
+  thread consumer([&my_queue]{
+    std::this_thread::sleep_for(milliseconds(50));
+    int value;
+    my_queue.pop(&value);
+  });
+  my_queue.push(3);
+  consumer.join();
+  EXPECT_THAT(my_queue.size(), Eq(2U));
+}
+
+TEST(TestMPMCQueue, MoveOnlyElements) {
+  mpmc_queue<std::unique_ptr<int>> my_queue(4);
+  std::unique_ptr<int> ptr(new int(5));
+  EXPECT_TRUE(my_queue.try_push(std::move(ptr)));
+  std::unique_ptr<int> result;
+  EXPECT_TRUE(my_queue.try_pop(&result));
+  EXPECT_THAT(*result, Eq(5));
+}
+
+TEST(TestMPMCQueue, DestroysElementsLeft) {
+  auto value = std::make_shared<int>(1);
+  {
+    mpmc_queue<std::shared_ptr<int>> my_queue(4);
+    my_queue.push(value);
+    my_queue.push(value);
+    EXPECT_THAT(value.use_count(), Eq(3));
+  }
+  EXPECT_THAT(value.use_count(), Eq(1));
+}
+
+TEST(TestMPMCQueue, ProducersConsumers) {
+  const int kThreads = 8;
+  const int kPerProducer = 20000;
+  mpmc_queue<int> my_queue(64);
+  std::vector<thread> producers;
+  std::vector<thread> consumers;
+  std::vector<long long> sums(kThreads, 0);
+  std::vector<int> counts(kThreads, 0);
+
+  for (int i = 0 ; i < kThreads ; ++i) {
+    producers.emplace_back([&my_queue]{
+      for (int j = 1 ; j <= kPerProducer ; ++j)
+        my_queue.push(j);
+    });
+    consumers.emplace_back([&my_queue, &sums, &counts, i]{
+      int value;
+      while (my_queue.pop(&value) && value != 0) {
+        sums[i] += value;
+        ++counts[i];
+      }
+    });
+  }
+  for (auto& producer : producers)
+    producer.join();
+  // One end marker per consumer
+  for (int i = 0 ; i < kThreads ; ++i)
+    my_queue.push(0);
+  for (auto& consumer : consumers)
+    consumer.join();
+
+  long long sum = 0;
+  int count = 0;
+  for (int i = 0 ; i < kThreads ; ++i) {
+    sum += sums[i];
+    count += counts[i];
+  }
+  EXPECT_THAT(count, Eq(kThreads * kPerProducer));
+  EXPECT_THAT(sum, Eq(static_cast<long long>(kThreads) * kPerProducer * (kPerProducer + 1) / 2));
+}
+
+// Sleeps when copied, which the queue does once it claimed a cell, so that
+// other threads run meanwhile
+struct Sleeping {
+  Sleeping(int v = 0) : value(v) {}  // NOLINT(runtime/explicit)
+  Sleeping(const Sleeping& other) : value(other.value) {
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+  }
+  Sleeping& operator=(const Sleeping& other) {
+    value = other.value;
+    std::this_thread::sleep_for(std::chrono::microseconds(10));
+    return *this;
+  }
+
+  int value;
+};
+
+TEST(TestMPMCQueue, BlockingContention) {
+  // Few cells, so that producers and consumers park on both sides at once
+  const int kThreads = 8;
+  const int kPerProducer = 500;
+  const int kRounds = 10;
+  mpmc_queue<Sleeping> my_queue(2);
+
+  for (int round = 0 ; round < kRounds ; ++round) {
+    std::vector<thread> threads;
+    std::vector<long long> sums(kThreads, 0);
+    for (int i = 0 ; i < kThreads ; ++i) {
+      threads.emplace_back([&my_queue]{
+        for (int j = 1 ; j <= kPerProducer ; ++j)
+          my_queue.push(Sleeping(j));
+      });
+      threads.emplace_back([&my_queue, &sums, i]{
+        Sleeping item;
+        for (int j = 0 ; j < kPerProducer ; ++j) {
+          my_queue.pop(&item);
+          sums[i] += item.value;
+        }
+      });
+    }
+    for (auto& thr : threads)
+      thr.join();
+
+    long long sum = 0;
+    for (auto partial : sums)
+      sum += partial;
+    ASSERT_THAT(sum, Eq(static_cast<long long>(kThreads) * kPerProducer * (kPerProducer + 1) / 2))
+        << "round " << round;
+    ASSERT_TRUE(my_queue.empty());
+  }
+}
@@ -0,0 +1,219 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "timer_wheel.h"
+
+////////////////////////////////////////
+// Test system include files
+#include "test/helpers.h"
+
+////////////////////////////////////////
+// Third-party include files
+#include "gmock/gmock.h"
+
+////////////////////////////////////////
+// Standard include files
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using mysql_harness::TimerWheel;
+
+using std::chrono::milliseconds;
+
+using testing::Eq;
+
+class TestTimerWheel : public ::testing::Test {
+ protected:
+  TestTimerWheel() : wheel(kTick), start(wheel.now()) {}
+
+  // Arms a timer at the time the wheel advanced to, not the clock
+  void arm(TimerWheel::Timer *timer, TimerWheel::Clock::duration delay) {
+    wheel.arm(timer, delay, wheel.now());
+  }
+
+  // Advances the wheel to the given tick
+  void advance_to(uint64_t tick) {
+    wheel.advance(start + kTick * static_cast<TimerWheel::Clock::rep>(tick));
+  }
+
+  static constexpr milliseconds kTick{10};
+
+  TimerWheel wheel;
+  TimerWheel::Clock::time_point start;
+};
+
+constexpr milliseconds TestTimerWheel::kTick;
+
+TEST_F(TestTimerWheel, ExpiresAfterDelay) {
+  int fired = 0;
+  TimerWheel::Timer timer([&fired]{ ++fired; });
+  arm(&timer, milliseconds(100));
+  EXPECT_THAT(wheel.size(), Eq(1U));
+
+  advance_to(9);
+  EXPECT_THAT(fired, Eq(0));
+  advance_to(10);
+  EXPECT_THAT(fired, Eq(1));
+  EXPECT_THAT(wheel.size(), Eq(0U));
+  EXPECT_TRUE(wheel.now() == start + milliseconds(100));
+
+  advance_to(1000);
+  EXPECT_THAT(fired, Eq(1));
+}
+
+TEST_F(TestTimerWheel, DelayRoundedUp) {
+  int fired = 0;
+  TimerWheel::Timer timer([&fired]{ ++fired; });
+  arm(&timer, milliseconds(11));
+  advance_to(1);
+  EXPECT_THAT(fired, Eq(0));
+  advance_to(2);
+  EXPECT_THAT(fired, Eq(1));
+
+  // At least one tick
+  arm(&timer, milliseconds(0));
+  advance_to(3);
+  EXPECT_THAT(fired, Eq(2));
+
+  // Counted from the time of arming, not the tick the wheel advanced to
+  wheel.arm(&timer, milliseconds(100), start + milliseconds(35));
+  advance_to(13);
+  EXPECT_THAT(fired, Eq(2));
+  advance_to(14);
+  EXPECT_THAT(fired, Eq(3));
+}
+
+TEST_F(TestTimerWheel, Cancel) {
+  int fired = 0;
+  TimerWheel::Timer timer([&fired]{ ++fired; });
+  arm(&timer, milliseconds(50));
+  EXPECT_TRUE(wheel.cancel(&timer));
+  EXPECT_FALSE(wheel.cancel(&timer));
+  EXPECT_THAT(wheel.size(), Eq(0U));
+  advance_to(100);
+  EXPECT_THAT(fired, Eq(0));
+}
+
+TEST_F(TestTimerWheel, Rearm) {
+  int fired = 0;
+  TimerWheel::Timer timer([&fired]{ ++fired; });
+  arm(&timer, milliseconds(50));
+  arm(&timer, milliseconds(200));
+  EXPECT_THAT(wheel.size(), Eq(1U));
+  advance_to(19);
+  EXPECT_THAT(fired, Eq(0));
+  advance_to(20);
+  EXPECT_THAT(fired, Eq(1));
+}
+
+TEST_F(TestTimerWheel, CallbackRearms) {
+  int fired = 0;
+  std::unique_ptr<TimerWheel::Timer> timer;
+  timer.reset(new TimerWheel::Timer([&]{
+    if (++fired < 3)
+      arm(timer.get(), kTick);
+  }));
+  arm(timer.get(), kTick);
+  for (uint64_t tick = 1 ; tick <= 10 ; ++tick)
+    advance_to(tick);
+  EXPECT_THAT(fired, Eq(3));
+  EXPECT_THAT(wheel.size(), Eq(0U));
+}
+
+TEST_F(TestTimerWheel, DestructorCancels) {
+  int fired = 0;
+  {
+    TimerWheel::Timer timer([&fired]{ ++fired; });
+    arm(&timer, milliseconds(50));
+  }
+  EXPECT_THAT(wheel.size(), Eq(0U));
+  advance_to(100);
+  EXPECT_THAT(fired, Eq(0));
+}
+
+TEST_F(TestTimerWheel, LongDelays) {
+  // Timers in each of the wheels, expiring exactly on time
+  const uint64_t delays[] = {255, 256, 257, 65535, 65536, 65537, 70000,
+                             (1 << 24) + 3};
+  for (uint64_t delay : delays) {
+    uint64_t now = static_cast<uint64_t>((wheel.now() - start) / kTick);
+    bool fired = false;
+    TimerWheel::Timer timer([&fired]{ fired = true; });
+    arm(&timer, kTick * static_cast<TimerWheel::Clock::rep>(delay));
+    advance_to(now + delay - 1);
+    EXPECT_FALSE(fired) << delay;
+    advance_to(now + delay);
+    EXPECT_TRUE(fired) << delay;
+  }
+}
+
+TEST_F(TestTimerWheel, ManyTimers) {
+  const size_t kTimers = 10000;
+  const uint64_t kMaxDelay = 300000;
+  std::mt19937 random(42);
+  std::uniform_int_distribution<uint64_t> delays(1, kMaxDelay);
+
+  std::vector<uint64_t> expected(kTimers);
+  std::vector<uint64_t> fired_at(kTimers, 0);
+  std::vector<std::unique_ptr<TimerWheel::Timer>> timers;
+  uint64_t tick = 0;
+  for (size_t i = 0 ; i < kTimers ; ++i) {
+    expected[i] = delays(random);
+    timers.emplace_back(new TimerWheel::Timer([&fired_at, &tick, i]{ fired_at[i] = tick; }));
+    arm(timers.back().get(), kTick * static_cast<TimerWheel::Clock::rep>(expected[i]));
+  }
+  EXPECT_THAT(wheel.size(), Eq(kTimers));
+
+  for (tick = 1 ; tick <= kMaxDelay ; ++tick)
+    advance_to(tick);
+  EXPECT_THAT(wheel.size(), Eq(0U));
+  EXPECT_THAT(fired_at, Eq(expected));
+}
+
+TEST_F(TestTimerWheel, CancelWaitsForCallback) {
+  std::atomic<bool> started{false};
+  std::atomic<bool> finished{false};
+  TimerWheel::Timer timer([&]{
+    started = true;
+    std::this_thread::sleep_for(milliseconds(50));
+    finished = true;
+  });
+  arm(&timer, kTick);
+  std::thread advancing([this]{ advance_to(1); });
+  while (!started)
+    std::this_thread::yield();
+  EXPECT_FALSE(wheel.cancel(&timer));
+  EXPECT_TRUE(finished);
+  advancing.join();
+}
+
+TEST_F(TestTimerWheel, CancelFromCallback) {
+  int fired = 0;
+  std::unique_ptr<TimerWheel::Timer> timer;
+  timer.reset(new TimerWheel::Timer([&]{
+    ++fired;
+    wheel.cancel(timer.get());
+  }));
+  arm(timer.get(), kTick);
+  advance_to(5);
+  EXPECT_THAT(fired, Eq(1));
+}
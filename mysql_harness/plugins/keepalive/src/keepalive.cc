@@ -83,7 +83,7 @@ static void start(const ConfigSection *section) {
   }
 
   for (int total_runs = 0 ; runs == 0 || total_runs < runs ; ++total_runs) {
-    log_info(name.c_str());
+    log_info("%s", name.c_str());
     std::this_thread::sleep_for(std::chrono::seconds(interval));
   }
 }
@@ -111,5 +111,6 @@ Plugin DLLEXPORT keepalive = {
   nullptr,     // deinit
   start,       // start
   nullptr,     // stop
+  nullptr,     // reload
 };
 }
@@ -0,0 +1,812 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "flight_recorder.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+# include <fcntl.h>
+# include <signal.h>
+# include <unistd.h>
+#else
+# include <io.h>
+#endif
+
+namespace {
+
+/** @brief Maximum number of arguments kept per event */
+const size_t kMaxArgs = 8;
+
+/** @brief Bytes available per event for copies of string arguments */
+const size_t kStringBytes = 96;
+
+const char *const kLevelNames[] = {"FATAL", "ERROR", "WARNING", "INFO", "DEBUG"};
+
+enum class ArgKind : uint8_t {
+  kSigned,
+  kUnsigned,
+  kDouble,
+  kString,
+  kPointer,
+};
+
+/** @brief Recorded event; plain data copied as a whole when dumped */
+struct EventData {
+  int64_t time_us;
+  uint64_t thread;
+  const char *fmt;
+  uint8_t level;
+  uint8_t arg_count;
+  ArgKind kinds[kMaxArgs];
+  union {
+    long long i;
+    unsigned long long u;
+    double d;
+    const void *p;
+    size_t offset;  // of a string argument in `strings`
+  } args[kMaxArgs];
+  char strings[kStringBytes];
+};
+
+/** @brief Slot of a ring; the sequence is odd while the event is written */
+struct Event {
+  std::atomic<uint32_t> sequence{0};
+  EventData data;
+};
+
+struct ThreadRing {
+  explicit ThreadRing(size_t count) : events(new Event[count]), size(count) {}
+
+  std::unique_ptr<Event[]> events;
+  const size_t size;
+  /** @brief Number of events recorded in the ring */
+  std::atomic<uint64_t> written{0};
+  /** @brief Whether a thread owns the ring */
+  std::atomic<bool> in_use{true};
+};
+
+std::atomic<size_t> g_events_per_thread{0};
+std::atomic<int> g_record_level{LOG_LEVEL_INFO};
+
+// Rings are never freed; the dump reads them without locking.
+std::mutex g_rings_mutex;
+std::vector<std::unique_ptr<ThreadRing>> g_rings;
+
+/** @brief Ring of the current thread; given back when the thread ends */
+struct RingHolder {
+  ~RingHolder() {
+    if (ring) {
+      ring->in_use.store(false, std::memory_order_release);
+    }
+  }
+
+  ThreadRing *ring = nullptr;
+  uint64_t thread = 0;
+};
+
+thread_local RingHolder t_ring;
+
+ThreadRing *acquire_ring(size_t size) {
+  std::lock_guard<std::mutex> lock(g_rings_mutex);
+  for (auto &ring: g_rings) {
+    bool in_use = false;
+    if (ring->size == size && ring->in_use.compare_exchange_strong(in_use, true)) {
+      return ring.get();
+    }
+  }
+  g_rings.emplace_back(new ThreadRing(size));
+  return g_rings.back().get();
+}
+
+enum class Length {
+  kNone,
+  kLong,
+  kLongLong,
+  kSize,
+  kMax,
+  kPtrdiff,
+  kLongDouble,
+};
+
+/** @brief Conversion specification of a format string */
+struct Spec {
+  const char *start;  // the '%'
+  const char *end;    // after the conversion character
+  const char *length_start;  // the length modifier, if any
+  bool width_arg;     // width given as argument ('*')
+  bool precision_arg; // precision given as argument ('*')
+  Length length;
+  char conversion;
+};
+
+// Parses the conversion specification starting after `%`. Returns false
+// when the end of the format string was reached.
+bool parse_spec(const char *pos, Spec *spec) noexcept {
+  spec->start = pos - 1;
+  spec->width_arg = false;
+  spec->precision_arg = false;
+  spec->length = Length::kNone;
+
+  while (*pos && strchr("-+ #0'", *pos)) {
+    ++pos;
+  }
+  if (*pos == '*') {
+    spec->width_arg = true;
+    ++pos;
+  } else {
+    while (*pos >= '0' && *pos <= '9') {
+      ++pos;
+    }
+  }
+  if (*pos == '.') {
+    ++pos;
+    if (*pos == '*') {
+      spec->precision_arg = true;
+      ++pos;
+    } else {
+      while (*pos >= '0' && *pos <= '9') {
+        ++pos;
+      }
+    }
+  }
+
+  spec->length_start = pos;
+  switch (*pos) {
+    case 'h':
+      pos += (pos[1] == 'h') ? 2 : 1;
+      break;
+    case 'l':
+      if (pos[1] == 'l') {
+        spec->length = Length::kLongLong;
+        pos += 2;
+      } else {
+        spec->length = Length::kLong;
+        ++pos;
+      }
+      break;
+    case 'q':
+      spec->length = Length::kLongLong;
+      ++pos;
+      break;
+    case 'z':
+      spec->length = Length::kSize;
+      ++pos;
+      break;
+    case 'j':
+      spec->length = Length::kMax;
+      ++pos;
+      break;
+    case 't':
+      spec->length = Length::kPtrdiff;
+      ++pos;
+      break;
+    case 'L':
+      spec->length = Length::kLongDouble;
+      ++pos;
+      break;
+    case 'I':  // Windows: %Iu, %I64u, %I32u
+      if (pos[1] == '6' && pos[2] == '4') {
+        spec->length = Length::kLongLong;
+        pos += 3;
+      } else if (pos[1] == '3' && pos[2] == '2') {
+        pos += 3;
+      } else {
+        spec->length = Length::kSize;
+        ++pos;
+      }
+      break;
+    default:
+      break;
+  }
+
+  if (*pos == '\0') {
+    return false;
+  }
+  spec->conversion = *pos;
+  spec->end = pos + 1;
+  return true;
+}
+
+// Reads the integer argument of given length
+long long read_signed(Length length, va_list *ap) noexcept {
+  switch (length) {
+    case Length::kLong:
+      return va_arg(*ap, long);
+    case Length::kLongLong:
+      return va_arg(*ap, long long);
+    case Length::kSize:
+      return static_cast<long long>(va_arg(*ap, size_t));
+    case Length::kMax:
+      return static_cast<long long>(va_arg(*ap, intmax_t));
+    case Length::kPtrdiff:
+      return static_cast<long long>(va_arg(*ap, ptrdiff_t));
+    default:
+      return va_arg(*ap, int);
+  }
+}
+
+unsigned long long read_unsigned(Length length, va_list *ap) noexcept {
+  switch (length) {
+    case Length::kLong:
+      return va_arg(*ap, unsigned long);
+    case Length::kLongLong:
+      return va_arg(*ap, unsigned long long);
+    case Length::kSize:
+      return va_arg(*ap, size_t);
+    case Length::kMax:
+      return static_cast<unsigned long long>(va_arg(*ap, uintmax_t));
+    case Length::kPtrdiff:
+      return static_cast<unsigned long long>(va_arg(*ap, ptrdiff_t));
+    default:
+      return va_arg(*ap, unsigned int);
+  }
+}
+
+// Stores the arguments of the format string in the event without
+// formatting them. Arguments which can not be stored, because there are
+// too many or the conversion is not known, are dropped with all the
+// following ones.
+void capture(EventData *event, const char *fmt, va_list *ap) noexcept {
+  size_t strings_used = 0;
+  event->arg_count = 0;
+
+  auto full = [event]() { return event->arg_count == kMaxArgs; };
+  auto add_int = [event](long long value) {
+    event->kinds[event->arg_count] = ArgKind::kSigned;
+    event->args[event->arg_count++].i = value;
+  };
+
+  for (const char *pos = fmt; *pos; ++pos) {
+    if (*pos != '%') {
+      continue;
+    }
+    if (pos[1] == '%') {
+      ++pos;
+      continue;
+    }
+    Spec spec;
+    if (!parse_spec(pos + 1, &spec)) {
+      return;
+    }
+    pos = spec.end - 1;
+
+    if (spec.width_arg) {
+      if (full()) return;
+      add_int(va_arg(*ap, int));
+    }
+    if (spec.precision_arg) {
+      if (full()) return;
+      add_int(va_arg(*ap, int));
+    }
+    if (full()) {
+      return;
+    }
+
+    auto &arg = event->args[event->arg_count];
+    auto &kind = event->kinds[event->arg_count];
+    switch (spec.conversion) {
+      case 'd': case 'i':
+        kind = ArgKind::kSigned;
+        arg.i = read_signed(spec.length, ap);
+        break;
+      case 'u': case 'o': case 'x': case 'X':
+        kind = ArgKind::kUnsigned;
+        arg.u = read_unsigned(spec.length, ap);
+        break;
+      case 'c':
+        kind = ArgKind::kSigned;
+        arg.i = va_arg(*ap, int);
+        break;
+      case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+        kind = ArgKind::kDouble;
+        if (spec.length == Length::kLongDouble) {
+          arg.d = static_cast<double>(va_arg(*ap, long double));
+        } else {
+          arg.d = va_arg(*ap, double);
+        }
+        break;
+      case 's': {
+        kind = ArgKind::kString;
+        const char *value = va_arg(*ap, const char *);
+        if (value == nullptr) {
+          value = "(null)";
+        }
+        size_t available = kStringBytes - strings_used;
+        if (available == 0) {
+          return;
+        }
+        size_t length = strnlen(value, available - 1);
+        memcpy(event->strings + strings_used, value, length);
+        event->strings[strings_used + length] = '\0';
+        arg.offset = strings_used;
+        strings_used += length + 1;
+        break;
+      }
+      case 'p':
+        kind = ArgKind::kPointer;
+        arg.p = va_arg(*ap, const void *);
+        break;
+      default:
+        // %n or unknown; size of the argument is not known
+        return;
+    }
+    ++event->arg_count;
+  }
+}
+
+// Appends to the buffer; returns false when it is full
+bool append(char *buffer, size_t size, size_t *used, const char *data, size_t length) noexcept {
+  if (*used + length >= size) {
+    length = size - *used - 1;
+  }
+  memcpy(buffer + *used, data, length);
+  *used += length;
+  buffer[*used] = '\0';
+  return *used + 1 < size;
+}
+
+// Appends a number in given base, padded with zeros to `min_digits`.
+// Unlike snprintf(), it can be used in signal handlers.
+bool append_number(char *buffer, size_t size, size_t *used, unsigned long long value,
+                   unsigned int base, size_t min_digits = 1, bool upper = false) noexcept {
+  const char *digits = upper ? "0123456789ABCDEF" : "0123456789abcdef";
+  char reversed[64];
+  size_t count = 0;
+  do {
+    reversed[count++] = digits[value % base];
+    value /= base;
+  } while (value > 0);
+  while (count < min_digits && count < sizeof(reversed)) {
+    reversed[count++] = '0';
+  }
+  char text[64];
+  for (size_t i = 0; i < count; ++i) {
+    text[i] = reversed[count - 1 - i];
+  }
+  return append(buffer, size, used, text, count);
+}
+
+// Appends a stored argument ignoring the flags, width and precision of
+// its conversion; used when snprintf() can not be
+bool append_argument(const EventData &event, size_t arg, char conversion,
+                     char *buffer, size_t size, size_t *used) noexcept {
+  auto &value = event.args[arg];
+  switch (event.kinds[arg]) {
+    case ArgKind::kSigned:
+      if (conversion == 'c') {
+        char ch = static_cast<char>(value.i);
+        return append(buffer, size, used, &ch, 1);
+      }
+      if (value.i < 0) {
+        return append(buffer, size, used, "-", 1) &&
+            append_number(buffer, size, used, 0ULL - static_cast<unsigned long long>(value.i), 10);
+      }
+      return append_number(buffer, size, used, static_cast<unsigned long long>(value.i), 10);
+    case ArgKind::kUnsigned:
+      return append_number(buffer, size, used, value.u,
+                           conversion == 'o' ? 8 : (conversion == 'u' ? 10 : 16), 1,
+                           conversion == 'X');
+    case ArgKind::kDouble: {
+      double number = value.d;
+      if (number != number) {
+        return append(buffer, size, used, "nan", 3);
+      }
+      if (number < 0) {
+        if (!append(buffer, size, used, "-", 1)) {
+          return false;
+        }
+        number = -number;
+      }
+      if (number >= 1e19) {
+        return append(buffer, size, used, "inf", 3);
+      }
+      auto integral = static_cast<unsigned long long>(number);
+      auto fraction = static_cast<unsigned long long>((number - static_cast<double>(integral)) * 1e6 + 0.5);
+      if (fraction >= 1000000) {
+        ++integral;
+        fraction -= 1000000;
+      }
+      return append_number(buffer, size, used, integral, 10) &&
+          append(buffer, size, used, ".", 1) &&
+          append_number(buffer, size, used, fraction, 10, 6);
+    }
+    case ArgKind::kString: {
+      const char *text = event.strings + value.offset;
+      return append(buffer, size, used, text, strlen(text));
+    }
+    default:
+      return append(buffer, size, used, "0x", 2) &&
+          append_number(buffer, size, used, reinterpret_cast<uintptr_t>(value.p), 16);
+  }
+}
+
+// Formats the message of an event using its stored arguments. The part
+// of the format string of which arguments were not stored is written as is.
+// When signal_safe, arguments are written without snprintf(), ignoring
+// their flags, width and precision.
+void format_message(const EventData &event, char *buffer, size_t size, bool signal_safe) noexcept {
+  size_t used = 0;
+  size_t arg = 0;
+  buffer[0] = '\0';
+
+  const char *literal = event.fmt;
+  const char *pos = event.fmt;
+  while (*pos) {
+    if (*pos != '%') {
+      ++pos;
+      continue;
+    }
+    if (pos[1] == '%') {
+      if (!append(buffer, size, &used, literal, static_cast<size_t>(pos + 1 - literal))) {
+        return;
+      }
+      pos += 2;
+      literal = pos;
+      continue;
+    }
+
+    Spec spec;
+    if (!parse_spec(pos + 1, &spec)) {
+      break;
+    }
+    size_t needed = 1 + (spec.width_arg ? 1 : 0) + (spec.precision_arg ? 1 : 0);
+    if (arg + needed > event.arg_count) {
+      break;
+    }
+    if (!append(buffer, size, &used, literal, static_cast<size_t>(pos - literal))) {
+      return;
+    }
+    if (signal_safe) {
+      arg += needed - 1;
+      if (!append_argument(event, arg++, spec.conversion, buffer, size, &used)) {
+        return;
+      }
+      pos = spec.end;
+      literal = pos;
+      continue;
+    }
+
+    // Rebuild the specification using the stored width and precision, and
+    // the length of the stored value
+    char format[64];
+    size_t length = 0;
+    for (const char *c = spec.start; c < spec.length_start && length < 32; ++c) {
+      if (*c == '*') {
+        length += static_cast<size_t>(snprintf(format + length, sizeof(format) - length, "%lld",
+                                               event.args[arg++].i));
+      } else {
+        format[length++] = *c;
+      }
+    }
+    format[length] = '\0';
+
+    int written;
+    char *out = buffer + used;
+    size_t available = size - used;
+    auto &value = event.args[arg];
+    switch (event.kinds[arg++]) {
+      case ArgKind::kSigned:
+        if (spec.conversion == 'c') {
+          strcat(format, "c");
+          written = snprintf(out, available, format, static_cast<int>(value.i));
+        } else {
+          format[length] = 'l';
+          format[length + 1] = 'l';
+          format[length + 2] = spec.conversion;
+          format[length + 3] = '\0';
+          written = snprintf(out, available, format, value.i);
+        }
+        break;
+      case ArgKind::kUnsigned:
+        format[length] = 'l';
+        format[length + 1] = 'l';
+        format[length + 2] = spec.conversion;
+        format[length + 3] = '\0';
+        written = snprintf(out, available, format, value.u);
+        break;
+      case ArgKind::kDouble:
+        format[length] = spec.conversion;
+        format[length + 1] = '\0';
+        written = snprintf(out, available, format, value.d);
+        break;
+      case ArgKind::kString:
+        strcat(format, "s");
+        written = snprintf(out, available, format, event.strings + value.offset);
+        break;
+      default:
+        strcat(format, "p");
+        written = snprintf(out, available, format, value.p);
+        break;
+    }
+    if (written < 0) {
+      return;
+    }
+    used = std::min(used + static_cast<size_t>(written), size - 1);
+    if (used + 1 >= size) {
+      return;
+    }
+    pos = spec.end;
+    literal = pos;
+  }
+  append(buffer, size, &used, literal, strlen(literal));
+}
+
+void write_all(int fd, const char *data, size_t size) noexcept {
+  while (size > 0) {
+#ifndef _WIN32
+    auto written = ::write(fd, data, size);
+#else
+    auto written = ::_write(fd, data, static_cast<unsigned int>(size));
+#endif
+    if (written <= 0) {
+      return;
+    }
+    data += written;
+    size -= static_cast<size_t>(written);
+  }
+}
+
+// Appends the time of an event, UTC with microseconds, computing the
+// date from the days since the epoch as gmtime_r() and strftime() can
+// not be used in signal handlers
+bool append_time(char *buffer, size_t size, size_t *used, int64_t time_us) noexcept {
+  if (time_us < 0) {
+    time_us = 0;
+  }
+  auto seconds = time_us / 1000000;
+  auto days = seconds / 86400;
+  auto day_seconds = static_cast<unsigned long long>(seconds % 86400);
+
+  // Howard Hinnant's civil_from_days()
+  days += 719468;
+  auto era = days / 146097;
+  auto day_of_era = static_cast<unsigned long long>(days - era * 146097);
+  auto year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+  auto day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+  auto month_index = (5 * day_of_year + 2) / 153;
+  auto day = day_of_year - (153 * month_index + 2) / 5 + 1;
+  auto month = month_index < 10 ? month_index + 3 : month_index - 9;
+  auto year = year_of_era + static_cast<unsigned long long>(era) * 400 + (month <= 2 ? 1 : 0);
+
+  return append_number(buffer, size, used, year, 10, 4) &&
+      append(buffer, size, used, "-", 1) &&
+      append_number(buffer, size, used, month, 10, 2) &&
+      append(buffer, size, used, "-", 1) &&
+      append_number(buffer, size, used, day, 10, 2) &&
+      append(buffer, size, used, " ", 1) &&
+      append_number(buffer, size, used, day_seconds / 3600, 10, 2) &&
+      append(buffer, size, used, ":", 1) &&
+      append_number(buffer, size, used, day_seconds / 60 % 60, 10, 2) &&
+      append(buffer, size, used, ":", 1) &&
+      append_number(buffer, size, used, day_seconds % 60, 10, 2) &&
+      append(buffer, size, used, ".", 1) &&
+      append_number(buffer, size, used, static_cast<unsigned long long>(time_us % 1000000), 10, 6);
+}
+
+// Writes the events of all rings. The caller holds g_rings_mutex, unless
+// crashing: the lock might then be held by the crashed thread, and only
+// async-signal-safe functions are used.
+void dump_events(int fd, bool crashing) noexcept {
+  char line[1024];
+
+  for (auto &ring: g_rings) {
+    auto written = ring->written.load(std::memory_order_acquire);
+    auto first = written > ring->size ? written - ring->size : 0;
+    for (auto index = first; index < written; ++index) {
+      Event &event = ring->events[index % ring->size];
+      auto sequence = event.sequence.load(std::memory_order_acquire);
+      if (sequence & 1) {
+        continue;
+      }
+      EventData data;
+      memcpy(&data, &event.data, sizeof(data));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (event.sequence.load(std::memory_order_relaxed) != sequence) {
+        continue;  // overwritten while copying
+      }
+
+      size_t used = 0;
+      const char *level = kLevelNames[data.level < static_cast<uint8_t>(LOG_LEVEL_COUNT) ?
+                                      static_cast<size_t>(data.level) :
+                                      static_cast<size_t>(LOG_LEVEL_DEBUG)];
+      size_t level_length = strlen(level);
+      line[0] = '\0';
+      append_time(line, sizeof(line), &used, data.time_us);
+      append(line, sizeof(line), &used, " ", 1);
+      append(line, sizeof(line), &used, level, level_length);
+      append(line, sizeof(line), &used, "        ", 8 - level_length);
+      append(line, sizeof(line), &used, "[", 1);
+      append_number(line, sizeof(line), &used, data.thread, 16);
+      append(line, sizeof(line), &used, "] ", 2);
+      format_message(data, line + used, sizeof(line) - used - 1, crashing);
+      size_t size = strlen(line);
+      line[size++] = '\n';
+      write_all(fd, line, size);
+    }
+  }
+}
+
+#ifndef _WIN32
+const int kCrashSignals[] = {SIGSEGV, SIGBUS, SIGFPE, SIGILL, SIGABRT};
+
+/** @brief Path of the dump file; fixed size so signal handlers can use it */
+char g_dump_path[4096];
+int g_dump_pipe[2] = {-1, -1};
+std::thread g_dump_thread;
+struct sigaction g_previous_usr1;
+struct sigaction g_previous_crash[sizeof(kCrashSignals) / sizeof(kCrashSignals[0])];
+
+void dump_to_path(bool crashing) noexcept {
+  int fd = open(g_dump_path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+  if (fd >= 0) {
+    if (crashing) {
+      dump_events(fd, true);
+    } else {
+      flight_recorder::dump(fd);
+    }
+    close(fd);
+  }
+}
+
+void on_dump_signal(int) {
+  char command = 'd';
+  auto written = write(g_dump_pipe[1], &command, 1);
+  (void)written;
+}
+
+void on_crash_signal(int signum) {
+  dump_to_path(true);
+  signal(signum, SIG_DFL);
+  raise(signum);
+}
+
+// Dumps each time SIGUSR1 was received, until told to quit
+void dump_thread() {
+  char command;
+  while (read(g_dump_pipe[0], &command, 1) == 1 && command == 'd') {
+    dump_to_path(false);
+  }
+}
+
+// Restores the signal handlers and stops the dump thread when the plugin
+// is unloaded, or the process exits, without deinit() being called
+struct DumpThreadGuard {
+  ~DumpThreadGuard() {
+    flight_recorder::remove_signal_handlers();
+  }
+} g_dump_thread_guard;
+#endif
+
+} // namespace
+
+namespace flight_recorder {
+
+void enable(size_t events, LogLevel level) {
+  g_record_level.store(level, std::memory_order_relaxed);
+  g_events_per_thread.store(std::min(events, kMaxEvents), std::memory_order_relaxed);
+}
+
+bool is_recorded(LogLevel level) noexcept {
+  return level <= g_record_level.load(std::memory_order_relaxed) &&
+      g_events_per_thread.load(std::memory_order_relaxed) > 0;
+}
+
+void record(LogLevel level, const char *fmt, va_list ap) noexcept {
+  size_t size = g_events_per_thread.load(std::memory_order_relaxed);
+  if (size == 0) {
+    return;
+  }
+
+  if (t_ring.ring == nullptr || t_ring.ring->size != size) {
+    if (t_ring.ring) {
+      t_ring.ring->in_use.store(false, std::memory_order_release);
+      t_ring.ring = nullptr;
+    }
+    try {
+      t_ring.ring = acquire_ring(size);
+    } catch (...) {
+      return;
+    }
+    t_ring.thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+  }
+
+  ThreadRing *ring = t_ring.ring;
+  auto count = ring->written.load(std::memory_order_relaxed);
+  Event &event = ring->events[count % ring->size];
+
+  auto sequence = event.sequence.load(std::memory_order_relaxed);
+  event.sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  event.data.time_us = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now().time_since_epoch()).count();
+  event.data.thread = t_ring.thread;
+  event.data.fmt = fmt;
+  event.data.level = static_cast<uint8_t>(level);
+  va_list args;
+  va_copy(args, ap);
+  capture(&event.data, fmt, &args);
+  va_end(args);
+
+  event.sequence.store(sequence + 2, std::memory_order_release);
+  ring->written.store(count + 1, std::memory_order_release);
+}
+
+void dump(int fd) noexcept {
+  std::lock_guard<std::mutex> lock(g_rings_mutex);
+  dump_events(fd, false);
+}
+
+void install_signal_handlers(const std::string &path) {
+#ifndef _WIN32
+  if (g_dump_thread.joinable()) {
+    return;
+  }
+  snprintf(g_dump_path, sizeof(g_dump_path), "%s", path.c_str());
+  if (pipe(g_dump_pipe) != 0) {
+    return;
+  }
+  g_dump_thread = std::thread(dump_thread);
+
+  struct sigaction action;
+  memset(&action, 0, sizeof(action));
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  action.sa_handler = on_dump_signal;
+  sigaction(SIGUSR1, &action, &g_previous_usr1);
+
+  action.sa_handler = on_crash_signal;
+  for (size_t i = 0; i < sizeof(kCrashSignals) / sizeof(kCrashSignals[0]); ++i) {
+    sigaction(kCrashSignals[i], &action, &g_previous_crash[i]);
+  }
+#else
+  (void)path;
+#endif
+}
+
+void remove_signal_handlers() {
+#ifndef _WIN32
+  if (!g_dump_thread.joinable()) {
+    return;
+  }
+  sigaction(SIGUSR1, &g_previous_usr1, nullptr);
+  for (size_t i = 0; i < sizeof(kCrashSignals) / sizeof(kCrashSignals[0]); ++i) {
+    sigaction(kCrashSignals[i], &g_previous_crash[i], nullptr);
+  }
+
+  char command = 'q';
+  auto written = write(g_dump_pipe[1], &command, 1);
+  (void)written;
+  g_dump_thread.join();
+  close(g_dump_pipe[0]);
+  close(g_dump_pipe[1]);
+  g_dump_pipe[0] = g_dump_pipe[1] = -1;
+#endif
+}
+
+} // namespace flight_recorder
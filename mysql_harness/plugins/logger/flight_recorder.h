@@ -0,0 +1,99 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef MYSQL_HARNESS_LOGGER_FLIGHT_RECORDER_INCLUDED
+#define MYSQL_HARNESS_LOGGER_FLIGHT_RECORDER_INCLUDED
+
+#include "logger.h"
+
+#include <cstdarg>
+#include <cstddef>
+#include <string>
+
+/**
+ * The flight recorder keeps the last log events of each thread in memory,
+ * whatever the log level, so that they can be dumped after an incident.
+ * It has its own level, so that recording does not make the messages
+ * filtered by the log level more expensive than the ones it records.
+ *
+ * Recording an event does not format the message: the time, the pointer
+ * to the format string and the raw arguments are stored in a ring owned
+ * by the thread. Strings given as arguments are copied (truncated). Rings
+ * are only written by their thread and read without locking when dumped;
+ * events being overwritten while dumped are skipped.
+ *
+ * Rings of threads which ended are reused by new threads, so the memory
+ * used is bounded by the number of concurrent threads.
+ */
+namespace flight_recorder {
+
+/** @brief Maximum number of events kept per thread */
+const size_t kMaxEvents = 65536;
+
+/** @brief Default number of events kept per thread */
+const size_t kDefaultEvents = 256;
+
+/**
+ * Enables recording.
+ *
+ * @param events number of events kept per thread; 0 disables recording
+ * @param level most verbose level recorded
+ */
+void enable(size_t events, LogLevel level);
+
+/** @brief Returns whether events of the given level are recorded */
+bool is_recorded(LogLevel level) noexcept;
+
+/**
+ * Records a log event of the calling thread.
+ *
+ * @param level level of the event
+ * @param fmt printf-like format string; must stay valid (a literal)
+ * @param ap arguments of the format string
+ */
+void record(LogLevel level, const char *fmt, va_list ap) noexcept;
+
+/**
+ * Writes the events of all threads, formatted, to a file descriptor.
+ *
+ * Events are written thread by thread, oldest first. Threads recording
+ * their first event wait for the dump to end. When crashing, the events
+ * are written by the signal handler without this lock, nor any function
+ * which is not async-signal-safe.
+ *
+ * @param fd file descriptor to write to
+ */
+void dump(int fd) noexcept;
+
+/**
+ * Dumps the events when the process receives SIGUSR1 or crashes.
+ *
+ * On SIGUSR1, the events are written to the given file by a thread
+ * started for this purpose. On SIGSEGV, SIGBUS, SIGFPE, SIGILL and
+ * SIGABRT, they are written from the signal handler before the signal is
+ * raised again with its default action. Does nothing on Windows.
+ *
+ * @param path file the events are written to
+ */
+void install_signal_handlers(const std::string &path);
+
+/** @brief Restores the signal handlers and stops the dump thread */
+void remove_signal_handlers();
+
+} // namespace flight_recorder
+
+#endif // MYSQL_HARNESS_LOGGER_FLIGHT_RECORDER_INCLUDED
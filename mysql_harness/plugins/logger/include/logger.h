@@ -20,6 +20,8 @@
 
 #include <mysql/harness/plugin.h>
 
+#include <stddef.h>
+
 #ifdef _MSC_VER
 #  ifdef logger_EXPORTS
 /* We are building this library */
@@ -36,11 +38,129 @@
 extern "C" {
 #endif
 
+/** Log levels, from the least to the most verbose */
+enum LogLevel {
+  LOG_LEVEL_FATAL,
+  LOG_LEVEL_ERROR,
+  LOG_LEVEL_WARNING,
+  LOG_LEVEL_INFO,
+  LOG_LEVEL_DEBUG,
+  LOG_LEVEL_COUNT
+};
+
+/**
+ * Field of a structured log message. In JSON format each field is written
+ * as a separate key; in text format fields are not written.
+ */
+struct LogField {
+  const char *key;
+  const char *value;
+};
+
+/*
+ * Each plugin logs in its own domain, the name of the plugin, which is
+ * defined when building it (see add_harness_plugin). The level can be set
+ * per domain using the level_<domain> option of the [logger] section.
+ */
+#ifndef MYSQL_ROUTER_LOG_DOMAIN
+#define MYSQL_ROUTER_LOG_DOMAIN ""
+#endif
+
+/**
+ * Logs a message in a domain.
+ *
+ * @param level level of the message
+ * @param domain domain of the message; empty for the global level
+ * @param fields structured fields of the message; can be NULL
+ * @param field_count number of fields
+ * @param fmt printf-like format string; must be a literal
+ */
+void LOGGER_API log_domain_message(enum LogLevel level, const char *domain,
+                                   const struct LogField *fields, size_t field_count,
+                                   const char *fmt, ...);
+
+/**
+ * Returns non-zero when messages of the given level and domain are logged.
+ */
+int LOGGER_API log_domain_level_is_handled(const char *domain, enum LogLevel level);
+
+/**
+ * Returns non-zero when messages of the given level and domain are written
+ * to the log; messages which are handled might only be recorded by the
+ * flight recorder.
+ */
+int LOGGER_API log_domain_level_is_written(const char *domain, enum LogLevel level);
+
+/*
+ * Logging functions not knowing the domain; log_error() and friends below
+ * use the domain of the plugin being built instead.
+ */
 void LOGGER_API log_error(const char *fmt, ...);
 void LOGGER_API log_warning(const char *fmt, ...);
 void LOGGER_API log_info(const char *fmt, ...);
 void LOGGER_API log_debug(const char *fmt, ...);
 
+#define log_error(...) \
+  log_domain_message(LOG_LEVEL_ERROR, MYSQL_ROUTER_LOG_DOMAIN, NULL, 0, __VA_ARGS__)
+#define log_warning(...) \
+  log_domain_message(LOG_LEVEL_WARNING, MYSQL_ROUTER_LOG_DOMAIN, NULL, 0, __VA_ARGS__)
+#define log_info(...) \
+  log_domain_message(LOG_LEVEL_INFO, MYSQL_ROUTER_LOG_DOMAIN, NULL, 0, __VA_ARGS__)
+#define log_debug(...) \
+  log_domain_message(LOG_LEVEL_DEBUG, MYSQL_ROUTER_LOG_DOMAIN, NULL, 0, __VA_ARGS__)
+
+/**
+ * Returns the number of log messages dropped because the queue of the
+ * asynchronous mode was full (see option async_overflow).
+ */
+unsigned long long LOGGER_API log_dropped_count();
+
+/**
+ * Returns non-zero when messages of the given level are logged.
+ */
+int LOGGER_API log_level_is_handled(enum LogLevel level);
+
+/*
+ * The LOG_* macros check the log level before evaluating their arguments,
+ * so that messages which are not logged cost no formatting, nor building
+ * strings. Use them on hot paths. When built with LOGGER_NO_DEBUG (see the
+ * WITH_DEBUG_LOGGING CMake option), LOG_DEBUG messages are compiled out.
+ *
+ * The flight recorder records debug messages by default, so LOG_DEBUG
+ * arguments are evaluated. Debug messages whose arguments are costly to
+ * build (strings, system calls) check LOG_DEBUG_WRITTEN() instead; they are
+ * left out of the flight recorder unless written to the log.
+ */
+#ifdef LOGGER_NO_DEBUG
+#define LOG_DEBUG_ENABLED() 0
+#define LOG_DEBUG_WRITTEN() 0
+#else
+#define LOG_DEBUG_ENABLED() log_domain_level_is_handled(MYSQL_ROUTER_LOG_DOMAIN, LOG_LEVEL_DEBUG)
+#define LOG_DEBUG_WRITTEN() log_domain_level_is_written(MYSQL_ROUTER_LOG_DOMAIN, LOG_LEVEL_DEBUG)
+#endif
+
+#define LOG_IS_HANDLED(level) log_domain_level_is_handled(MYSQL_ROUTER_LOG_DOMAIN, level)
+
+#define LOG_ERROR(...) \
+  do { if (LOG_IS_HANDLED(LOG_LEVEL_ERROR)) log_error(__VA_ARGS__); } while (0)
+#define LOG_WARNING(...) \
+  do { if (LOG_IS_HANDLED(LOG_LEVEL_WARNING)) log_warning(__VA_ARGS__); } while (0)
+#define LOG_INFO(...) \
+  do { if (LOG_IS_HANDLED(LOG_LEVEL_INFO)) log_info(__VA_ARGS__); } while (0)
+#define LOG_DEBUG(...) \
+  do { if (LOG_DEBUG_ENABLED()) log_debug(__VA_ARGS__); } while (0)
+
+/*
+ * Logs a message with structured fields; `fields` must be an array of
+ * LogField.
+ */
+#define LOG_FIELDS(level, fields, ...) \
+  do { \
+    if (LOG_IS_HANDLED(level)) \
+      log_domain_message(level, MYSQL_ROUTER_LOG_DOMAIN, fields, \
+                         sizeof(fields) / sizeof((fields)[0]), __VA_ARGS__); \
+  } while (0)
+
 #ifdef WITH_DEBUG
 #define log_debug2(args) log_debug args
 #define log_debug3(args) log_debug args
@@ -51,6 +171,81 @@ void LOGGER_API log_debug(const char *fmt, ...);
 
 #ifdef __cplusplus
 }
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+/** @class LogRateLimiter
+ * @brief Token bucket limiting the messages logged by a call site
+ *
+ * Allows `burst` messages at once, refilled at `per_second` messages per
+ * second. Implemented as the equivalent generic cell rate algorithm: a
+ * single theoretical arrival time is advanced with compare-and-swap, so
+ * that checking costs no lock. Messages not allowed are counted, and the
+ * count is reported with the next message allowed.
+ *
+ * The constructor is constexpr so that a static limiter of a call site is
+ * initialized at compile time and needs no guard.
+ */
+class LogRateLimiter {
+ public:
+  constexpr LogRateLimiter(unsigned int per_second, unsigned int burst)
+      : interval_ns_(1000000000LL / (per_second ? per_second : 1)),
+        tolerance_ns_((1000000000LL / (per_second ? per_second : 1)) * (burst ? burst - 1 : 0)) {}
+
+  /** @brief Returns whether a message can be logged now
+   *
+   * @param suppressed set to the number of messages not allowed since the
+   *        previous allowed one, when allowed
+   */
+  bool allow(unsigned long long *suppressed) noexcept {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64_t arrival = arrival_ns_.load(std::memory_order_relaxed);
+    do {
+      if (now < arrival - tolerance_ns_) {
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+      }
+    } while (!arrival_ns_.compare_exchange_weak(arrival, (arrival > now ? arrival : now) + interval_ns_,
+                                                std::memory_order_relaxed));
+    *suppressed = suppressed_.exchange(0, std::memory_order_relaxed);
+    return true;
+  }
+
+ private:
+  const int64_t interval_ns_;
+  const int64_t tolerance_ns_;
+  std::atomic<int64_t> arrival_ns_{0};
+  std::atomic<unsigned long long> suppressed_{0};
+};
+
+/*
+ * Logs at most `burst` messages at once and `per_second` messages per
+ * second from the call site; others are counted and reported as
+ * suppressed with the next message logged. Use for messages which can be
+ * triggered by each client, for example when a backend is down.
+ */
+#define LOG_RATE_LIMITED_IMPL(level, per_second, burst, fields, field_count, ...) \
+  do { \
+    static LogRateLimiter log_rate_limiter(per_second, burst); \
+    unsigned long long log_suppressed; \
+    if (LOG_IS_HANDLED(level) && log_rate_limiter.allow(&log_suppressed)) { \
+      log_domain_message(level, MYSQL_ROUTER_LOG_DOMAIN, fields, field_count, __VA_ARGS__); \
+      if (log_suppressed > 0) \
+        log_domain_message(level, MYSQL_ROUTER_LOG_DOMAIN, fields, field_count, \
+                           "suppressed %llu similar messages", log_suppressed); \
+    } \
+  } while (0)
+
+#define LOG_RATE_LIMITED(level, per_second, burst, ...) \
+  LOG_RATE_LIMITED_IMPL(level, per_second, burst, NULL, 0, __VA_ARGS__)
+
+#define LOG_FIELDS_RATE_LIMITED(level, per_second, burst, fields, ...) \
+  LOG_RATE_LIMITED_IMPL(level, per_second, burst, fields, \
+                        sizeof(fields) / sizeof((fields)[0]), __VA_ARGS__)
+
 #endif
 
 #endif /* MYSQL_HARNESS_LOGGER_INCLUDED */
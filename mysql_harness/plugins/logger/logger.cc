@@ -21,18 +21,26 @@
 #include "mysql/harness/filesystem.h"
 #include "mysql/harness/plugin.h"
 
+#include "flight_recorder.h"
+
 #include <algorithm>
 #include <atomic>
 #include <cassert>
 #include <cerrno>
+#include <chrono>
+#include <condition_variable>
 #include <cstdarg>
+#include <cstdint>
 #include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <vector>
 
 
 using std::string;
@@ -51,32 +59,425 @@ using mysql_harness::Plugin;
 #  define LOGGER_API
 #endif
 
-enum Level {
-  LVL_FATAL,
-  LVL_ERROR,
-  LVL_WARNING,
-  LVL_INFO,
-  LVL_DEBUG,
-  LEVEL_COUNT
-};
-
 static const char *const level_str[] = {
   "FATAL", "ERROR", "WARNING", "INFO", "DEBUG", 0
 };
 
-static const std::map<std::string, Level> map_level_str = {
-    {level_str[0], LVL_FATAL},
-    {level_str[1], LVL_ERROR},
-    {level_str[2], LVL_WARNING},
-    {level_str[3], LVL_INFO},
-    {level_str[4], LVL_DEBUG},
+static const std::map<std::string, LogLevel> map_level_str = {
+    {level_str[0], LOG_LEVEL_FATAL},
+    {level_str[1], LOG_LEVEL_ERROR},
+    {level_str[2], LOG_LEVEL_WARNING},
+    {level_str[3], LOG_LEVEL_INFO},
+    {level_str[4], LOG_LEVEL_DEBUG},
 };
 
 static std::atomic<FILE*> g_log_file;
 static std::atomic<int> g_log_level;
 
+/** @brief Most verbose level of the global and the domain levels */
+static std::atomic<int> g_max_log_level;
+
+/** @brief Most verbose level logged or recorded by the flight recorder */
+static std::atomic<int> g_max_handled_level;
+
+/** @brief Maximum length of a log domain, the name of a plugin */
+static const size_t kMaxDomainLength = 32;
+
+/** @brief Maximum number of domains with their own level */
+static const size_t kMaxDomainLevels = 16;
+
+/** @brief Level of a domain set with option level_<domain> */
+struct DomainLevel {
+  char domain[kMaxDomainLength];
+  LogLevel level;
+};
+
+// Only changed by init(), before plugins using the logger are started
+static DomainLevel g_domain_levels[kMaxDomainLevels];
+static size_t g_domain_level_count = 0;
+
+/** @brief Formats of the log lines */
+enum class Format {
+  kText,
+  kJson,
+};
+
+static Format g_log_format = Format::kText;
+
+/** @brief Capacity of the message buffers; longer messages grow them */
+static const size_t kMessageCapacity = 256;
+
+/** @brief Default number of records of the ring used in async mode */
+static const size_t kDefaultAsyncQueueSize = 4096;
+
+/** @brief Maximum number of records written at once by the writer thread */
+static const size_t kMaxWriteBatch = 256;
+
+/** @brief What logging threads do when the ring of async mode is full */
+enum class Overflow {
+  kDrop,
+  kBlock,
+};
+
+/** @brief Formatted log message with its fields
+ *
+ * Records are reused; their buffers only grow so that formatting messages
+ * does not allocate memory once they are large enough.
+ */
+struct LogRecord {
+  LogRecord() {
+    message.reserve(kMessageCapacity);
+  }
+
+  LogLevel level;
+  time_t time;
+  char thread[24];
+  char domain[kMaxDomainLength];
+  std::string message;
+  /** @brief Keys and values of the fields, each terminated by '\0' */
+  std::string fields;
+};
+
+// Returns the ID of the calling thread as text; formatted once per thread
+static const char *thread_name() {
+  thread_local char name[24] = "";
+  if (name[0] == '\0') {
+    std::stringstream ss;
+    ss << std::hex << std::noshowbase << std::this_thread::get_id();
+    snprintf(name, sizeof(name), "%s", ss.str().c_str());
+  }
+  return name;
+}
+
+// Formats the message in `out`, reusing its buffer. The message is not
+// truncated. Consumes `ap`.
+static void format_message(std::string *out, const char *fmt, va_list ap) {
+  out->resize(std::max(out->capacity(), kMessageCapacity));
+  va_list args;
+  va_copy(args, ap);
+  int length = vsnprintf(&(*out)[0], out->size(), fmt, args);
+  va_end(args);
+  if (length < 0) {
+    out->clear();
+    return;
+  }
+  if (static_cast<size_t>(length) >= out->size()) {
+    out->resize(static_cast<size_t>(length) + 1);
+    vsnprintf(&(*out)[0], out->size(), fmt, ap);
+  }
+  out->resize(static_cast<size_t>(length));
+}
+
+static void fill_record(LogRecord *record, LogLevel level, const char *domain,
+                        const LogField *fields, size_t field_count,
+                        const char *fmt, va_list ap) {
+  record->level = level;
+  record->time = time(nullptr);
+  snprintf(record->thread, sizeof(record->thread), "%s", thread_name());
+  snprintf(record->domain, sizeof(record->domain), "%s", domain);
+  format_message(&record->message, fmt, ap);
+  record->fields.clear();
+  for (size_t i = 0; i < field_count; ++i) {
+    record->fields.append(fields[i].key ? fields[i].key : "");
+    record->fields.push_back('\0');
+    record->fields.append(fields[i].value ? fields[i].value : "");
+    record->fields.push_back('\0');
+  }
+}
+
+/** @class LogRing
+ * @brief Bounded lock-free ring of log records
+ *
+ * Logging threads claim a slot using compare-and-swap on the head, format
+ * the message directly in the slot and publish it by bumping the sequence
+ * number of the slot (Dmitry Vyukov's bounded queue). The single writer
+ * thread consumes slots in order. Neither side ever takes a lock.
+ */
+class LogRing {
+ public:
+  /** @brief Constructor
+   *
+   * @param size number of records; rounded up to a power of 2
+   */
+  explicit LogRing(size_t size) {
+    size_t capacity = 2;
+    while (capacity < size) {
+      capacity <<= 1;
+    }
+    mask_ = capacity - 1;
+    slots_.reset(new Slot[capacity]);
+    for (size_t i = 0; i < capacity; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  /** @brief Formats a message into a free record
+   *
+   * Does not allocate memory unless the message or its fields are larger
+   * than any formatted in the record before.
+   *
+   * @return false when the ring is full
+   */
+  bool push(LogLevel level, const char *domain, const LogField *fields, size_t field_count,
+            const char *fmt, va_list ap) {
+    size_t pos = head_.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+      slot = &slots_[pos & mask_];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+      if (diff == 0) {
+        if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (diff < 0) {
+        return false;
+      } else {
+        pos = head_.load(std::memory_order_relaxed);
+      }
+    }
+
+    fill_record(&slot->record, level, domain, fields, field_count, fmt, ap);
+    slot->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  /** @brief Returns the oldest published record, or nullptr
+   *
+   * Only used by the writer thread. The record stays valid until release()
+   * is called.
+   */
+  const LogRecord *front() noexcept {
+    Slot &slot = slots_[tail_ & mask_];
+    if (slot.sequence.load(std::memory_order_acquire) != tail_ + 1) {
+      return nullptr;
+    }
+    return &slot.record;
+  }
+
+  /** @brief Gives the record returned by front() back to logging threads */
+  void release() noexcept {
+    slots_[tail_ & mask_].sequence.store(tail_ + mask_ + 1, std::memory_order_release);
+    ++tail_;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    LogRecord record;
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_;
+  std::atomic<size_t> head_{0};
+  size_t tail_ = 0;
+};
+
+/** @brief Settings and state of async mode */
+static std::unique_ptr<LogRing> g_log_ring;
+static std::atomic<bool> g_log_async{false};
+static Overflow g_log_overflow = Overflow::kDrop;
+static std::atomic<unsigned long long> g_log_dropped{0};
+
+static std::thread g_log_writer;
+static std::mutex g_log_writer_mutex;
+static std::condition_variable g_log_writer_cond;
+static bool g_log_writer_stop = false;
+
+// Appends `data` to `out` as the content of a JSON string
+static void append_json(std::string *out, const char *data) {
+  static const char kHex[] = "0123456789abcdef";
+  for (; *data; ++data) {
+    unsigned char ch = static_cast<unsigned char>(*data);
+    switch (ch) {
+      case '"':
+        out->append("\\\"");
+        break;
+      case '\\':
+        out->append("\\\\");
+        break;
+      case '\n':
+        out->append("\\n");
+        break;
+      case '\r':
+        out->append("\\r");
+        break;
+      case '\t':
+        out->append("\\t");
+        break;
+      default:
+        if (ch < 0x20) {
+          out->append("\\u00");
+          out->push_back(kHex[ch >> 4]);
+          out->push_back(kHex[ch & 0xf]);
+        } else {
+          out->push_back(static_cast<char>(ch));
+        }
+    }
+  }
+}
+
+// Appends the log line of a record to `out`. Text lines are:
+//   <date> <level> [<thread>] <message>
+// JSON lines are objects with keys time, level, thread, domain (unless
+// empty), message and one key per field.
+static void format_record(std::string *out, const LogRecord &record) {
+  struct tm local_time;
+#ifndef _WIN32
+  localtime_r(&record.time, &local_time);
+#else
+  localtime_s(&local_time, &record.time);
+#endif
+
+  char time_buf[20];
+  if (g_log_format == Format::kText) {
+    strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", &local_time);
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "%-19s %-7s [%s] ",
+             time_buf, level_str[record.level], record.thread);
+    out->append(prefix).append(record.message).push_back('\n');
+    return;
+  }
+
+  strftime(time_buf, sizeof(time_buf), "%Y-%m-%dT%H:%M:%S", &local_time);
+  out->append("{\"time\":\"").append(time_buf);
+  out->append("\",\"level\":\"").append(level_str[record.level]);
+  out->append("\",\"thread\":\"").append(record.thread);
+  if (record.domain[0] != '\0') {
+    out->append("\",\"domain\":\"");
+    append_json(out, record.domain);
+  }
+  out->append("\",\"message\":\"");
+  append_json(out, record.message.c_str());
+  out->push_back('"');
+
+  const char *field = record.fields.data();
+  const char *end = field + record.fields.size();
+  while (field < end) {
+    const char *value = field + strlen(field) + 1;
+    out->append(",\"");
+    append_json(out, field);
+    out->append("\":\"");
+    append_json(out, value);
+    out->push_back('"');
+    field = value + strlen(value) + 1;
+  }
+  out->append("}\n");
+}
+
+// Emits log lines on the log file (or stdout)
+static void write_lines(const std::string &lines) {
+  FILE *outfp = g_log_file.load(std::memory_order_consume);
+
+  // note that outfp can be NULL if fopen() fails, therefore not equivalent to
+  // testing for stdout.  TODO review this, it is a hack!!!
+  if (outfp != stdout) {
+    fwrite(lines.data(), 1, lines.size(), outfp ? outfp : stdout);
+    fflush(outfp);
+  } else {
+    // For unit tests, we need to use cout, so we can use its rdbuf() mechanism
+    // to intercept the output.
+    std::cout << lines << std::flush;
+  }
+}
+
+// Writes the records of the ring in batches until stopped; records
+// still in the ring when stopping are written before returning. Messages
+// dropped beyond `dropped_reported` are reported.
+static void log_writer(unsigned long long dropped_reported) {
+  std::string lines;
+  LogRecord notice;
+  for (;;) {
+    size_t count = 0;
+    const LogRecord *record;
+    while (count < kMaxWriteBatch && (record = g_log_ring->front()) != nullptr) {
+      format_record(&lines, *record);
+      g_log_ring->release();
+      ++count;
+    }
+
+    auto dropped = g_log_dropped.load(std::memory_order_relaxed);
+    if (dropped != dropped_reported) {
+      char message[128];
+      snprintf(message, sizeof(message), "%llu log message(s) dropped; logging too fast",
+               dropped - dropped_reported);
+      notice.level = LOG_LEVEL_WARNING;
+      notice.time = time(nullptr);
+      snprintf(notice.thread, sizeof(notice.thread), "%s", thread_name());
+      snprintf(notice.domain, sizeof(notice.domain), "logger");
+      notice.message = message;
+      format_record(&lines, notice);
+      dropped_reported = dropped;
+    }
+
+    if (!lines.empty()) {
+      write_lines(lines);
+      lines.clear();
+    }
+    if (count == kMaxWriteBatch) {
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(g_log_writer_mutex);
+    if (g_log_writer_stop) {
+      // Messages dropped since the last report are reported before ending
+      if (g_log_ring->front() == nullptr &&
+          g_log_dropped.load(std::memory_order_relaxed) == dropped_reported) {
+        break;
+      }
+      continue;
+    }
+    // Logging threads only wake us up when the ring is full
+    g_log_writer_cond.wait_for(lock, std::chrono::milliseconds(10));
+  }
+}
+
+// Starts the writer thread of async mode
+static void start_async(size_t queue_size, Overflow overflow) {
+  g_log_ring.reset(new LogRing(queue_size));
+  g_log_overflow = overflow;
+  g_log_writer_stop = false;
+  // Drops counted while a previous writer ran were reported by it
+  g_log_writer = std::thread(log_writer, g_log_dropped.load(std::memory_order_relaxed));
+  g_log_async.store(true, std::memory_order_release);
+}
+
+// Stops the writer thread of async mode after it wrote all records
+static void stop_async() {
+  if (!g_log_async.exchange(false, std::memory_order_acq_rel)) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(g_log_writer_mutex);
+    g_log_writer_stop = true;
+  }
+  g_log_writer_cond.notify_one();
+  g_log_writer.join();
+}
+
+// Returns the level named by the value of an option
+static LogLevel parse_level(std::string value) {
+  std::transform(value.begin(), value.end(), value.begin(), ::toupper);
+  auto level = map_level_str.find(value);
+  // Invalid values are reported as error
+  if (level == map_level_str.end()) {
+    throw std::invalid_argument(
+        "Log level '" + value + "' is not valid; valid are " +
+        level_str[0] + ", " + level_str[1] + ", " + level_str[2] +
+        ", " + level_str[3] + ", or " + level_str[4]);
+  }
+  return level->second;
+}
+
 static int init(const AppInfo* info) {
-  g_log_level = LVL_INFO;  // Default log level is INFO
+  g_log_level = LOG_LEVEL_INFO;  // Default log level is INFO
+  g_log_format = Format::kText;
+  g_domain_level_count = 0;
+  bool async = false;
+  size_t async_queue_size = kDefaultAsyncQueueSize;
+  Overflow async_overflow = Overflow::kDrop;
+  size_t flight_recorder_size = flight_recorder::kDefaultEvents;
+  LogLevel flight_recorder_level = LOG_LEVEL_DEBUG;
 
   if (info && info->config) {
     auto sections = info->config->get("logger");
@@ -86,20 +487,98 @@ static int init(const AppInfo* info) {
     auto section = sections.front();
 
     if (section->has("level")) {
-      auto level_value = section->get("level");
-      std::transform(level_value.begin(), level_value.end(),
-                     level_value.begin(), ::toupper);
-      auto level = map_level_str.find(level_value);
-      // Invalid values are reported as error
-      if (level == map_level_str.end()) {
+      g_log_level = parse_level(section->get("level"));
+    }
+
+    // Levels of domains, for example level_routing = debug
+    const std::string domain_prefix = "level_";
+    for (auto &option: section->get_options()) {
+      if (option.first.compare(0, domain_prefix.size(), domain_prefix) != 0) {
+        continue;
+      }
+      auto domain = option.first.substr(domain_prefix.size());
+      if (domain.empty() || domain.size() >= kMaxDomainLength) {
+        throw std::invalid_argument("Option " + option.first + " in [logger] does not name a plugin");
+      }
+      if (g_domain_level_count == kMaxDomainLevels) {
+        throw std::invalid_argument("Too many level_<plugin> options in [logger]; maximum is " +
+                                    std::to_string(kMaxDomainLevels));
+      }
+      auto &domain_level = g_domain_levels[g_domain_level_count++];
+      snprintf(domain_level.domain, sizeof(domain_level.domain), "%s", domain.c_str());
+      domain_level.level = parse_level(section->get(option.first));
+    }
+
+    if (section->has("format")) {
+      auto value = section->get("format");
+      std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+      if (value == "text") {
+        g_log_format = Format::kText;
+      } else if (value == "json") {
+        g_log_format = Format::kJson;
+      } else {
+        throw std::invalid_argument("Option format in [logger] must be text or json, was '" + value + "'");
+      }
+    }
+
+    if (section->has("async")) {
+      auto value = section->get("async");
+      std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+      if (value != "yes" && value != "no") {
+        throw std::invalid_argument("Option async in [logger] must be yes or no, was '" + value + "'");
+      }
+      async = value == "yes";
+    }
+
+    if (section->has("async_queue_size")) {
+      auto value = section->get("async_queue_size");
+      char *end;
+      errno = 0;
+      auto size = strtoul(value.c_str(), &end, 10);
+      if (value.empty() || *end != '\0' || errno != 0 || size == 0 || size > (1UL << 20)) {
+        throw std::invalid_argument(
+            "Option async_queue_size in [logger] needs value between 1 and 1048576, was '" + value + "'");
+      }
+      async_queue_size = static_cast<size_t>(size);
+    }
+
+    if (section->has("async_overflow")) {
+      auto value = section->get("async_overflow");
+      std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+      if (value == "drop") {
+        async_overflow = Overflow::kDrop;
+      } else if (value == "block") {
+        async_overflow = Overflow::kBlock;
+      } else {
         throw std::invalid_argument(
-            "Log level '" + level_value + "' is not valid; valid are " +
-            level_str[0] + ", " + level_str[1] + ", " + level_str[2] +
-            ", " + level_str[3] + ", or " + level_str[4]);
+            "Option async_overflow in [logger] must be drop or block, was '" + value + "'");
       }
-      g_log_level = level->second;
     }
+
+    if (section->has("flight_recorder_size")) {
+      auto value = section->get("flight_recorder_size");
+      char *end;
+      errno = 0;
+      auto size = strtoul(value.c_str(), &end, 10);
+      if (value.empty() || *end != '\0' || errno != 0 || size > flight_recorder::kMaxEvents) {
+        throw std::invalid_argument(
+            "Option flight_recorder_size in [logger] needs value between 0 and " +
+            std::to_string(flight_recorder::kMaxEvents) + ", was '" + value + "'");
+      }
+      flight_recorder_size = static_cast<size_t>(size);
+    }
+
+    if (section->has("flight_recorder_level")) {
+      flight_recorder_level = parse_level(section->get("flight_recorder_level"));
+    }
+  }
+  int max_level = g_log_level;
+  for (size_t i = 0; i < g_domain_level_count; ++i) {
+    max_level = std::max(max_level, static_cast<int>(g_domain_levels[i].level));
   }
+  g_max_log_level = max_level;
+  g_max_handled_level = flight_recorder_size > 0 ? std::max<int>(max_level, flight_recorder_level) : max_level;
+
   // We allow the log directory to be NULL or empty, meaning that all
   // will go to the standard output.
   if (info->logging_folder == NULL || strlen(info->logging_folder) == 0) {
@@ -117,92 +596,154 @@ static int init(const AppInfo* info) {
     g_log_file.store(fp, std::memory_order_release);
   }
 
+  if (async) {
+    start_async(async_queue_size, async_overflow);
+  }
+
+  flight_recorder::enable(flight_recorder_size, flight_recorder_level);
+  if (flight_recorder_size > 0 && info->program != NULL) {
+    // Dumped next to the log file, or in the current directory
+    std::string dump_file = std::string(info->program) + ".flight";
+    if (info->logging_folder != NULL && strlen(info->logging_folder) > 0) {
+      dump_file = Path::make_path(info->logging_folder, info->program, "flight").str();
+    }
+    flight_recorder::install_signal_handlers(dump_file);
+  }
+
   return 0;
 }
 
 static int deinit(const AppInfo*) {
   assert(g_log_file.load());
+  flight_recorder::remove_signal_handlers();
+  flight_recorder::enable(0, LOG_LEVEL_INFO);
+  stop_async();
   return fclose(g_log_file.exchange(nullptr, std::memory_order_acq_rel));
 }
 
-static void log_message(Level level, const char* fmt, va_list ap) {
-  assert(level < LEVEL_COUNT);
-
-  // Format the message
-  char message[256];
-  vsnprintf(message, sizeof(message), fmt, ap);
+// Returns the level of a domain
+static int domain_level(const char *domain) {
+  for (size_t i = 0; i < g_domain_level_count; ++i) {
+    if (strcmp(g_domain_levels[i].domain, domain) == 0) {
+      return g_domain_levels[i].level;
+    }
+  }
+  return g_log_level.load(std::memory_order_relaxed);
+}
 
-  // Format the time (19 characters)
-  char time_buf[20];
-  time_t now;
-  time(&now);
-  strftime(time_buf, sizeof(time_buf), "%Y-%m-%d %H:%M:%S", localtime(&now));
+static void log_message(LogLevel level, const char *domain,
+                        const LogField *fields, size_t field_count,
+                        const char* fmt, va_list ap) {
+  assert(level < LOG_LEVEL_COUNT);
 
-  // Get the thread ID
-  std::stringstream ss;
-  ss << std::hex << std::noshowbase << std::this_thread::get_id();
+  // Events are recorded whatever the log level
+  if (flight_recorder::is_recorded(level)) {
+    flight_recorder::record(level, fmt, ap);
+  }
+  if (level > g_max_log_level.load(std::memory_order_relaxed) || level > domain_level(domain)) {
+    return;
+  }
 
-  std::string thread_id = ss.str();
+  if (g_log_async.load(std::memory_order_acquire)) {
+    for (;;) {
+      va_list args;
+      va_copy(args, ap);
+      bool pushed = g_log_ring->push(level, domain, fields, field_count, fmt, args);
+      va_end(args);
+      if (pushed) {
+        return;
+      }
+      g_log_writer_cond.notify_one();
+      if (g_log_overflow == Overflow::kDrop) {
+        g_log_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      std::this_thread::yield();
+    }
+  }
 
-  // Emit a message on log file (or stdout).
-  FILE *outfp = g_log_file.load(std::memory_order_consume);
+  // Record and line are kept so that logging does not allocate memory
+  thread_local LogRecord record;
+  thread_local std::string line;
+  fill_record(&record, level, domain, fields, field_count, fmt, ap);
+  line.clear();
+  format_record(&line, record);
+  write_lines(line);
+}
 
-  // note that outfp can be NULL if fopen() fails, therefore not equivalent to
-  // testing for stdout.  TODO review this, it is a hack!!!
-  if (outfp != stdout) {
-    fprintf(outfp ? outfp : stdout, "%-19s %-7s [%s] %s\n",
-            time_buf, level_str[level], thread_id.c_str(), message);
-    fflush(outfp);
-  } else {
-    // For unit tests, we need to use cout, so we can use its rdbuf() mechanism
-    // to intercept the output.
-    char buf[1024];
-    snprintf(buf, sizeof(buf), "%-19s %-7s [%s] %s\n",
-            time_buf, level_str[level], thread_id.c_str(), message);
-    std::cout << buf << std::flush;
+int log_domain_level_is_handled(const char *domain, LogLevel level) {
+  if (level > g_max_handled_level.load(std::memory_order_relaxed)) {
+    return 0;
   }
+  return flight_recorder::is_recorded(level) ||
+      (level <= g_max_log_level.load(std::memory_order_relaxed) &&
+       level <= domain_level(domain ? domain : ""));
+}
+
+int log_domain_level_is_written(const char *domain, LogLevel level) {
+  return level <= g_max_log_level.load(std::memory_order_relaxed) &&
+      level <= domain_level(domain ? domain : "");
+}
+
+int log_level_is_handled(LogLevel level) {
+  return level <= g_log_level.load(std::memory_order_relaxed) || flight_recorder::is_recorded(level);
+}
+
+unsigned long long log_dropped_count() {
+  return g_log_dropped.load(std::memory_order_relaxed);
+}
+
+void log_domain_message(LogLevel level, const char *domain,
+                        const LogField *fields, size_t field_count,
+                        const char *fmt, ...) {
+  if (!log_domain_level_is_handled(domain, level))
+    return;
+  va_list args;
+  va_start(args, fmt);
+  log_message(level, domain ? domain : "", fields, field_count, fmt, args);
+  va_end(args);
 }
 
 
-// Log format is:
-// <date> <level> <plugin> <message>
+// The functions below do not know the domain of the caller; their names
+// are in parentheses since log_error() and friends are macros.
 
-void log_error(const char *fmt, ...) {
-  if (g_log_level < LVL_ERROR)
+void (log_error)(const char *fmt, ...) {
+  if (!log_level_is_handled(LOG_LEVEL_ERROR))
     return;
   va_list args;
   va_start(args, fmt);
-  log_message(LVL_ERROR, fmt, args);
+  log_message(LOG_LEVEL_ERROR, "", nullptr, 0, fmt, args);
   va_end(args);
 }
 
 
-void log_warning(const char *fmt, ...) {
-  if (g_log_level < LVL_WARNING)
+void (log_warning)(const char *fmt, ...) {
+  if (!log_level_is_handled(LOG_LEVEL_WARNING))
     return;
   va_list args;
   va_start(args, fmt);
-  log_message(LVL_WARNING, fmt, args);
+  log_message(LOG_LEVEL_WARNING, "", nullptr, 0, fmt, args);
   va_end(args);
 }
 
 
-void log_info(const char *fmt, ...) {
-  if (g_log_level < LVL_INFO)
+void (log_info)(const char *fmt, ...) {
+  if (!log_level_is_handled(LOG_LEVEL_INFO))
     return;
   va_list args;
   va_start(args, fmt);
-  log_message(LVL_INFO, fmt, args);
+  log_message(LOG_LEVEL_INFO, "", nullptr, 0, fmt, args);
   va_end(args);
 }
 
 
-void log_debug(const char *fmt, ...) {
-  if (g_log_level < LVL_DEBUG)
+void (log_debug)(const char *fmt, ...) {
+  if (!log_level_is_handled(LOG_LEVEL_DEBUG))
     return;
   va_list args;
   va_start(args, fmt);
-  log_message(LVL_DEBUG, fmt, args);
+  log_message(LOG_LEVEL_DEBUG, "", nullptr, 0, fmt, args);
   va_end(args);
 }
 
@@ -219,5 +760,6 @@ extern "C" {
     deinit,
     nullptr,     // start
     nullptr,     // stop
+    nullptr,     // reload
   };
 }
@@ -0,0 +1,441 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "logger.h"
+
+////////////////////////////////////////
+// Harness interface include files
+#include "mysql/harness/config_parser.h"
+#include "mysql/harness/filesystem.h"
+#include "mysql/harness/plugin.h"
+
+////////////////////////////////////////
+// Third-party include files
+#include "gmock/gmock.h"
+
+////////////////////////////////////////
+// Standard include files
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern "C" { extern mysql_harness::Plugin LOGGER_API logger; }  // defined in logger.cc
+
+using mysql_harness::Path;
+
+using testing::Contains;
+using testing::ContainsRegex;
+using testing::Eq;
+using testing::Gt;
+using testing::HasSubstr;
+using testing::Not;
+
+Path g_here;
+
+class LoggerTest : public ::testing::Test {
+ protected:
+  virtual void TearDown() {
+    if (running_) {
+      stop();
+    }
+  }
+
+  // Starts the logger with the given options of its section. Messages are
+  // written to var/log/logger/harness.log, emptied first.
+  void start(const std::map<std::string, std::string> &options) {
+    config_.add("logger");
+    auto section = config_.get("logger").front();
+    for (auto &option: options) {
+      section->set(option.first, option.second);
+    }
+
+    log_folder_ = g_here.join("var/log/logger").str();
+    log_file_ = Path::make_path(log_folder_, "harness", "log").str();
+    std::ofstream(log_file_, std::ofstream::trunc);
+
+    memset(&info_, 0, sizeof(info_));
+    info_.program = "harness";
+    info_.logging_folder = log_folder_.c_str();
+    info_.config = &config_;
+    ASSERT_THAT(logger.init(&info_), Eq(0));
+    running_ = true;
+  }
+
+  // Stops the logger, which writes the messages still queued, and returns
+  // the lines written
+  std::vector<std::string> stop() {
+    running_ = false;
+    logger.deinit(&info_);
+    return read_lines(log_file_);
+  }
+
+  static std::vector<std::string> read_lines(const std::string &path) {
+    std::vector<std::string> lines;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+      lines.push_back(line);
+    }
+    return lines;
+  }
+
+  // Returns the message of a text line, after the level and thread
+  static std::string message(const std::string &line) {
+    auto pos = line.find("] ");
+    return pos == std::string::npos ? "" : line.substr(pos + 2);
+  }
+
+  std::string log_folder_;
+  std::string log_file_;
+
+ private:
+  mysql_harness::Config config_;
+  mysql_harness::AppInfo info_;
+  bool running_ = false;
+};
+
+TEST_F(LoggerTest, AsyncWritesAllMessages) {
+  start({{"async", "yes"}});
+
+  std::vector<std::thread> threads;
+  for (int thread = 0; thread < 4; ++thread) {
+    threads.emplace_back([thread] {
+      for (int i = 0; i < 250; ++i) {
+        log_domain_message(LOG_LEVEL_INFO, "", nullptr, 0, "thread %d message %d", thread, i);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  auto lines = stop();
+  EXPECT_THAT(lines.size(), Eq(1000U));
+  EXPECT_THAT(lines, Contains(HasSubstr("] thread 0 message 0")));
+  EXPECT_THAT(lines, Contains(HasSubstr("] thread 3 message 249")));
+}
+
+TEST_F(LoggerTest, AsyncOverflowDrop) {
+  const int kMessages = 20000;
+  start({{"async", "yes"}, {"async_queue_size", "2"}, {"async_overflow", "drop"}});
+  auto dropped = log_dropped_count();
+
+  for (int i = 0; i < kMessages; ++i) {
+    log_domain_message(LOG_LEVEL_INFO, "", nullptr, 0, "message %d", i);
+  }
+  auto lines = stop();
+  dropped = log_dropped_count() - dropped;
+  EXPECT_THAT(dropped, Gt(0ULL));
+
+  // Each message is either written or reported as dropped
+  unsigned long long reported = 0;
+  unsigned long long written = 0;
+  for (auto &line : lines) {
+    unsigned long long count;
+    auto text = message(line);
+    if (sscanf(text.c_str(), "%llu log message(s) dropped", &count) == 1) {
+      reported += count;
+    } else if (text.compare(0, 8, "message ") == 0) {
+      ++written;
+    }
+  }
+  EXPECT_THAT(reported, Eq(dropped));
+  EXPECT_THAT(written + dropped, Eq(static_cast<unsigned long long>(kMessages)));
+}
+
+TEST_F(LoggerTest, AsyncOverflowBlock) {
+  const int kMessages = 5000;
+  start({{"async", "yes"}, {"async_queue_size", "2"}, {"async_overflow", "block"}});
+  auto dropped = log_dropped_count();
+
+  for (int i = 0; i < kMessages; ++i) {
+    log_domain_message(LOG_LEVEL_INFO, "", nullptr, 0, "message %d", i);
+  }
+  auto lines = stop();
+
+  // Nothing is dropped, and messages of a thread keep their order
+  EXPECT_THAT(log_dropped_count(), Eq(dropped));
+  ASSERT_THAT(lines.size(), Eq(static_cast<size_t>(kMessages)));
+  for (int i = 0; i < kMessages; ++i) {
+    ASSERT_THAT(message(lines[static_cast<size_t>(i)]), Eq("message " + std::to_string(i)));
+  }
+}
+
+// Counts the evaluations of the arguments of a message
+static int g_evaluations = 0;
+
+static int evaluated(int value) {
+  ++g_evaluations;
+  return value;
+}
+
+TEST_F(LoggerTest, MacrosSkipArgumentsNotLogged) {
+  start({{"level", "info"}, {"flight_recorder_size", "0"}});
+  g_evaluations = 0;
+
+  EXPECT_FALSE(LOG_DEBUG_ENABLED());
+  EXPECT_FALSE(LOG_IS_HANDLED(LOG_LEVEL_DEBUG));
+  EXPECT_TRUE(LOG_IS_HANDLED(LOG_LEVEL_INFO));
+  LOG_DEBUG("debug %d", evaluated(1));
+  LogField fields[] = {{"key", "value"}};
+  LOG_FIELDS(LOG_LEVEL_DEBUG, fields, "fields %d", evaluated(2));
+  EXPECT_THAT(g_evaluations, Eq(0));
+
+  LOG_INFO("info %d", evaluated(3));
+  LOG_ERROR("error %d", evaluated(4));
+  EXPECT_THAT(g_evaluations, Eq(2));
+
+  auto lines = stop();
+  ASSERT_THAT(lines.size(), Eq(2U));
+  EXPECT_THAT(message(lines[0]), Eq("info 3"));
+  EXPECT_THAT(message(lines[1]), Eq("error 4"));
+}
+
+TEST_F(LoggerTest, MacrosLogEnabledLevels) {
+  start({{"level", "debug"}});
+  g_evaluations = 0;
+
+  EXPECT_TRUE(LOG_DEBUG_ENABLED());
+  EXPECT_TRUE(LOG_DEBUG_WRITTEN());
+  LOG_DEBUG("debug %d", evaluated(1));
+  LOG_WARNING("warning %d", evaluated(2));
+  EXPECT_THAT(g_evaluations, Eq(2));
+
+  auto lines = stop();
+  ASSERT_THAT(lines.size(), Eq(2U));
+  EXPECT_THAT(lines[0], HasSubstr(" DEBUG "));
+  EXPECT_THAT(message(lines[0]), Eq("debug 1"));
+  EXPECT_THAT(lines[1], HasSubstr(" WARNING "));
+}
+
+TEST_F(LoggerTest, FlightRecorderDefaultLevel) {
+  // Debug messages are recorded by default, except those which check
+  // whether they are written
+  start({{"level", "warning"}});
+  g_evaluations = 0;
+  EXPECT_TRUE(LOG_DEBUG_ENABLED());
+  EXPECT_FALSE(LOG_DEBUG_WRITTEN());
+  LOG_DEBUG("debug %d", evaluated(1));
+  if (LOG_DEBUG_WRITTEN()) {
+    log_debug("written %d", evaluated(2));
+  }
+  EXPECT_THAT(g_evaluations, Eq(1));
+  EXPECT_THAT(stop().size(), Eq(0U));
+}
+
+TEST_F(LoggerTest, FlightRecorderLevel) {
+  // Recording at info leaves debug messages alone
+  start({{"level", "warning"}, {"flight_recorder_level", "info"}});
+  g_evaluations = 0;
+  EXPECT_TRUE(LOG_IS_HANDLED(LOG_LEVEL_INFO));
+  EXPECT_FALSE(LOG_DEBUG_ENABLED());
+  LOG_INFO("info %d", evaluated(1));
+  LOG_DEBUG("debug %d", evaluated(2));
+  EXPECT_THAT(g_evaluations, Eq(1));
+  EXPECT_THAT(stop().size(), Eq(0U));
+}
+
+TEST_F(LoggerTest, FlightRecorderDisabled) {
+  start({{"level", "warning"}, {"flight_recorder_size", "0"}});
+  EXPECT_FALSE(LOG_IS_HANDLED(LOG_LEVEL_INFO));
+  EXPECT_TRUE(LOG_IS_HANDLED(LOG_LEVEL_WARNING));
+}
+
+#ifndef _WIN32
+class FlightRecorderTest : public LoggerTest {
+ protected:
+  virtual void SetUp() {
+    start({{"level", "error"}, {"flight_recorder_size", "16"}, {"flight_recorder_level", "debug"}});
+    dump_file_ = Path::make_path(log_folder_, "harness", "flight").str();
+    std::remove(dump_file_.c_str());
+  }
+
+  std::string dump_file_;
+};
+
+TEST_F(FlightRecorderTest, DumpOnSignal) {
+  for (int i = 0; i < 20; ++i) {
+    LOG_DEBUG("event %d of %s", i, "dump");
+  }
+  LOG_INFO("padded %5d|%-4s|", 42, "ab");
+
+  // The dump thread writes the dump before ending, which stop() waits for
+  raise(SIGUSR1);
+  auto lines = stop();
+  EXPECT_THAT(lines.size(), Eq(0U));
+
+  // Only the last events fit in the ring of the thread
+  auto dump = read_lines(dump_file_);
+  EXPECT_THAT(dump, Not(Contains(HasSubstr("event 4 of dump"))));
+  EXPECT_THAT(dump, Contains(HasSubstr(" DEBUG   [")));
+  EXPECT_THAT(dump, Contains(HasSubstr("] event 5 of dump")));
+  EXPECT_THAT(dump, Contains(HasSubstr("] event 19 of dump")));
+  EXPECT_THAT(dump, Contains(HasSubstr("] padded    42|ab  |")));
+}
+
+TEST_F(FlightRecorderTest, DumpOnCrash) {
+  time_t before = time(nullptr);
+  ASSERT_EXIT({
+    LOG_INFO("crash %d %s %5.2f %x", -7, "text", 1.5, 255U);
+    raise(SIGSEGV);
+  }, ::testing::KilledBySignal(SIGSEGV), "");
+  time_t after = time(nullptr);
+
+  // The signal handler formats the time itself and ignores widths and
+  // precisions
+  auto dump = read_lines(dump_file_);
+  EXPECT_THAT(dump, Contains(ContainsRegex(
+      "^[0-9]{4}-[0-9]{2}-[0-9]{2} [0-9]{2}:[0-9]{2}:[0-9]{2}\\.[0-9]{6} "
+      "INFO    \\[[0-9a-f]+\\] crash -7 text 1\\.500000 ff$")));
+
+  // Dates are UTC
+  char date_before[16];
+  char date_after[16];
+  struct tm tm;
+  strftime(date_before, sizeof(date_before), "%Y-%m-%d", gmtime_r(&before, &tm));
+  strftime(date_after, sizeof(date_after), "%Y-%m-%d", gmtime_r(&after, &tm));
+  for (auto &line: dump) {
+    if (line.find("] crash ") != std::string::npos) {
+      auto date = line.substr(0, 10);
+      EXPECT_TRUE(date == date_before || date == date_after) << line;
+    }
+  }
+}
+#endif
+
+TEST_F(LoggerTest, DomainLevels) {
+  // Without the flight recorder, handled means logged
+  start({{"level", "warning"}, {"level_routing", "debug"}, {"level_metadata", "error"},
+         {"flight_recorder_size", "0"}});
+
+  EXPECT_TRUE(log_domain_level_is_handled("routing", LOG_LEVEL_DEBUG));
+  EXPECT_FALSE(log_domain_level_is_handled("metadata", LOG_LEVEL_WARNING));
+  EXPECT_TRUE(log_domain_level_is_handled("other", LOG_LEVEL_WARNING));
+  log_domain_message(LOG_LEVEL_DEBUG, "routing", nullptr, 0, "routing debug");
+  log_domain_message(LOG_LEVEL_WARNING, "metadata", nullptr, 0, "metadata warning");
+  log_domain_message(LOG_LEVEL_ERROR, "metadata", nullptr, 0, "metadata error");
+  log_domain_message(LOG_LEVEL_DEBUG, "other", nullptr, 0, "other debug");
+  log_domain_message(LOG_LEVEL_WARNING, "other", nullptr, 0, "other warning");
+
+  auto lines = stop();
+  ASSERT_THAT(lines.size(), Eq(3U));
+  EXPECT_THAT(message(lines[0]), Eq("routing debug"));
+  EXPECT_THAT(message(lines[1]), Eq("metadata error"));
+  EXPECT_THAT(message(lines[2]), Eq("other warning"));
+}
+
+TEST_F(LoggerTest, DomainLevelWithoutDomain) {
+  EXPECT_THROW(start({{"level_", "debug"}}), std::invalid_argument);
+}
+
+TEST_F(LoggerTest, DomainLevelTooLong) {
+  EXPECT_THROW(start({{"level_" + std::string(40, 'x'), "debug"}}), std::invalid_argument);
+}
+
+TEST_F(LoggerTest, JsonEscapes) {
+  start({{"format", "json"}});
+
+  LogField fields[] = {{"route", "r\"1"}, {"client", "a\\b"}};
+  log_domain_message(LOG_LEVEL_INFO, "routing", fields, 2, "say \"%s\"\n\t%c", "hi", 1);
+
+  auto lines = stop();
+  ASSERT_THAT(lines.size(), Eq(1U));
+  EXPECT_THAT(lines[0], ContainsRegex("^\\{\"time\":\"[0-9-]+T[0-9:]+\",\"level\":\"INFO\","));
+  EXPECT_THAT(lines[0], HasSubstr(
+      "\"domain\":\"routing\",\"message\":\"say \\\"hi\\\"\\n\\t\\u0001\","
+      "\"route\":\"r\\\"1\",\"client\":\"a\\\\b\"}"));
+}
+
+TEST_F(LoggerTest, LongMessagesNotTruncated) {
+  std::string text(5000, 'x');
+  start({{"format", "json"}});
+  log_domain_message(LOG_LEVEL_INFO, "", nullptr, 0, "long %s.", text.c_str());
+  auto lines = stop();
+  ASSERT_THAT(lines.size(), Eq(1U));
+  EXPECT_THAT(lines[0], HasSubstr("\"message\":\"long " + text + ".\""));
+}
+
+TEST_F(LoggerTest, LongMessagesAsync) {
+  std::string text(5000, 'x');
+  start({{"async", "yes"}});
+  for (int i = 0; i < 10; ++i) {
+    log_domain_message(LOG_LEVEL_INFO, "", nullptr, 0, "%d %s.", i, text.c_str());
+  }
+  auto lines = stop();
+  ASSERT_THAT(lines.size(), Eq(10U));
+  EXPECT_THAT(message(lines[9]), Eq("9 " + text + "."));
+}
+
+TEST(TestLogRateLimiter, Burst) {
+  LogRateLimiter limiter(1, 3);
+  unsigned long long suppressed = 99;
+
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_TRUE(limiter.allow(&suppressed));
+    EXPECT_THAT(suppressed, Eq(0ULL));
+  }
+
+  // Refused calls are counted until the next allowed one, a second later
+  unsigned long long refused = 0;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!limiter.allow(&suppressed)) {
+    ++refused;
+    ASSERT_TRUE(std::chrono::steady_clock::now() < deadline);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  EXPECT_THAT(refused, Gt(0ULL));
+  EXPECT_THAT(suppressed, Eq(refused));
+}
+
+// Logs through a single call site, allowing two messages at once and one
+// per second
+static void log_limited(int value) {
+  LOG_RATE_LIMITED(LOG_LEVEL_INFO, 1, 2, "limited %d", value);
+}
+
+TEST_F(LoggerTest, RateLimitedSummary) {
+  start({});
+
+  for (int i = 0; i < 10; ++i) {
+    log_limited(i);
+  }
+  // The third message was allowed one second after the first one
+  std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+  log_limited(10);
+
+  auto lines = stop();
+  ASSERT_THAT(lines.size(), Eq(4U));
+  EXPECT_THAT(message(lines[0]), Eq("limited 0"));
+  EXPECT_THAT(message(lines[1]), Eq("limited 1"));
+  EXPECT_THAT(message(lines[2]), Eq("limited 10"));
+  EXPECT_THAT(message(lines[3]), Eq("suppressed 8 similar messages"));
+}
+
+int main(int argc, char *argv[]) {
+  g_here = Path(argv[0]).dirname();
+
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
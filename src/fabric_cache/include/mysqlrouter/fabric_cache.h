@@ -22,7 +22,9 @@
 #include <exception>
 #include <list>
 #include <map>
+#include <memory>
 #include <string>
+#include <vector>
 
 #include "mysqlrouter/utils.h"
 
@@ -72,6 +74,12 @@ public:
   int status;
   /** @brief The weight of the server */
   float weight;
+  /** @brief Socket address of the server resolved by the cache
+   *
+   * Raw bytes of the `struct sockaddr` of host and port, resolved when the
+   * cache was refreshed. Empty when the host could not be resolved.
+   */
+  string resolved_address;
 
   /**
    * Modes for managed servers
@@ -157,14 +165,46 @@ public:
 /** @class LookupResult
  *
  * Class holding result after looking up data in the cache.
+ *
+ * The result is a handle into the cached data valid at the time of the
+ * lookup; it does not copy the servers. The data referenced by server_list
+ * stays valid as long as the LookupResult exists, even when the cache gets
+ * refreshed in the meantime.
  */
 class FABRIC_CACHE_API LookupResult {
 public:
-  /** @brief Constructor */
-  LookupResult(const list<ManagedServer> &server_list_) : server_list(server_list_) { }
+  /** @brief Constructor
+   *
+   * @param servers list of servers shared with the cache; nullptr for
+   *                an empty result
+   */
+  explicit LookupResult(std::shared_ptr<const list<ManagedServer>> servers)
+      : servers_(servers ? std::move(servers) : empty_list()), server_list(*servers_) { }
+
+  /** @overload
+   *
+   * The servers are copied.
+   *
+   * @param server_list_ list of servers
+   */
+  LookupResult(const list<ManagedServer> &server_list_)
+      : servers_(std::make_shared<const list<ManagedServer>>(server_list_)), server_list(*servers_) { }
+
+  /** @brief Copy constructor */
+  LookupResult(const LookupResult &other) : servers_(other.servers_), server_list(*servers_) { }
 
+private:
+  static std::shared_ptr<const list<ManagedServer>> empty_list() {
+    static const std::shared_ptr<const list<ManagedServer>> empty{std::make_shared<const list<ManagedServer>>()};
+    return empty;
+  }
+
+  /** @brief Keeps the cached data alive */
+  std::shared_ptr<const list<ManagedServer>> servers_;
+
+public:
   /** @brief List of ManagedServer objects */
-  const list<ManagedServer> server_list;
+  const list<ManagedServer> &server_list;
 };
 
 /** @brief Initialize a FabricCache object and start caching
@@ -180,6 +220,15 @@ public:
  * The parameters connection_timeout and connection_attempts are used when
  * connected to the MySQL Fabric node.
  *
+ * When cache_file is not empty, the data fetched from MySQL Fabric is stored
+ * in the given file. Data stored before is loaded right away and used until
+ * MySQL Fabric can be reached, so that routes have destinations even when
+ * MySQL Fabric is slow or down while starting.
+ *
+ * The cache is available as soon as its file was loaded: MySQL Fabric is
+ * contacted by the thread refreshing the cache. Until the first refresh,
+ * lookups only find the data of the cache file.
+ *
  * Throws a fabric_cache::base_error when the cache object was already
  * initialized.
  *
@@ -188,10 +237,12 @@ public:
  * @param port MySQL Fabric port (default 32275, MySQL-RPC)
  * @param user MySQL Fabric username
  * @param password MySQL Fabric password
+ * @param cache_file Path of the file storing the cached data (default: none)
  */
 void FABRIC_CACHE_API cache_init(const string &cache_name, const string &host, const int port,
                 const string &user,
-                const string &password);
+                const string &password,
+                const string &cache_file = "");
 
 /** @brief Checks whether the given cache was initialized
  *
@@ -213,6 +264,32 @@ bool FABRIC_CACHE_API have_cache(const string &cache_name);
  */
 LookupResult FABRIC_CACHE_API lookup_group(const string &cache_name, const string &group_id);
 
+/** @brief Returns the generation of the cached data
+ *
+ * The generation is incremented each time the Fabric Cache is refreshed.
+ * Users deriving data from the cache, for example a list of destinations,
+ * can compare generations to know whether they have to derive again.
+ *
+ * Throws fabric_cache::base_error when the cache was not initialized.
+ *
+ * @param cache_name Name of the Fabric Cache instance
+ * @return generation as uint64_t
+ */
+uint64_t FABRIC_CACHE_API cache_generation(const string &cache_name);
+
+/** @brief Requests the Fabric Cache to be refreshed now
+ *
+ * Users which find the cached data stale, for example because connecting
+ * to a managed server failed, request a refresh instead of waiting for
+ * the refresh interval (TTL) to pass. Requested refreshes are rate
+ * limited by the cache.
+ *
+ * Throws fabric_cache::base_error when the cache was not initialized.
+ *
+ * @param cache_name Name of the Fabric Cache instance
+ */
+void FABRIC_CACHE_API request_refresh(const string &cache_name);
+
 /** @brief Returns list of managed server for a shard
  *
  * Returns a list of MySQL server managed by MySQL Fabric for a shard. The
@@ -226,6 +303,52 @@ LookupResult FABRIC_CACHE_API lookup_group(const string &cache_name, const strin
 LookupResult FABRIC_CACHE_API lookup_shard(const string &cache_name, const string &table_name,
                           const string &shard_key);
 
+/** @brief Returns list of managed server for the value of a shard key
+ *
+ * Same as lookup_shard(), except that for HASH sharded tables the shard
+ * key is the value of the key instead of its MD5 hash. The hash is
+ * computed by the cache.
+ *
+ * Throws fabric_cache::base_error when the cache was not initialized.
+ *
+ * @param cache_name Name of the Fabric Cache instance
+ * @param table_name Shard table name
+ * @param shard_key Value of the sharding key
+ * @return List of ManagedServer objects
+ */
+LookupResult FABRIC_CACHE_API lookup_shard_key(const string &cache_name, const string &table_name,
+                                               const string &shard_key);
+
+/** @brief Returns lists of managed servers for values of shard keys
+ *
+ * Looks up many shard keys of the same table at once, for example for
+ * each row loaded in bulk. All keys are placed using the same cached
+ * data.
+ *
+ * Throws fabric_cache::base_error when the cache was not initialized.
+ *
+ * @param cache_name Name of the Fabric Cache instance
+ * @param table_name Shard table name
+ * @param shard_keys Values of the sharding keys
+ * @return List of ManagedServer objects for each key, in the same order
+ */
+std::vector<LookupResult> FABRIC_CACHE_API lookup_shard_keys(const string &cache_name, const string &table_name,
+                                                             const std::vector<string> &shard_keys);
+
+/** @brief Returns list of managed server in the global group of a table
+ *
+ * Returns a list of MySQL server managed by MySQL Fabric for the global
+ * group of the sharded table given by table_name. The global group holds
+ * the data which is not sharded and from which all shard groups replicate.
+ *
+ * Throws fabric_cache::base_error when the cache was not initialized.
+ *
+ * @param cache_name Name of the Fabric Cache instance
+ * @param table_name Shard table name
+ * @return List of ManagedServer objects; empty when table is not sharded
+ */
+LookupResult FABRIC_CACHE_API lookup_global_group(const string &cache_name, const string &table_name);
+
 } // namespace fabric_cache
 
 #endif // MYSQLROUTER_FABRIC_CACHE_INCLUDED
@@ -20,9 +20,28 @@
 
 #include <map>
 #include <memory>
-
-std::map<string, std::unique_ptr<FabricCache> > g_fabric_caches;
-std::mutex fabrix_caches_mutex;
+#include <mutex>
+
+using FabricCacheMap = std::map<string, std::shared_ptr<FabricCache>>;
+
+// Caches are looked up by routing threads for each new connection. The map
+// is replaced as a whole when a cache is added so that lookups only load
+// the current map and never wait for cache_init().
+static std::shared_ptr<const FabricCacheMap> g_fabric_caches{std::make_shared<const FabricCacheMap>()};
+static std::mutex fabric_caches_mutex;
+
+/** @brief Returns the cache with given name
+ *
+ * Throws fabric_cache::base_error when the cache was not initialized.
+ */
+static std::shared_ptr<FabricCache> get_cache(const string &cache_name) {
+  auto caches = std::atomic_load(&g_fabric_caches);
+  auto cache = caches->find(cache_name);
+  if (cache == caches->end()) {
+    throw fabric_cache::base_error("Fabric Cache '" + cache_name + "' not initialized");
+  }
+  return cache->second;
+}
 
 namespace fabric_cache {
 
@@ -34,27 +53,27 @@ std::vector<string> g_fabric_cache_config_sections{};
 
 void cache_init(const string &cache_name, const string &host, const int port,
                 const string &user,
-                const string &password) {
-  if (g_fabric_caches.find(cache_name) != g_fabric_caches.end()) {
+                const string &password,
+                const string &cache_file) {
+  if (std::atomic_load(&g_fabric_caches)->count(cache_name) > 0) {
     return;
   }
 
+  // Creating the cache only loads its cache file. It is registered right
+  // away, so that routes use the loaded data while the refresh thread
+  // contacts Fabric.
+  std::shared_ptr<FabricCache> cache(new FabricCache(host, port, user, password, 1, 1, cache_file));
   {
-    // scope for lock_guard
-    std::lock_guard<std::mutex> lock(fabrix_caches_mutex);
-    g_fabric_caches.emplace(std::make_pair(
-        cache_name,
-        std::unique_ptr<FabricCache>(
-            new FabricCache(host, port, user, password, 1, 1)))
-    );
-  }
-
-  auto cache = g_fabric_caches.find(cache_name);
-  if (cache == g_fabric_caches.end()) {
-    log_info("Failed starting: %s", cache_name.c_str());
-  } else {
-    cache->second->start();
+    std::lock_guard<std::mutex> lock(fabric_caches_mutex);
+    auto current = std::atomic_load(&g_fabric_caches);
+    if (current->count(cache_name) > 0) {
+      return;
+    }
+    std::shared_ptr<FabricCacheMap> caches(new FabricCacheMap(*current));
+    caches->emplace(cache_name, cache);
+    std::atomic_store(&g_fabric_caches, std::shared_ptr<const FabricCacheMap>(std::move(caches)));
   }
+  cache->start();
 }
 
 bool have_cache(const string &cache_name) {
@@ -63,20 +82,34 @@ bool have_cache(const string &cache_name) {
 }
 
 LookupResult lookup_group(const string &cache_name, const string &group_id) {
-  auto cache = g_fabric_caches.find(cache_name);
-  if (cache == g_fabric_caches.end()) {
-    throw fabric_cache::base_error("Fabric Cache '" + cache_name + "' not initialized");
-  }
-  return LookupResult(cache->second->group_lookup(group_id));
+  return LookupResult(get_cache(cache_name)->group_lookup(group_id));
+}
+
+uint64_t cache_generation(const string &cache_name) {
+  return get_cache(cache_name)->generation();
+}
+
+void request_refresh(const string &cache_name) {
+  get_cache(cache_name)->request_refresh();
 }
 
 LookupResult lookup_shard(const string &cache_name, const string &table_name,
                           const string &shard_key) {
-  auto cache = g_fabric_caches.find(cache_name);
-  if (cache == g_fabric_caches.end()) {
-    throw fabric_cache::base_error("Fabric Cache '" + cache_name + "' not initialized");
-  }
-  return LookupResult(cache->second->shard_lookup(table_name, shard_key));
+  return LookupResult(get_cache(cache_name)->shard_lookup(table_name, shard_key));
+}
+
+LookupResult lookup_shard_key(const string &cache_name, const string &table_name,
+                              const string &shard_key) {
+  return get_cache(cache_name)->shard_key_lookup(table_name, shard_key);
+}
+
+std::vector<LookupResult> lookup_shard_keys(const string &cache_name, const string &table_name,
+                                           const std::vector<string> &shard_keys) {
+  return get_cache(cache_name)->shard_key_lookup(table_name, shard_keys);
+}
+
+LookupResult lookup_global_group(const string &cache_name, const string &table_name) {
+  return LookupResult(get_cache(cache_name)->global_group_lookup(table_name));
 }
 
 } // namespace fabric_cache
@@ -0,0 +1,362 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "cache_file.h"
+#include "utils.h"
+
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <fstream>
+#include <io.h>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using fabric_cache::base_error;
+
+namespace {
+
+const char kMagic[8] = {'M', 'R', 'F', 'C', 'A', 'C', 'H', 'E'};
+
+// magic, version, reserved, payload size, payload checksum
+const size_t kHeaderSize = sizeof(kMagic) + 4 + 4 + 8 + 8;
+
+class PayloadWriter {
+public:
+  void put(uint64_t value, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+      buffer_.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+  }
+
+  void put_uint32(uint32_t value) {
+    put(value, 4);
+  }
+
+  void put_int32(int value) {
+    put(static_cast<uint32_t>(value), 4);
+  }
+
+  void put_float(float value) {
+    uint32_t bits;
+    static_assert(sizeof(bits) == sizeof(value), "float must be 32 bits");
+    std::memcpy(&bits, &value, sizeof(bits));
+    put_uint32(bits);
+  }
+
+  void put_string(const string &value) {
+    put_uint32(static_cast<uint32_t>(value.size()));
+    buffer_.append(value);
+  }
+
+  string &buffer() {
+    return buffer_;
+  }
+
+private:
+  string buffer_;
+};
+
+class PayloadReader {
+public:
+  PayloadReader(const char *data, size_t size) : pos_(data), end_(data + size) { }
+
+  uint64_t get(size_t size) {
+    need(size);
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; ++i) {
+      value |= static_cast<uint64_t>(static_cast<unsigned char>(pos_[i])) << (8 * i);
+    }
+    pos_ += size;
+    return value;
+  }
+
+  uint32_t get_uint32() {
+    return static_cast<uint32_t>(get(4));
+  }
+
+  int get_int32() {
+    return static_cast<int>(static_cast<int32_t>(get_uint32()));
+  }
+
+  float get_float() {
+    uint32_t bits = get_uint32();
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  string get_string() {
+    size_t size = get_uint32();
+    need(size);
+    string value(pos_, size);
+    pos_ += size;
+    return value;
+  }
+
+  bool at_end() const noexcept {
+    return pos_ == end_;
+  }
+
+private:
+  void need(size_t size) const {
+    if (static_cast<size_t>(end_ - pos_) < size) {
+      throw base_error("truncated data");
+    }
+  }
+
+  const char *pos_;
+  const char *end_;
+};
+
+// Flushes a file to disk
+bool sync_file(FILE *fp) {
+#ifdef _WIN32
+  return _commit(_fileno(fp)) == 0;
+#else
+  return fsync(fileno(fp)) == 0;
+#endif
+}
+
+// Flushes the directory of a file to disk so that a rename of the file
+// survives a crash. Not all file systems support this, so it is best effort.
+void sync_directory(const string &path) {
+#ifndef _WIN32
+  auto slash = path.find_last_of('/');
+  string dir = slash == string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+  int fd = open(dir.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    fsync(fd);
+    close(fd);
+  }
+#else
+  (void)path;  // NTFS journals renames
+#endif
+}
+
+// Read-only contents of a file; mapped into memory where possible, since
+// the payload is parsed in place
+class FileContents {
+public:
+  explicit FileContents(const string &path) {
+#ifdef _WIN32
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      throw base_error("Failed opening Fabric Cache file '" + path + "'");
+    }
+    content_.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    if (in.bad()) {
+      throw base_error("Failed reading Fabric Cache file '" + path + "'");
+    }
+    data_ = content_.data();
+    size_ = content_.size();
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw base_error("Failed opening Fabric Cache file '" + path + "'");
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+      close(fd);
+      throw base_error("Failed reading Fabric Cache file '" + path + "'");
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ > 0) {
+      void *mapped = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped == MAP_FAILED) {
+        close(fd);
+        throw base_error("Failed reading Fabric Cache file '" + path + "'");
+      }
+      data_ = static_cast<const char *>(mapped);
+    }
+    close(fd);
+#endif
+  }
+
+  ~FileContents() {
+#ifndef _WIN32
+    if (size_ > 0) {
+      munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+  }
+
+  FileContents(const FileContents &) = delete;
+  FileContents &operator=(const FileContents &) = delete;
+
+  const char *data() const noexcept {
+    return data_;
+  }
+
+  size_t size() const noexcept {
+    return size_;
+  }
+
+private:
+  const char *data_ = "";
+  size_t size_ = 0;
+#ifdef _WIN32
+  string content_;
+#endif
+};
+
+} // namespace
+
+void write_cache_file(const string &path, const map<string, list<ManagedServer>> &groups,
+                      const map<string, list<ManagedShard>> &shards, int ttl) {
+  PayloadWriter payload;
+  payload.put_int32(ttl);
+
+  payload.put_uint32(static_cast<uint32_t>(groups.size()));
+  for (auto &group: groups) {
+    payload.put_string(group.first);
+    payload.put_uint32(static_cast<uint32_t>(group.second.size()));
+    for (auto &server: group.second) {
+      payload.put_string(server.server_uuid);
+      payload.put_string(server.group_id);
+      payload.put_string(server.host);
+      payload.put_int32(server.port);
+      payload.put_int32(server.mode);
+      payload.put_int32(server.status);
+      payload.put_float(server.weight);
+    }
+  }
+
+  payload.put_uint32(static_cast<uint32_t>(shards.size()));
+  for (auto &table: shards) {
+    payload.put_string(table.first);
+    payload.put_uint32(static_cast<uint32_t>(table.second.size()));
+    for (auto &shard: table.second) {
+      payload.put_string(shard.schema_name);
+      payload.put_string(shard.table_name);
+      payload.put_string(shard.column_name);
+      payload.put_string(shard.lb);
+      payload.put_int32(shard.shard_id);
+      payload.put_string(shard.type_name);
+      payload.put_string(shard.group_id);
+      payload.put_string(shard.global_group);
+    }
+  }
+
+  PayloadWriter header;
+  header.buffer().append(kMagic, sizeof(kMagic));
+  header.put_uint32(kCacheFileVersion);
+  header.put_uint32(0);  // reserved
+  header.put(payload.buffer().size(), 8);
+  header.put(fnv1a_update(kFNVOffsetBasis, payload.buffer().data(), payload.buffer().size()), 8);
+
+  // The file is on disk before it replaces the previous one, so that a
+  // crash leaves either of them
+  string tmp_path = path + ".tmp";
+  {
+    FILE *out = std::fopen(tmp_path.c_str(), "wb");
+    bool written = out != nullptr &&
+        std::fwrite(header.buffer().data(), 1, header.buffer().size(), out) == header.buffer().size() &&
+        std::fwrite(payload.buffer().data(), 1, payload.buffer().size(), out) == payload.buffer().size() &&
+        std::fflush(out) == 0 && sync_file(out);
+    if (out != nullptr && std::fclose(out) != 0) {
+      written = false;
+    }
+    if (!written) {
+      std::remove(tmp_path.c_str());
+      throw base_error("Failed writing Fabric Cache file '" + tmp_path + "'");
+    }
+  }
+
+#ifdef _WIN32
+  // rename() does not replace existing files on Windows
+  std::remove(path.c_str());
+#endif
+  if (std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    std::remove(tmp_path.c_str());
+    throw base_error("Failed replacing Fabric Cache file '" + path + "'");
+  }
+  sync_directory(path);
+}
+
+CacheFileData read_cache_file(const string &path) {
+  FileContents content(path);
+
+  CacheFileData data;
+  try {
+    if (content.size() < kHeaderSize || std::memcmp(content.data(), kMagic, sizeof(kMagic)) != 0) {
+      throw base_error("not a Fabric Cache file");
+    }
+    PayloadReader header(content.data() + sizeof(kMagic), kHeaderSize - sizeof(kMagic));
+    auto version = header.get_uint32();
+    if (version != kCacheFileVersion) {
+      throw base_error("unsupported version " + mysqlrouter::to_string(version));
+    }
+    header.get_uint32();  // reserved
+    auto payload_size = header.get(8);
+    auto payload_checksum = header.get(8);
+    if (payload_size != content.size() - kHeaderSize) {
+      throw base_error("truncated data");
+    }
+    const char *payload_data = content.data() + kHeaderSize;
+    if (payload_checksum != fnv1a_update(kFNVOffsetBasis, payload_data, payload_size)) {
+      throw base_error("checksum mismatch");
+    }
+
+    PayloadReader payload(payload_data, static_cast<size_t>(payload_size));
+    data.ttl = payload.get_int32();
+
+    for (auto groups = payload.get_uint32(); groups > 0; --groups) {
+      auto &servers = data.groups[payload.get_string()];
+      for (auto count = payload.get_uint32(); count > 0; --count) {
+        ManagedServer server;
+        server.server_uuid = payload.get_string();
+        server.group_id = payload.get_string();
+        server.host = payload.get_string();
+        server.port = payload.get_int32();
+        server.mode = payload.get_int32();
+        server.status = payload.get_int32();
+        server.weight = payload.get_float();
+        servers.push_back(std::move(server));
+      }
+    }
+
+    for (auto tables = payload.get_uint32(); tables > 0; --tables) {
+      auto &shards = data.shards[payload.get_string()];
+      for (auto count = payload.get_uint32(); count > 0; --count) {
+        ManagedShard shard;
+        shard.schema_name = payload.get_string();
+        shard.table_name = payload.get_string();
+        shard.column_name = payload.get_string();
+        shard.lb = payload.get_string();
+        shard.shard_id = payload.get_int32();
+        shard.type_name = payload.get_string();
+        shard.group_id = payload.get_string();
+        shard.global_group = payload.get_string();
+        shards.push_back(std::move(shard));
+      }
+    }
+
+    if (!payload.at_end()) {
+      throw base_error("unexpected trailing data");
+    }
+  } catch (const base_error &exc) {
+    throw base_error("Invalid Fabric Cache file '" + path + "': " + exc.what());
+  }
+  return data;
+}
@@ -0,0 +1,79 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef FABRIC_CACHE_CACHE_FILE_INCLUDED
+#define FABRIC_CACHE_CACHE_FILE_INCLUDED
+
+#include "mysqlrouter/fabric_cache.h"
+
+#include <list>
+#include <map>
+#include <string>
+
+using std::list;
+using std::map;
+using std::string;
+using fabric_cache::ManagedServer;
+using fabric_cache::ManagedShard;
+
+/** @brief Version of the layout of Fabric Cache files */
+const uint32_t kCacheFileVersion = 1;
+
+/** @brief Data of a Fabric Cache stored in a cache file */
+struct CacheFileData {
+  /** @brief Servers of each group */
+  map<string, list<ManagedServer>> groups;
+  /** @brief Shards of each table */
+  map<string, list<ManagedShard>> shards;
+  /** @brief Refresh interval (TTL) reported by Fabric */
+  int ttl = 0;
+};
+
+/** @brief Writes the data of a Fabric Cache to a file
+ *
+ * The data is written in a compact binary format: a fixed size header
+ * holding a magic, the layout version, the size of the payload and a
+ * 64-bit FNV-1a checksum of the payload, followed by the payload. Integers
+ * are stored little-endian, strings prefixed by their length.
+ *
+ * The data is first written to a temporary file next to `path`, flushed to
+ * disk, which then replaces `path`, so that readers never see a partially
+ * written file, nor an empty one after a crash.
+ *
+ * Throws fabric_cache::base_error when the file could not be written.
+ *
+ * @param path Path of the cache file
+ * @param groups Servers of each group
+ * @param shards Shards of each table
+ * @param ttl Refresh interval (TTL) reported by Fabric
+ */
+void write_cache_file(const string &path, const map<string, list<ManagedServer>> &groups,
+                      const map<string, list<ManagedShard>> &shards, int ttl);
+
+/** @brief Reads the data of a Fabric Cache from a file
+ *
+ * The file is memory mapped where possible, and parsed in place.
+ *
+ * Throws fabric_cache::base_error when the file could not be read, or
+ * when it is truncated, corrupted, or uses another layout version.
+ *
+ * @param path Path of the cache file
+ * @return data read from the file
+ */
+CacheFileData read_cache_file(const string &path);
+
+#endif // FABRIC_CACHE_CACHE_FILE_INCLUDED
@@ -21,6 +21,8 @@
 #include <chrono>
 #include <cstdlib>
 #include <errmsg.h>
+#include <exception>
+#include <future>
 #include <iostream>
 #include <sstream>
 #include <stdio.h>
@@ -38,15 +40,15 @@ Fabric::Fabric(const string &host, int port, const string &user,
                const string &password, int connection_timeout,
                int connection_attempts) {
   this->fabric_connection_ = nullptr;
-  this->fabric_uuid_ = "";
+  this->shard_connection_ = nullptr;
   this->ttl_ = 0;
-  this->message_ = "";
   this->host_ = host;
   this->port_ = port;
   this->user_ = user;
   this->password_ = password;
   this->connection_timeout_ = connection_timeout;
   this->connection_attempts_ = connection_attempts;
+  this->fetch_timeout_ = kDefaultFetchTimeout;
   this->reconnect_tries_ = 0;
 
   connect();
@@ -60,52 +62,66 @@ Fabric::~Fabric() {
   disconnect();
 }
 
-bool Fabric::connect() noexcept {
-
-  if (connected_ && mysql_ping(fabric_connection_) == 0) {
-    return connected_;
-  }
-
+MYSQL *Fabric::open_connection(MYSQL *storage, const string &host) noexcept {
   unsigned int protocol = MYSQL_PROTOCOL_TCP;
   bool reconnect = false;
-  connected_ = false;
 
-  const string host(host_ == "localhost" ? "127.0.0.1" : host_);
-
-  disconnect();
-  assert(fabric_connection_ == nullptr);
-  fabric_connection_ = mysql_init(nullptr);
-  if (!fabric_connection_) {
+  MYSQL *connection = mysql_init(storage);
+  if (!connection) {
     log_error("Failed initializing MySQL client connection");
-    return connected_;
+    return nullptr;
   }
 
   // Following would fail only when invalid values are given. It is not possible
   // for the user to change these values.
-  mysql_options(fabric_connection_, MYSQL_OPT_CONNECT_TIMEOUT, &connection_timeout_);
-  mysql_options(fabric_connection_, MYSQL_OPT_PROTOCOL, reinterpret_cast<char *> (&protocol));
-  mysql_options(fabric_connection_, MYSQL_OPT_RECONNECT, &reconnect);
+  mysql_options(connection, MYSQL_OPT_CONNECT_TIMEOUT, &connection_timeout_);
+  mysql_options(connection, MYSQL_OPT_PROTOCOL, reinterpret_cast<char *> (&protocol));
+  mysql_options(connection, MYSQL_OPT_RECONNECT, &reconnect);
+  // A Fabric server which stops sending rows can not hold up refreshing
+  mysql_options(connection, MYSQL_OPT_READ_TIMEOUT, &fetch_timeout_);
+  mysql_options(connection, MYSQL_OPT_WRITE_TIMEOUT, &fetch_timeout_);
 
   const unsigned long client_flags = (
       CLIENT_LONG_PASSWORD | CLIENT_LONG_FLAG | CLIENT_PROTOCOL_41 | CLIENT_MULTI_RESULTS
   );
 
-  if (mysql_real_connect(fabric_connection_, host.c_str(), user_.c_str(),
+  if (mysql_real_connect(connection, host.c_str(), user_.c_str(),
                          password_.c_str(), nullptr, static_cast<unsigned int>(port_), nullptr,
-                         client_flags)) {
-    if (mysql_ping(fabric_connection_) == 0) {
-      connected_ = true;
-      log_info("Connected with Fabric running on %s", host.c_str());
-      reconnect_tries_ = 0;
-    }
+                         client_flags) && mysql_ping(connection) == 0) {
+    return connection;
+  }
+
+  // We log every 5th retries (time between retry depends on TTL set in Fabric or default)
+  if (reconnect_tries_++ % 5 == 0) {
+    log_error("Failed connecting with Fabric: %s (tried %d time%s)",
+              mysql_error(connection), reconnect_tries_,
+              (reconnect_tries_ > 1) ? "s" : "");
+  }
+  mysql_close(connection);
+  return nullptr;
+}
+
+bool Fabric::connect() noexcept {
+
+  if (connected_ && mysql_ping(fabric_connection_) == 0 && mysql_ping(shard_connection_) == 0) {
+    return connected_;
+  }
+
+  const string host(host_ == "localhost" ? "127.0.0.1" : host_);
+
+  disconnect();
+  assert(fabric_connection_ == nullptr && shard_connection_ == nullptr);
+  fabric_connection_ = open_connection(&fabric_mysql_, host);
+  if (fabric_connection_) {
+    shard_connection_ = open_connection(&shard_mysql_, host);
+  }
+
+  if (fabric_connection_ && shard_connection_) {
+    connected_ = true;
+    log_info("Connected with Fabric running on %s", host.c_str());
+    reconnect_tries_ = 0;
   } else {
-    // We log every 5th retries (time between retry depends on TTL set in Fabric or default)
-    if (reconnect_tries_++ % 5 == 0) {
-      log_error("Failed connecting with Fabric: %s (tried %d time%s)",
-                mysql_error(fabric_connection_), reconnect_tries_,
-                (reconnect_tries_ > 1) ? "s" : "");
-    }
-    connected_ = false;
+    disconnect();
   }
   return connected_;
 }
@@ -116,9 +132,13 @@ void Fabric::disconnect() noexcept {
     mysql_close(fabric_connection_);
   }
   fabric_connection_ = nullptr;
+  if (shard_connection_ != nullptr) {
+    mysql_close(shard_connection_);
+  }
+  shard_connection_ = nullptr;
 }
 
-MYSQL_RES *Fabric::fetch_metadata(string &remote_api) {
+MYSQL_RES *Fabric::fetch_metadata(MYSQL *connection, const string &remote_api, int *ttl) {
 
   if (!connected_) {
     return nullptr;
@@ -130,7 +150,7 @@ MYSQL_RES *Fabric::fetch_metadata(string &remote_api) {
   MYSQL_ROW row = nullptr;
 
   query << "CALL " << remote_api << "()";
-  status = mysql_query(fabric_connection_, query.str().c_str());
+  status = mysql_query(connection, query.str().c_str());
   if (status) {
     ostringstream ss;
     ss << "CALL statement failed: " << remote_api;
@@ -140,14 +160,15 @@ MYSQL_RES *Fabric::fetch_metadata(string &remote_api) {
   // The first result set returned by MySQL-RPC will always contain the
   // same information. The UUID of the Fabric Instance, the Time-To-Live
   // and a message such as errors.
-  result = mysql_store_result(fabric_connection_);
-  row = mysql_fetch_row(result);
+  result = mysql_store_result(connection);
+  row = result ? mysql_fetch_row(result) : nullptr;
   if (row != nullptr) {
-    fabric_uuid_ = get_string(row[0]);
-    ttl_ = atoi(row[1]);
-    message_ = get_string(row[2]);
+    *ttl = atoi(row[1]);
   }
   else {
+    if (result) {
+      mysql_free_result(result);
+    }
     ostringstream ss;
     ss << "Failed fetching row: " << remote_api;
     throw fabric_cache::metadata_error(ss.str());
@@ -156,8 +177,8 @@ MYSQL_RES *Fabric::fetch_metadata(string &remote_api) {
 
   // If there are more result sets, fetch the next result set and extract
   // the dump information.
-  if (mysql_more_results(fabric_connection_)) {
-    status = mysql_next_result(fabric_connection_);
+  if (mysql_more_results(connection)) {
+    status = mysql_next_result(connection);
     // Fetching the next result set throws an error. Since the metadata result
     // set cannot be found, we cannot fetch the metadata.
     if (status > 0) {
@@ -171,13 +192,14 @@ MYSQL_RES *Fabric::fetch_metadata(string &remote_api) {
       ss << "Failed fetching next result: " << remote_api;
       throw fabric_cache::metadata_error(ss.str());
     }
-    result = mysql_store_result(fabric_connection_);
+    // The dump can be large; rows are read while processing them
+    result = mysql_use_result(connection);
     if (result) {
       return result;
     }
     else {
       ostringstream ss;
-      ss << "Failed storing results: " << remote_api;
+      ss << "Failed reading results: " << remote_api;
       throw fabric_cache::metadata_error(ss.str());
     }
   }
@@ -188,75 +210,188 @@ MYSQL_RES *Fabric::fetch_metadata(string &remote_api) {
   }
 }
 
-/** @brief Returns relation between group ID and list of servers
- *
- * Returns relation as a std::map between group ID and list of managed servers.
- *
- * @return Map of group ID, server list pairs.
- */
-map<string, list<ManagedServer>> Fabric::fetch_servers() {
-  string api = "dump.servers";
+void Fabric::finish_metadata(MYSQL *connection, MYSQL_RES *result) noexcept {
+  // Freeing a result of mysql_use_result() reads the rows left
+  mysql_free_result(result);
+  while (mysql_next_result(connection) == 0) {
+    MYSQL_RES *next = mysql_store_result(connection);
+    if (next) {
+      mysql_free_result(next);
+    }
+  }
+}
+
+void Fabric::abandon_metadata(MYSQL *&connection, MYSQL_RES *result) noexcept {
+  // Freeing the result first would read all rows left. Once the connection
+  // is closed, the result is cancelled and freeing it reads nothing. The
+  // MYSQL object is owned by us and stays valid after mysql_close().
+  mysql_close(connection);
+  connection = nullptr;
+  mysql_free_result(result);
+}
+
+namespace {
+
+// Checking the clock for each row would be wasteful
+const unsigned int kRowsBetweenDeadlineChecks = 256;
+
+void check_deadline(std::chrono::steady_clock::time_point deadline, const string &remote_api) {
+  if (std::chrono::steady_clock::now() > deadline) {
+    throw fabric_cache::metadata_error("Timeout fetching " + remote_api);
+  }
+}
+
+} // namespace
+
+map<string, list<ManagedServer>> Fabric::read_servers(MYSQL *&connection,
+                                                      clock_type::time_point deadline) {
+  const string api = "dump.servers";
   map<string, list<ManagedServer>> server_map;
 
   MYSQL_ROW row = nullptr;
-  MYSQL_RES *result = fetch_metadata(api);
+  MYSQL_RES *result = fetch_metadata(connection, api, &ttl_);
 
   if (!result) {
     throw fabric_cache::metadata_error("Failed executing " + api);
   }
 
-  while ((row = mysql_fetch_row(result)) != nullptr) {
-    ManagedServer s;
-    s.server_uuid = get_string(row[0]);
-    s.group_id = get_string(row[1]);
-    s.host = get_string(row[2]);
-    s.port = atoi(row[3]);
-    s.mode = atoi(row[4]);
-    s.status = atoi(row[5]);
-    s.weight = std::strtof(row[6], nullptr);
-
-    server_map[s.group_id].push_back(s);
+  try {
+    unsigned int count = 0;
+    while ((row = mysql_fetch_row(result)) != nullptr) {
+      ManagedServer s;
+      s.server_uuid = get_string(row[0]);
+      s.group_id = get_string(row[1]);
+      s.host = get_string(row[2]);
+      s.port = atoi(row[3]);
+      s.mode = atoi(row[4]);
+      s.status = atoi(row[5]);
+      s.weight = std::strtof(row[6], nullptr);
+
+      server_map[s.group_id].push_back(std::move(s));
+      if (++count % kRowsBetweenDeadlineChecks == 0) {
+        check_deadline(deadline, api);
+      }
+    }
+    // Rows are read from the server; reading stops on errors too
+    if (mysql_errno(connection) != 0) {
+      throw fabric_cache::metadata_error("Failed reading rows of " + api + ": " + mysql_error(connection));
+    }
+  } catch (...) {
+    abandon_metadata(connection, result);
+    throw;
   }
 
-  mysql_free_result(result);
+  finish_metadata(connection, result);
 
   return server_map;
 }
 
-map<string, list<ManagedShard>> Fabric::fetch_shards() {
-  string api = "dump.sharding_information";
+map<string, list<ManagedShard>> Fabric::read_shards(MYSQL *&connection,
+                                                    clock_type::time_point deadline) {
+  const string api = "dump.sharding_information";
 
   map<string, list<ManagedShard>> shard_map;
 
   MYSQL_ROW row = nullptr;
-  MYSQL_RES *result = fetch_metadata(api);
+  int ttl;
+  MYSQL_RES *result = fetch_metadata(connection, api, &ttl);
 
   if (!result) {
     throw fabric_cache::metadata_error("Failed executing " + api);
   }
 
-  while ((row = mysql_fetch_row(result)) != nullptr) {
-    ManagedShard sh;
-    sh.schema_name = get_string(row[0]);
-    sh.table_name = get_string(row[1]);
-    sh.column_name = get_string(row[2]);
-    sh.lb = get_string(row[3]);
-    sh.shard_id = atoi(row[4]);
-    sh.type_name = get_string(row[5]);
-    sh.group_id = get_string(row[6]);
-    sh.global_group = get_string(row[7]);
-
-    ostringstream ss;
-    ss << sh.schema_name << "." << sh.table_name;
-    string fully_qualified_table_name = ss.str();
-    shard_map[fully_qualified_table_name].push_back(sh);
+  try {
+    unsigned int count = 0;
+    string fully_qualified_table_name;
+    while ((row = mysql_fetch_row(result)) != nullptr) {
+      ManagedShard sh;
+      sh.schema_name = get_string(row[0]);
+      sh.table_name = get_string(row[1]);
+      sh.column_name = get_string(row[2]);
+      sh.lb = get_string(row[3]);
+      sh.shard_id = atoi(row[4]);
+      sh.type_name = get_string(row[5]);
+      sh.group_id = get_string(row[6]);
+      sh.global_group = get_string(row[7]);
+
+      fully_qualified_table_name = sh.schema_name + "." + sh.table_name;
+      shard_map[fully_qualified_table_name].push_back(std::move(sh));
+      if (++count % kRowsBetweenDeadlineChecks == 0) {
+        check_deadline(deadline, api);
+      }
+    }
+    // Rows are read from the server; reading stops on errors too
+    if (mysql_errno(connection) != 0) {
+      throw fabric_cache::metadata_error("Failed reading rows of " + api + ": " + mysql_error(connection));
+    }
+  } catch (...) {
+    abandon_metadata(connection, result);
+    throw;
   }
 
-  mysql_free_result(result);
+  finish_metadata(connection, result);
 
   return shard_map;
 }
 
+/** @brief Returns relation between group ID and list of servers
+ *
+ * Returns relation as a std::map between group ID and list of managed servers.
+ *
+ * @return Map of group ID, server list pairs.
+ */
+map<string, list<ManagedServer>> Fabric::fetch_servers() {
+  try {
+    return read_servers(fabric_connection_, clock_type::now() + std::chrono::seconds(fetch_timeout_));
+  } catch (const fabric_cache::base_error &) {
+    disconnect();
+    throw;
+  }
+}
+
+map<string, list<ManagedShard>> Fabric::fetch_shards() {
+  try {
+    return read_shards(shard_connection_, clock_type::now() + std::chrono::seconds(fetch_timeout_));
+  } catch (const fabric_cache::base_error &) {
+    disconnect();
+    throw;
+  }
+}
+
+void Fabric::fetch_all(map<string, list<ManagedServer>> *servers,
+                       map<string, list<ManagedShard>> *shards) {
+  auto deadline = clock_type::now() + std::chrono::seconds(fetch_timeout_);
+
+  // Shards are fetched in another thread while servers are fetched
+  auto shard_result = std::async(std::launch::async, [this, deadline] {
+    return read_shards(shard_connection_, deadline);
+  });
+
+  std::exception_ptr error;
+  try {
+    *servers = read_servers(fabric_connection_, deadline);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  try {
+    *shards = shard_result.get();
+  } catch (...) {
+    if (!error) {
+      error = std::current_exception();
+    }
+  }
+
+  if (error) {
+    // Connections might have unread rows
+    disconnect();
+    std::rethrow_exception(error);
+  }
+}
+
 int Fabric::fetch_ttl() {
   return ttl_;
 }
+
+void Fabric::set_fetch_timeout(int seconds) noexcept {
+  fetch_timeout_ = seconds;
+}
@@ -22,6 +22,7 @@
 #include "fabric_metadata.h"
 #include "utils.h"
 
+#include <chrono>
 #include <list>
 #include <map>
 #include <string>
@@ -31,11 +32,17 @@
 
 using std::string;
 
+/** @brief Time (in seconds) fetching all data from Fabric may take */
+const int kDefaultFetchTimeout = 10;
+
 /** @class Fabric
  *
- * The `Fabric` class encapsulates a connection to the Fabric server. It
+ * The `Fabric` class encapsulates connections to the Fabric server. It
  * uses the MySQL Client C Library to setup, manage and retrieve results.
  *
+ * Two connections are used so that servers and shards can be fetched at
+ * the same time. Rows are streamed from the server instead of being
+ * buffered by the client library first.
  */
 class Fabric : public FabricMetaData {
 public:
@@ -85,6 +92,29 @@ public:
    */
   int fetch_ttl();
 
+  /** @brief Sets the seconds fetching all data may take
+   *
+   * The timeout is also used as read and write timeout of connections
+   * opened afterwards.
+   *
+   * @param seconds timeout in seconds
+   */
+  void set_fetch_timeout(int seconds) noexcept;
+
+  /** @brief Fetches servers and shards at the same time
+   *
+   * Servers and shards are fetched in parallel, each over its own
+   * connection. Fetching has to finish within the fetch timeout
+   * (kDefaultFetchTimeout seconds unless set using set_fetch_timeout());
+   * when it does not, or on errors, the connections are closed without
+   * reading the rows left and fabric_cache::metadata_error is thrown.
+   *
+   * @param servers (out) servers of each group
+   * @param shards (out) shards of each table
+   */
+  void fetch_all(map<string, list<ManagedServer>> *servers,
+                 map<string, list<ManagedShard>> *shards) override;
+
   /** @brief Connects with the Fabric server
    *
    * Checks first whether we are connected. If not, this method will
@@ -102,14 +132,56 @@ public:
   void disconnect() noexcept;
 
 private:
+  using clock_type = std::chrono::steady_clock;
+
+  /** @brief Opens and configures a connection with the Fabric server
+   *
+   * @param storage MYSQL object to initialize
+   * @param host host of the Fabric server
+   * @return connected MYSQL object, or nullptr
+   */
+  MYSQL *open_connection(MYSQL *storage, const string &host) noexcept;
+
   /** @brief Returns result from remote API call
    *
    * Returns result from remote API call executed on the Fabric Server.
+   * The rows of the result are read from the server while fetching them;
+   * the result has to be released using finish_metadata().
    *
+   * @param connection Connection to use
    * @param remote_api Remote API to be executed
+   * @param ttl (out) TTL reported by Fabric
    * @return MYSQL_RES object containg result of remote API execution
    */
-  MYSQL_RES *fetch_metadata(string &remote_api);
+  MYSQL_RES *fetch_metadata(MYSQL *connection, const string &remote_api, int *ttl);
+
+  /** @brief Releases result of remote API call
+   *
+   * Frees the result and reads the remaining results of the call so that
+   * the connection can be used again.
+   */
+  void finish_metadata(MYSQL *connection, MYSQL_RES *result) noexcept;
+
+  /** @brief Releases result of remote API call which was not read fully
+   *
+   * Closes the connection before freeing the result so that the rows
+   * left are not read. The connection is set to nullptr.
+   */
+  void abandon_metadata(MYSQL *&connection, MYSQL_RES *result) noexcept;
+
+  /** @brief Fetches servers using given connection before deadline
+   *
+   * On errors the connection is closed and set to nullptr.
+   */
+  map<string, list<ManagedServer>> read_servers(MYSQL *&connection,
+                                                clock_type::time_point deadline);
+
+  /** @brief Fetches shards using given connection before deadline
+   *
+   * On errors the connection is closed and set to nullptr.
+   */
+  map<string, list<ManagedShard>> read_shards(MYSQL *&connection,
+                                              clock_type::time_point deadline);
 
   // Fabric node connection information
   string host_;
@@ -118,9 +190,7 @@ private:
   string password_;
 
   // Fabric node generic information
-  string fabric_uuid_;
   int ttl_;
-  string message_;
 
   // The time after which a connection to the fabric server should timeout.
   int connection_timeout_;
@@ -128,8 +198,18 @@ private:
   // The number of times we should try connecting to fabric if a connection attempt fails.
   int connection_attempts_;
 
-  // MySQL client objects
+  // Seconds fetching all data may take
+  int fetch_timeout_;
+
+  // MySQL client objects; servers and shards are fetched using their
+  // own connection
   MYSQL *fabric_connection_;
+  MYSQL *shard_connection_;
+
+  // Storage of the MySQL client objects, which have to outlive the
+  // connections for results freed after closing them
+  MYSQL fabric_mysql_;
+  MYSQL shard_mysql_;
 
   // Boolean variable indicates if a connection to fabric has been established.
   bool connected_ = false;
@@ -16,9 +16,14 @@
 */
 
 #include "fabric_cache.h"
+#include "cache_file.h"
 
+#include <algorithm>
 #include <list>
 #include <memory>
+#include <set>
+#include <system_error>
+#include <utility>
 
 const map<string, int> FabricCache::shard_type_map_{
     {"RANGE",          RANGE},
@@ -54,135 +59,641 @@ std::map<ManagedServer::Status, string> ManagedServer::StatusNames{
  *                                  fabric server should timeout.
  * @param connection_attempts The number of times a connection to fabric must be
  *                            attempted, when a connection attempt fails.
+ * @param cache_file Path of the file in which the cached data is stored.
  */
 FabricCache::FabricCache(string host, int port, string user, string password,
-                         int connection_timeout, int connection_attempts) {
+                         int connection_timeout, int connection_attempts,
+                         string cache_file)
+    : snapshot_(std::make_shared<const Snapshot>()), cache_file_(std::move(cache_file)),
+      resolver_(new mysql_harness::CachingResolver(kResolveThreads, kResolveTimeToLive,
+                                                   kResolveNegativeTimeToLive)),
+      resolve_ttl_(kResolveTimeToLive), last_resolve_(std::chrono::steady_clock::now()),
+      refreshes_applied_(0), refreshes_skipped_(0), servers_resolved_(0) {
   fabric_meta_data_ = get_instance(host, port, user, password,
                                    connection_timeout, connection_attempts);
   ttl_ = kDefaultTimeToLive;
   terminate_ = false;
+  refresh_requested_ = false;
 
-  refresh();
+  // The refresh thread refreshes the cache first; until then, lookups use
+  // the data of the cache file
+  if (!cache_file_.empty()) {
+    load_cache_file();
+  }
 }
 
 FabricCache::~FabricCache() {
-  terminate_ = true;
+  stop();
+}
+
+void FabricCache::start() {
+  if (refresh_thread_.joinable()) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(terminate_mutex_);
+    terminate_ = false;
+  }
+  refresh_thread_ = thread(&FabricCache::refresh_loop, this);
+}
+
+void FabricCache::stop() {
+  {
+    std::lock_guard<std::mutex> lock(terminate_mutex_);
+    terminate_ = true;
+  }
+  terminate_cond_.notify_all();
   if (refresh_thread_.joinable()) {
     refresh_thread_.join();
   }
 }
 
-void FabricCache::start() {
-  // Start the Fabric Cache refresh thread
-  auto refresh_loop = [this] {
-    while (!terminate_) {
-      if (fabric_meta_data_->connect()) {
-        refresh();
-      } else {
-        fabric_meta_data_->disconnect();
+void FabricCache::request_refresh() noexcept {
+  {
+    std::lock_guard<std::mutex> lock(terminate_mutex_);
+    refresh_requested_ = true;
+  }
+  terminate_cond_.notify_all();
+}
+
+bool FabricCache::wait_refreshed(uint64_t generation, std::chrono::milliseconds timeout) {
+  std::unique_lock<std::mutex> lock(terminate_mutex_);
+  return refreshed_cond_.wait_for(lock, timeout, [this, generation] { return this->generation() > generation; });
+}
+
+void FabricCache::refresh_loop() {
+  using clock = std::chrono::steady_clock;
+
+  // The cache is refreshed right away, then each TTL
+  auto last_refresh = clock::now();
+  bool first = true;
+  std::unique_lock<std::mutex> lock(terminate_mutex_);
+  while (!terminate_) {
+    if (!first) {
+      int ttl = ttl_.load();
+      terminate_cond_.wait_until(lock, last_refresh + std::chrono::seconds(ttl == 0 ? kDefaultTimeToLive : ttl),
+                                 [this] { return terminate_ || refresh_requested_; });
+      if (terminate_) {
+        break;
+      }
+      // Requested refreshes are rate limited so that a storm of failing
+      // connections does not hammer Fabric.
+      if (refresh_requested_ &&
+          terminate_cond_.wait_until(lock, last_refresh + kMinRefreshInterval, [this] { return terminate_; })) {
+        break;
       }
-      std::this_thread::sleep_for(
-          std::chrono::seconds(ttl_ == 0 ? kDefaultTimeToLive : ttl_));
     }
-  };
-  thread(refresh_loop).join();
+    first = false;
+    refresh_requested_ = false;
+    lock.unlock();
+    if (fabric_meta_data_->connect()) {
+      refresh();
+    } else {
+      fabric_meta_data_->disconnect();
+    }
+    last_refresh = clock::now();
+    lock.lock();
+  }
 }
 
-list<ManagedServer> FabricCache::group_lookup(const string &group_id) {
-  std::lock_guard<std::mutex> lock(cache_refreshing_mutex_);
-  auto group = group_data_.find(group_id);
-  if (group == group_data_.end()) {
+LookupResult FabricCache::group_lookup(const string &group_id) const {
+  auto snapshot = std::atomic_load(&snapshot_);
+  auto group = snapshot->group_data.find(group_id);
+  if (group == snapshot->group_data.end()) {
     log_warning("Fabric Group '%s' not available", group_id.c_str());
-    return {};
-  }
-  list<ManagedServer> servers = group_data_[group_id];
-  return servers;
-}
-
-list<ManagedServer> FabricCache::shard_lookup(const string &table_name, const string &shard_key) {
-  list<ManagedServer> servers;
-  cache_refreshing_mutex_.lock();
-  if (shard_data_.count(table_name)) {
-    std::unique_ptr<ManagedShard> ret(nullptr);
-    list<ManagedShard> shards = shard_data_[table_name];
-    std::unique_ptr<ValueComparator> vc(fetch_value_comparator(shards.front().type_name));
-    for (auto &&s : shards) {
-      int cmp = vc->compare(shard_key, s.lb);
-      if (cmp == 0 || cmp == 1) {
-        if (ret == nullptr) {
-          ret.reset(new ManagedShard);
-          copy(s, *ret);
-        }
-        else if (vc->compare(s.lb, ret->lb) == 1) {
-          //The  shard with the smallest lower bound greater than the
-          //shard key is the shard in which the shard key should be
-          //placed.
-          ret.reset(new ManagedShard);
-          copy(s, *ret);
-        }
-        else {
-          continue;
-        }
+    return LookupResult(nullptr);
+  }
+  return LookupResult(group->second);
+}
+
+LookupResult FabricCache::shard_lookup(const string &table_name, const string &shard_key) const {
+  auto snapshot = std::atomic_load(&snapshot_);
+  auto table = snapshot->shard_index.find(table_name);
+  if (table == snapshot->shard_index.end()) {
+    return LookupResult(nullptr);
+  }
+
+  return shard_group(*snapshot, *table->second, find_shard(*table->second, shard_key));
+}
+
+LookupResult FabricCache::shard_key_lookup(const string &table_name, const string &shard_key) const {
+  auto snapshot = std::atomic_load(&snapshot_);
+  auto table = snapshot->shard_index.find(table_name);
+  if (table == snapshot->shard_index.end()) {
+    return LookupResult(nullptr);
+  }
+
+  long index;
+  if (table->second->type == HASH) {
+    index = find_digest(*table->second, md5(shard_key.data(), shard_key.size()));
+  } else {
+    index = find_shard(*table->second, shard_key);
+  }
+  return shard_group(*snapshot, *table->second, index);
+}
+
+std::vector<LookupResult> FabricCache::shard_key_lookup(const string &table_name,
+                                                        const std::vector<string> &shard_keys) const {
+  std::vector<LookupResult> results;
+  results.reserve(shard_keys.size());
+
+  auto snapshot = std::atomic_load(&snapshot_);
+  auto table = snapshot->shard_index.find(table_name);
+  if (table == snapshot->shard_index.end()) {
+    for (size_t i = 0; i < shard_keys.size(); ++i) {
+      results.push_back(LookupResult(nullptr));
+    }
+    return results;
+  }
+
+  if (table->second->type == HASH) {
+    std::vector<MD5Digest> digests;
+    digests.reserve(shard_keys.size());
+    for (auto &key: shard_keys) {
+      digests.push_back(md5(key.data(), key.size()));
+    }
+    for (auto &digest: digests) {
+      results.push_back(shard_group(*snapshot, *table->second, find_digest(*table->second, digest)));
+    }
+  } else {
+    for (auto &key: shard_keys) {
+      results.push_back(shard_group(*snapshot, *table->second, find_shard(*table->second, key)));
+    }
+  }
+  return results;
+}
+
+LookupResult FabricCache::shard_group(const Snapshot &snapshot, const ShardTable &table, long index) {
+  if (index < 0) {
+    return LookupResult(nullptr);
+  }
+  auto group = snapshot.group_data.find(table.groups[table.shard_groups[static_cast<size_t>(index)]]);
+  if (group == snapshot.group_data.end()) {
+    return LookupResult(nullptr);
+  }
+  return LookupResult(group->second);
+}
+
+LookupResult FabricCache::global_group_lookup(const string &table_name) const {
+  auto snapshot = std::atomic_load(&snapshot_);
+  auto table = snapshot->shard_index.find(table_name);
+  if (table == snapshot->shard_index.end() || table->second->groups.empty()) {
+    return LookupResult(nullptr);
+  }
+
+  auto group = snapshot->group_data.find(table->second->groups[table->second->global_group]);
+  if (group == snapshot->group_data.end()) {
+    return LookupResult(nullptr);
+  }
+  return LookupResult(group->second);
+}
+
+namespace {
+
+// Converts the lower bounds of the shards to native keys using `convert`
+// and sorts both on the keys. Returns false when a lower bound could not
+// be converted.
+template<typename Key, typename Converter>
+bool sort_shards(const list<ManagedShard> &shards, Converter convert,
+                 std::vector<Key> *bounds, std::vector<const ManagedShard*> *sorted) {
+  std::vector<std::pair<Key, const ManagedShard*>> keyed;
+  keyed.reserve(shards.size());
+  for (auto &shard: shards) {
+    Key key;
+    if (!convert(shard.lb, &key)) {
+      log_warning("Invalid lower bound '%s' of shard %d for sharding type '%s'",
+                  shard.lb.c_str(), shard.shard_id, shard.type_name.c_str());
+      return false;
+    }
+    keyed.emplace_back(std::move(key), &shard);
+  }
+
+  std::stable_sort(keyed.begin(), keyed.end(),
+                   [](const std::pair<Key, const ManagedShard*> &a,
+                      const std::pair<Key, const ManagedShard*> &b) {
+                     return a.first < b.first;
+                   });
+
+  bounds->reserve(keyed.size());
+  sorted->reserve(keyed.size());
+  for (auto &it: keyed) {
+    bounds->push_back(std::move(it.first));
+    sorted->push_back(it.second);
+  }
+  return true;
+}
+
+// The shard with the greatest lower bound not greater than the
+// shard key is the shard in which the shard key should be placed.
+template<typename Key>
+long find_bound(const std::vector<Key> &bounds, const Key &key) noexcept {
+  auto found = std::upper_bound(bounds.begin(), bounds.end(), key);
+  return static_cast<long>(found - bounds.begin()) - 1;
+}
+
+bool to_string_key(const string &value, string *result) {
+  *result = value;
+  return true;
+}
+
+// Checksums of the data fetched from Fabric use 64-bit FNV-1a
+void checksum_update(uint64_t *hash, const void *data, size_t size) noexcept {
+  *hash = fnv1a_update(*hash, data, size);
+}
+
+void checksum_update(uint64_t *hash, const string &value) noexcept {
+  // include the size so that concatenated fields can not collide
+  uint64_t size = value.size();
+  checksum_update(hash, &size, sizeof(size));
+  checksum_update(hash, value.data(), value.size());
+}
+
+template<typename T>
+void checksum_update(uint64_t *hash, T value) noexcept {
+  checksum_update(hash, &value, sizeof(value));
+}
+
+uint64_t checksum(const list<ManagedServer> &servers) noexcept {
+  uint64_t hash = kFNVOffsetBasis;
+  for (auto &server: servers) {
+    checksum_update(&hash, server.server_uuid);
+    checksum_update(&hash, server.group_id);
+    checksum_update(&hash, server.host);
+    checksum_update(&hash, server.port);
+    checksum_update(&hash, server.mode);
+    checksum_update(&hash, server.status);
+    checksum_update(&hash, server.weight);
+  }
+  return hash;
+}
+
+uint64_t checksum(const list<ManagedShard> &shards) noexcept {
+  uint64_t hash = kFNVOffsetBasis;
+  for (auto &shard: shards) {
+    checksum_update(&hash, shard.schema_name);
+    checksum_update(&hash, shard.table_name);
+    checksum_update(&hash, shard.column_name);
+    checksum_update(&hash, shard.lb);
+    checksum_update(&hash, shard.shard_id);
+    checksum_update(&hash, shard.type_name);
+    checksum_update(&hash, shard.group_id);
+    checksum_update(&hash, shard.global_group);
+  }
+  return hash;
+}
+
+// Resolves the addresses of the servers of given groups using the
+// resolver of the cache, which resolves each distinct host once, a few
+// at a time. Servers of which host was not resolved by the deadline stay
+// unresolved, with an empty resolved_address, so that a slow name server
+// does not delay the refresh: they are resolved again with the next
+// refresh. Returns the number of hosts looked up.
+size_t resolve_servers(const std::vector<list<ManagedServer>*> &groups,
+                       mysql_harness::CachingResolver &resolver,
+                       std::chrono::steady_clock::time_point deadline) {
+  std::set<string> hosts;
+  for (auto group: groups) {
+    for (auto &server: *group) {
+      if (hosts.insert(server.host).second) {
+        resolver.prefetch(server.host);
       }
     }
-    if (ret) {
-      servers = group_data_[ret->group_id];
-    } else {
-      servers = {};
+  }
+
+  map<string, string> addresses;
+  for (auto &host: hosts) {
+    auto timeout = std::max(deadline - std::chrono::steady_clock::now(),
+                            std::chrono::steady_clock::duration::zero());
+    try {
+      addresses.emplace(host, resolver.hostname(host, timeout).front().str());
+    } catch (const std::system_error &) {
+      log_info("Host '%s' not resolved yet", host.c_str());
+    } catch (const std::exception &exc) {
+      log_warning("Failed resolving '%s': %s", host.c_str(), exc.what());
+    }
+  }
+
+  for (auto group: groups) {
+    for (auto &server: *group) {
+      server.resolved_address.clear();
+      auto address = addresses.find(server.host);
+      if (address == addresses.end()) {
+        continue;
+      }
+      // The address is numeric; getaddrinfo() does not query a name server
+      try {
+        server.resolved_address = resolve_address(address->second, server.port);
+      } catch (const fabric_cache::base_error &exc) {
+        log_warning("Server %s: %s", server.server_uuid.c_str(), exc.what());
+      }
     }
   }
-  cache_refreshing_mutex_.unlock();
-  return servers;
+  return hosts.size();
 }
 
-void FabricCache::refresh() {
-  try {
-    fetch_data();
-    cache_refreshing_mutex_.lock();
-    group_data_ = group_data_temp_;
-    shard_data_ = shard_data_temp_;
-    cache_refreshing_mutex_.unlock();
-  } catch (const fabric_cache::base_error &exc) {
-    log_debug("Failed fetching data: %s", exc.what());
+bool has_unresolved(const list<ManagedServer> &servers) noexcept {
+  for (auto &server: servers) {
+    if (server.resolved_address.empty()) {
+      return true;
+    }
   }
+  return false;
 }
 
-void FabricCache::fetch_data() {
-    group_data_temp_ = fabric_meta_data_->fetch_servers();
-    shard_data_temp_ = fabric_meta_data_->fetch_shards();
-    ttl_ = fabric_meta_data_->fetch_ttl();
+// Whether the servers of a group, which did not change, resolved to the
+// same addresses
+bool same_addresses(const list<ManagedServer> &servers, const list<ManagedServer> &other) noexcept {
+  if (servers.size() != other.size()) {
+    return false;
+  }
+  auto it = other.begin();
+  for (auto &server: servers) {
+    if (server.resolved_address != (it++)->resolved_address) {
+      return false;
+    }
+  }
+  return true;
 }
 
-ValueComparator *FabricCache::fetch_value_comparator(string shard_type) {
-  std::transform(shard_type.begin(), shard_type.end(),
-                 shard_type.begin(), ::toupper);
-  switch (shard_type_map_.at(shard_type)) {
+} // namespace
+
+long FabricCache::find_shard(const ShardTable &table, const string &shard_key) noexcept {
+  switch (table.type) {
+    case RANGE:
+    case RANGE_INTEGER: {
+      int64_t key;
+      return to_integer_key(shard_key, &key) ? find_bound(table.integer_bounds, key) : -1;
+    }
+    case RANGE_DATETIME: {
+      int64_t key;
+      return to_datetime_key(shard_key, &key) ? find_bound(table.integer_bounds, key) : -1;
+    }
+    case HASH: {
+      MD5Digest key;
+      return to_md5_key(shard_key, &key) ? find_digest(table, key) : -1;
+    }
+    case RANGE_STRING:
+      return table.find_string_bound(shard_key);
+  }
+  return -1;
+}
+
+long FabricCache::ShardTable::find_string_bound(const string &key) const noexcept {
+  // same as find_bound(), comparing with bounds in the shared buffer
+  size_t low = 0;
+  size_t high = string_bound_ends.size();
+  while (low < high) {
+    size_t middle = low + (high - low) / 2;
+    size_t start = middle == 0 ? 0 : string_bound_ends[middle - 1];
+    if (key.compare(0, string::npos, string_bound_data, start, string_bound_ends[middle] - start) < 0) {
+      high = middle;
+    } else {
+      low = middle + 1;
+    }
+  }
+  return static_cast<long>(low) - 1;
+}
+
+long FabricCache::find_digest(const ShardTable &table, const MD5Digest &digest) noexcept {
+  auto index = find_bound(table.digest_bounds, digest);
+  if (index < 0) {
+    return static_cast<long>(table.digest_bounds.size()) - 1;
+  }
+  return index;
+}
+
+std::shared_ptr<const FabricCache::ShardTable> FabricCache::build_shard_table(
+    const string &table_name, const list<ManagedShard> &shards) {
+  if (shards.empty()) {
+    return nullptr;
+  }
+  string type_name = shards.front().type_name;
+  std::transform(type_name.begin(), type_name.end(), type_name.begin(), ::toupper);
+  auto type = shard_type_map_.find(type_name);
+  if (type == shard_type_map_.end()) {
+    log_warning("Unknown sharding type '%s' for table '%s'",
+                shards.front().type_name.c_str(), table_name.c_str());
+    return nullptr;
+  }
+
+  std::shared_ptr<ShardTable> table(new ShardTable());
+  table->type = static_cast<shard_type_enum_>(type->second);
+  std::vector<const ManagedShard*> sorted;
+  std::vector<string> string_bounds;
+  bool valid = false;
+  switch (table->type) {
     case RANGE:
     case RANGE_INTEGER:
-      return new IntegerValueComparator();
+      valid = sort_shards(shards, to_integer_key, &table->integer_bounds, &sorted);
       break;
     case RANGE_DATETIME:
-      return new DateTimeValueComparator();
-      break;
-    case RANGE_STRING:
-      return new StringValueComparator();
+      valid = sort_shards(shards, to_datetime_key, &table->integer_bounds, &sorted);
       break;
     case HASH:
-      return new MD5HashValueComparator();
+      valid = sort_shards(shards, to_md5_key, &table->digest_bounds, &sorted);
       break;
-    default:
-      return nullptr;
+    case RANGE_STRING:
+      valid = sort_shards(shards, to_string_key, &string_bounds, &sorted);
       break;
   }
+  if (!valid) {
+    log_warning("Shard information of table '%s' ignored", table_name.c_str());
+    return nullptr;
+  }
+
+  size_t string_bounds_size = 0;
+  for (auto &bound: string_bounds) {
+    string_bounds_size += bound.size();
+  }
+  table->string_bound_data.reserve(string_bounds_size);
+  table->string_bound_ends.reserve(string_bounds.size());
+  for (auto &bound: string_bounds) {
+    table->string_bound_data.append(bound);
+    table->string_bound_ends.push_back(static_cast<uint32_t>(table->string_bound_data.size()));
+  }
+
+  // Tables are usually spread over a few groups; each is stored once
+  map<string, uint32_t> group_ids;
+  auto intern_group = [&group_ids, &table](const string &group_id) {
+    auto found = group_ids.find(group_id);
+    if (found != group_ids.end()) {
+      return found->second;
+    }
+    auto id = static_cast<uint32_t>(table->groups.size());
+    table->groups.push_back(group_id);
+    group_ids.emplace(group_id, id);
+    return id;
+  };
+  table->shard_groups.reserve(sorted.size());
+  for (auto shard: sorted) {
+    table->shard_groups.push_back(intern_group(shard->group_id));
+  }
+  table->global_group = intern_group(sorted.front()->global_group);
+  table->groups.shrink_to_fit();
+  return table;
 }
 
-void FabricCache::copy(const ManagedShard &source_shard, ManagedShard &destn_shard) {
-  destn_shard.schema_name = source_shard.schema_name;
-  destn_shard.table_name = source_shard.table_name;
-  destn_shard.column_name = source_shard.column_name;
-  destn_shard.lb = source_shard.lb;
-  destn_shard.shard_id = source_shard.shard_id;
-  destn_shard.type_name = source_shard.type_name;
-  destn_shard.group_id = source_shard.group_id;
-  destn_shard.global_group = source_shard.global_group;
+void FabricCache::refresh() {
+  std::lock_guard<std::mutex> lock(cache_refreshing_mutex_);
+  try {
+    fetch_data();
+  } catch (const fabric_cache::base_error &exc) {
+    LOG_DEBUG("Failed fetching data: %s", exc.what());
+    return;
+  }
+  if (apply_data(true)) {
+    refreshes_applied_.fetch_add(1, std::memory_order_relaxed);
+    // Waiters check the generation while holding the mutex
+    { std::lock_guard<std::mutex> waiters_lock(terminate_mutex_); }
+    refreshed_cond_.notify_all();
+  } else {
+    refreshes_skipped_.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+void FabricCache::set_resolve_ttl(std::chrono::milliseconds ttl) {
+  std::lock_guard<std::mutex> lock(cache_refreshing_mutex_);
+  resolve_ttl_ = ttl;
+  resolver_->set_ttl(ttl, kResolveNegativeTimeToLive);
+}
+
+void FabricCache::set_resolver_lookup(mysql_harness::CachingResolver::Lookup lookup) {
+  std::lock_guard<std::mutex> lock(cache_refreshing_mutex_);
+  resolver_.reset(new mysql_harness::CachingResolver(kResolveThreads, resolve_ttl_,
+                                                     kResolveNegativeTimeToLive, std::move(lookup)));
+}
+
+void FabricCache::load_cache_file() {
+  std::lock_guard<std::mutex> lock(cache_refreshing_mutex_);
+  try {
+    auto data = read_cache_file(cache_file_);
+    group_data_temp_.swap(data.groups);
+    shard_data_temp_.swap(data.shards);
+    ttl_ = data.ttl;
+  } catch (const fabric_cache::base_error &exc) {
+    log_warning("%s", exc.what());
+    return;
+  }
+  apply_data(false);
+  log_info("Loaded Fabric Cache data from '%s'", cache_file_.c_str());
+}
+
+bool FabricCache::apply_data(bool persist) {
+  map<string, uint64_t> group_checksums;
+  for (auto &it: group_data_temp_) {
+    group_checksums.emplace(it.first, checksum(it.second));
+  }
+  map<string, uint64_t> table_checksums;
+  for (auto &it: shard_data_temp_) {
+    table_checksums.emplace(it.first, checksum(it.second));
+  }
+
+  auto current = std::atomic_load(&snapshot_);
+  bool data_changed = current->generation == 0 || group_checksums != group_checksums_ ||
+                      table_checksums != table_checksums_;
+
+  // Groups of which the checksum did not change are shared with the
+  // current snapshot. Only the servers of changed groups, and of groups
+  // having servers which could not be resolved, are resolved again; all
+  // of them are once resolve_ttl_ passed, so that address changes are
+  // picked up.
+  auto now = std::chrono::steady_clock::now();
+  bool resolve_all = now - last_resolve_ >= resolve_ttl_;
+  std::shared_ptr<Snapshot> snapshot(new Snapshot());
+  std::vector<list<ManagedServer>*> changed;
+  std::vector<map<string, list<ManagedServer>>::iterator> unchanged;
+  for (auto it = group_data_temp_.begin(); it != group_data_temp_.end(); ++it) {
+    auto previous = group_checksums_.find(it->first);
+    auto group = current->group_data.find(it->first);
+    if (previous == group_checksums_.end() || previous->second != group_checksums[it->first] ||
+        group == current->group_data.end()) {
+      changed.push_back(&it->second);
+    } else if (resolve_all || has_unresolved(*group->second)) {
+      // Unchanged, but resolved again
+      unchanged.push_back(it);
+    } else {
+      snapshot->group_data.emplace(*group);
+    }
+  }
+
+  if (!data_changed && unchanged.empty()) {
+    group_data_temp_.clear();
+    shard_data_temp_.clear();
+    return false;
+  }
+
+  if (data_changed && persist && !cache_file_.empty()) {
+    try {
+      write_cache_file(cache_file_, group_data_temp_, shard_data_temp_, ttl_);
+    } catch (const fabric_cache::base_error &exc) {
+      log_warning("%s", exc.what());
+    }
+  }
+
+  std::vector<list<ManagedServer>*> resolving(changed);
+  for (auto it: unchanged) {
+    resolving.push_back(&it->second);
+  }
+  servers_resolved_.fetch_add(resolve_servers(resolving, *resolver_, now + kResolveTimeout),
+                              std::memory_order_relaxed);
+  if (resolve_all) {
+    last_resolve_ = now;
+  }
+
+  // Groups resolving to the same addresses again are shared as well
+  size_t resolved_groups = 0;
+  for (auto it: unchanged) {
+    auto group = current->group_data.find(it->first);
+    if (same_addresses(it->second, *group->second)) {
+      snapshot->group_data.emplace(*group);
+    } else {
+      ++resolved_groups;
+    }
+  }
+  if (!data_changed && resolved_groups == 0) {
+    group_data_temp_.clear();
+    shard_data_temp_.clear();
+    return false;
+  }
+
+  size_t changed_groups = changed.size() + resolved_groups;
+  for (auto &it: group_data_temp_) {
+    if (snapshot->group_data.find(it.first) == snapshot->group_data.end()) {
+      snapshot->group_data.emplace(it.first, std::make_shared<const list<ManagedServer>>(std::move(it.second)));
+    }
+  }
+
+  size_t changed_tables = 0;
+  for (auto &it: shard_data_temp_) {
+    auto previous = table_checksums_.find(it.first);
+    if (previous != table_checksums_.end() && previous->second == table_checksums[it.first]) {
+      // Tables which were ignored before stay ignored
+      auto table = current->shard_index.find(it.first);
+      if (table != current->shard_index.end()) {
+        snapshot->shard_index.emplace(*table);
+      }
+      continue;
+    }
+    auto table = build_shard_table(it.first, it.second);
+    if (table) {
+      snapshot->shard_index.emplace(it.first, std::move(table));
+    }
+    ++changed_tables;
+  }
+
+  snapshot->generation = current->generation + 1;
+  group_data_temp_.clear();
+  shard_data_temp_.clear();
+  group_checksums_.swap(group_checksums);
+  table_checksums_.swap(table_checksums);
+
+  std::atomic_store(&snapshot_, std::shared_ptr<const Snapshot>(std::move(snapshot)));
+  LOG_DEBUG("Fabric Cache refreshed; %u group(s) and %u table(s) changed",
+            static_cast<unsigned int>(changed_groups), static_cast<unsigned int>(changed_tables));
+  return true;
+}
+
+void FabricCache::fetch_data() {
+    fabric_meta_data_->fetch_all(&group_data_temp_, &shard_data_temp_);
+    ttl_ = fabric_meta_data_->fetch_ttl();
 }
@@ -23,21 +23,42 @@
 #include "utils.h"
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <ctime>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <thread>
+#include <vector>
 
 #include "mysql/harness/logger.h"
+#include "networking/caching_resolver.h"
 
 using std::string;
 using std::thread;
+using fabric_cache::LookupResult;
 using fabric_cache::ManagedServer;
 using fabric_cache::ManagedShard;
 
 const int kDefaultTimeToLive = 10;
 
+/** @brief Minimum time between a refresh and a requested refresh */
+const std::chrono::milliseconds kMinRefreshInterval{500};
+
+/** @brief Time after which the addresses of all servers are resolved again */
+const std::chrono::milliseconds kResolveTimeToLive{300000};
+
+/** @brief Time after which hosts which failed to resolve are resolved again */
+const std::chrono::milliseconds kResolveNegativeTimeToLive{5000};
+
+/** @brief Maximum time a refresh waits for the addresses of servers */
+const std::chrono::milliseconds kResolveTimeout{1000};
+
+/** @brief Number of threads resolving the addresses of servers */
+const size_t kResolveThreads = 2;
+
 /** @class FabricCache
  *
  * The FabricCache manages cached information fetched from the
@@ -47,37 +68,173 @@ const int kDefaultTimeToLive = 10;
 class FabricCache {
 
 public:
-  /** @brief Constructor */
+  /** @brief Constructor
+   *
+   * Does not contact Fabric: the cache is first refreshed by the thread
+   * launched by start(). When cache_file is given, data previously stored
+   * in it is loaded and served until then. Each refresh publishing new
+   * data stores it again in the file.
+   *
+   * @param host MySQL Fabric host
+   * @param port MySQL Fabric port
+   * @param user MySQL Fabric username
+   * @param password MySQL Fabric password
+   * @param connection_timeout timeout connecting to Fabric
+   * @param connection_attempts number of attempts connecting to Fabric
+   * @param cache_file path of the cache file; empty disables it
+   */
   FabricCache(string host, int port, string user, string password,
-              int connection_timeout, int connection_attempts);
+              int connection_timeout, int connection_attempts,
+              string cache_file = "");
 
   /** @brief Destructor */
   ~FabricCache();
 
   /** Starts the Fabric Cache
    *
-   * Starts the Fabric Cache and launch thread.
+   * Starts the Fabric Cache and launches the thread refreshing it. The
+   * thread refreshes the cache right away, then waits the refresh
+   * interval (TTL) reported by Fabric between refreshes. Does nothing
+   * when the cache was already started.
    */
   void start();
 
+  /** Stops the Fabric Cache
+   *
+   * Wakes up and joins the refresh thread. Lookups keep using the
+   * data refreshed last.
+   */
+  void stop();
+
+  /** @brief Requests the refresh thread to refresh the cache now
+   *
+   * Used when the cached data is suspected to be stale, for example when
+   * connecting to a managed server failed. The refresh thread refreshes
+   * without waiting for the TTL, but not sooner than kMinRefreshInterval
+   * after the previous refresh. Requests made while a refresh is pending
+   * are merged.
+   */
+  void request_refresh() noexcept;
+
+  /** @brief Waits until the cache was refreshed
+   *
+   * Waits until the generation of the cached data is greater than the
+   * given generation.
+   *
+   * @param generation Generation to wait past
+   * @param timeout Maximum time to wait
+   * @return true when the generation changed, false when timed out
+   */
+  bool wait_refreshed(uint64_t generation, std::chrono::milliseconds timeout);
+
   /** @brief Returns list of managed servers in a group
    *
-   * Returns list of managed servers in a group.
+   * Returns list of managed servers in a group. The servers are not
+   * copied; the result shares the snapshot current at the time of the
+   * lookup.
    *
    * @param group_id The ID of the group being looked up
-   * @return std::list containing ManagedServer objects
+   * @return LookupResult referencing ManagedServer objects
    */
-  list<ManagedServer> group_lookup(const string &group_id);
+  LookupResult group_lookup(const string &group_id) const;
 
   /** @brief Returns list of managed servers using sharding table and key
    *
-   * Returns list of managed servers using sharding table and key.
+   * Returns list of managed servers using sharding table and key. The
+   * servers are not copied; the result shares the snapshot current at the
+   * time of the lookup.
    *
    * @param table_name The string representing the table name being sharded.
    * @param shard_key The shard key that needs to be looked up.
-   * @return std::list containing ManagedServer objects
+   * @return LookupResult referencing ManagedServer objects
    */
-  list<ManagedServer> shard_lookup(const string &table_name, const string &shard_key);
+  LookupResult shard_lookup(const string &table_name, const string &shard_key) const;
+
+  /** @brief Returns list of managed servers using the value of a shard key
+   *
+   * Same as shard_lookup(), except that for HASH sharded tables the shard
+   * key is the value of the key, as stored in the row, instead of its
+   * MD5 hash. The hash is computed by the cache.
+   *
+   * @param table_name The string representing the table name being sharded.
+   * @param shard_key The value of the shard key.
+   * @return LookupResult referencing ManagedServer objects
+   */
+  LookupResult shard_key_lookup(const string &table_name, const string &shard_key) const;
+
+  /** @overload
+   *
+   * Looks up many shard keys at once using the same snapshot. For HASH
+   * sharded tables all keys are hashed first, then placed.
+   *
+   * @param table_name The string representing the table name being sharded.
+   * @param shard_keys The values of the shard keys.
+   * @return LookupResult for each shard key, in the same order
+   */
+  std::vector<LookupResult> shard_key_lookup(const string &table_name,
+                                             const std::vector<string> &shard_keys) const;
+
+  /** @brief Returns list of managed servers of the global group of a table
+   *
+   * @param table_name The string representing the table name being sharded.
+   * @return LookupResult referencing ManagedServer objects
+   */
+  LookupResult global_group_lookup(const string &table_name) const;
+
+  /** @brief Returns the generation of the cached data
+   *
+   * The generation is incremented each time the cache was
+   * successfully refreshed, or loaded from the cache file.
+   *
+   * @return generation as uint64_t
+   */
+  uint64_t generation() const noexcept {
+    return std::atomic_load(&snapshot_)->generation;
+  }
+
+  /** @brief Refreshes the cache
+   *
+   * Fetches the data from Fabric and publishes a new snapshot when the
+   * data changed. Groups and tables which did not change are shared with
+   * the previous snapshot. When nothing changed, the current snapshot and
+   * its generation are kept.
+   */
+  void refresh();
+
+  /** @brief Returns number of refreshes which published new data */
+  uint64_t refreshes_applied() const noexcept {
+    return refreshes_applied_.load(std::memory_order_relaxed);
+  }
+
+  /** @brief Returns number of refreshes skipped because data was unchanged */
+  uint64_t refreshes_skipped() const noexcept {
+    return refreshes_skipped_.load(std::memory_order_relaxed);
+  }
+
+  /** @brief Returns number of server addresses resolved */
+  uint64_t servers_resolved() const noexcept {
+    return servers_resolved_.load(std::memory_order_relaxed);
+  }
+
+  /** @brief Sets the time after which all servers are resolved again
+   *
+   * Servers which could not be resolved are resolved again with each
+   * refresh. Resolved hosts are kept, and refreshed in the background,
+   * for the same time. Defaults to kResolveTimeToLive.
+   *
+   * @param ttl time between resolving all servers
+   */
+  void set_resolve_ttl(std::chrono::milliseconds ttl);
+
+  /** @brief Sets the function resolving the hosts of servers
+   *
+   * Hosts are resolved by the system (see Resolver::hostname()) unless
+   * set otherwise, for example by tests. Hosts resolved before are
+   * resolved again.
+   *
+   * @param lookup function resolving a host
+   */
+  void set_resolver_lookup(mysql_harness::CachingResolver::Lookup lookup);
 
 private:
   enum shard_type_enum_ {
@@ -85,13 +242,79 @@ private:
     HASH
   };
 
-  /**
-   * Copy source shard to the destination shard.
+  /** @brief Shards of a table sorted by lower bound
+   *
+   * The lower bounds are converted once, when the cache is refreshed, to
+   * native keys of the sharding type of the table. Looking up a shard key
+   * converts the key the same way and does a binary search on the bounds.
+   * Only the bounds matching the sharding type are filled.
+   *
+   * Only what is needed for lookups is kept, one array per field: the
+   * i-th shard is the shard of which lower bound is the i-th bound and
+   * which is held by group `groups[shard_groups[i]]`. Group IDs are
+   * stored once per table, and string bounds are stored one after the
+   * other in a single buffer.
+   */
+  struct ShardTable {
+    /** @brief Sharding type of the table */
+    shard_type_enum_ type;
+    /** @brief Bounds of RANGE, RANGE_INTEGER and RANGE_DATETIME tables */
+    std::vector<int64_t> integer_bounds;
+    /** @brief Bounds of HASH tables */
+    std::vector<MD5Digest> digest_bounds;
+    /** @brief Bounds of RANGE_STRING tables, one after the other */
+    string string_bound_data;
+    /** @brief End of each bound of RANGE_STRING tables in string_bound_data */
+    std::vector<uint32_t> string_bound_ends;
+    /** @brief Distinct IDs of the groups holding shards of the table */
+    std::vector<string> groups;
+    /** @brief Index in `groups` of the group of each shard */
+    std::vector<uint32_t> shard_groups;
+    /** @brief Index in `groups` of the global group */
+    uint32_t global_group;
+
+    /** @brief Returns index of the shard holding a RANGE_STRING key
+     *
+     * @return index of the shard, or -1 when no shard holds the key
+     */
+    long find_string_bound(const string &key) const noexcept;
+
+    /** @brief Returns the number of shards */
+    size_t size() const noexcept {
+      return shard_groups.size();
+    }
+  };
+
+  /** @brief Builds the sorted shards of a table
+   *
+   * Tables using an unknown sharding type, or having a lower bound which
+   * is not valid for the sharding type, can not be looked up.
+   *
+   * @param table_name Name of the sharded table
+   * @param shards Shards of the table fetched from Fabric
+   * @return sorted shards, or nullptr when the table can not be looked up
+   */
+  static std::shared_ptr<const ShardTable> build_shard_table(const string &table_name,
+                                                             const list<ManagedShard> &shards);
+
+  /** @brief Returns index of the shard in which given key is placed
+   *
+   * @param table Sharded table
+   * @param shard_key The shard key as string
+   * @return index of the shard, or -1 when no shard holds the key
+   */
+  static long find_shard(const ShardTable &table, const string &shard_key) noexcept;
+
+  /** @brief Returns index of the shard of a HASH table holding given digest
    *
-   * @param source_shard Source shard structure.
-   * @param destn_shard Destination shard structure.
+   * Digests lower than the lowest bound belong to the shard with the
+   * highest bound, closing the ring like MySQL Fabric does.
+   *
+   * @param table HASH sharded table
+   * @param digest MD5 digest of the shard key
+   * @return index of the shard, or -1 when table has no shards
    */
-  void copy(const ManagedShard &source_shard, ManagedShard &destn_shard);
+  static long find_digest(const ShardTable &table, const MD5Digest &digest) noexcept;
 
   /** @brief Fetches all data from Fabric
    *
@@ -99,37 +322,93 @@ private:
    */
   void fetch_data();
 
-  /** @brief Refreshes the cache
+  /** @brief Refreshes the cache until stopped */
+  void refresh_loop();
+
+  /** @brief Loads data stored in the cache file
    *
-   * Refreshes the cache.
+   * Invalid or missing cache files are ignored.
    */
-  void refresh();
+  void load_cache_file();
+
+  /** @brief Publishes the fetched data
+   *
+   * Publishes a new snapshot using the data fetched, unless it did not
+   * change. The caller is responsible for locking `cache_refreshing_mutex_`.
+   *
+   * @param persist whether to store published data in the cache file
+   * @return true when a new snapshot was published
+   */
+  bool apply_data(bool persist);
 
-  /** @brief Returns instance of key comparator for Sharding
+  /** @brief Immutable copy of the cached data
    *
-   * Returns instance of the appropriated key comparator for Sharding.
+   * A refresh builds a new snapshot and publishes it replacing `snapshot_`
+   * atomically. Lookups only load the current snapshot and never wait for
+   * a refresh; results keep their snapshot alive.
+   */
+  struct Snapshot {
+    /** @brief Servers of each group */
+    map<string, std::shared_ptr<const list<ManagedServer>>> group_data;
+    /** @brief Sorted shards of each table */
+    map<string, std::shared_ptr<const ShardTable>> shard_index;
+    /** @brief Number of snapshots published before, including this one */
+    uint64_t generation = 0;
+  };
+
+  /** @brief Returns servers of the group holding the given shard
    *
-   * @param shard_type The sharding type for which the keys need to be compared.
-   * @return Comparator class implementation.
+   * @param snapshot Snapshot holding the table
+   * @param table Sharded table
+   * @param index Index of the shard in `table`; -1 for none
+   * @return LookupResult referencing ManagedServer objects
    */
-  ValueComparator *fetch_value_comparator(string shard_type);
+  static LookupResult shard_group(const Snapshot &snapshot, const ShardTable &table, long index);
 
-  map<string, list<ManagedServer>> group_data_;
-  map<string, list<ManagedShard>> shard_data_;
-  int ttl_;
+  /** @brief Current snapshot; accessed using std::atomic_load/atomic_store */
+  std::shared_ptr<const Snapshot> snapshot_;
+  std::atomic<int> ttl_;
 
   map<string, list<ManagedServer>> group_data_temp_;
   map<string, list<ManagedShard>> shard_data_temp_;
 
   static const map<string, int> shard_type_map_;
 
+  /** @brief Whether the refresh thread has to stop; guarded by `terminate_mutex_` */
   bool terminate_;
+  /** @brief Whether a refresh was requested; guarded by `terminate_mutex_` */
+  bool refresh_requested_;
+  std::mutex terminate_mutex_;
+  /** @brief Wakes up the refresh thread */
+  std::condition_variable terminate_cond_;
+  /** @brief Wakes up threads waiting for a refresh; uses `terminate_mutex_` */
+  std::condition_variable refreshed_cond_;
 
   std::shared_ptr<FabricMetaData> fabric_meta_data_;
 
+  /** @brief Path of the cache file; empty when not used */
+  string cache_file_;
+
   thread refresh_thread_;
 
+  /** @brief Serializes refreshes */
   std::mutex cache_refreshing_mutex_;
+
+  /** @brief Checksums of the servers of each group of the last refresh */
+  map<string, uint64_t> group_checksums_;
+  /** @brief Checksums of the shards of each table of the last refresh */
+  map<string, uint64_t> table_checksums_;
+
+  /** @brief Resolves the hosts of servers in the background; guarded by `cache_refreshing_mutex_` */
+  std::unique_ptr<mysql_harness::CachingResolver> resolver_;
+  /** @brief Time between resolving all servers; guarded by `cache_refreshing_mutex_` */
+  std::chrono::milliseconds resolve_ttl_;
+  /** @brief When all servers were last resolved; guarded by `cache_refreshing_mutex_` */
+  std::chrono::steady_clock::time_point last_resolve_;
+
+  std::atomic<uint64_t> refreshes_applied_;
+  std::atomic<uint64_t> refreshes_skipped_;
+  std::atomic<uint64_t> servers_resolved_;
 };
 
 #endif // FABRIC_CACHE_FABRIC_CACHE_INCLUDED
@@ -21,6 +21,7 @@
 #include "mysqlrouter/utils.h"
 #include "mysql/harness/logger.h"
 #include "mysql/harness/config_parser.h"
+#include "mysql/harness/filesystem.h"
 
 #include <string>
 #include <thread>
@@ -32,6 +33,7 @@
 
 
 using fabric_cache::LookupResult;
+using mysql_harness::Path;
 using mysqlrouter::TCPAddress;
 using std::string;
 
@@ -57,6 +59,22 @@ PasswordKey make_cache_password(const TCPAddress &addr, const string &user) {
   return std::make_pair(addr.str(), user);
 }
 
+/** @brief Returns path of the file storing data of a cache
+ *
+ * The file is stored in the runtime folder. No file is used when
+ * the runtime folder is not set.
+ *
+ * @param cache_name name of the cache (section key)
+ * @return path as string, or empty string
+ */
+static string get_cache_file(const string &cache_name) {
+  if (!g_app_info || !g_app_info->runtime_folder || !*g_app_info->runtime_folder) {
+    return {};
+  }
+  string basename = cache_name.empty() ? kSectionName : kSectionName + "_" + cache_name;
+  return Path::make_path(g_app_info->runtime_folder, basename, "cache").str();
+}
+
 /** @brief Returns whether we have already password
  *
  * @param std::pair holding address and username
@@ -71,10 +89,6 @@ static int init(const mysql_harness::AppInfo *info) {
 
   if (info && info->config) {
 
-    if (info->config->get(kSectionName).size() > 1) {
-      throw std::invalid_argument("Router supports only 1 fabric_cache section.");
-    }
-
     for (auto &section: info->config->get(kSectionName)) {
       FabricCachePluginConfig config(section); // raises on errors
       fabric_cache::g_fabric_cache_config_sections.push_back(section->key);
@@ -147,13 +161,14 @@ static void start(const mysql_harness::ConfigSection *section) {
     if (found != fabric_cache_passwords.end()) {
       password = found->second;
     }
-    fabric_cache::cache_init(section->key, config.address.addr, port, config.user, password);
+    fabric_cache::cache_init(section->key, config.address.addr, port, config.user, password,
+                             get_cache_file(section->key));
 
   } catch (const fabric_cache::base_error &exc) {
     // We continue and retry
-    log_error(exc.what());
+    log_error("%s", exc.what());
   } catch (const std::invalid_argument &exc) {
-    log_error(exc.what());
+    log_error("%s", exc.what());
     return;
   }
 }
@@ -170,5 +185,6 @@ extern "C" {
     nullptr,    // deinit
     start,      // start
     nullptr,    // stop
+    nullptr,    // reload
   };
 }
@@ -19,33 +19,12 @@
 #include "fabric.h"
 
 #include <memory>
-#include <mutex>
-
-std::once_flag fabric_metadata_flag;
-
-std::shared_ptr<FabricMetaData> fabric_meta_data(nullptr);
 
 /**
- * Create an instance of fabric metadata.
+ * Create a fabric metadata fetch instance.
  *
- * @param host The host on which the fabric server is running.
- * @param port The port number on which the fabric server is listening.
- * @param user The user name used to authenticate to the fabric server.
- * @param password The password used to authenticate to the fabric server.
- * @param fabric_connection_timeout The time after which a connection to the
- *                                  fabric server should timeout.
- * @param connection_attempts The number of times a connection to fabric must be
- *                            attempted, when a connection attempt fails.
- */
-void create_instance(const string &host, int port, const string &user,
-                     const string &password, int connection_timeout,
-                     int connection_attempts) {
-  fabric_meta_data.reset(new Fabric(host, port, user, password,
-                                    connection_timeout, connection_attempts));
-}
-
-/**
- * Get a fabric metadata fetch instance.
+ * Each Fabric Cache gets its own instance, so that caches using different
+ * MySQL Fabric farms do not share connections.
  *
  * @param host The host on which the fabric server is running.
  * @param port The port number on which the fabric server is listening.
@@ -63,10 +42,6 @@ std::shared_ptr<FabricMetaData> get_instance(const string &host, int port,
                                              const string &password,
                                              int connection_timeout,
                                              int connection_attempts) {
-  if (fabric_meta_data) {
-    return fabric_meta_data;
-  }
-  std::call_once(fabric_metadata_flag, create_instance, host, port, user,
-                 password, connection_timeout, connection_attempts);
-  return fabric_meta_data;
+  return std::make_shared<Fabric>(host, port, user, password,
+                                  connection_timeout, connection_attempts);
 }
@@ -39,6 +39,21 @@ public:
   virtual int fetch_ttl() = 0;
   virtual map<string, list<ManagedServer>> fetch_servers() = 0;
   virtual map<string, list<ManagedShard>> fetch_shards() = 0;
+
+  /** @brief Fetches servers and shards
+   *
+   * Implementations can fetch both at the same time. The default
+   * fetches servers, then shards.
+   *
+   * @param servers (out) servers of each group
+   * @param shards (out) shards of each table
+   */
+  virtual void fetch_all(map<string, list<ManagedServer>> *servers,
+                         map<string, list<ManagedShard>> *shards) {
+    *servers = fetch_servers();
+    *shards = fetch_shards();
+  }
+
   virtual bool connect() = 0;
   virtual void disconnect() = 0;
 };
@@ -19,21 +19,21 @@
 
 #include "mysqlrouter/fabric_cache.h"
 
+#include <cerrno>
+#include <climits>
+#include <cstdint>
 #include <cstring>
-#include <ctime>
-#include <iomanip>
-#include <sstream>
-#include <stdlib.h>
 #include <string>
-#include <time.h>
-#include <vector>
 
-using std::getline;
-using std::hex;
-using std::stoi;
-using std::stringstream;
-using std::tm;
-using std::vector;
+#ifndef _WIN32
+# include <netdb.h>
+# include <sys/socket.h>
+#else
+# define WIN32_LEAN_AND_MEAN
+# include <windows.h>
+# include <winsock2.h>
+# include <ws2tcpip.h>
+#endif
 
 string get_string(const char *input_str) {
   if (input_str == nullptr) {
@@ -43,122 +43,282 @@ string get_string(const char *input_str) {
 }
 
 
-int IntegerValueComparator::compare(string val_a, string val_b) {
-  if (atoi(val_a.c_str()) > atoi(val_b.c_str())) {
-    return 1;
+namespace {
+
+const char *skip_spaces(const char *pos, const char *end) noexcept {
+  while (pos < end && (*pos == ' ' || *pos == '\t')) {
+    ++pos;
   }
-  else if (atoi(val_a.c_str()) < atoi(val_b.c_str())) {
-    return -1;
+  return pos;
+}
+
+// Reads exactly `digits` decimal digits
+bool read_digits(const char **pos, const char *end, int digits, int64_t *result) noexcept {
+  int64_t value = 0;
+  for (int i = 0; i < digits; ++i, ++*pos) {
+    if (*pos >= end || **pos < '0' || **pos > '9') {
+      return false;
+    }
+    value = value * 10 + (**pos - '0');
   }
-  return 0;
+  *result = value;
+  return true;
 }
 
-time_t DateTimeValueComparator::convert_to_time_t(string datetime_str) {
-  stringstream ss(datetime_str);
+// Days since 1970-01-01 of a date in the proleptic Gregorian calendar
+int64_t days_from_civil(int64_t year, int64_t month, int64_t day) noexcept {
+  year -= month <= 2;
+  const int64_t era = (year >= 0 ? year : year - 399) / 400;
+  const int64_t yoe = year - era * 400;
+  const int64_t doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
 
-  char delimiter = ' ';
-  string part;
+int hex_value(char c) noexcept {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  } else if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  } else if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
 
-  vector<int> date;
-  vector<int> time;
+} // namespace
 
-  size_t pos;
+bool to_integer_key(const string &value, int64_t *result) noexcept {
+  const char *pos = value.c_str();
+  const char *end = pos + value.size();
 
-  struct tm datetime_tm;
+  pos = skip_spaces(pos, end);
+  bool negative = false;
+  if (pos < end && (*pos == '-' || *pos == '+')) {
+    negative = (*pos == '-');
+    ++pos;
+  }
+  if (pos == end || *pos < '0' || *pos > '9') {
+    return false;
+  }
 
-  //Parse the date and time parts separately
-  while (getline(ss, part, delimiter)) {
-    //Parse Date
-    if (date.size() == 0) {
-      stringstream ss_date(part);
-      while (getline(ss_date, part, '-')) {
-        date.push_back(stoi(part));
-      }
+  // accumulate as negative number so INT64_MIN can be represented
+  int64_t number = 0;
+  for (; pos < end && *pos >= '0' && *pos <= '9'; ++pos) {
+    int digit = *pos - '0';
+    if (number < (INT64_MIN + digit) / 10) {
+      return false;  // overflow
     }
-      //Parse Time
-    else if (date.size() == 3) {
-      stringstream ss_time(part);
-      while (getline(ss_time, part, ':')) {
-        time.push_back(stoi(part));
-      }
+    number = number * 10 - digit;
+  }
+  if (skip_spaces(pos, end) != end) {
+    return false;
+  }
+  if (!negative) {
+    if (number == INT64_MIN) {
+      return false;  // overflow
+    }
+    number = -number;
+  }
+  *result = number;
+  return true;
+}
+
+bool to_datetime_key(const string &value, int64_t *result) noexcept {
+  const char *pos = value.c_str();
+  const char *end = pos + value.size();
+  int64_t year, month, day;
+  int64_t hour = 0, minute = 0, second = 0, micros = 0;
+
+  pos = skip_spaces(pos, end);
+  if (!read_digits(&pos, end, 4, &year) || pos >= end || *pos++ != '-' ||
+      !read_digits(&pos, end, 2, &month) || pos >= end || *pos++ != '-' ||
+      !read_digits(&pos, end, 2, &day)) {
+    return false;
+  }
+
+  if (pos < end && (*pos == ' ' || *pos == 'T') && skip_spaces(pos, end) != end) {
+    ++pos;
+    if (!read_digits(&pos, end, 2, &hour) || pos >= end || *pos++ != ':' ||
+        !read_digits(&pos, end, 2, &minute) || pos >= end || *pos++ != ':' ||
+        !read_digits(&pos, end, 2, &second)) {
+      return false;
     }
-      //Invalid Date Format
-    else {
-      return 0;
+    if (pos < end && *pos == '.') {
+      ++pos;
+      int digits = 0;
+      for (; pos < end && *pos >= '0' && *pos <= '9'; ++pos, ++digits) {
+        if (digits < 6) {
+          micros = micros * 10 + (*pos - '0');
+        }
+      }
+      if (digits == 0) {
+        return false;
+      }
+      for (; digits < 6; ++digits) {
+        micros *= 10;
+      }
     }
   }
 
-  //Parse Millisecond information
-  if ((pos = datetime_str.find('.')) != string::npos) {
-    time.push_back(stoi(datetime_str.substr(pos++)));
+  if (skip_spaces(pos, end) != end ||
+      month < 1 || month > 12 || day < 1 || day > 31 ||
+      hour > 23 || minute > 59 || second > 59) {
+    return false;
   }
 
-  auto date_size = date.size();
-  for (size_t count = 1; count <= (date_size - 3); count++) {
-    date.push_back(0);
+  int64_t seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second;
+  *result = seconds * 1000000 + micros;
+  return true;
+}
+
+bool to_md5_key(const string &value, MD5Digest *result) noexcept {
+  if (value.empty() || value.size() > result->size() * 2) {
+    return false;
+  }
+
+  MD5Digest digest{};
+  for (size_t i = 0; i < value.size(); ++i) {
+    int nibble = hex_value(value[i]);
+    if (nibble < 0) {
+      return false;
+    }
+    digest[i / 2] = static_cast<uint8_t>(digest[i / 2] | (i % 2 ? nibble : nibble << 4));
   }
+  *result = digest;
+  return true;
+}
 
-  auto time_size = time.size();
-  for (size_t count = 1; count <= (time_size - 4); count++) {
-    time.push_back(0);
+uint64_t fnv1a_update(uint64_t hash, const void *data, size_t size) noexcept {
+  const uint64_t kFNVPrime = 1099511628211ULL;
+  auto bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i) {
+    hash = (hash ^ bytes[i]) * kFNVPrime;
   }
+  return hash;
+}
 
-  //Initialize the tm structure with the date.
-  datetime_tm.tm_mday = date[0];
-  datetime_tm.tm_mon = date[1];
-  datetime_tm.tm_year = date[2];
+namespace {
 
-  //Initialize the tm structure with the time.
-  //NOTE: Milliseconds are not being used in conversion.
-  datetime_tm.tm_hour = time[0];
-  datetime_tm.tm_min = time[1];
-  datetime_tm.tm_sec = time[2];
+// Per-round shift amounts and constants of MD5 (RFC 1321)
+const uint32_t kMD5Shifts[64] = {
+    7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+    5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+    4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+    6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21,
+};
 
-  return mktime(&datetime_tm);
+const uint32_t kMD5Constants[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee,
+    0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be,
+    0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa,
+    0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed,
+    0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c,
+    0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05,
+    0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039,
+    0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1,
+    0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+inline uint32_t rotate_left(uint32_t value, uint32_t count) noexcept {
+  return (value << count) | (value >> (32 - count));
 }
 
-int DateTimeValueComparator::compare(string val_a, string val_b) {
-  double diff = difftime(convert_to_time_t(val_a),
-                         convert_to_time_t(val_b));
-  if (diff > 0) {
-    return 1;
+void md5_block(uint32_t *state, const unsigned char *block) noexcept {
+  uint32_t words[16];
+  for (size_t i = 0; i < 16; ++i) {
+    words[i] = static_cast<uint32_t>(block[i * 4]) |
+               static_cast<uint32_t>(block[i * 4 + 1]) << 8 |
+               static_cast<uint32_t>(block[i * 4 + 2]) << 16 |
+               static_cast<uint32_t>(block[i * 4 + 3]) << 24;
   }
-  else if (diff < 0) {
-    return -1;
+
+  uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+  for (uint32_t i = 0; i < 64; ++i) {
+    uint32_t f, g;
+    if (i < 16) {
+      f = (b & c) | (~b & d);
+      g = i;
+    } else if (i < 32) {
+      f = (d & b) | (~d & c);
+      g = (5 * i + 1) % 16;
+    } else if (i < 48) {
+      f = b ^ c ^ d;
+      g = (3 * i + 5) % 16;
+    } else {
+      f = c ^ (b | ~d);
+      g = (7 * i) % 16;
+    }
+    f += a + kMD5Constants[i] + words[g];
+    a = d;
+    d = c;
+    c = b;
+    b += rotate_left(f, kMD5Shifts[i]);
   }
-  return 0;
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
 }
 
-int StringValueComparator::compare(string val_a, string val_b) {
-  return strcmp(val_a.c_str(), val_b.c_str());
-}
+} // namespace
 
-int MD5HashValueComparator::convert_hexa_char_to_int(char c) {
-  int result;
+MD5Digest md5(const void *data, size_t size) noexcept {
+  uint32_t state[4] = {0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476};
+  auto bytes = static_cast<const unsigned char*>(data);
 
-  std::stringstream ss;
-  ss << std::hex << c;
-  ss >> result;
+  size_t full = size - size % 64;
+  for (size_t offset = 0; offset < full; offset += 64) {
+    md5_block(state, bytes + offset);
+  }
 
-  return result;
+  // Pad with 0x80, zeros and the size in bits; needs 1 or 2 more blocks
+  unsigned char tail[128] = {};
+  size_t remaining = size - full;
+  for (size_t i = 0; i < remaining; ++i) {
+    tail[i] = bytes[full + i];
+  }
+  tail[remaining] = 0x80;
+  size_t tail_size = remaining < 56 ? 64 : 128;
+  uint64_t bits = static_cast<uint64_t>(size) * 8;
+  for (size_t i = 0; i < 8; ++i) {
+    tail[tail_size - 8 + i] = static_cast<unsigned char>(bits >> (8 * i));
+  }
+  for (size_t offset = 0; offset < tail_size; offset += 64) {
+    md5_block(state, tail + offset);
+  }
+
+  MD5Digest digest;
+  for (size_t i = 0; i < 16; ++i) {
+    digest[i] = static_cast<uint8_t>(state[i / 4] >> (8 * (i % 4)));
+  }
+  return digest;
 }
 
-int MD5HashValueComparator::compare(string val_a, string val_b) {
-  // A MD5 hash value is 16 bytes. Iterate through the string
-  // comparing the value at each position. The earliest mismatch
-  // helps us decide which of the values is greater.
-  for (size_t i = 0; i <= 15; i++) {
-    int a = convert_hexa_char_to_int(val_a.at(i));
-    int b = convert_hexa_char_to_int(val_b.at(i));
-    if (a > b) {
-      return 1;
-    }
-    else if (a < b) {
-      return -1;
-    }
-    else {
-      continue;
-    }
+string resolve_address(const string &host, int port) {
+  struct addrinfo hints, *info;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+
+  int err = getaddrinfo(host.c_str(), std::to_string(port).c_str(), &hints, &info);
+  if (err != 0) {
+#ifndef _WIN32
+    string errstr{(err == EAI_SYSTEM) ? strerror(errno) : gai_strerror(err)};
+#else
+    string errstr{gai_strerrorA(err)};
+#endif
+    throw fabric_cache::base_error("Failed resolving '" + host + "': " + errstr);
   }
-  return 0;
+
+  string result(reinterpret_cast<const char *>(info->ai_addr), info->ai_addrlen);
+  freeaddrinfo(info);
+  return result;
 }
@@ -18,8 +18,10 @@
 #ifndef FABRIC_CACHE_UTILS_INCLUDED
 #define FABRIC_CACHE_UTILS_INCLUDED
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
 #include <string>
-#include <time.h>
 
 using std::string;
 
@@ -33,98 +35,77 @@ using std::string;
  */
 string get_string(const char *input_str);
 
-/** @class ValueComparator
- * Base utility class for comparing two values. The compare method will be
- * overwritten by the base classes for converting the input strings into
- * appropriate datatypes for comparison.
+/** @brief 128-bit MD5 digest */
+using MD5Digest = std::array<uint8_t, 16>;
+
+/** @brief Converts a string to an integer shard key
+ *
+ * Converts a string containing a decimal integer, optionally signed
+ * and surrounded by spaces, to a 64-bit integer.
+ *
+ * @param value The string to convert
+ * @param result Pointer to storage for the converted value
+ * @return true when value was converted, false when it is not valid
  */
-class ValueComparator {
-public:
-  virtual int compare(string val_a, string val_b) = 0;
-};
+bool to_integer_key(const string &value, int64_t *result) noexcept;
 
-/** @class IntegerValueComparator
- * Convert the input strings into integers and compare
+/** @brief Converts a DATETIME string to a shard key
+ *
+ * Converts a string in MySQL DATETIME format, `YYYY-MM-DD[ HH:MM:SS[.ffffff]]`,
+ * to microseconds since the UNIX epoch. No timezone conversion is done,
+ * only the order of values matters.
+ *
+ * @param value The string to convert
+ * @param result Pointer to storage for the converted value
+ * @return true when value was converted, false when it is not valid
+ */
+bool to_datetime_key(const string &value, int64_t *result) noexcept;
+
+/** @brief Converts a hexadecimal MD5 hash to a shard key
+ *
+ * Converts a string containing a MD5 hash as hexadecimal digits (up to 32,
+ * case insensitive) to a 16-byte digest. Shorter strings are padded with
+ * zeros on the right.
+ *
+ * @param value The string to convert
+ * @param result Pointer to storage for the converted value
+ * @return true when value was converted, false when it is not valid
  */
-class IntegerValueComparator final : public ValueComparator {
-public:
-  /** @brief Compares two integer values
-   *
-   * Compare two integer values.
-   */
-  int compare(string val_a, string val_b);
-};
-
-/** @class DateTimeValueComparator
- * Compare the input values into datetime values and compare.
+bool to_md5_key(const string &value, MD5Digest *result) noexcept;
+
+/** @brief Computes the MD5 digest of a shard key
+ *
+ * MySQL Fabric places the rows of HASH sharded tables using the MD5
+ * digest of the value of the shard key.
+ *
+ * @param data Bytes of the shard key
+ * @param size Number of bytes
+ * @return 16-byte digest
  */
-class DateTimeValueComparator final : public ValueComparator {
-public:
-  /** @brief Converts the datetime string to a time_t value
-   *
-   * @param datetime_str The string that needs to be converted
-   *
-   * @return The converted time_t value.
-   */
-  time_t convert_to_time_t(string datetime_str);
-
-  /** @brief Compares two strings containing DATETIME
-   *
-   * Compares the two strings containing values in DATETIME format.
-   *
-   * @param val_a The first DATETIME value.
-   * @param val_b The second DATETIME value.
-   *
-   * @return 1 if val_a > val_b
-   *        -1 if val_a < val_b
-   *         0 if val_a = val_b
-   */
-  int compare(string val_a, string val_b);
-};
-
-/** @class StringValueComparator
- * Compare the input strings as string values.
+MD5Digest md5(const void *data, size_t size) noexcept;
+
+/** @brief Offset basis of the 64-bit FNV-1a hash */
+const uint64_t kFNVOffsetBasis = 14695981039346656037ULL;
+
+/** @brief Updates a 64-bit FNV-1a hash
+ *
+ * @param hash Hash to update; start with kFNVOffsetBasis
+ * @param data Bytes to add to the hash
+ * @param size Number of bytes
+ * @return the updated hash
  */
-class StringValueComparator final : public ValueComparator {
-public:
-  /** @brief Compares two strings
-   *
-   * Compare the two input strings, using standard string comparison.
-   *
-   * @param val_a The first string.
-   * @param val_b The second string.
-   *
-   * @return 1 if val_a > val_b
-   *        -1 if val_a < val_b
-   *         0 if val_a = val_b.
-   */
-  int compare(string val_a, string val_b);
-};
-
-/** @class MD5HashValueComparator
- * Compare the input MD5 hash values.
+uint64_t fnv1a_update(uint64_t hash, const void *data, size_t size) noexcept;
+
+/** @brief Resolves the socket address of a host
+ *
+ * Resolves host and port using getaddrinfo() and returns the first
+ * TCP address found.
+ *
+ * @param host Host name or IP address
+ * @param port TCP port
+ * @return raw bytes of the `struct sockaddr`
+ * @throws fabric_cache::base_error when host could not be resolved
  */
-class MD5HashValueComparator final : public ValueComparator {
-public:
-  /** @brief Converts hexadecimal character to integer
-   * Convert a hexadecimal character to an integer.
-   *
-   * @param c The character that needs to be converted to an hexadecimal value.
-   */
-  int convert_hexa_char_to_int(char c);
-
-  /** @brief Compares two strings containing a MD5 hash
-   *
-   * Compares two strings containing a MD5 hash.
-   *
-   * @param val_a The first MD5 hash string.
-   * @param val_b The second MD5 hash string.
-   *
-   * @return 1 if val_a > val_b
-   *        -1 if val_a < val_b
-   *         0 if val_a = val_b.
-   */
-  int compare(string val_a, string val_b);
-};
+string resolve_address(const string &host, int port);
 
 #endif // FABRIC_CACHE_UTILS_INCLUDED
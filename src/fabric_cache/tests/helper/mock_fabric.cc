@@ -140,6 +140,40 @@ MockFabric::MockFabric(const string &host, int port, const string &user,
   table_1_list.push_back(shard2);
 
   shard_map["db1.t1"] = table_1_list;
+
+  // Shards of db2.t2 are not reported in order of their lower bound
+  shard3.schema_name = "db2";
+  shard3.table_name = "t2";
+  shard3.column_name = "id";
+  shard3.lb = "1000";
+  shard3.shard_id = 3;
+  shard3.type_name = "RANGE_INTEGER";
+  shard3.group_id = "group-3";
+  shard3.global_group = "group-1";
+
+  shard4.schema_name = "db2";
+  shard4.table_name = "t2";
+  shard4.column_name = "id";
+  shard4.lb = "1";
+  shard4.shard_id = 4;
+  shard4.type_name = "RANGE_INTEGER";
+  shard4.group_id = "group-2";
+  shard4.global_group = "group-1";
+
+  shard5.schema_name = "db2";
+  shard5.table_name = "t2";
+  shard5.column_name = "id";
+  shard5.lb = "500";
+  shard5.shard_id = 5;
+  shard5.type_name = "RANGE_INTEGER";
+  shard5.group_id = "group-1";
+  shard5.global_group = "group-1";
+
+  table_2_list.push_back(shard3);
+  table_2_list.push_back(shard4);
+  table_2_list.push_back(shard5);
+
+  shard_map["db2.t2"] = table_2_list;
 }
 
 /** @brief Destructor
@@ -155,6 +189,9 @@ MockFabric::~MockFabric() {}
  * @return Map of group ID, server list pairs.
  */
 map<string, list<ManagedServer>> MockFabric::fetch_servers() {
+  if (unavailable) {
+    throw fabric_cache::connection_error("Fabric unavailable");
+  }
   return group_map;
 }
 
@@ -188,6 +225,19 @@ map<string, list<ManagedShard>> MockFabric::fetch_shards() {
   return shard_map;
 }
 
+/**
+ *
+ * Fetches mock servers and shards one after the other.
+ *
+ * @param servers (out) servers of each group
+ * @param shards (out) shards of each table
+ */
+void MockFabric::fetch_all(map<string, list<ManagedServer>> *servers,
+                           map<string, list<ManagedShard>> *shards) {
+  *servers = fetch_servers();
+  *shards = fetch_shards();
+}
+
 /**
  *
  * Returns a mock refresh interval.
@@ -195,5 +245,5 @@ map<string, list<ManagedShard>> MockFabric::fetch_shards() {
  * @return refresh interval of the Fabric cache.
  */
 int MockFabric::fetch_ttl() {
-  return 5;
+  return ttl;
 }
@@ -58,8 +58,12 @@ public:
    */
   ManagedShard shard1;
   ManagedShard shard2;
+  ManagedShard shard3;
+  ManagedShard shard4;
+  ManagedShard shard5;
 
   list<ManagedShard> table_1_list;
+  list<ManagedShard> table_2_list;
 
   /**
    * The information about the HA topology being managed by Fabric.
@@ -71,6 +75,16 @@ public:
    */
   map<string, list<ManagedShard>> shard_map;
 
+  /**
+   * When set, fetching data fails as if Fabric was down.
+   */
+  bool unavailable = false;
+
+  /**
+   * Refresh interval returned by fetch_ttl().
+   */
+  int ttl = 5;
+
   /** @brief Constructor
    * @param host The host on which the fabric server is running.
    * @param port The port number on which the fabric server is listening.
@@ -125,6 +139,16 @@ public:
    */
   map<string, list<ManagedShard>> fetch_shards();
 
+  /**
+   *
+   * Fetches mock servers and shards one after the other.
+   *
+   * @param servers (out) servers of each group
+   * @param shards (out) shards of each table
+   */
+  void fetch_all(map<string, list<ManagedServer>> *servers,
+                 map<string, list<ManagedShard>> *shards) override;
+
   /**
    *
    * Returns a mock refresh interval.
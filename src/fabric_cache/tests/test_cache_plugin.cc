@@ -60,7 +60,7 @@ public:
     list<ManagedServer> server_list_1;
     thread connect_thread(
       fabric_cache::cache_init, cache_name, kDefaultFabricHost,
-      kDefaultFabricPort, kDefaultFabricUser, kDefaultFabricPassword);
+      kDefaultFabricPort, kDefaultFabricUser, kDefaultFabricPassword, string());
     connect_thread.detach();
 
     int count = 1;
@@ -163,8 +163,26 @@ TEST_F(FabricCachePluginTest, InvalidShardTest) {
   EXPECT_TRUE(server_list_2.empty());
 }
 
+/**
+ * Test that several caches can be used at the same time.
+ */
+TEST_F(FabricCachePluginTest, MultipleCachesTest) {
+  fabric_cache::cache_init("secondtest", kDefaultFabricHost, kDefaultFabricPort,
+                           kDefaultFabricUser, kDefaultFabricPassword);
+  // The cache is available right away, and refreshed by its thread
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (fabric_cache::cache_generation("secondtest") == 0) {
+    ASSERT_LT(std::chrono::steady_clock::now(), deadline);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(mf.ms1, fabric_cache::lookup_group("secondtest", kDefaultTestGroup_1).server_list.front());
+  EXPECT_EQ(mf.ms1, fabric_cache::lookup_group(cache_name, kDefaultTestGroup_1).server_list.front());
+  EXPECT_THROW(fabric_cache::lookup_group("unknowntest", kDefaultTestGroup_1), fabric_cache::base_error);
+}
+
 int main(int argc, char *argv[])
 {
   ::testing::InitGoogleTest(&argc, argv);
   return RUN_ALL_TESTS();
 }
+
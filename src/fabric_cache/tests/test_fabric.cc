@@ -0,0 +1,250 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Test fetching the metadata by the Fabric class. The MySQL client
+ * functions used by the Fabric class are replaced by the functions below,
+ * which simulate a Fabric server dumping rows.
+ */
+
+#include "fabric.h"
+
+#include <climits>
+#include <map>
+#include <mutex>
+
+#include <mysql.h>
+
+#include "gmock/gmock.h"
+
+#ifndef STDCALL
+#define STDCALL
+#endif
+
+namespace {
+
+// State of a simulated connection with the Fabric server
+struct FakeConnection {
+  bool closed = false;
+  int results_left = 0;
+  unsigned int dump_rows_read = 0;
+  bool dump_freed = false;
+  // Freeing the dump before closing the connection would read all rows left
+  bool dump_flushed = false;
+  MYSQL_RES ttl_result = MYSQL_RES();
+  MYSQL_RES dump_result = MYSQL_RES();
+};
+
+std::mutex fake_mutex;
+std::map<MYSQL *, FakeConnection> fake_connections;
+
+// Rows of the dump each connection sends
+unsigned int fake_dump_rows = UINT_MAX;
+
+char kUuid[] = "uuid";
+char kTtl[] = "1";
+char kMessage[] = "";
+char *ttl_row[] = {kUuid, kTtl, kMessage};
+
+char kField0[] = "uuid-1";
+char kField1[] = "group-1";
+char kField2[] = "127.0.0.1";
+char kField3[] = "3306";
+char kField4[] = "3";
+char kField5[] = "3";
+char kField6[] = "1.0";
+char kField7[] = "global";
+// Used for servers as well as for shards
+char *dump_row[] = {kField0, kField1, kField2, kField3, kField4, kField5, kField6, kField7};
+
+FakeConnection *find_connection(MYSQL_RES *result) {
+  for (auto &entry : fake_connections) {
+    if (&entry.second.ttl_result == result || &entry.second.dump_result == result) {
+      return &entry.second;
+    }
+  }
+  return nullptr;
+}
+
+} // namespace
+
+extern "C" {
+
+MYSQL *STDCALL mysql_init(MYSQL *mysql) {
+  if (!mysql) {
+    return nullptr;
+  }
+  std::lock_guard<std::mutex> lock(fake_mutex);
+  fake_connections[mysql] = FakeConnection();
+  return mysql;
+}
+
+int STDCALL mysql_options(MYSQL *, enum mysql_option, const void *) {
+  return 0;
+}
+
+MYSQL *STDCALL mysql_real_connect(MYSQL *mysql, const char *, const char *,
+                                  const char *, const char *, unsigned int,
+                                  const char *, unsigned long) {
+  return mysql;
+}
+
+int STDCALL mysql_ping(MYSQL *mysql) {
+  std::lock_guard<std::mutex> lock(fake_mutex);
+  return fake_connections.at(mysql).closed ? 1 : 0;
+}
+
+const char *STDCALL mysql_error(MYSQL *) {
+  return "";
+}
+
+unsigned int STDCALL mysql_errno(MYSQL *) {
+  return 0;
+}
+
+void STDCALL mysql_close(MYSQL *mysql) {
+  std::lock_guard<std::mutex> lock(fake_mutex);
+  fake_connections.at(mysql).closed = true;
+}
+
+int STDCALL mysql_query(MYSQL *mysql, const char *) {
+  std::lock_guard<std::mutex> lock(fake_mutex);
+  fake_connections.at(mysql).results_left = 1;
+  return 0;
+}
+
+MYSQL_RES *STDCALL mysql_store_result(MYSQL *mysql) {
+  std::lock_guard<std::mutex> lock(fake_mutex);
+  auto &connection = fake_connections.at(mysql);
+  return connection.results_left ? &connection.ttl_result : nullptr;
+}
+
+MYSQL_RES *STDCALL mysql_use_result(MYSQL *mysql) {
+  std::lock_guard<std::mutex> lock(fake_mutex);
+  return &fake_connections.at(mysql).dump_result;
+}
+
+decltype(mysql_more_results(nullptr)) STDCALL mysql_more_results(MYSQL *mysql) {
+  std::lock_guard<std::mutex> lock(fake_mutex);
+  return fake_connections.at(mysql).results_left > 0;
+}
+
+int STDCALL mysql_next_result(MYSQL *mysql) {
+  std::lock_guard<std::mutex> lock(fake_mutex);
+  auto &connection = fake_connections.at(mysql);
+  if (connection.results_left > 0) {
+    --connection.results_left;
+    return 0;
+  }
+  return -1;
+}
+
+MYSQL_ROW STDCALL mysql_fetch_row(MYSQL_RES *result) {
+  std::lock_guard<std::mutex> lock(fake_mutex);
+  auto connection = find_connection(result);
+  if (result == &connection->ttl_result) {
+    return ttl_row;
+  }
+  // Results of closed connections are cancelled
+  if (connection->closed || connection->dump_rows_read == fake_dump_rows) {
+    return nullptr;
+  }
+  ++connection->dump_rows_read;
+  return dump_row;
+}
+
+void STDCALL mysql_free_result(MYSQL_RES *result) {
+  std::lock_guard<std::mutex> lock(fake_mutex);
+  auto connection = find_connection(result);
+  if (result == &connection->dump_result) {
+    connection->dump_freed = true;
+    if (!connection->closed && connection->dump_rows_read < fake_dump_rows) {
+      connection->dump_flushed = true;
+    }
+  }
+}
+
+} // extern "C"
+
+class FabricTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    std::lock_guard<std::mutex> lock(fake_mutex);
+    fake_connections.clear();
+    fake_dump_rows = UINT_MAX;
+  }
+
+  // Checks that each dump was freed without reading the rows left
+  static void expect_dumps_abandoned(size_t dumps) {
+    std::lock_guard<std::mutex> lock(fake_mutex);
+    size_t abandoned = 0;
+    for (auto &entry : fake_connections) {
+      auto &connection = entry.second;
+      if (connection.dump_rows_read == 0) {
+        continue;
+      }
+      ++abandoned;
+      EXPECT_TRUE(connection.closed);
+      EXPECT_TRUE(connection.dump_freed);
+      EXPECT_FALSE(connection.dump_flushed);
+    }
+    EXPECT_EQ(dumps, abandoned);
+  }
+};
+
+TEST_F(FabricTest, FetchServers) {
+  fake_dump_rows = 3;
+  Fabric fabric("127.0.0.1", 32275, "admin", "", 1, 1);
+
+  auto servers = fabric.fetch_servers();
+  ASSERT_EQ(1u, servers.size());
+  EXPECT_EQ(3u, servers["group-1"].size());
+  EXPECT_EQ(1, fabric.fetch_ttl());
+}
+
+/**
+ * Test that a dump which takes longer than the fetch timeout is given up
+ * without reading the rows left.
+ */
+TEST_F(FabricTest, FetchServersTimeout) {
+  Fabric fabric("127.0.0.1", 32275, "admin", "", 1, 1);
+  fabric.set_fetch_timeout(0);
+
+  EXPECT_THROW(fabric.fetch_servers(), fabric_cache::metadata_error);
+  expect_dumps_abandoned(1);
+
+  // Connecting again reuses the MySQL client objects
+  EXPECT_TRUE(fabric.connect());
+}
+
+TEST_F(FabricTest, FetchShardsTimeout) {
+  Fabric fabric("127.0.0.1", 32275, "admin", "", 1, 1);
+  fabric.set_fetch_timeout(0);
+
+  EXPECT_THROW(fabric.fetch_shards(), fabric_cache::metadata_error);
+  expect_dumps_abandoned(1);
+}
+
+TEST_F(FabricTest, FetchAllTimeout) {
+  Fabric fabric("127.0.0.1", 32275, "admin", "", 1, 1);
+  fabric.set_fetch_timeout(0);
+
+  map<string, list<ManagedServer>> servers;
+  map<string, list<ManagedShard>> shards;
+  EXPECT_THROW(fabric.fetch_all(&servers, &shards), fabric_cache::metadata_error);
+  expect_dumps_abandoned(2);
+}
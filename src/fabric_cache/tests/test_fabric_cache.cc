@@ -19,20 +19,47 @@
  * Test the fabric cache implementation.
  */
 
+#include "cache_file.h"
 #include "fabric_cache.h"
 #include "mock_fabric.h"
 
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include "gmock/gmock.h"
 
 using fabric_cache::ManagedServer;
 
+// Instance of MockFabric used by the cache, see mock_fabric_factory.cc
+extern std::shared_ptr<FabricMetaData> fabric_meta_data;
+
 class FabricCacheTest : public ::testing::Test {
 public:
   MockFabric mf;
   FabricCache cache;
 
   FabricCacheTest() : mf("localhost", 32275, "admin", "admin", 1, 1),
-                      cache("localhost", 32275, "admin", "admin", 1, 1) {}
+                      cache("localhost", 32275, "admin", "admin", 1, 1) {
+    cache.refresh();
+  }
+
+  // Waits until the cache was refreshed a given number of times, applied
+  // or skipped
+  static bool wait_refreshes(const FabricCache &cache, uint64_t count) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (cache.refreshes_applied() + cache.refreshes_skipped() < count) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  }
 };
 
 /**
@@ -41,7 +68,7 @@ public:
 TEST_F(FabricCacheTest, ValidGroupTest_1) {
   list<ManagedServer> server_list_1;
 
-  server_list_1 = cache.group_lookup("group-1");
+  server_list_1 = cache.group_lookup("group-1").server_list;
 
   ManagedServer ms1_fetched = server_list_1.front();
   EXPECT_EQ(ms1_fetched, mf.ms1);
@@ -56,7 +83,7 @@ TEST_F(FabricCacheTest, ValidGroupTest_1) {
 TEST_F(FabricCacheTest, InvalidGroupTest) {
   list<ManagedServer> server_list;
 
-  server_list = cache.group_lookup("InvalidGroupTest");
+  server_list = cache.group_lookup("InvalidGroupTest").server_list;
 
   EXPECT_TRUE(server_list.empty());
 }
@@ -67,7 +94,7 @@ TEST_F(FabricCacheTest, InvalidGroupTest) {
 TEST_F(FabricCacheTest, ValidShardTest_1) {
   list<ManagedServer> server_list;
 
-  server_list = cache.shard_lookup("db1.t1", "100");
+  server_list = cache.shard_lookup("db1.t1", "100").server_list;
 
    ManagedServer ms3_fetched = server_list.front();
   EXPECT_EQ(ms3_fetched, mf.ms3);
@@ -82,7 +109,7 @@ TEST_F(FabricCacheTest, ValidShardTest_1) {
 TEST_F(FabricCacheTest, ValidShardTest_2) {
   list<ManagedServer> server_list;
 
-  server_list = cache.shard_lookup("db1.t1", "10000");
+  server_list = cache.shard_lookup("db1.t1", "10000").server_list;
 
    ManagedServer ms5_fetched = server_list.front();
   EXPECT_EQ(ms5_fetched, mf.ms5);
@@ -97,7 +124,425 @@ TEST_F(FabricCacheTest, ValidShardTest_2) {
 TEST_F(FabricCacheTest, InvalidShardTest) {
   list<ManagedServer> server_list;
 
-  server_list = cache.shard_lookup("InvalidTable", "100");
+  server_list = cache.shard_lookup("InvalidTable", "100").server_list;
 
   EXPECT_TRUE(server_list.empty());
 }
+
+/**
+ * Test that shards not reported in order of lower bound are found.
+ */
+TEST_F(FabricCacheTest, UnsortedShardsTest) {
+  EXPECT_EQ(mf.ms2, cache.shard_lookup("db2.t2", "750").server_list.back());
+  EXPECT_EQ(mf.ms2, cache.shard_lookup("db2.t2", "500").server_list.back());
+  EXPECT_EQ(mf.ms4, cache.shard_lookup("db2.t2", "499").server_list.back());
+  EXPECT_EQ(mf.ms4, cache.shard_lookup("db2.t2", "1").server_list.back());
+  EXPECT_EQ(mf.ms6, cache.shard_lookup("db2.t2", "1000").server_list.back());
+  EXPECT_EQ(mf.ms6, cache.shard_lookup("db2.t2", "99999").server_list.back());
+  // Lower than the lowest lower bound
+  EXPECT_TRUE(cache.shard_lookup("db2.t2", "0").server_list.empty());
+}
+
+/**
+ * Test that a shard key which is not valid for the sharding type is not found.
+ */
+TEST_F(FabricCacheTest, InvalidShardKeyTest) {
+  EXPECT_TRUE(cache.shard_lookup("db2.t2", "abc").server_list.empty());
+  EXPECT_TRUE(cache.shard_lookup("db2.t2", "").server_list.empty());
+}
+
+/**
+ * Test that a successful refresh increments the generation.
+ */
+TEST_F(FabricCacheTest, GenerationTest) {
+  // The fixture refreshes the cache once
+  EXPECT_EQ(1u, cache.generation());
+}
+
+/**
+ * Test that the cache is first refreshed by its thread, not when created.
+ */
+TEST_F(FabricCacheTest, FirstRefreshInThreadTest) {
+  FabricCache other("localhost", 32275, "admin", "admin", 1, 1);
+  EXPECT_EQ(0u, other.generation());
+  EXPECT_TRUE(other.group_lookup("group-1").server_list.empty());
+
+  other.start();
+  ASSERT_TRUE(other.wait_refreshed(0, std::chrono::seconds(10)));
+  EXPECT_EQ(mf.ms1, other.group_lookup("group-1").server_list.front());
+  other.stop();
+}
+
+/**
+ * Test that lookups share the cached servers instead of copying them.
+ */
+TEST_F(FabricCacheTest, LookupSharesSnapshotTest) {
+  LookupResult group_result = cache.group_lookup("group-1");
+  LookupResult shard_result = cache.shard_lookup("db2.t2", "750");
+  EXPECT_EQ(&group_result.server_list, &cache.group_lookup("group-1").server_list);
+  EXPECT_EQ(&shard_result.server_list, &cache.shard_lookup("db2.t2", "600").server_list);
+
+  LookupResult copy = group_result;
+  EXPECT_EQ(&group_result.server_list, &copy.server_list);
+}
+
+/**
+ * Test that refreshing without changes keeps the snapshot, and that a
+ * refresh with changes only replaces what changed.
+ */
+TEST_F(FabricCacheTest, RefreshChangeDetectionTest) {
+  auto mock = std::dynamic_pointer_cast<MockFabric>(fabric_meta_data);
+  ASSERT_TRUE(mock != nullptr);
+  auto group_1 = cache.group_lookup("group-1");
+  auto group_3 = cache.group_lookup("group-3");
+
+  cache.refresh();
+  EXPECT_EQ(1u, cache.generation());
+  EXPECT_EQ(1u, cache.refreshes_applied());
+  EXPECT_EQ(1u, cache.refreshes_skipped());
+
+  auto original = mock->group_map;
+  mock->group_map["group-3"].front().status = static_cast<int>(ManagedServer::Status::kFaulty);
+  cache.refresh();
+  mock->group_map = original;
+
+  EXPECT_EQ(2u, cache.generation());
+  EXPECT_EQ(2u, cache.refreshes_applied());
+  EXPECT_EQ(1u, cache.refreshes_skipped());
+  EXPECT_EQ(&group_1.server_list, &cache.group_lookup("group-1").server_list);
+  EXPECT_NE(&group_3.server_list, &cache.group_lookup("group-3").server_list);
+  EXPECT_EQ(static_cast<int>(ManagedServer::Status::kFaulty),
+            cache.group_lookup("group-3").server_list.front().status);
+  EXPECT_EQ(mf.ms6, cache.shard_lookup("db2.t2", "1000").server_list.back());
+}
+
+/**
+ * Test that the addresses of the servers of changed groups are resolved.
+ */
+TEST_F(FabricCacheTest, ResolveServersTest) {
+  auto mock = std::dynamic_pointer_cast<MockFabric>(fabric_meta_data);
+  ASSERT_TRUE(mock != nullptr);
+
+  auto original = mock->group_map;
+  mock->group_map["group-1"].front().host = "127.0.0.1";
+  mock->group_map["group-1"].front().port = 3306;
+  cache.refresh();
+  mock->group_map = original;
+
+  auto server = cache.group_lookup("group-1").server_list.front();
+  EXPECT_EQ(resolve_address("127.0.0.1", 3306), server.resolved_address);
+  EXPECT_FALSE(server.resolved_address.empty());
+}
+
+/**
+ * Test that servers which could not be resolved are resolved again with
+ * each refresh, without publishing a new snapshot while they still fail.
+ */
+TEST_F(FabricCacheTest, ResolveUnresolvedServersTest) {
+  ASSERT_TRUE(cache.group_lookup("group-1").server_list.front().resolved_address.empty());
+  auto resolved = cache.servers_resolved();
+
+  cache.refresh();
+  EXPECT_GT(cache.servers_resolved(), resolved);
+  EXPECT_EQ(1u, cache.generation());
+  EXPECT_EQ(1u, cache.refreshes_skipped());
+}
+
+/**
+ * Test that resolved servers are resolved again only once the resolve TTL
+ * passed.
+ */
+TEST_F(FabricCacheTest, ResolveTimeToLiveTest) {
+  auto mock = std::dynamic_pointer_cast<MockFabric>(fabric_meta_data);
+  ASSERT_TRUE(mock != nullptr);
+
+  auto original = mock->group_map;
+  for (auto &group: mock->group_map) {
+    for (auto &server: group.second) {
+      server.host = "127.0.0.1";
+    }
+  }
+  cache.refresh();
+  EXPECT_EQ(2u, cache.generation());
+  auto resolved = cache.servers_resolved();
+
+  cache.refresh();
+  EXPECT_EQ(resolved, cache.servers_resolved());
+
+  cache.set_resolve_ttl(std::chrono::milliseconds(0));
+  cache.refresh();
+  mock->group_map = original;
+  EXPECT_GT(cache.servers_resolved(), resolved);
+  // The addresses did not change
+  EXPECT_EQ(2u, cache.generation());
+  EXPECT_EQ(2u, cache.refreshes_skipped());
+}
+
+/**
+ * Test that a host slow to resolve does not delay the refresh: its server
+ * is published unresolved, and resolved by a later refresh.
+ */
+TEST_F(FabricCacheTest, SlowResolveTest) {
+  auto mock = std::dynamic_pointer_cast<MockFabric>(fabric_meta_data);
+  ASSERT_TRUE(mock != nullptr);
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  bool released = false;
+  cache.set_resolver_lookup([&](const string &host) {
+    if (host == "slow") {
+      std::unique_lock<std::mutex> lock(mutex);
+      cond.wait(lock, [&released] { return released; });
+    }
+    return std::vector<mysql_harness::IPAddress>{mysql_harness::IPAddress("127.0.0.1")};
+  });
+  auto release = [&] {
+    std::lock_guard<std::mutex> lock(mutex);
+    released = true;
+    cond.notify_all();
+  };
+
+  auto original = mock->group_map;
+  mock->group_map["group-1"].front().host = "slow";
+  auto started = std::chrono::steady_clock::now();
+  cache.refresh();
+  auto elapsed = std::chrono::steady_clock::now() - started;
+  EXPECT_LT(elapsed, kResolveTimeout + std::chrono::seconds(2));
+  EXPECT_EQ(2u, cache.generation());
+  EXPECT_TRUE(cache.group_lookup("group-1").server_list.front().resolved_address.empty());
+  EXPECT_FALSE(cache.group_lookup("group-1").server_list.back().resolved_address.empty());
+
+  release();
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (cache.group_lookup("group-1").server_list.front().resolved_address.empty() &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    cache.refresh();
+  }
+  mock->group_map = original;
+  EXPECT_EQ(resolve_address("127.0.0.1", 3306),
+            cache.group_lookup("group-1").server_list.front().resolved_address);
+}
+
+/**
+ * Test that a requested refresh replaces a failed primary well before the
+ * TTL passed, and that requested refreshes are rate limited.
+ */
+TEST_F(FabricCacheTest, RequestRefreshTest) {
+  using std::chrono::steady_clock;
+  using std::chrono::milliseconds;
+  auto mock = std::dynamic_pointer_cast<MockFabric>(fabric_meta_data);
+  ASSERT_TRUE(mock != nullptr);
+  auto original = mock->group_map;
+  cache.start();
+  // The data of the mock is not changed while the first refresh reads it
+  ASSERT_TRUE(wait_refreshes(cache, 2));
+
+  // Primary fails and the secondary gets promoted
+  auto generation = cache.generation();
+  mock->group_map["group-1"].front().status = static_cast<int>(ManagedServer::Status::kFaulty);
+  mock->group_map["group-1"].back().status = static_cast<int>(ManagedServer::Status::kPrimary);
+  auto failed_at = steady_clock::now();
+  cache.request_refresh();
+  ASSERT_TRUE(cache.wait_refreshed(generation, std::chrono::seconds(kDefaultTimeToLive)));
+  auto failover = std::chrono::duration_cast<milliseconds>(steady_clock::now() - failed_at);
+  RecordProperty("failover_ms", static_cast<int>(failover.count()));
+  EXPECT_LT(failover, std::chrono::seconds(mock->fetch_ttl()));
+  EXPECT_EQ(static_cast<int>(ManagedServer::Status::kPrimary),
+            cache.group_lookup("group-1").server_list.back().status);
+
+  // Requests right after a refresh wait for the minimum interval
+  generation = cache.generation();
+  mock->group_map["group-1"].front().status = static_cast<int>(ManagedServer::Status::kSpare);
+  auto requested_at = steady_clock::now();
+  cache.request_refresh();
+  cache.request_refresh();
+  ASSERT_TRUE(cache.wait_refreshed(generation, std::chrono::seconds(kDefaultTimeToLive)));
+  EXPECT_GE(steady_clock::now() - requested_at, kMinRefreshInterval - milliseconds(50));
+  EXPECT_EQ(generation + 1, cache.generation());
+
+  cache.stop();
+  mock->group_map = original;
+}
+
+/**
+ * Test that the global group of a sharded table is found.
+ */
+TEST_F(FabricCacheTest, GlobalGroupTest) {
+  auto server_list = cache.global_group_lookup("db2.t2").server_list;
+  ASSERT_EQ(2u, server_list.size());
+  EXPECT_EQ(mf.ms1, server_list.front());
+  EXPECT_TRUE(cache.global_group_lookup("InvalidTable").server_list.empty());
+}
+
+/**
+ * Test that data stored in the cache file is served while Fabric is down.
+ */
+TEST_F(FabricCacheTest, WarmStartTest) {
+  auto mock = std::dynamic_pointer_cast<MockFabric>(fabric_meta_data);
+  ASSERT_TRUE(mock != nullptr);
+  const string path = "fabric_cache_warm_start.cache";
+  std::remove(path.c_str());
+
+  {
+    FabricCache live("localhost", 32275, "admin", "admin", 1, 1, path);
+    live.refresh();
+    EXPECT_EQ(1u, live.refreshes_applied());
+  }
+  auto data = read_cache_file(path);
+  EXPECT_EQ(mock->group_map.size(), data.groups.size());
+  EXPECT_EQ(mock->shard_map.size(), data.shards.size());
+
+  mock->unavailable = true;
+  FabricCache warm("localhost", 32275, "admin", "admin", 1, 1, path);
+  mock->unavailable = false;
+
+  EXPECT_EQ(1u, warm.generation());
+  EXPECT_EQ(0u, warm.refreshes_applied());
+  EXPECT_EQ(mf.ms1, warm.group_lookup("group-1").server_list.front());
+  EXPECT_EQ(mf.ms6, warm.shard_lookup("db2.t2", "1000").server_list.back());
+
+  // Fabric has the same data as the cache file
+  warm.refresh();
+  EXPECT_EQ(1u, warm.generation());
+  EXPECT_EQ(1u, warm.refreshes_skipped());
+
+  std::remove(path.c_str());
+}
+
+/**
+ * Test that corrupted cache files are ignored.
+ */
+TEST_F(FabricCacheTest, CorruptCacheFileTest) {
+  auto mock = std::dynamic_pointer_cast<MockFabric>(fabric_meta_data);
+  ASSERT_TRUE(mock != nullptr);
+  const string path = "fabric_cache_corrupt.cache";
+  write_cache_file(path, mock->group_map, mock->shard_map, 1);
+
+  {
+    // flip a byte of the payload
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekg(-1, std::ios::end);
+    char last = static_cast<char>(file.get());
+    file.seekp(-1, std::ios::end);
+    file.put(static_cast<char>(last ^ 0x1));
+  }
+  EXPECT_THROW(read_cache_file(path), fabric_cache::base_error);
+
+  mock->unavailable = true;
+  FabricCache warm("localhost", 32275, "admin", "admin", 1, 1, path);
+  mock->unavailable = false;
+  EXPECT_EQ(0u, warm.generation());
+  EXPECT_TRUE(warm.group_lookup("group-1").server_list.empty());
+
+  // empty, as left by a crash while writing it
+  std::ofstream(path, std::ios::trunc).close();
+  EXPECT_THROW(read_cache_file(path), fabric_cache::base_error);
+
+  std::remove(path.c_str());
+  EXPECT_THROW(read_cache_file(path), fabric_cache::base_error);
+}
+
+/**
+ * Test that stopping the cache does not wait for the next refresh.
+ */
+TEST_F(FabricCacheTest, StartStopTest) {
+  auto start = std::chrono::steady_clock::now();
+  cache.start();
+  cache.start();
+  cache.stop();
+  EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(kDefaultTimeToLive));
+  EXPECT_EQ(1u, cache.generation());
+}
+
+/**
+ * Test that keys of HASH sharded tables are hashed and placed on the ring.
+ */
+TEST_F(FabricCacheTest, HashShardTest) {
+  auto mock = std::dynamic_pointer_cast<MockFabric>(fabric_meta_data);
+  ASSERT_TRUE(mock != nullptr);
+
+  ManagedShard shard;
+  shard.schema_name = "db3";
+  shard.table_name = "t3";
+  shard.column_name = "id";
+  shard.type_name = "HASH";
+  shard.global_group = "group-1";
+  list<ManagedShard> shards;
+  shard.shard_id = 6;
+  shard.lb = "C0000000000000000000000000000000";
+  shard.group_id = "group-3";
+  shards.push_back(shard);
+  shard.shard_id = 7;
+  shard.lb = "40000000000000000000000000000000";
+  shard.group_id = "group-1";
+  shards.push_back(shard);
+
+  auto original = mock->shard_map;
+  mock->shard_map["db3.t3"] = shards;
+  cache.refresh();
+  mock->shard_map = original;
+
+  // md5("abc") = 900150983cd24fb0d6963f7d28e17f72
+  EXPECT_EQ(mf.ms1, cache.shard_key_lookup("db3.t3", "abc").server_list.front());
+  EXPECT_EQ(mf.ms1, cache.shard_lookup("db3.t3", "900150983cd24fb0d6963f7d28e17f72").server_list.front());
+  // md5("") = d41d8cd98f00b204e9800998ecf8427e
+  EXPECT_EQ(mf.ms5, cache.shard_key_lookup("db3.t3", "").server_list.front());
+  // md5("a") = 0cc175b9c0f1b6a831c399e269772661 is below the lowest bound
+  EXPECT_EQ(mf.ms5, cache.shard_key_lookup("db3.t3", "a").server_list.front());
+  EXPECT_EQ(mf.ms5, cache.shard_lookup("db3.t3", "0cc175b9c0f1b6a831c399e269772661").server_list.front());
+
+  auto results = cache.shard_key_lookup("db3.t3", std::vector<string>{"abc", "a", ""});
+  ASSERT_EQ(3u, results.size());
+  EXPECT_EQ(mf.ms1, results[0].server_list.front());
+  EXPECT_EQ(mf.ms5, results[1].server_list.front());
+  EXPECT_EQ(mf.ms5, results[2].server_list.front());
+
+  // Other sharding types use the value as is
+  EXPECT_EQ(mf.ms6, cache.shard_key_lookup("db2.t2", "1000").server_list.back());
+  results = cache.shard_key_lookup("InvalidTable", std::vector<string>{"1", "2"});
+  ASSERT_EQ(2u, results.size());
+  EXPECT_TRUE(results[1].server_list.empty());
+}
+
+/**
+ * Test that shards of RANGE_STRING tables are found.
+ */
+TEST_F(FabricCacheTest, StringShardTest) {
+  auto mock = std::dynamic_pointer_cast<MockFabric>(fabric_meta_data);
+  ASSERT_TRUE(mock != nullptr);
+
+  ManagedShard shard;
+  shard.schema_name = "db4";
+  shard.table_name = "t4";
+  shard.column_name = "name";
+  shard.type_name = "RANGE_STRING";
+  shard.global_group = "group-1";
+  list<ManagedShard> shards;
+  shard.shard_id = 8;
+  shard.lb = "m";
+  shard.group_id = "group-3";
+  shards.push_back(shard);
+  shard.shard_id = 9;
+  shard.lb = "a";
+  shard.group_id = "group-1";
+  shards.push_back(shard);
+  shard.shard_id = 10;
+  shard.lb = "mm";
+  shard.group_id = "group-1";
+  shards.push_back(shard);
+
+  auto original = mock->shard_map;
+  mock->shard_map["db4.t4"] = shards;
+  cache.refresh();
+  mock->shard_map = original;
+
+  EXPECT_EQ(mf.ms1, cache.shard_lookup("db4.t4", "a").server_list.front());
+  EXPECT_EQ(mf.ms1, cache.shard_lookup("db4.t4", "lzzz").server_list.front());
+  EXPECT_EQ(mf.ms5, cache.shard_lookup("db4.t4", "m").server_list.front());
+  EXPECT_EQ(mf.ms5, cache.shard_lookup("db4.t4", "ml").server_list.front());
+  EXPECT_EQ(mf.ms1, cache.shard_lookup("db4.t4", "mm").server_list.front());
+  EXPECT_EQ(mf.ms1, cache.shard_lookup("db4.t4", "zzz").server_list.front());
+  EXPECT_TRUE(cache.shard_lookup("db4.t4", "A").server_list.empty());
+  EXPECT_EQ(mf.ms1, cache.global_group_lookup("db4.t4").server_list.front());
+}
@@ -0,0 +1,116 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Test the memory used by the fabric cache for large sharded tables.
+ */
+
+#include "fabric_cache.h"
+#include "mock_fabric.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+#include "gmock/gmock.h"
+
+// Instance of MockFabric used by the cache, see mock_fabric_factory.cc
+extern std::shared_ptr<FabricMetaData> fabric_meta_data;
+
+// Bytes currently allocated using operator new
+static std::atomic<long long> g_allocated_bytes{0};
+
+// Each allocation is prefixed with its size, keeping the alignment
+static const size_t kHeaderSize = 16;
+
+void *operator new(size_t size) {
+  void *block = std::malloc(size + kHeaderSize);
+  if (!block) {
+    throw std::bad_alloc();
+  }
+  *static_cast<size_t*>(block) = size;
+  g_allocated_bytes += static_cast<long long>(size);
+  return static_cast<char*>(block) + kHeaderSize;
+}
+
+void operator delete(void *ptr) noexcept {
+  if (!ptr) {
+    return;
+  }
+  void *block = static_cast<char*>(ptr) - kHeaderSize;
+  g_allocated_bytes -= static_cast<long long>(*static_cast<size_t*>(block));
+  std::free(block);
+}
+
+void operator delete(void *ptr, size_t) noexcept {
+  operator delete(ptr);
+}
+
+const int kShardCount = 10000;
+
+class FabricCacheMemoryTest : public ::testing::Test {
+public:
+  MockFabric mf;
+
+  FabricCacheMemoryTest() : mf("localhost", 32275, "admin", "admin", 1, 1) {}
+
+  static list<ManagedShard> make_shards() {
+    list<ManagedShard> shards;
+    for (int i = 0; i < kShardCount; ++i) {
+      ManagedShard shard;
+      shard.schema_name = "shop_production";
+      shard.table_name = "customer_orders";
+      shard.column_name = "customer_id";
+      shard.lb = mysqlrouter::to_string(i * 1000);
+      shard.shard_id = i;
+      shard.type_name = "RANGE_INTEGER";
+      shard.group_id = "group-" + mysqlrouter::to_string(1 + i % 3);
+      shard.global_group = "group-1";
+      shards.push_back(shard);
+    }
+    return shards;
+  }
+};
+
+/**
+ * Test that the cache keeps much less than the shards fetched from Fabric.
+ */
+TEST_F(FabricCacheMemoryTest, LargeShardTableTest) {
+  // the cache uses the first MockFabric created
+  FabricCache cache("localhost", 32275, "admin", "admin", 1, 1);
+  auto mock = std::dynamic_pointer_cast<MockFabric>(fabric_meta_data);
+  ASSERT_TRUE(mock != nullptr);
+  cache.refresh();
+
+  auto before = g_allocated_bytes.load();
+  mock->shard_map["shop_production.customer_orders"] = make_shards();
+  auto fetched_bytes = g_allocated_bytes.load() - before;
+
+  before = g_allocated_bytes.load();
+  cache.refresh();
+  auto cached_bytes = g_allocated_bytes.load() - before;
+
+  EXPECT_EQ(mf.ms5, cache.shard_lookup("shop_production.customer_orders", "2500").server_list.front());
+  EXPECT_EQ(mf.ms1, cache.shard_lookup("shop_production.customer_orders", "9999999").server_list.front());
+
+  // 8 bytes for the bound and 4 for the group of each shard
+  std::cout << "Memory for " << kShardCount << " shards: fetched " << fetched_bytes
+            << " bytes, cached " << cached_bytes << " bytes" << std::endl;
+  EXPECT_LT(cached_bytes, kShardCount * 16);
+  EXPECT_LT(cached_bytes * 10, fetched_bytes);
+}
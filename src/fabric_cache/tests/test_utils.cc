@@ -0,0 +1,115 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Test the conversion of shard keys to native keys.
+ */
+
+#include "utils.h"
+
+#include "gmock/gmock.h"
+
+TEST(ShardKeyTest, IntegerKey) {
+  int64_t key = 0;
+  EXPECT_TRUE(to_integer_key("1234", &key));
+  EXPECT_EQ(1234, key);
+  EXPECT_TRUE(to_integer_key(" -42 ", &key));
+  EXPECT_EQ(-42, key);
+  EXPECT_TRUE(to_integer_key("+7", &key));
+  EXPECT_EQ(7, key);
+  EXPECT_TRUE(to_integer_key("-9223372036854775808", &key));
+  EXPECT_EQ(INT64_MIN, key);
+  EXPECT_TRUE(to_integer_key("9223372036854775807", &key));
+  EXPECT_EQ(INT64_MAX, key);
+}
+
+TEST(ShardKeyTest, InvalidIntegerKey) {
+  int64_t key = 0;
+  EXPECT_FALSE(to_integer_key("", &key));
+  EXPECT_FALSE(to_integer_key("-", &key));
+  EXPECT_FALSE(to_integer_key("12a", &key));
+  EXPECT_FALSE(to_integer_key("1 2", &key));
+  EXPECT_FALSE(to_integer_key("9223372036854775808", &key));
+  EXPECT_FALSE(to_integer_key("-9223372036854775809", &key));
+}
+
+TEST(ShardKeyTest, DateTimeKey) {
+  int64_t key = 0;
+  EXPECT_TRUE(to_datetime_key("1970-01-01", &key));
+  EXPECT_EQ(0, key);
+  EXPECT_TRUE(to_datetime_key("1970-01-02 00:00:01", &key));
+  EXPECT_EQ(86401000000LL, key);
+  EXPECT_TRUE(to_datetime_key("2016-02-29 12:30:45.5", &key));
+  EXPECT_EQ(1456749045500000LL, key);
+  EXPECT_TRUE(to_datetime_key("1969-12-31 23:59:59", &key));
+  EXPECT_EQ(-1000000LL, key);
+
+  int64_t earlier, later;
+  EXPECT_TRUE(to_datetime_key("2015-12-31 23:59:59.999999", &earlier));
+  EXPECT_TRUE(to_datetime_key("2016-01-01", &later));
+  EXPECT_LT(earlier, later);
+}
+
+TEST(ShardKeyTest, InvalidDateTimeKey) {
+  int64_t key = 0;
+  EXPECT_FALSE(to_datetime_key("", &key));
+  EXPECT_FALSE(to_datetime_key("2016-13-01", &key));
+  EXPECT_FALSE(to_datetime_key("2016-1-01", &key));
+  EXPECT_FALSE(to_datetime_key("2016-01-01 25:00:00", &key));
+  EXPECT_FALSE(to_datetime_key("2016-01-01 12:00", &key));
+  EXPECT_FALSE(to_datetime_key("2016-01-01 12:00:00.", &key));
+}
+
+TEST(ShardKeyTest, MD5Key) {
+  MD5Digest key;
+  MD5Digest expected{{0x0f, 0x1e, 0x2d, 0x3c, 0x4b, 0x5a, 0x69, 0x78,
+                      0x87, 0x96, 0xa5, 0xb4, 0xc3, 0xd2, 0xe1, 0xf0}};
+  EXPECT_TRUE(to_md5_key("0F1E2D3C4B5A69788796A5B4C3D2E1F0", &key));
+  EXPECT_EQ(expected, key);
+  EXPECT_TRUE(to_md5_key("0f1e2d3c4b5a69788796a5b4c3d2e1f0", &key));
+  EXPECT_EQ(expected, key);
+
+  // Shorter values are padded with zeros
+  MD5Digest padded{{0xab, 0xc0}};
+  EXPECT_TRUE(to_md5_key("abc", &key));
+  EXPECT_EQ(padded, key);
+}
+
+TEST(ShardKeyTest, InvalidMD5Key) {
+  MD5Digest key;
+  EXPECT_FALSE(to_md5_key("", &key));
+  EXPECT_FALSE(to_md5_key("xyz", &key));
+  EXPECT_FALSE(to_md5_key("0F1E2D3C4B5A69788796A5B4C3D2E1F000", &key));
+}
+
+TEST(ShardKeyTest, MD5Digest) {
+  auto expect_md5 = [](const string &hex, const string &value) {
+    MD5Digest expected;
+    ASSERT_TRUE(to_md5_key(hex, &expected));
+    EXPECT_EQ(expected, md5(value.data(), value.size())) << "value: " << value;
+  };
+  expect_md5("d41d8cd98f00b204e9800998ecf8427e", "");
+  expect_md5("0cc175b9c0f1b6a831c399e269772661", "a");
+  expect_md5("900150983cd24fb0d6963f7d28e17f72", "abc");
+  expect_md5("9e107d9d372bb6826bd81d3542a419d6", "The quick brown fox jumps over the lazy dog");
+  // 62 bytes leave no room for the length; padding needs an extra block
+  expect_md5("d174ab98d277d9f5a5611c2c9f419d9f",
+             "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789");
+  // 80 bytes span two blocks
+  expect_md5("57edf4a22be3c955ac49da2e2107b67a",
+             "12345678901234567890123456789012345678901234567890123456789012345678901234567890");
+}
@@ -27,6 +27,13 @@ namespace mysql_protocol {
 // - See also MySQL Server source include/mysql_com.h
 // - using uint32_t because transmitted as 4 byte long integer
 
+/** @brief CLIENT_CONNECT_WITH_DB
+ *
+ * Server: Supports initial schema in handshake response.
+ * Client: Handshake response contains initial schema.
+ */
+const uint32_t kClientConnectWithDB = 0x00000008;
+
 /** @brief CLIENT_PROTOCOL_41
  *
  * Server: Supports the 4.1 protocol.
@@ -41,6 +48,34 @@ const uint32_t kClientProtocol41 = 0x00000200;
  */
 const uint32_t kClientSSL = 0x00000800;
 
+/** @brief CLIENT_SECURE_CONNECTION
+ *
+ * Server: Supports authentication data prefixed with its length.
+ * Client: Authentication data is prefixed with its length (1 byte).
+ */
+const uint32_t kClientSecureConnection = 0x00008000;
+
+/** @brief CLIENT_PLUGIN_AUTH
+ *
+ * Server: Supports authentication plugins and authentication method switch.
+ * Client: Handshake response contains the authentication plugin name.
+ */
+const uint32_t kClientPluginAuth = 0x00080000;
+
+/** @brief CLIENT_CONNECT_ATTRS
+ *
+ * Server: Supports connection attributes.
+ * Client: Handshake response contains connection attributes.
+ */
+const uint32_t kClientConnectAttrs = 0x00100000;
+
+/** @brief CLIENT_PLUGIN_AUTH_LENENC_CLIENT_DATA
+ *
+ * Server: Supports length encoded authentication data.
+ * Client: Authentication data is prefixed with its length encoded integer.
+ */
+const uint32_t kClientPluginAuthLenencClientData = 0x00200000;
+
 } // mysql_protocol
 
 #endif // MYSQLROUTER_MYSQL_PROTOCOL_CONSTANTS_INCLUDED
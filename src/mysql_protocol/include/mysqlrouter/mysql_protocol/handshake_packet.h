@@ -20,6 +20,8 @@
 
 #include "base_packet.h"
 
+#include <map>
+
 namespace mysql_protocol {
 
 /** @class HandshakeResponsePacket
@@ -50,7 +52,7 @@ class MYSQL_PROTOCOL_API HandshakeResponsePacket final : public Packet {
 
   /** @brief Constructor */
   HandshakeResponsePacket() : Packet(0), auth_data_({}), username_(""), password_(""),
-                              char_set_(8), auth_plugin_("mysql_native_password") {
+                              char_set_(8), auth_plugin_("mysql_native_password"), auth_plugin_pos_(0) {
     prepare_packet();
   }
 
@@ -70,6 +72,59 @@ class MYSQL_PROTOCOL_API HandshakeResponsePacket final : public Packet {
                           unsigned char char_set = 8,
                           const std::string &auth_plugin = "mysql_native_password");
 
+  /** @overload
+   *
+   * Parses the handshake response sent by a MySQL client. Only responses
+   * using the 4.1 protocol are supported.
+   *
+   * Throws packet_error when the buffer does not contain a complete and
+   * valid handshake response.
+   *
+   * @param buffer Vector of uint8_t containing the packet
+   */
+  explicit HandshakeResponsePacket(const std::vector<uint8_t> &buffer);
+
+  /** @brief Gets MySQL username
+   *
+   * @return const std::string reference
+   */
+  const std::string &get_username() const noexcept {
+    return username_;
+  }
+
+  /** @brief Gets initial schema
+   *
+   * @return const std::string reference; empty when not set
+   */
+  const std::string &get_database() const noexcept {
+    return database_;
+  }
+
+  /** @brief Gets authentication plugin name
+   *
+   * @return const std::string reference; empty when not set
+   */
+  const std::string &get_auth_plugin() const noexcept {
+    return auth_plugin_;
+  }
+
+  /** @brief Gets the connection attributes sent by the client
+   *
+   * @return const std::map reference of attribute names and values
+   */
+  const std::map<std::string, std::string> &get_connect_attributes() const noexcept {
+    return connect_attributes_;
+  }
+
+  /** @brief Replaces the authentication plugin name
+   *
+   * Replaces the authentication plugin name in the packet keeping all
+   * other data, and updates the payload size.
+   *
+   * @param auth_plugin Name of the authentication plugin
+   */
+  void set_auth_plugin(const std::string &auth_plugin);
+
  private:
   /** @brief Prepares the packet
    *
@@ -78,6 +133,12 @@ class MYSQL_PROTOCOL_API HandshakeResponsePacket final : public Packet {
    */
   void prepare_packet();
 
+  /** @brief Parses the packet
+   *
+   * Parses the packet from the given buffer.
+   */
+  void parse_payload();
+
   /** @brief Authentication data provided by the MySQL handshake packet */
   std::vector<unsigned char> auth_data_;
 
@@ -95,6 +156,12 @@ class MYSQL_PROTOCOL_API HandshakeResponsePacket final : public Packet {
 
   /** @brief MySQL authentication plugin name */
   std::string auth_plugin_;
+
+  /** @brief Position of the authentication plugin name in the packet */
+  size_t auth_plugin_pos_;
+
+  /** @brief Connection attributes */
+  std::map<std::string, std::string> connect_attributes_;
 };
 
 } // namespace mysql_protocol
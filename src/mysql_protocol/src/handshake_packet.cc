@@ -19,6 +19,7 @@
 #include "mysqlrouter/utils.h"
 
 #include <cassert>
+#include <algorithm>
 #include <cstddef>
 #include <iomanip>
 #include <iostream>
@@ -36,10 +37,15 @@ HandshakeResponsePacket::HandshakeResponsePacket(uint8_t sequence_id,
                                                  unsigned char char_set,
                                                  const std::string &auth_plugin)
     : Packet(sequence_id), auth_data_(auth_data), username_(username), password_(password),
-      database_(database), char_set_(char_set), auth_plugin_(auth_plugin) {
+      database_(database), char_set_(char_set), auth_plugin_(auth_plugin), auth_plugin_pos_(0) {
   prepare_packet();
 }
 
+HandshakeResponsePacket::HandshakeResponsePacket(const std::vector<uint8_t> &buffer)
+    : Packet(buffer), char_set_(0), auth_plugin_pos_(0) {
+  parse_payload();
+}
+
 /** @fn HandshakeResponsePacket::prepare_packet()
  *
  * @devnote
@@ -81,10 +87,139 @@ void HandshakeResponsePacket::prepare_packet() {
   push_back(0x0);
 
   // Authentication plugin name
+  auth_plugin_pos_ = size();
   add(auth_plugin_);
   push_back(0x0);
 
   update_packet_size();
 }
 
+namespace {
+
+// Returns the position after the nil-terminated string starting at pos
+size_t skip_nil_string(const Packet &packet, size_t pos, size_t end) {
+  auto found = std::find(packet.begin() + static_cast<long>(pos), packet.begin() + static_cast<long>(end), 0);
+  if (found == packet.begin() + static_cast<long>(end)) {
+    throw packet_error("Handshake response: string not terminated");
+  }
+  return static_cast<size_t>(found - packet.begin()) + 1;
+}
+
+// Reads a length encoded integer checking that it fits in the packet
+uint64_t read_lenenc_uint(const Packet &packet, size_t *pos, size_t end) {
+  if (*pos >= end) {
+    throw packet_error("Handshake response: truncated");
+  }
+  size_t length = 0;
+  switch (packet[*pos]) {
+    case 0xfc:
+      length = 2;
+      break;
+    case 0xfd:
+      length = 3;
+      break;
+    case 0xfe:
+      length = 8;
+      break;
+    case 0xfb:
+    case 0xff:
+      throw packet_error("Handshake response: invalid length encoded integer");
+    default:
+      return packet[(*pos)++];
+  }
+  if (*pos + 1 + length > end) {
+    throw packet_error("Handshake response: truncated");
+  }
+  auto value = packet.get_int<uint64_t>(*pos + 1, length);
+  *pos += 1 + length;
+  return value;
+}
+
+// Reads a length encoded string checking that it fits in the packet
+std::string read_lenenc_string(const Packet &packet, size_t *pos, size_t end) {
+  auto length = read_lenenc_uint(packet, pos, end);
+  if (length > end - *pos) {
+    throw packet_error("Handshake response: truncated");
+  }
+  auto start = packet.begin() + static_cast<long>(*pos);
+  *pos += static_cast<size_t>(length);
+  return std::string(start, start + static_cast<long>(length));
+}
+
+} // namespace
+
+void HandshakeResponsePacket::parse_payload() {
+  // capabilities (4), max packet size (4), character set (1), filler (23)
+  const size_t kFixedSize = 32;
+  const size_t end = kHeaderSize + payload_size_;
+  if (size() < kHeaderSize || payload_size_ < kFixedSize) {
+    throw packet_error("Handshake response: truncated");
+  }
+
+  size_t pos = kHeaderSize;
+  capability_flags_ = get_int<uint32_t>(pos);
+  if (!(capability_flags_ & kClientProtocol41)) {
+    throw packet_error("Handshake response: only protocol 4.1 is supported");
+  }
+  char_set_ = (*this)[pos + 8];
+  pos += kFixedSize;
+
+  auto next = skip_nil_string(*this, pos, end);
+  username_ = get_string(pos, next - pos - 1);
+  pos = next;
+
+  if (capability_flags_ & kClientPluginAuthLenencClientData) {
+    auto data = read_lenenc_string(*this, &pos, end);
+    auth_data_.assign(data.begin(), data.end());
+  } else if (capability_flags_ & kClientSecureConnection) {
+    if (pos >= end || (*this)[pos] > end - pos - 1) {
+      throw packet_error("Handshake response: truncated");
+    }
+    auto length = (*this)[pos++];
+    auth_data_.assign(begin() + static_cast<long>(pos), begin() + static_cast<long>(pos + length));
+    pos += length;
+  } else {
+    next = skip_nil_string(*this, pos, end);
+    auth_data_.assign(begin() + static_cast<long>(pos), begin() + static_cast<long>(next - 1));
+    pos = next;
+  }
+
+  if ((capability_flags_ & kClientConnectWithDB) && pos < end) {
+    next = skip_nil_string(*this, pos, end);
+    database_ = get_string(pos, next - pos - 1);
+    pos = next;
+  }
+
+  if ((capability_flags_ & kClientPluginAuth) && pos < end) {
+    auth_plugin_pos_ = pos;
+    next = skip_nil_string(*this, pos, end);
+    auth_plugin_ = get_string(pos, next - pos - 1);
+    pos = next;
+  }
+
+  if ((capability_flags_ & kClientConnectAttrs) && pos < end) {
+    auto length = read_lenenc_uint(*this, &pos, end);
+    if (length > end - pos) {
+      throw packet_error("Handshake response: truncated");
+    }
+    auto attrs_end = pos + static_cast<size_t>(length);
+    while (pos < attrs_end) {
+      auto name = read_lenenc_string(*this, &pos, attrs_end);
+      connect_attributes_[name] = read_lenenc_string(*this, &pos, attrs_end);
+    }
+  }
+}
+
+void HandshakeResponsePacket::set_auth_plugin(const std::string &auth_plugin) {
+  if (auth_plugin_pos_ == 0) {
+    throw packet_error("Handshake response does not contain authentication plugin name");
+  }
+  auto start = begin() + static_cast<long>(auth_plugin_pos_);
+  erase(start, start + static_cast<long>(auth_plugin_.size()));
+  insert(begin() + static_cast<long>(auth_plugin_pos_), auth_plugin.begin(), auth_plugin.end());
+  payload_size_ = static_cast<uint32_t>(payload_size_ - auth_plugin_.size() + auth_plugin.size());
+  write_int<uint32_t>(*this, 0, payload_size_, 3);
+  auth_plugin_ = auth_plugin;
+}
+
 } // namespace mysql_protocol
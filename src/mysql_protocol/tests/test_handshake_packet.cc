@@ -119,3 +119,86 @@ TEST_F(HandshakeResponsePacketTest, Constructor) {
   }
 }
 
+
+class HandshakeResponseParseTest : public ::testing::Test {
+protected:
+  // Handshake response as sent by the mysql client with initial schema,
+  // authentication plugin and connection attributes
+  static mysql_protocol::Packet make_response(uint32_t capabilities) {
+    mysql_protocol::Packet p(1);
+    p.assign({0x0, 0x0, 0x0, 0x1});
+    p.add_int<uint32_t>(capabilities);
+    p.add_int<uint32_t>(mysql_protocol::Packet::kMaxAllowedSize);
+    p.add_int<uint8_t>(33);
+    p.insert(p.end(), 23, 0x0);
+    p.add(string("app_user"));
+    p.push_back(0x0);
+    p.add_int<uint8_t>(3);
+    p.add(string("\x01\x02\x03"));
+    if (capabilities & mysql_protocol::kClientConnectWithDB) {
+      p.add(string("shop"));
+      p.push_back(0x0);
+    }
+    if (capabilities & mysql_protocol::kClientPluginAuth) {
+      p.add(string("mysql_native_password"));
+      p.push_back(0x0);
+    }
+    if (capabilities & mysql_protocol::kClientConnectAttrs) {
+      p.add_int<uint8_t>(23);
+      p.add_int<uint8_t>(9);
+      p.add(string("shard_key"));
+      p.add_int<uint8_t>(4);
+      p.add(string("1234"));
+      p.add_int<uint8_t>(4);
+      p.add(string("_pid"));
+      p.add_int<uint8_t>(2);
+      p.add(string("42"));
+    }
+    mysql_protocol::Packet::write_int<uint32_t>(p, 0, static_cast<uint32_t>(p.size() - 4), 3);
+    return p;
+  }
+
+  const uint32_t kCapabilities = mysql_protocol::kClientProtocol41 | mysql_protocol::kClientSecureConnection |
+      mysql_protocol::kClientConnectWithDB | mysql_protocol::kClientPluginAuth;
+};
+
+TEST_F(HandshakeResponseParseTest, Parse) {
+  mysql_protocol::HandshakeResponsePacket p(make_response(kCapabilities));
+
+  ASSERT_EQ(1, p.get_sequence_id());
+  ASSERT_EQ(string("app_user"), p.get_username());
+  ASSERT_EQ(string("shop"), p.get_database());
+  ASSERT_EQ(string("mysql_native_password"), p.get_auth_plugin());
+  ASSERT_TRUE(p.get_connect_attributes().empty());
+}
+
+TEST_F(HandshakeResponseParseTest, ParseConnectAttributes) {
+  mysql_protocol::HandshakeResponsePacket p(make_response(kCapabilities | mysql_protocol::kClientConnectAttrs));
+
+  ASSERT_EQ(2u, p.get_connect_attributes().size());
+  ASSERT_EQ(string("1234"), p.get_connect_attributes().at("shard_key"));
+  ASSERT_EQ(string("42"), p.get_connect_attributes().at("_pid"));
+}
+
+TEST_F(HandshakeResponseParseTest, SetAuthPlugin) {
+  auto buffer = make_response(kCapabilities);
+  mysql_protocol::HandshakeResponsePacket p(buffer);
+  p.set_auth_plugin("other");
+
+  ASSERT_EQ(buffer.size() - 16, p.size());
+  ASSERT_EQ(p.size() - 4, p.get_int<uint32_t>(0, 3));
+  mysql_protocol::HandshakeResponsePacket parsed(p);
+  ASSERT_EQ(string("other"), parsed.get_auth_plugin());
+  ASSERT_EQ(string("shop"), parsed.get_database());
+}
+
+TEST_F(HandshakeResponseParseTest, Truncated) {
+  auto buffer = make_response(kCapabilities);
+  // Cut the authentication plugin name
+  buffer.resize(buffer.size() - 5);
+  mysql_protocol::Packet::write_int<uint32_t>(buffer, 0, static_cast<uint32_t>(buffer.size() - 4), 3);
+  ASSERT_THROW(mysql_protocol::HandshakeResponsePacket{buffer}, mysql_protocol::packet_error);
+
+  ASSERT_THROW(mysql_protocol::HandshakeResponsePacket(mysql_protocol::Packet::vector_t{0x1, 0x0, 0x0, 0x1, 0x0}),
+               mysql_protocol::packet_error);
+}
@@ -20,6 +20,7 @@
 
 #include "mysqlrouter/datatypes.h"
 #include "mysqlrouter/plugin_config.h"
+#include "networking/caching_resolver.h"
 
 #include <map>
 #include <string>
@@ -37,6 +38,12 @@ namespace routing {
  */
 const int kDefaultWaitTimeout = 0; // 0 = no timeout used
 
+/** @brief Maximum lifetime of client sessions (in seconds)
+ *
+ * Sessions are ended once open for this long, idle or not.
+ */
+const int kDefaultMaxSessionLifetime = 0; // 0 = no maximum
+
 /** @brief Max number of active routes for this routing instance */
 const int kDefaultMaxConnections = 512;
 
@@ -76,6 +83,26 @@ const unsigned int kDefaultNetBufferLength = 16384;  // Default defined in lates
  */
 const unsigned int kDefaultClientConnectTimeout = 9; // Default connect_timeout MySQL Server minus 1
 
+/** @brief Error rate (in percent) ejecting a destination
+ *
+ * Percentage of relayed sessions which have to fail in-band, for example
+ * with an error packet during the handshake, before the destination is
+ * ejected. The default 0 disables outlier detection.
+ */
+const unsigned int kDefaultOutlierErrorRate = 0;
+
+/** @brief Minimum relayed sessions before outlier detection kicks in */
+const unsigned int kDefaultOutlierMinRequests = 5;
+
+/** @brief Length of the sliding window of outlier detection (in seconds) */
+const unsigned int kDefaultOutlierInterval = 10;
+
+/** @brief How long an outlier is ejected (in seconds) */
+const unsigned int kDefaultOutlierEjectionTime = 30;
+
+/** @brief Maximum percentage of destinations ejected at the same time */
+const unsigned int kDefaultOutlierMaxEjectionPercent = 50;
+
 /** @brief Modes supported by Routing plugin */
 enum class AccessMode {
   kReadWrite = 1,
@@ -113,7 +140,34 @@ void set_socket_blocking(int sock, bool blocking);
 class SocketOperationsBase {
  public:
   virtual ~SocketOperationsBase() = default;
-  virtual int get_mysql_socket(mysqlrouter::TCPAddress addr, int connect_timeout, bool log = true) noexcept = 0;
+  virtual int get_mysql_socket(const mysqlrouter::TCPAddress &addr, int connect_timeout, bool log = true) noexcept = 0;
+
+  /** @brief Returns socket descriptor connected to an address resolved before
+   *
+   * The default implementation ignores the resolved address and resolves
+   * addr again.
+   *
+   * @param addr information of the server we connect with
+   * @param resolved raw bytes of the `struct sockaddr` of the server
+   * @param resolved_len number of bytes of resolved
+   * @param connect_timeout number of seconds waiting for connection
+   * @param log whether to log errors or not
+   * @return a socket descriptor
+   */
+  virtual int get_mysql_socket(const mysqlrouter::TCPAddress &addr, const void * /* resolved */,
+                               size_t /* resolved_len */, int connect_timeout, bool log = true) noexcept {
+    return get_mysql_socket(addr, connect_timeout, log);
+  }
+
+  /** @brief Resolves the address of a server in the background
+   *
+   * Called for the servers which will be connected to, so that they are
+   * resolved before the first connection. Does nothing by default.
+   *
+   * @param addr information of the server
+   */
+  virtual void prefetch(const mysqlrouter::TCPAddress & /* addr */) noexcept {}
+
   virtual ssize_t write(int  fd, void *buffer, size_t nbyte) = 0;
   virtual ssize_t read(int fd, void *buffer, size_t nbyte) = 0;
   virtual void close(int fd) = 0;
@@ -148,12 +202,38 @@ class SocketOperations : public SocketOperationsBase {
    * Returns a socket descriptor for the connection to the MySQL Server or
    * -1 when an error occurred.
    *
+   * The address of the server is resolved using the cache shared by all
+   * routes, see resolver().
+   *
    * @param addr information of the server we connect with
    * @param connect_timeout number of seconds waiting for connection
    * @param log whether to log errors or not
    * @return a socket descriptor
    */
-  int get_mysql_socket(mysqlrouter::TCPAddress addr, int connect_timeout, bool log = true) noexcept override;
+  int get_mysql_socket(const mysqlrouter::TCPAddress &addr, int connect_timeout, bool log = true) noexcept override;
+
+  /** @brief Returns socket descriptor of connected MySQL server
+   *
+   * Same as get_mysql_socket(), but connects to the given socket address
+   * without resolving the address of the server.
+   *
+   * @param addr information of the server we connect with; used for logging
+   * @param resolved raw bytes of the `struct sockaddr` of the server
+   * @param resolved_len number of bytes of resolved
+   * @param connect_timeout number of seconds waiting for connection
+   * @param log whether to log errors or not
+   * @return a socket descriptor
+   */
+  int get_mysql_socket(const mysqlrouter::TCPAddress &addr, const void *resolved, size_t resolved_len,
+                       int connect_timeout, bool log = true) noexcept override;
+
+  /** @brief Resolves the address of a server in the resolver cache */
+  void prefetch(const mysqlrouter::TCPAddress &addr) noexcept override;
+
+  /** @brief Returns the cache resolving the addresses of the servers */
+  mysql_harness::CachingResolver &resolver() noexcept {
+    return resolver_;
+  }
 
   /** @brief Thin wrapper around socket library write() */
   ssize_t write(int fd, void *buffer, size_t nbyte) override;
@@ -167,9 +247,19 @@ class SocketOperations : public SocketOperationsBase {
   /** @brief Thin wrapper around socket library shutdown() */
   void shutdown(int fd)  override;
  private:
+  /** @brief Connects a new socket to given socket address
+   *
+   * @return a socket descriptor, or -1 when connecting failed
+   */
+  int connect_address(const mysqlrouter::TCPAddress &addr, const void *resolved, size_t resolved_len,
+                      int connect_timeout, bool log) noexcept;
+
   SocketOperations(const SocketOperations&) = delete;
   SocketOperations operator=(const SocketOperations&) = delete;
   SocketOperations() = default;
+
+  /** @brief Addresses of the servers, resolved by threads of its own */
+  mysql_harness::CachingResolver resolver_;
 };
 
 } // namespace routing
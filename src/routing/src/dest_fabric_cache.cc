@@ -20,6 +20,7 @@
 #include "mysqlrouter/routing.h"
 
 #include <algorithm>
+#include <cerrno>
 #include <chrono>
 #include <iostream>
 
@@ -48,8 +49,15 @@ using std::chrono::seconds;
 using fabric_cache::lookup_group;
 using fabric_cache::ManagedServer;
 
-std::vector<TCPAddress> DestFabricCacheGroup::get_available() {
-  auto managed_servers = lookup_group(cache_name, ha_group).server_list;
+namespace {
+
+// Returns the managed servers which can be used for given routing mode. When
+// resolved is not nullptr, it gets the socket address of each server resolved
+// by the Fabric Cache.
+std::vector<TCPAddress> filter_managed_servers(const list<ManagedServer> &managed_servers,
+                                               routing::AccessMode routing_mode,
+                                               bool allow_primary_reads,
+                                               std::vector<string> *resolved = nullptr) {
   std::vector<TCPAddress> available;
 
   for (auto &it: managed_servers) {
@@ -62,66 +70,186 @@ std::vector<TCPAddress> DestFabricCacheGroup::get_available() {
       continue;
     }
 
+    bool usable;
     if (routing_mode == routing::AccessMode::kReadOnly && server_mode == ManagedServer::Mode::kReadOnly) {
       // Secondary read-only
-      available.push_back(TCPAddress(it.host, static_cast<uint16_t >(it.port)));
-    } else if ((routing_mode == routing::AccessMode::kReadWrite &&
+      usable = true;
+    } else {
+      // Primary and secondary read-write/write-only
+      usable = (routing_mode == routing::AccessMode::kReadWrite &&
                 (server_mode == ManagedServer::Mode::kReadWrite ||
                  server_mode == ManagedServer::Mode::kWriteOnly)) ||
-               allow_primary_reads_) {
-      // Primary and secondary read-write/write-only
-      available.push_back(TCPAddress(it.host, static_cast<uint16_t >(it.port)));
+               allow_primary_reads;
+    }
+    if (!usable) {
+      continue;
+    }
+
+    available.push_back(TCPAddress(it.host, static_cast<uint16_t >(it.port)));
+    if (resolved) {
+      resolved->push_back(it.resolved_address);
     }
   }
 
   return available;
 }
 
+// Parses the allow_primary_reads option of the URI query
+bool get_allow_primary_reads(const URIQuery &uri_query, routing::AccessMode routing_mode) {
+  auto query_part = uri_query.find("allow_primary_reads");
+  if (query_part == uri_query.end()) {
+    return false;
+  }
+  if (routing_mode != routing::AccessMode::kReadOnly) {
+    log_warning("allow_primary_reads only works with read-only mode");
+    return false;
+  }
+  auto value = query_part->second;
+  std::transform(value.begin(), value.end(), value.begin(), ::tolower);
+  return value == "yes";
+}
+
+// Stores the error of the failed connect and, unless we ran out of file
+// descriptors, requests the Fabric Cache to be refreshed: the server might
+// have failed and been replaced by another one. Returns -1.
+int connect_failed(const string &cache_name, int *error) noexcept {
+#ifndef _WIN32
+  *error = errno;
+#else
+  *error = WSAGetLastError();
+#endif
+  if (*error == ENFILE || *error == EMFILE) {
+    return -1;
+  }
+  try {
+    fabric_cache::request_refresh(cache_name);
+  } catch (const fabric_cache::base_error &) {
+    // Cache not initialized; the failure was already logged
+  }
+  return -1;
+}
+
+} // namespace
+
+std::vector<TCPAddress> DestFabricCacheGroup::get_available() {
+  auto managed_servers = lookup_group(cache_name, ha_group);
+  return filter_managed_servers(managed_servers.server_list, routing_mode, allow_primary_reads_);
+}
+
 void DestFabricCacheGroup::init() {
+  allow_primary_reads_ = get_allow_primary_reads(uri_query, routing_mode);
+}
 
-  auto query_part = uri_query.find("allow_primary_reads");
-  if (query_part != uri_query.end()) {
-    if (routing_mode == routing::AccessMode::kReadOnly) {
-      auto value = query_part->second;
-      std::transform(value.begin(), value.end(), value.begin(), ::tolower);
-      if (value == "yes") {
-        allow_primary_reads_ = true;
-      }
-    } else {
-      log_warning("allow_primary_reads only works with read-only mode");
-    }
+std::shared_ptr<const DestFabricCacheGroup::Candidates> DestFabricCacheGroup::get_candidates(uint64_t generation) {
+  auto candidates = std::atomic_load(&candidates_);
+  if (candidates && candidates->generation == generation) {
+    return candidates;
   }
+
+  std::lock_guard<std::mutex> lock(mutex_candidates_);
+  // Another thread might have updated while we were waiting
+  candidates = std::atomic_load(&candidates_);
+  if (candidates && candidates->generation == generation) {
+    return candidates;
+  }
+
+  std::shared_ptr<Candidates> updated(new Candidates());
+  updated->generation = generation;
+  auto managed_servers = lookup_group(cache_name, ha_group);
+  updated->addresses = filter_managed_servers(managed_servers.server_list, routing_mode, allow_primary_reads_,
+                                              &updated->resolved);
+  std::atomic_store(&candidates_, std::shared_ptr<const Candidates>(updated));
+  LOG_DEBUG("Updated destinations of Fabric group '%s' (%u available)", ha_group.c_str(),
+            static_cast<unsigned int>(updated->addresses.size()));
+  return updated;
 }
 
-int DestFabricCacheGroup::get_server_socket(int connect_timeout, int *error) noexcept {
+int DestFabricCacheGroup::get_server_socket(int connect_timeout, int *error, TCPAddress *address) noexcept {
 
   try {
-
-    auto available = get_available();
-    if (available.empty()) {
-      return -1;
+    auto candidates = get_candidates(fabric_cache::cache_generation(cache_name));
+    auto sock = connect_round_robin(candidates->addresses, connect_timeout, address, candidates->resolved);
+    if (sock >= 0) {
+      return sock;
     }
+  } catch (const fabric_cache::base_error &) {
+    log_error("Failed getting managed servers from Fabric");
+  }
+
+  return connect_failed(cache_name, error);
+}
+
+void DestFabricCacheShard::init() {
+  allow_primary_reads_ = get_allow_primary_reads(uri_query, routing_mode);
+
+  auto query_part = uri_query.find("shard_key_attribute");
+  if (query_part != uri_query.end() && !query_part->second.empty()) {
+    shard_key_attribute_ = query_part->second;
+  }
+}
+
+bool DestFabricCacheShard::get_shard_key(const mysql_protocol::HandshakeResponsePacket &response,
+                                         string *shard_key) const {
+  auto &attributes = response.get_connect_attributes();
+  auto attribute = attributes.find(shard_key_attribute_);
+  if (attribute != attributes.end()) {
+    *shard_key = attribute->second;
+    return true;
+  }
+  if (!response.get_database().empty()) {
+    *shard_key = response.get_database();
+    return true;
+  }
+  return false;
+}
+
+std::vector<TCPAddress> DestFabricCacheShard::get_shard_candidates(const string &shard_key,
+                                                                   std::vector<string> *resolved) {
+  auto managed_servers = fabric_cache::lookup_shard_key(cache_name, shard_table, shard_key);
+  auto candidates = filter_managed_servers(managed_servers.server_list, routing_mode, allow_primary_reads_,
+                                           resolved);
+  last_pool_size_.store(candidates.size(), std::memory_order_relaxed);
+  return candidates;
+}
 
-    auto next_up = current_pos_;
-    if (next_up >= available.size()) {
-      next_up = 0;
-      current_pos_ = 0;
+int DestFabricCacheShard::get_server_socket(int connect_timeout, int *error, TCPAddress *address) noexcept {
+  try {
+    auto managed_servers = fabric_cache::lookup_global_group(cache_name, shard_table);
+    std::vector<string> resolved;
+    auto candidates = filter_managed_servers(managed_servers.server_list, routing_mode, allow_primary_reads_,
+                                             &resolved);
+    auto sock = connect_round_robin(candidates, connect_timeout, address, resolved);
+    if (sock >= 0) {
+      return sock;
     }
+  } catch (const fabric_cache::base_error &) {
+    log_error("Failed getting managed servers from Fabric");
+  }
+
+  return connect_failed(cache_name, error);
+}
 
-    std::lock_guard<std::mutex> lock(mutex_update_);
-    ++current_pos_;
-    if (current_pos_ >= available.size()) {
-      current_pos_ = 0;
+int DestFabricCacheShard::get_server_socket_for_key(const string &shard_key, int connect_timeout, int *error,
+                                                    TCPAddress *address) noexcept {
+  try {
+    std::vector<string> resolved;
+    auto candidates = get_shard_candidates(shard_key, &resolved);
+    auto sock = connect_round_robin(candidates, connect_timeout, address, resolved);
+    if (sock >= 0) {
+      return sock;
     }
-    return get_mysql_socket(available.at(next_up), connect_timeout);
-  } catch (fabric_cache::base_error) {
+  } catch (const fabric_cache::base_error &) {
     log_error("Failed getting managed servers from Fabric");
   }
 
-#ifndef _WIN32
-  *error = errno;
-#else
-  *error = WSAGetLastError();
-#endif
-  return -1;
+  return connect_failed(cache_name, error);
+}
+
+bool DestFabricCacheShard::is_shard_candidate(const string &shard_key, const TCPAddress &address) noexcept {
+  try {
+    auto candidates = get_shard_candidates(shard_key);
+    return std::find(candidates.begin(), candidates.end(), address) != candidates.end();
+  } catch (const fabric_cache::base_error &) {
+    return false;
+  }
 }
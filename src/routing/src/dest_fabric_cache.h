@@ -20,8 +20,10 @@
 
 #include "destination.h"
 #include "mysql_routing.h"
+#include "mysqlrouter/mysql_protocol.h"
 #include "mysqlrouter/uri.h"
 
+#include <memory>
 #include <thread>
 
 #include "mysqlrouter/datatypes.h"
@@ -34,6 +36,9 @@ using mysqlrouter::URIQuery;
 
 const int kDefaultRefreshInterval = 3;
 
+/** @brief Default name of the connection attribute holding the shard key */
+const string kDefaultShardKeyAttribute = "shard_key";
+
 class DestFabricCacheGroup final : public RouteDestination {
 public:
   /** @brief Constructor */
@@ -45,8 +50,7 @@ public:
         ha_group(group),
         routing_mode(mode),
         uri_query(query),
-        allow_primary_reads_(false),
-        current_pos_(0) {
+        allow_primary_reads_(false) {
     init();
   };
 
@@ -62,7 +66,7 @@ public:
   /** @brief Move assignment */
   DestFabricCacheGroup &operator=(DestFabricCacheGroup &&) = delete;
 
-  int get_server_socket(int connect_timeout, int *error) noexcept;
+  int get_server_socket(int connect_timeout, int *error, TCPAddress *address = nullptr) noexcept;
 
   void add(const string &, uint16_t) { }
 
@@ -88,6 +92,36 @@ public:
     destinations_ = get_available();
   }
 
+  /** @brief Candidate destinations derived from the Fabric Cache
+   *
+   * Managed servers of the HA group, filtered by status and routing mode,
+   * as they were when the Fabric Cache had the given generation. Once
+   * published, Candidates are never modified and shared by all
+   * connections.
+   */
+  struct Candidates {
+    /** @brief Generation of the Fabric Cache the candidates were derived from */
+    uint64_t generation;
+    /** @brief Available destinations */
+    std::vector<TCPAddress> addresses;
+    /** @brief Socket address of each destination resolved by the Fabric Cache */
+    std::vector<string> resolved;
+  };
+
+  /** @brief Returns the candidates for given Fabric Cache generation
+   *
+   * Returns the currently published candidates when they were derived
+   * from the given generation of the Fabric Cache. Otherwise, the candidates
+   * are derived again using `get_available()` and published. Only one
+   * thread derives candidates at a time.
+   *
+   * Throws fabric_cache::base_error when the Fabric Cache is not available.
+   *
+   * @param generation Current generation of the Fabric Cache
+   * @return shared pointer to candidates
+   */
+  std::shared_ptr<const Candidates> get_candidates(uint64_t generation);
+
   /** @brief The Fabric Cache to use
    *
    * cache_name is the the section key in the configuration of Fabric Cache.
@@ -128,6 +162,13 @@ public:
    */
   const URIQuery uri_query;
 
+protected:
+  /** @brief Returns number of candidate destinations */
+  size_t pool_size() noexcept override {
+    auto candidates = std::atomic_load(&candidates_);
+    return candidates ? candidates->addresses.size() : 0;
+  }
+
 private:
   /** @brief Initializes
    *
@@ -147,8 +188,138 @@ private:
 
   /** @brief Whether we allow a read operations going to the primary (master) */
   bool allow_primary_reads_;
-  size_t current_pos_;
+
+  /** @brief Currently published candidates (use atomic load and store) */
+  std::shared_ptr<const Candidates> candidates_;
+
+  /** @brief Mutex serializing the update of candidates */
+  std::mutex mutex_candidates_;
 };
 
+/** @class DestFabricCacheShard
+ * @brief Routes connections to the HA group holding a shard
+ *
+ * The destination is given using a URI like:
+ *
+ *     fabric+cache://ham/shard/shop.orders?shard_key_attribute=customer
+ *
+ * The shard key is only known once the client sent its handshake
+ * response: it is taken from the connection attribute named by the
+ * `shard_key_attribute` query option (default "shard_key") or, when the
+ * attribute was not sent, from the initial schema. Clients send the value
+ * of the key; for HASH sharded tables it is hashed by the Fabric Cache.
+ *
+ * Connections are first made to the global group of the sharded table,
+ * which sends the greeting to the client. MySQLRouting then asks this
+ * destination for a server of the group holding the shard of the key.
+ */
+class DestFabricCacheShard final : public RouteDestination {
+public:
+  /** @brief Constructor */
+  DestFabricCacheShard(const string fabric_cache, const string table, routing::AccessMode mode, URIQuery query,
+                       routing::SocketOperationsBase *sock_ops = routing::SocketOperations::instance())
+      : RouteDestination(sock_ops),
+        cache_name(fabric_cache),
+        shard_table(table),
+        routing_mode(mode),
+        uri_query(query),
+        allow_primary_reads_(false),
+        shard_key_attribute_(kDefaultShardKeyAttribute),
+        last_pool_size_(0) {
+    init();
+  };
+
+  /** @brief Copy constructor */
+  DestFabricCacheShard(const DestFabricCacheShard &other) = delete;
+
+  /** @brief Copy assignment */
+  DestFabricCacheShard &operator=(const DestFabricCacheShard &) = delete;
+
+  /** @brief Returns socket descriptor of a server of the global group
+   *
+   * @param connect_timeout number of seconds waiting for connection
+   * @param error (out) errno of failed connection
+   * @param address (out) address of the server; can be nullptr
+   * @return a socket descriptor or -1 on errors
+   */
+  int get_server_socket(int connect_timeout, int *error, TCPAddress *address = nullptr) noexcept;
+
+  /** @brief Returns socket descriptor of a server holding the shard key
+   *
+   * @param shard_key the shard key sent by the client
+   * @param connect_timeout number of seconds waiting for connection
+   * @param error (out) errno of failed connection
+   * @param address (out) address of the server; can be nullptr
+   * @return a socket descriptor or -1 when no server is available
+   */
+  int get_server_socket_for_key(const string &shard_key, int connect_timeout, int *error,
+                                TCPAddress *address = nullptr) noexcept;
+
+  /** @brief Returns whether given server can handle the shard key
+   *
+   * @param shard_key the shard key sent by the client
+   * @param address server to check
+   * @return true when the server is a candidate for the shard key
+   */
+  bool is_shard_candidate(const string &shard_key, const TCPAddress &address) noexcept;
+
+  /** @brief Gets the shard key out of the client's handshake response
+   *
+   * @param response handshake response sent by the client
+   * @param shard_key (out) the shard key
+   * @return false when the client did not send a shard key
+   */
+  bool get_shard_key(const mysql_protocol::HandshakeResponsePacket &response, string *shard_key) const;
+
+  void add(const string &, uint16_t) { }
+
+  /** @brief Returns whether there are destination servers
+   *
+   * Always returns false; see DestFabricCacheGroup::empty().
+   *
+   * @return false
+   */
+  bool empty() const noexcept {
+    return false;
+  }
+
+  /** @brief The Fabric Cache to use */
+  const string cache_name;
+
+  /** @brief The sharded table as schema.table */
+  const string shard_table;
+
+  /** @brief Routing mode, usually set to read-only or read-write */
+  const routing::AccessMode routing_mode;
+
+  /** @brief Query part of the URI given as destination in the configuration */
+  const URIQuery uri_query;
+
+protected:
+  /** @brief Returns number of candidates found by the last shard lookup */
+  size_t pool_size() noexcept override {
+    return last_pool_size_.load(std::memory_order_relaxed);
+  }
+
+private:
+  /** @brief Initializes using the URI query */
+  void init();
+
+  /** @brief Returns the servers of the group holding the shard key
+   *
+   * @param shard_key the shard key
+   * @param resolved (out) socket address of each server; can be nullptr
+   */
+  std::vector<TCPAddress> get_shard_candidates(const string &shard_key, std::vector<string> *resolved = nullptr);
+
+  /** @brief Whether we allow a read operations going to the primary (master) */
+  bool allow_primary_reads_;
+
+  /** @brief Name of the connection attribute holding the shard key */
+  string shard_key_attribute_;
+
+  /** @brief Number of candidates found by the last shard lookup */
+  std::atomic<size_t> last_pool_size_;
+};
 
 #endif // ROUTING_DEST_FABRIC_CACHE_INCLUDED
@@ -24,7 +24,7 @@
 #  include <ws2tcpip.h>
 #endif
 
-int DestFirstAvailable::get_server_socket(int connect_timeout, int *error) noexcept {
+int DestFirstAvailable::get_server_socket(int connect_timeout, int *error, TCPAddress *address) noexcept {
   // Say for example, that we have three servers: A, B and C.
   // The active server should be failed-over in such fashion:
   //
@@ -39,10 +39,19 @@ int DestFirstAvailable::get_server_socket(int connect_timeout, int *error) noexc
   // We start the list at the currently available server
   for (size_t i = current_pos_; i < destinations_.size(); ++i) {
     auto addr = destinations_.at(i);
-    log_debug("Trying server %s (index %d)", addr.str().c_str(), i);
+    if (is_ejected(addr)) {
+      // Ejected servers are treated as unavailable
+      continue;
+    }
+    if (LOG_DEBUG_WRITTEN()) {
+      log_debug("Trying server %s (index %d)", addr.str().c_str(), i);
+    }
     auto sock = get_mysql_socket(addr, connect_timeout);
     if (sock != -1) {
       current_pos_ = i;
+      if (address) {
+        *address = addr;
+      }
       return sock;
     }
   }
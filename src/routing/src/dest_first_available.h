@@ -27,7 +27,7 @@ class DestFirstAvailable final : public RouteDestination {
  public:
   using RouteDestination::RouteDestination;
 
-  int get_server_socket(int connect_timeout, int *error) noexcept override;
+  int get_server_socket(int connect_timeout, int *error, TCPAddress *address = nullptr) noexcept override;
 };
 
 
@@ -50,11 +50,35 @@ static const int kTimeoutQuarantineConditional = 2;
 RouteDestination::~RouteDestination() {
 
   stopping_ = true;
+  if (executor_ != nullptr) {
+    executor_->cancel(quarantine_timer_);
+  }
   if (quarantine_thread_.joinable()) {
     quarantine_thread_.join();
   }
 }
 
+void RouteDestination::start(mysql_harness::Executor *executor) {
+  {
+    // Resolved before the first connections need them
+    std::lock_guard<std::mutex> lock(mutex_update_);
+    for (auto &dest: destinations_) {
+      socket_operations_->prefetch(dest);
+    }
+  }
+
+  if (executor_ != nullptr || quarantine_thread_.joinable()) {
+    LOG_DEBUG("Tried to restart quarantine thread");
+  } else if (executor != nullptr) {
+    executor_ = executor;
+    quarantine_timer_ = executor->schedule_every(
+        "routing", std::chrono::seconds(kQuarantineCleanupInterval),
+        [this] { cleanup_quarantine(); });
+  } else {
+    quarantine_thread_ = std::thread(&RouteDestination::quarantine_manager_thread, this);
+  }
+}
+
 void RouteDestination::add(const TCPAddress dest) {
   auto dest_end = destinations_.end();
 
@@ -103,12 +127,14 @@ void RouteDestination::clear() {
   destinations_.clear();
 }
 
-int RouteDestination::get_server_socket(int connect_timeout, int *error) noexcept {
+int RouteDestination::get_server_socket(int connect_timeout, int *error, TCPAddress *address) noexcept {
 
   if (destinations_.empty()) {
     return -1;  // no destination is available
   }
 
+  size_t ejected_skipped = 0;
+
   // We start the list at the currently available server
   for (size_t i = current_pos_;
        quarantined_.size() < destinations_.size() && i < destinations_.size();
@@ -125,12 +151,27 @@ int RouteDestination::get_server_socket(int connect_timeout, int *error) noexcep
     // Try server
     TCPAddress addr;
     addr = destinations_.at(i);
-    log_debug("Trying server %s (index %d)", addr.str().c_str(), i);
+
+    // If server is ejected as outlier, skip
+    if (is_ejected(addr)) {
+      if (++ejected_skipped >= destinations_.size()) {
+        LOG_DEBUG("No more destinations: all ejected or quarantined");
+        break;
+      }
+      continue;
+    }
+
+    if (LOG_DEBUG_WRITTEN()) {
+      log_debug("Trying server %s (index %d)", addr.str().c_str(), i);
+    }
     auto sock = get_mysql_socket(addr, connect_timeout);
 
     if (sock != -1) {
       // Server is available
       current_pos_ = (i + 1) % destinations_.size(); // Reset to 0 when current_pos_ == size()
+      if (address) {
+        *address = addr;
+      }
       return sock;
     } else {
 #ifndef _WIN32
@@ -143,7 +184,7 @@ int RouteDestination::get_server_socket(int connect_timeout, int *error) noexcep
         std::lock_guard<std::mutex> lock(mutex_quarantine_);
         add_to_quarantine(i);
         if (quarantined_.size() == destinations_.size()) {
-          log_debug("No more destinations: all quarantined");
+          LOG_DEBUG("No more destinations: all quarantined");
           break;
         }
         continue; // try another destination
@@ -160,14 +201,41 @@ int RouteDestination::get_mysql_socket(const TCPAddress &addr, const int connect
   return socket_operations_->get_mysql_socket(addr, connect_timeout, log_errors);
 }
 
+int RouteDestination::connect_round_robin(const std::vector<TCPAddress> &candidates, int connect_timeout,
+                                          TCPAddress *address, const std::vector<string> &resolved) noexcept {
+  if (candidates.empty()) {
+    return -1;
+  }
+
+  auto next_up = current_pos_.fetch_add(1, std::memory_order_relaxed) % candidates.size();
+
+  // Skip destinations ejected as outlier
+  for (size_t skipped = 0; is_ejected(candidates[next_up]); ++skipped) {
+    if (skipped + 1 == candidates.size()) {
+      LOG_DEBUG("No more destinations: all ejected");
+      return -1;
+    }
+    next_up = (next_up + 1) % candidates.size();
+  }
+
+  if (address) {
+    *address = candidates[next_up];
+  }
+  if (next_up < resolved.size() && !resolved[next_up].empty()) {
+    return socket_operations_->get_mysql_socket(candidates[next_up], resolved[next_up].data(),
+                                                resolved[next_up].size(), connect_timeout);
+  }
+  return get_mysql_socket(candidates[next_up], connect_timeout);
+}
+
 void RouteDestination::add_to_quarantine(const size_t index) noexcept {
   assert(index < size());
   if (index >= size()) {
-    log_debug("Impossible server being quarantined (index %d)", index);
+    LOG_DEBUG("Impossible server being quarantined (index %d)", index);
     return;
   }
   if (!is_quarantined(index)) {
-    log_debug("Quarantine destination server %s (index %d)", destinations_.at(index).str().c_str(), index);
+    LOG_DEBUG("Quarantine destination server %s (index %d)", destinations_.at(index).str().c_str(), index);
     quarantined_.push_back(index);
     condvar_quarantine_.notify_one();
   }
@@ -201,7 +269,7 @@ void RouteDestination::cleanup_quarantine() noexcept {
       shutdown(sock, SD_BOTH);
       closesocket(sock);
 #endif
-      log_debug("Unquarantine destination server %s (index %d)", addr.str().c_str(), *it);
+      LOG_DEBUG("Unquarantine destination server %s (index %d)", addr.str().c_str(), *it);
       std::lock_guard<std::mutex> lock(mutex_quarantine_);
       quarantined_.erase(std::remove(quarantined_.begin(), quarantined_.end(), *it));
     }
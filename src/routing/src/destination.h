@@ -31,6 +31,8 @@
 
 #include "mysqlrouter/datatypes.h"
 #include "mysqlrouter/routing.h"
+#include "outlier_detector.h"
+#include "executor.h"
 #include "logger.h"
 
 using mysqlrouter::TCPAddress;
@@ -115,11 +117,44 @@ public:
    * -1 when an error occurred, which means that no destination was
    * available.
    *
+   * When address is not nullptr, the address of the destination the
+   * socket is connected with is stored in it.
+   *
    * @param connect_timeout About of seconds before timing out
    * @param error Pointer to int for storing errno
+   * @param address Pointer to TCPAddress for storing the destination (can be nullptr)
    * @return a socket descriptor
    */
-  virtual int get_server_socket(int connect_timeout, int *error) noexcept;
+  virtual int get_server_socket(int connect_timeout, int *error, TCPAddress *address = nullptr) noexcept;
+
+  /** @brief Configures outlier detection
+   *
+   * @param settings settings of the outlier detection
+   */
+  void set_outlier_detection(const OutlierDetector::Settings &settings) {
+    outlier_detector_.set_settings(settings);
+  }
+
+  /** @brief Reports the outcome of a relayed session
+   *
+   * Reports whether the session relayed to given destination failed
+   * because of the destination. Destinations failing too often are
+   * ejected for a while (see OutlierDetector).
+   *
+   * @param address destination the session was relayed to
+   * @param failed whether the destination failed the session
+   */
+  void report_relay_result(const TCPAddress &address, bool failed) noexcept {
+    outlier_detector_.report(address, failed, pool_size());
+  }
+
+  /** @brief Returns number of ejected destinations
+   *
+   * @return size_t
+   */
+  size_t size_ejected() {
+    return outlier_detector_.size_ejected();
+  }
 
   /** @brief Gets the number of destinations
    *
@@ -145,14 +180,13 @@ public:
 
   /** @brief Start the destination threads
    *
+   * Quarantined servers are checked by a periodic task of the executor,
+   * when given, or else by a thread of their own. The addresses of the
+   * destinations are resolved in the background.
+   *
+   * @param executor executor of the harness, or nullptr
    */
-  virtual void start() {
-    if (!quarantine_thread_.joinable()) {
-      quarantine_thread_ = std::thread(&RouteDestination::quarantine_manager_thread, this);
-    } else {
-      log_debug("Tried to restart quarantine thread");
-    }
-  }
+  virtual void start(mysql_harness::Executor *executor = nullptr);
 
   AddrVector::iterator begin() {
     return destinations_.begin();
@@ -230,6 +264,42 @@ protected:
    */
   virtual int get_mysql_socket(const TCPAddress &addr, int connect_timeout, bool log_errors = true);
 
+  /** @brief Connects to the next of the given candidates
+   *
+   * Picks the candidate using round-robin, skipping candidates ejected by
+   * outlier detection, and returns a socket descriptor of the connection
+   * or -1 when no candidate is available or connecting failed.
+   *
+   * When the socket address of the candidate was resolved before, it is
+   * used instead of resolving the address of the candidate again.
+   *
+   * @param candidates destinations to choose from
+   * @param connect_timeout number of seconds waiting for connection
+   * @param address (out) address of the candidate; can be nullptr
+   * @param resolved raw `struct sockaddr` of each candidate, empty when not
+   *                 resolved; can be empty
+   * @return a socket descriptor
+   */
+  int connect_round_robin(const std::vector<TCPAddress> &candidates, int connect_timeout,
+                          TCPAddress *address, const std::vector<string> &resolved = {}) noexcept;
+
+  /** @brief Returns whether destination is ejected by outlier detection
+   *
+   * @param addr destination to check
+   * @return True if destination is ejected
+   */
+  bool is_ejected(const TCPAddress &addr) noexcept {
+    return outlier_detector_.is_ejected(addr);
+  }
+
+  /** @brief Returns the number of destinations outliers are ejected from
+   *
+   * @return size_t
+   */
+  virtual size_t pool_size() noexcept {
+    return destinations_.size();
+  }
+
   /** @brief List of destinations */
   AddrVector destinations_;
 
@@ -257,6 +327,15 @@ protected:
   /** @brief Quarantine manager thread */
   std::thread quarantine_thread_;
 
+  /** @brief Executor running the quarantine check, if any */
+  mysql_harness::Executor *executor_ = nullptr;
+
+  /** @brief Timer of the quarantine check on `executor_` */
+  mysql_harness::Executor::TimerId quarantine_timer_ = 0;
+
+  /** @brief Ejects destinations failing sessions in-band */
+  OutlierDetector outlier_detector_;
+
   /** @brief socket operation methods (facilitates dependency injection)*/
   routing::SocketOperationsBase *socket_operations_;
 };
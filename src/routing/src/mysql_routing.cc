@@ -68,6 +68,16 @@ using routing::SocketOperationsBase;
 using mysqlrouter::URI;
 using mysqlrouter::URIError;
 using mysqlrouter::URIQuery;
+using mysql_harness::TimerWheel;
+
+/** @brief Warnings per second logged for rejected clients, per message */
+static const unsigned int kLogRatePerSecond = 1;
+
+/** @brief Warnings logged at once for rejected clients, per message */
+static const unsigned int kLogRateBurst = 5;
+
+/** @brief Precision of the timeouts of sessions */
+static const std::chrono::milliseconds kTimerWheelTick(100);
 
 
 MySQLRouting::MySQLRouting(routing::AccessMode mode, uint16_t port, const string &bind_address,
@@ -89,6 +99,7 @@ MySQLRouting::MySQLRouting(routing::AccessMode mode, uint16_t port, const string
       stopping_(false),
       info_active_routes_(0),
       info_handled_routes_(0),
+      timer_wheel_(kTimerWheelTick),
       socket_operations_(socket_operations) {
 
   assert(socket_operations_ != nullptr);
@@ -101,7 +112,8 @@ MySQLRouting::MySQLRouting(routing::AccessMode mode, uint16_t port, const string
 int MySQLRouting::copy_mysql_protocol_packets(int sender, int receiver, fd_set *readfds,
                                 mysql_protocol::Packet::vector_t &buffer, int *curr_pktnr,
                                 bool handshake_done, size_t *report_bytes_read,
-                                SocketOperationsBase *socket_operations) {
+                                SocketOperationsBase *socket_operations,
+                                unsigned short *handshake_error_code) {
   assert(curr_pktnr);
   assert(report_bytes_read);
   ssize_t res = 0;
@@ -117,7 +129,7 @@ int MySQLRouting::copy_mysql_protocol_packets(int sender, int receiver, fd_set *
   if (FD_ISSET(sender, readfds)) {
     if ((res = socket_operations->read(sender, &buffer.front(), buffer_length)) <= 0) {
       if (res == -1) {
-        log_debug("sender read failed: (%d %s)", errno, get_message_error(errno).c_str());
+        LOG_DEBUG("sender read failed: (%d %s)", errno, get_message_error(errno).c_str());
       }
       return -1;
     }
@@ -137,7 +149,7 @@ int MySQLRouting::copy_mysql_protocol_packets(int sender, int receiver, fd_set *
       }
       pktnr = buffer[3];
       if (*curr_pktnr > 0 && pktnr != *curr_pktnr + 1) {
-        log_debug("Received incorrect packet number; aborting (was %d)", pktnr);
+        LOG_DEBUG("Received incorrect packet number; aborting (was %d)", pktnr);
         return -1;
       }
 
@@ -145,8 +157,11 @@ int MySQLRouting::copy_mysql_protocol_packets(int sender, int receiver, fd_set *
         // We got error from MySQL Server while handshaking
         // We do not consider this a failed handshake
         auto server_error = mysql_protocol::ErrorPacket(buffer);
+        if (handshake_error_code) {
+          *handshake_error_code = server_error.get_code();
+        }
         if (socket_operations->write_all(receiver, server_error.data(), server_error.size()) ) {
-          log_debug("Write error: %s", get_message_error(errno).c_str());
+          LOG_DEBUG("Write error: %s", get_message_error(errno).c_str());
         }
         // receiver socket closed by caller
         *curr_pktnr = 2; // we assume handshaking is done though there was an error
@@ -162,7 +177,7 @@ int MySQLRouting::copy_mysql_protocol_packets(int sender, int receiver, fd_set *
           auto pkt = mysql_protocol::Packet(buffer);
           capabilities = pkt.get_int<uint32_t>(4);
         } catch (const mysql_protocol::packet_error &exc) {
-          log_debug(exc.what());
+          LOG_DEBUG("%s", exc.what());
           return -1;
         }
         if (capabilities & mysql_protocol::kClientSSL) {
@@ -172,7 +187,9 @@ int MySQLRouting::copy_mysql_protocol_packets(int sender, int receiver, fd_set *
     }
 
     if (socket_operations->write_all(receiver, &buffer[0], bytes_read) < 0) {
-      log_debug("Write error: %s", get_message_error(errno).c_str());
+      LOG_DEBUG("Write error: %s", get_message_error(errno).c_str());
+      // bytes read are reported so caller knows the receiver failed
+      *report_bytes_read = bytes_read;
       return -1;
     }
   }
@@ -183,29 +200,177 @@ int MySQLRouting::copy_mysql_protocol_packets(int sender, int receiver, fd_set *
   return 0;
 }
 
+bool MySQLRouting::is_destination_error(unsigned short code) noexcept {
+  switch (code) {
+    case 1044:  // ER_DBACCESS_DENIED_ERROR
+    case 1045:  // ER_ACCESS_DENIED_ERROR
+    case 1049:  // ER_BAD_DB_ERROR
+    case 1251:  // ER_NOT_SUPPORTED_AUTH_MODE
+    case 1698:  // ER_ACCESS_DENIED_NO_PASSWORD_ERROR
+    case 1862:  // ER_MUST_CHANGE_PASSWORD_LOGIN
+      // Caused by the client; the server is doing fine
+      return false;
+    default:
+      return true;
+  }
+}
+
 bool MySQLRouting::block_client_host(const std::array<uint8_t, 16> &client_ip_array,
                                      const string &client_ip_str, int server) {
   bool blocked = false;
   std::lock_guard<std::mutex> lock(mutex_auth_errors_);
 
   if (++auth_error_counters_[client_ip_array] >= max_connect_errors_) {
-    log_warning("[%s] blocking client host %s", name.c_str(), client_ip_str.c_str());
+    LogField fields[] = {{"route", name.c_str()}, {"client", client_ip_str.c_str()}};
+    LOG_FIELDS(LOG_LEVEL_WARNING, fields, "[%s] blocking client host %s", name.c_str(), client_ip_str.c_str());
     blocked = true;
   } else {
     log_info("[%s] %d authentication errors for %s (max %u)",
-             name.c_str(), auth_error_counters_[client_ip_array], client_ip_str.c_str(), max_connect_errors_);
+             name.c_str(), auth_error_counters_[client_ip_array], client_ip_str.c_str(), max_connect_errors_.load());
   }
 
   if (server >= 0) {
     auto fake_response = mysql_protocol::HandshakeResponsePacket(1, {}, "ROUTER", "", "fake_router_login");
     if (socket_operations_->write_all(server, fake_response.data(), fake_response.size()) < 0) {
-      log_debug("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
+      LOG_DEBUG("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
     }
   }
 
   return blocked;
 }
 
+/** @brief Authentication plugin name forcing the server to switch authentication
+ *
+ * No server knows this plugin; the server replies with an authentication
+ * method switch request containing its own scramble.
+ */
+static const char *const kShardRoutingAuthPlugin = "mysqlrouter_shard_routing";
+
+bool MySQLRouting::route_by_shard_key(DestFabricCacheShard *destination, int client, int *server,
+                                      TCPAddress *server_addr, mysql_protocol::Packet::vector_t &buffer,
+                                      int *curr_pktnr, size_t *report_bytes_read) noexcept {
+  auto res = socket_operations_->read(client, &buffer.front(), buffer.size());
+  if (res < static_cast<ssize_t>(mysql_protocol::Packet::kHeaderSize) + 4) {
+    return false;
+  }
+  auto bytes_read = static_cast<size_t>(res);
+  *report_bytes_read = bytes_read;
+  if (buffer[3] != 1) {
+    LOG_DEBUG("Received incorrect packet number; aborting (was %d)", buffer[3]);
+    return false;
+  }
+
+  auto forward = [&](int pktnr) {
+    if (socket_operations_->write_all(*server, &buffer[0], bytes_read) < 0) {
+      LOG_DEBUG("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
+      return false;
+    }
+    *curr_pktnr = pktnr;
+    return true;
+  };
+
+  mysql_protocol::Packet::vector_t packet(buffer.begin(), buffer.begin() + static_cast<long>(bytes_read));
+  uint32_t capabilities = mysql_protocol::Packet(packet, true).get_int<uint32_t>(4);
+  if (capabilities & mysql_protocol::kClientSSL) {
+    // We can not read the handshake response; stay with the global group
+    return forward(2);
+  }
+
+  std::unique_ptr<mysql_protocol::HandshakeResponsePacket> response;
+  string shard_key;
+  try {
+    response.reset(new mysql_protocol::HandshakeResponsePacket(packet));
+  } catch (const mysql_protocol::packet_error &exc) {
+    LOG_DEBUG("[%s] %s", name.c_str(), exc.what());
+    return forward(1);
+  }
+  if (!destination->get_shard_key(*response, &shard_key) ||
+      destination->is_shard_candidate(shard_key, *server_addr)) {
+    return forward(1);
+  }
+
+  auto send_error = [&](unsigned short code, const string &message) {
+    auto error = mysql_protocol::ErrorPacket(2, code, message, "HY000", capabilities);
+    if (socket_operations_->write_all(client, error.data(), error.size()) < 0) {
+      LOG_DEBUG("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
+    }
+  };
+
+  if (!(capabilities & mysql_protocol::kClientPluginAuth)) {
+    log_warning("[%s] client does not support authentication plugins; can not route shard key",
+                name.c_str());
+    send_error(1251, "Client does not support authentication protocol requested by server");
+    return false;
+  }
+
+  int error = 0;
+  TCPAddress shard_addr;
+  int shard_server = destination->get_server_socket_for_key(shard_key, destination_connect_timeout_, &error,
+                                                            &shard_addr);
+  if (shard_server < 0) {
+    log_warning("[%s] no server available for shard key of table %s", name.c_str(),
+                destination->shard_table.c_str());
+    send_error(2003, "Can't connect to MySQL server");
+    return false;
+  }
+
+  // The greeting of the shard server is not used; the client authenticates
+  // using the scramble the server sends with the authentication switch
+  fd_set readfds;
+  FD_ZERO(&readfds);
+  FD_SET(shard_server, &readfds);
+  struct timeval timeout_val;
+  timeout_val.tv_sec = destination_connect_timeout_;
+  timeout_val.tv_usec = 0;
+  res = -1;
+  if (select(shard_server + 1, &readfds, nullptr, nullptr, &timeout_val) > 0) {
+    res = socket_operations_->read(shard_server, &buffer.front(), buffer.size());
+  }
+  if (res < static_cast<ssize_t>(mysql_protocol::Packet::kHeaderSize) + 1 || buffer[4] == 0xff) {
+    log_warning("[%s] failed greeting from shard server %s", name.c_str(), shard_addr.str().c_str());
+    destination->report_relay_result(shard_addr, true);
+    send_error(2013, "Lost connection to MySQL server during query");
+    socket_operations_->shutdown(shard_server);
+    socket_operations_->close(shard_server);
+    return false;
+  }
+
+  try {
+    response->set_auth_plugin(kShardRoutingAuthPlugin);
+  } catch (const mysql_protocol::packet_error &exc) {
+    LOG_DEBUG("[%s] %s", name.c_str(), exc.what());
+    send_error(1251, "Client does not support authentication protocol requested by server");
+    socket_operations_->shutdown(shard_server);
+    socket_operations_->close(shard_server);
+    return false;
+  }
+  if (socket_operations_->write_all(shard_server, response->data(), response->size()) < 0) {
+    LOG_DEBUG("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
+    socket_operations_->shutdown(shard_server);
+    socket_operations_->close(shard_server);
+    return false;
+  }
+
+  // Finish the handshake with the global group so it does not count
+  // as a connection error
+  auto fake_response = mysql_protocol::HandshakeResponsePacket(1, {}, "ROUTER", "", "fake_router_login");
+  if (socket_operations_->write_all(*server, fake_response.data(), fake_response.size()) < 0) {
+    LOG_DEBUG("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
+  }
+  socket_operations_->shutdown(*server);
+  socket_operations_->close(*server);
+
+  if (LOG_DEBUG_WRITTEN()) {
+    auto shard_str = shard_addr.str();
+    LogField fields[] = {{"route", name.c_str()}, {"destination", shard_str.c_str()}};
+    LOG_FIELDS(LOG_LEVEL_DEBUG, fields, "[%s] shard key routed to %s", name.c_str(), shard_str.c_str());
+  }
+  *server = shard_server;
+  *server_addr = shard_addr;
+  *curr_pktnr = 1;
+  return true;
+}
+
 void MySQLRouting::routing_select_thread(int client, const in6_addr client_addr) noexcept {
   int nfds;
   int res;
@@ -216,13 +381,21 @@ void MySQLRouting::routing_select_thread(int client, const in6_addr client_addr)
   string extra_msg = "";
   mysql_protocol::Packet::vector_t buffer(net_buffer_length_);
   bool handshake_done = false;
+  unsigned short handshake_error_code = 0;
+  bool server_failed = false;
+  TCPAddress server_addr;
+  // Kept for the whole session, as the destinations can be replaced
+  auto destination = std::atomic_load(&destination_);
+  auto shard_destination = dynamic_cast<DestFabricCacheShard*>(destination.get());
 
-  int server = destination_->get_server_socket(destination_connect_timeout_, &error);
+  int server = destination->get_server_socket(destination_connect_timeout_, &error, &server_addr);
 
   if (!(server > 0 && client > 0)) {
     std::stringstream os;
     os << "Can't connect to MySQL server";
-    log_warning("[%s] %s", name.c_str(), os.str().c_str());
+    LogField fields[] = {{"route", name.c_str()}};
+    LOG_FIELDS_RATE_LIMITED(LOG_LEVEL_WARNING, kLogRatePerSecond, kLogRateBurst, fields,
+                            "[%s] %s", name.c_str(), os.str().c_str());
 
     auto server_error = mysql_protocol::ErrorPacket(0, 2003, os.str(), "HY000");
     // at this point, it does not matter whether client gets the error
@@ -231,7 +404,7 @@ void MySQLRouting::routing_select_thread(int client, const in6_addr client_addr)
     WSASetLastError(0);
 #endif
     if (socket_operations_->write_all(client, server_error.data(), server_error.size()) < 0) {
-      log_debug("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
+      LOG_DEBUG("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
     }
 
     socket_operations_->shutdown(client);
@@ -243,16 +416,75 @@ void MySQLRouting::routing_select_thread(int client, const in6_addr client_addr)
     if (server > 0) {
       socket_operations_->close(server);
     }
+    end_route();
     return;
   }
 
-  auto c_ip = get_peer_name(client);
-  auto s_ip = get_peer_name(server);
-
-  log_debug("[%s] [%s]:%d - [%s]:%d", name.c_str(), c_ip.first.c_str(), c_ip.second,
-            s_ip.first.c_str(), s_ip.second);
+  if (LOG_DEBUG_WRITTEN()) {
+    auto c_ip = get_peer_name(client);
+    auto s_ip = get_peer_name(server);
+    auto client_str = "[" + c_ip.first + "]:" + std::to_string(c_ip.second);
+    auto server_str = "[" + s_ip.first + "]:" + std::to_string(s_ip.second);
+    LogField fields[] = {{"route", name.c_str()}, {"client", client_str.c_str()},
+                         {"destination", server_str.c_str()}};
+    LOG_FIELDS(LOG_LEVEL_DEBUG, fields, "[%s] %s - %s", name.c_str(), client_str.c_str(), server_str.c_str());
+  }
   ++info_handled_routes_;
 
+  // Timeouts end the session by shutting down the client socket, which
+  // makes select() return and reading from the client fail. The timers
+  // capture only a pointer to the session, which std::function stores
+  // without allocating.
+  struct Session {
+    Session(MySQLRouting *owner, int client_socket)
+        : routing(owner), client(client_socket),
+          wait_timeout(owner->wait_timeout_.load()),
+          max_session_lifetime(owner->max_session_lifetime_.load()),
+          last_activity(owner->timer_wheel_.now()) {}
+
+    void expire(const char *reason) {
+      timeout_reason = reason;
+      routing->socket_operations_->shutdown(client);
+    }
+
+    void check_idle() {
+      if (wait_timeout == std::chrono::seconds::zero()) {
+        return;
+      }
+      auto idle = routing->timer_wheel_.now() - last_activity.load(std::memory_order_relaxed);
+      if (idle >= wait_timeout) {
+        expire("Wait timeout reached");
+      } else {
+        routing->timer_wheel_.arm(&idle_timer, wait_timeout - idle);
+      }
+    }
+
+    MySQLRouting *const routing;
+    const int client;
+    // Timeouts changed by a reload apply to the sessions started after it
+    const std::chrono::seconds wait_timeout;
+    const std::chrono::seconds max_session_lifetime;
+    std::atomic<const char*> timeout_reason{nullptr};
+    // Idle sessions are measured lazily, to leave the idle timer alone on
+    // each packet
+    std::atomic<TimerWheel::Clock::time_point> last_activity;
+    TimerWheel::Timer handshake_timer{[this] { expire("Handshake timed out"); }};
+    TimerWheel::Timer idle_timer{[this] { check_idle(); }};
+    TimerWheel::Timer lifetime_timer{[this] { expire("Maximum session lifetime reached"); }};
+  } session(this, client);
+
+  timer_wheel_.arm(&session.handshake_timer, std::chrono::seconds(client_connect_timeout_));
+  if (session.max_session_lifetime > std::chrono::seconds::zero()) {
+    timer_wheel_.arm(&session.lifetime_timer, session.max_session_lifetime);
+  }
+  auto complete_handshake = [&] {
+    handshake_done = true;
+    timer_wheel_.cancel(&session.handshake_timer);
+    if (session.wait_timeout > std::chrono::seconds::zero()) {
+      timer_wheel_.arm(&session.idle_timer, session.wait_timeout);
+    }
+  };
+
   nfds = std::max(client, server) + 1;
 
   int pktnr = 0;
@@ -265,20 +497,10 @@ void MySQLRouting::routing_select_thread(int client, const in6_addr client_addr)
     FD_SET(client, &readfds);
     FD_SET(server, &readfds);
 
-    if (handshake_done) {
-      res = select(nfds, &readfds, nullptr, &errfds, nullptr);
-    } else {
-      // Handshake reply timeout
-      struct timeval timeout_val;
-      timeout_val.tv_sec = client_connect_timeout_;
-      timeout_val.tv_usec = 0;
-      res = select(nfds, &readfds, nullptr, &errfds, &timeout_val);
-    }
+    res = select(nfds, &readfds, nullptr, &errfds, nullptr);
 
     if (res <= 0) {
-      if (res == 0) {
-        extra_msg = string("Select timed out");
-      } else if (errno > 0) {
+      if (errno > 0) {
         extra_msg = string("Select failed with error: " + to_string(strerror(errno)));
 #ifdef _WIN32
       } else if (WSAGetLastError() > 0) {
@@ -290,30 +512,50 @@ void MySQLRouting::routing_select_thread(int client, const in6_addr client_addr)
 
       break;
     }
+    session.last_activity.store(timer_wheel_.now(), std::memory_order_relaxed);
 
     if (!handshake_done && pktnr == 2) {
-      handshake_done = true;
+      complete_handshake();
     }
 
     // Handle traffic from Server to Client
     // Note: Server _always_ talks first
+    bytes_read = 0;
     if (copy_mysql_protocol_packets(server, client,
                                     &readfds, buffer, &pktnr,
                                     handshake_done, &bytes_read,
-                                    socket_operations_) == -1) {
+                                    socket_operations_, &handshake_error_code) == -1) {
 #ifndef _WIN32
       if (errno > 0) {
 #else
 	  if (errno > 0 || WSAGetLastError() != 0) {
 #endif
         extra_msg = string("Copy server-client failed: " + to_string(get_message_error(errno)));
+        // Nothing read means the server reset or otherwise broke the session
+        server_failed = (bytes_read == 0);
       }
       break;
     }
     bytes_up += bytes_read;
 
+    if (handshake_error_code > 0 && is_destination_error(handshake_error_code)) {
+      server_failed = true;
+    }
+
     if (!handshake_done && pktnr == 2) {
-      handshake_done = true;
+      complete_handshake();
+    }
+
+    // The handshake response decides which shard server is used
+    if (shard_destination && !handshake_done && pktnr == 0 && bytes_up > 0 && FD_ISSET(client, &readfds)) {
+      bytes_read = 0;
+      if (!route_by_shard_key(shard_destination, client, &server, &server_addr, buffer, &pktnr, &bytes_read)) {
+        extra_msg = string("Routing by shard key failed");
+        break;
+      }
+      bytes_down += bytes_read;
+      nfds = std::max(client, server) + 1;
+      continue;
     }
 
     // Handle traffic from Client to Server
@@ -327,10 +569,31 @@ void MySQLRouting::routing_select_thread(int client, const in6_addr client_addr)
 
   } // while (true)
 
+  // No timer may shut down the sockets once closed, as their descriptors
+  // can be reused
+  timer_wheel_.cancel(&session.handshake_timer);
+  timer_wheel_.cancel(&session.idle_timer);
+  timer_wheel_.cancel(&session.lifetime_timer);
+  if (session.timeout_reason.load() != nullptr) {
+    extra_msg = string(session.timeout_reason.load());
+  }
+
+  if (server_failed || handshake_done) {
+    destination->report_relay_result(server_addr, server_failed);
+  }
+
   if (!handshake_done) {
+    // The client socket might be shut down already; the name is taken
+    // from the address accepted
     auto ip_array = in6_addr_to_array(client_addr);
-    log_debug("[%s] Routing failed for %s: %s", name.c_str(), c_ip.first.c_str(), extra_msg.c_str());
-    block_client_host(ip_array, c_ip.first.c_str(), server);
+    char client_ip[INET6_ADDRSTRLEN] = "";
+    inet_ntop(AF_INET6, &client_addr, client_ip, static_cast<socklen_t>(sizeof(client_ip)));
+    if (LOG_DEBUG_ENABLED()) {
+      LogField fields[] = {{"route", name.c_str()}, {"client", client_ip}};
+      LOG_FIELDS(LOG_LEVEL_DEBUG, fields, "[%s] Routing failed for %s: %s", name.c_str(), client_ip,
+                 extra_msg.c_str());
+    }
+    block_client_host(ip_array, client_ip, server);
   }
 
   // Either client or server terminated
@@ -339,12 +602,19 @@ void MySQLRouting::routing_select_thread(int client, const in6_addr client_addr)
   socket_operations_->close(client);
   socket_operations_->close(server);
 
-  --info_active_routes_;
 #ifndef _WIN32
-  log_debug("[%s] Routing stopped (up:%zub;down:%zub) %s", name.c_str(), bytes_up, bytes_down, extra_msg.c_str());
+  LOG_DEBUG("[%s] Routing stopped (up:%zub;down:%zub) %s", name.c_str(), bytes_up, bytes_down, extra_msg.c_str());
 #else
-  log_debug("[%s] Routing stopped (up:%Iub;down:%Iub) %s", name.c_str(), bytes_up, bytes_down, extra_msg.c_str());
+  LOG_DEBUG("[%s] Routing stopped (up:%Iub;down:%Iub) %s", name.c_str(), bytes_up, bytes_down, extra_msg.c_str());
 #endif
+  end_route();
+}
+
+void MySQLRouting::end_route() noexcept {
+  std::lock_guard<std::mutex> lock(mutex_active_routes_);
+  if (--info_active_routes_ == 0) {
+    cond_active_routes_.notify_all();
+  }
 }
 
 void MySQLRouting::start() {
@@ -355,6 +625,10 @@ void MySQLRouting::start() {
   int opt_nodelay = 1;
 
   try {
+    std::lock_guard<std::mutex> lock(mutex_server_);
+    if (stopping()) {
+      return;
+    }
     setup_service();
   } catch (const runtime_error &exc) {
     throw runtime_error(
@@ -364,13 +638,38 @@ void MySQLRouting::start() {
   log_info("[%s] listening on %s; %s", name.c_str(), bind_address_.str().c_str(),
            routing::get_access_mode_name(mode_).c_str());
 
-  destination_->start();
+  {
+    std::lock_guard<std::mutex> lock(mutex_destination_);
+    destination_->set_outlier_detection(outlier_settings_);
+    destination_->start(executor_);
+    destination_started_ = true;
+  }
+
+  // Timeouts of sessions expire on the ticks of the wheel, until the
+  // last session ended
+  mysql_harness::Executor::TimerId wheel_timer = 0;
+  std::thread wheel_thread;
+  std::atomic<bool> wheel_running{true};
+  if (executor_ != nullptr) {
+    wheel_timer = executor_->schedule_every("routing", kTimerWheelTick,
+                                            [this] { timer_wheel_.advance(); });
+  } else {
+    wheel_thread = std::thread([this, &wheel_running] {
+      while (wheel_running) {
+        std::this_thread::sleep_for(kTimerWheelTick);
+        timer_wheel_.advance();
+      }
+    });
+  }
 
   auto error_1041 = mysql_protocol::ErrorPacket(
       0, 1041, "Out of resources (please check logs)", "HY000");
 
   while (!stopping()) {
     if ((sock_client = accept(sock_server_, (struct sockaddr *) &client_addr, &sin_size)) < 0) {
+      if (stopping()) {
+        break;  // woken up by stop()
+      }
       log_error("[%s] Failed opening socket: %s", name.c_str(), get_message_error(errno).c_str());
       continue;
     }
@@ -386,7 +685,7 @@ void MySQLRouting::start() {
       auto server_error = mysql_protocol::ErrorPacket(0, 1129, os.str(), "HY000");
       errno = 0;
       if (socket_operations_->write_all(sock_client, server_error.data(), server_error.size()) < 0) {
-        log_debug("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
+        LOG_DEBUG("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
       }
       socket_operations_->close(sock_client); // no shutdown() before close()
       continue;
@@ -395,10 +694,12 @@ void MySQLRouting::start() {
     if (info_active_routes_.load(std::memory_order_relaxed) >= max_connections_) {
       auto server_error = mysql_protocol::ErrorPacket(0, 1040, "Too many connections", "HY000");
       if (socket_operations_->write_all(sock_client, server_error.data(), server_error.size()) < 0) {
-        log_debug("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
+        LOG_DEBUG("[%s] write error: %s", name.c_str(), get_message_error(errno).c_str());
       }
       socket_operations_->close(sock_client); // no shutdown() before close()
-      log_warning("[%s] reached max active connections (%d)", name.c_str(), max_connections_);
+      LogField fields[] = {{"route", name.c_str()}};
+      LOG_FIELDS_RATE_LIMITED(LOG_LEVEL_WARNING, kLogRatePerSecond, kLogRateBurst, fields,
+                              "[%s] reached max active connections (%d)", name.c_str(), max_connections_.load());
       continue;
     }
 
@@ -411,12 +712,39 @@ void MySQLRouting::start() {
     std::thread(&MySQLRouting::routing_select_thread, this, sock_client, client_addr.sin6_addr).detach();
   } // while (!stopping())
 
+  {
+    std::lock_guard<std::mutex> lock(mutex_server_);
+    socket_operations_->close(sock_server_);
+    sock_server_ = -1;
+  }
+  cond_server_.notify_all();
+
+  // Connections use this object until they end
+  {
+    std::unique_lock<std::mutex> lock(mutex_active_routes_);
+    cond_active_routes_.wait(lock, [this] { return info_active_routes_ == 0; });
+  }
+
+  if (executor_ != nullptr) {
+    executor_->cancel(wheel_timer);
+  } else {
+    wheel_running = false;
+    wheel_thread.join();
+  }
 
   log_info("[%s] stopped", name.c_str());
 }
 
 void MySQLRouting::stop() {
   stopping_.store(true);
+
+  // Wakes up accept() and waits for the socket to be closed, so that
+  // the address can be bound again right away
+  std::unique_lock<std::mutex> lock(mutex_server_);
+  if (sock_server_ >= 0) {
+    socket_operations_->shutdown(sock_server_);
+    cond_server_.wait(lock, [this] { return sock_server_ < 0; });
+  }
 }
 
 void MySQLRouting::setup_service() {
@@ -447,7 +775,10 @@ void MySQLRouting::setup_service() {
     option_value = 1;
     if (setsockopt(sock_server_, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&option_value),
             static_cast<socklen_t>(sizeof(int))) == -1) {
-      throw std::runtime_error(get_message_error(errno));
+      int errcode = errno;
+      socket_operations_->close(sock_server_);
+      sock_server_ = -1;
+      throw std::runtime_error(get_message_error(errcode));
     }
 #endif
 
@@ -458,6 +789,7 @@ void MySQLRouting::setup_service() {
       int errcode = errno;
 #endif
       socket_operations_->close(sock_server_);
+      sock_server_ = -1;
       throw std::runtime_error(get_message_error(errcode));
     }
     break;
@@ -469,6 +801,8 @@ void MySQLRouting::setup_service() {
   }
 
   if (listen(sock_server_, 20) < 0) {
+    socket_operations_->close(sock_server_);
+    sock_server_ = -1;
     throw runtime_error(string_format("[%s] Failed to start listening for connections", name.c_str()));
   }
 }
@@ -481,7 +815,15 @@ void MySQLRouting::set_destinations_from_uri(const URI &uri) {
       if (!fabric_cache::have_cache(uri.host)) {
         throw runtime_error("Invalid Fabric Cache in URI; was '" + uri.host + "'");
       }
-      destination_.reset(new DestFabricCacheGroup(uri.host, uri.path[1], mode_, uri.query));
+      replace_destination(std::make_shared<DestFabricCacheGroup>(uri.host, uri.path[1], mode_, uri.query));
+    } else if (fabric_cmd == "shard") {
+      if (!fabric_cache::have_cache(uri.host)) {
+        throw runtime_error("Invalid Fabric Cache in URI; was '" + uri.host + "'");
+      }
+      if (uri.path.size() < 2 || uri.path[1].find('.') == string::npos) {
+        throw runtime_error("Invalid sharded table in URI; must be schema.table");
+      }
+      replace_destination(std::make_shared<DestFabricCacheShard>(uri.host, uri.path[1], mode_, uri.query));
     } else {
       throw runtime_error("Invalid Fabric command in URI; was '" + fabric_cmd + "'");
     }
@@ -494,11 +836,12 @@ void MySQLRouting::set_destinations_from_csv(const string &csv) {
   std::stringstream ss(csv);
   std::string part;
   std::pair<std::string, uint16_t> info;
+  std::shared_ptr<RouteDestination> destination;
 
   if (AccessMode::kReadOnly == mode_) {
-    destination_.reset(new RouteDestination());
+    destination = std::make_shared<RouteDestination>();
   } else if (AccessMode::kReadWrite == mode_) {
-    destination_.reset(new DestFirstAvailable());
+    destination = std::make_shared<DestFirstAvailable>();
   } else {
     throw std::runtime_error("Unknown mode");
   }
@@ -510,22 +853,33 @@ void MySQLRouting::set_destinations_from_csv(const string &csv) {
     }
     TCPAddress addr(info.first, info.second);
     if (addr.is_valid()) {
-      destination_->add(addr);
+      destination->add(addr);
     } else {
       throw std::runtime_error(string_format("Destination address '%s' is invalid", addr.str().c_str()));
     }
   }
 
   // Check whether bind address is part of list of destinations
-  for (auto &it: *destination_) {
+  for (auto &it: *destination) {
     if (it == bind_address_) {
       throw std::runtime_error("Bind Address can not be part of destinations");
     }
   }
 
-  if (destination_->size() == 0) {
+  if (destination->size() == 0) {
     throw std::runtime_error("No destinations available");
   }
+  replace_destination(destination);
+}
+
+void MySQLRouting::replace_destination(std::shared_ptr<RouteDestination> destination) {
+  std::lock_guard<std::mutex> lock(mutex_destination_);
+  if (destination_started_) {
+    destination->set_outlier_detection(outlier_settings_);
+    destination->start(executor_);
+  }
+  // The previous destinations are destroyed with their last connection
+  std::atomic_store(&destination_, std::move(destination));
 }
 
 int MySQLRouting::set_destination_connect_timeout(int seconds) {
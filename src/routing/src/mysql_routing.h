@@ -32,14 +32,17 @@
 #include "mysqlrouter/datatypes.h"
 #include "mysqlrouter/mysql_protocol.h"
 #include "plugin_config.h"
+#include "timer_wheel.h"
 #include "utils.h"
 #include "mysqlrouter/routing.h"
 
 #include <array>
 #include <atomic>
+#include <condition_variable>
 #include <iostream>
 #include <map>
 #include <memory>
+#include <mutex>
 
 #ifndef _WIN32
 #  include <arpa/inet.h>
@@ -73,6 +76,8 @@
 using std::string;
 using mysqlrouter::URI;
 
+class DestFabricCacheShard;
+
 /** @class MySQLRoutering
  *  @brief Manage Connections from clients to MySQL servers
  *
@@ -130,7 +135,8 @@ public:
    *
    * Starts the connection routing service and start accepting incoming
    * MySQL client connections. Each connection will be further handled
-   * in a separate thread.
+   * in a separate thread. Returns when the service was stopped and all
+   * its connections ended.
    *
    * Throws std::runtime_error on errors.
    *
@@ -139,6 +145,8 @@ public:
 
   /** @brief Asks the service to stop
    *
+   * Stops accepting connections and returns once the service closed
+   * its socket. start() returns once the active connections ended.
    */
   void stop();
 
@@ -160,6 +168,10 @@ public:
    * Example of destinations:
    *   "10.0.10.5,10.0.11.6:3307"
    *
+   * When the service is running, the destinations are replaced: new
+   * connections use the new destinations, while active connections stay
+   * with their server.
+   *
    * @param csv destinations as comma-separated-values
    */
   void set_destinations_from_csv(const string &csv);
@@ -234,7 +246,25 @@ public:
    * @return Maximum as int
    */
   int get_max_connections() const noexcept {
-    return max_connections_;
+    return max_connections_.load();
+  }
+
+  /** @brief Sets maximum connect or handshake errors per host
+   *
+   * @param maximum Max number of errors before a host is blocked
+   */
+  void set_max_connect_errors(unsigned long long maximum) {
+    max_connect_errors_ = maximum;
+  }
+
+  /** @brief Sets timeout waiting for handshake response of clients
+   *
+   * Applies to connections accepted after the change.
+   *
+   * @param seconds Timeout in seconds
+   */
+  void set_client_connect_timeout(unsigned int seconds) {
+    client_connect_timeout_ = seconds;
   }
 
   /** @brief Reads from sender and writes it back to receiver using select
@@ -250,6 +280,12 @@ public:
    * decrypt). When SSL switch is detected, this function will set pktnr
    * to 2, so we assume the handshaking was OK.
    *
+   * When writing to the receiver fails, the number of bytes read is still
+   * reported so the caller can tell which side failed.
+   *
+   * When the sender replies with an error packet while handshaking, the
+   * error code is stored in handshake_error_code (when not nullptr).
+   *
    * @param sender Descriptor of the sender
    * @param receiver Descriptor of the receiver
    * @param readfds Read descriptors used with FD_ISSET
@@ -257,12 +293,58 @@ public:
    * @param curr_pktnr Pointer to storage for sequence id of packet
    * @param handshake_done Whether handshake phase is finished or not
    * @param report_bytes_read Pointer to storage to report bytes read
+   * @param handshake_error_code Pointer to storage for error code sent while handshaking (can be nullptr)
    * @return 0 on success; -1 on error
    */
   static int copy_mysql_protocol_packets(int sender, int receiver, fd_set *readfds,
                                          mysql_protocol::Packet::vector_t &buffer, int *curr_pktnr,
                                          bool handshake_done, size_t *report_bytes_read,
-                                         routing::SocketOperationsBase *socket_operations);
+                                         routing::SocketOperationsBase *socket_operations,
+                                         unsigned short *handshake_error_code = nullptr);
+
+  /** @brief Sets the outlier detection settings
+   *
+   * Settings are applied on the destinations when the service starts,
+   * or when they are replaced.
+   *
+   * @param settings outlier detection settings
+   */
+  void set_outlier_detection(const OutlierDetector::Settings &settings) {
+    outlier_settings_ = settings;
+  }
+
+  /** @brief Sets the timeouts of client sessions
+   *
+   * Sessions started after the call use the new timeouts; active
+   * sessions keep the ones they started with.
+   *
+   * @param wait_timeout seconds a session can stay idle; 0 for no limit
+   * @param max_session_lifetime seconds a session can last; 0 for no limit
+   */
+  void set_session_timeouts(unsigned int wait_timeout, unsigned int max_session_lifetime) {
+    wait_timeout_ = wait_timeout;
+    max_session_lifetime_ = max_session_lifetime;
+  }
+
+  /** @brief Sets the executor running the periodic tasks of the service
+   *
+   * Without executor, the destinations use threads of their own.
+   *
+   * @param executor executor of the harness, or nullptr
+   */
+  void set_executor(mysql_harness::Executor *executor) {
+    executor_ = executor;
+  }
+
+  /** @brief Returns whether a server error is caused by the destination
+   *
+   * Errors caused by the client, such as access denied or unknown
+   * database, do not count towards outlier detection.
+   *
+   * @param code MySQL error code sent by the server
+   * @return true when error is considered a destination failure
+   */
+  static bool is_destination_error(unsigned short code) noexcept;
 
 private:
   /** @brief Sets up the TCP service
@@ -275,6 +357,15 @@ private:
    */
   void setup_service();
 
+  /** @brief Replaces the destinations, starting them when the service runs
+   *
+   * @param destination the new destinations
+   */
+  void replace_destination(std::shared_ptr<RouteDestination> destination);
+
+  /** @brief Counts the end of a route, waking up start() after the last one */
+  void end_route() noexcept;
+
   /** @brief Worker function for thread
    *
    * Worker function handling incoming connection from a MySQL client using
@@ -288,6 +379,32 @@ private:
    */
   void routing_select_thread(int client, const in6_addr client_addr) noexcept;
 
+  /** @brief Moves the session to the server holding the client's shard
+   *
+   * Reads the handshake response of the client, which was greeted by a
+   * server of the global group, and gets the shard key out of it. When the
+   * connected server can not handle the shard key, the session is moved to
+   * a server of the group holding the shard: the handshake response is
+   * passed on with an authentication plugin name the server does not know,
+   * so that the server asks the client to authenticate again using its own
+   * scramble. The connection with the server of the global group is closed.
+   *
+   * When the client switches to SSL or sends no shard key, the session
+   * stays with the server of the global group.
+   *
+   * @param destination the shard destination
+   * @param client socket descriptor of the client
+   * @param server (in/out) socket descriptor of the server
+   * @param server_addr (in/out) address of the server
+   * @param buffer buffer to use for storage
+   * @param curr_pktnr pointer to storage for sequence id of packet
+   * @param report_bytes_read pointer to storage to report bytes read
+   * @return false when the session has to be aborted
+   */
+  bool route_by_shard_key(DestFabricCacheShard *destination, int client, int *server, TCPAddress *server_addr,
+                          mysql_protocol::Packet::vector_t &buffer, int *curr_pktnr,
+                          size_t *report_bytes_read) noexcept;
+
   /** @brief Mode to use when getting next destination */
   routing::AccessMode mode_;
   /** @brief Maximum active connections
@@ -296,7 +413,7 @@ private:
    * by this MySQLRouter instances. There is no maximum for outgoing
    * connections since it is one-to-one with incoming.
    */
-  int max_connections_;
+  std::atomic<int> max_connections_;
   /** @brief Timeout connecting to destination
    *
    * This timeout is used when trying to connect with a destination
@@ -304,23 +421,42 @@ private:
    * tried. It is good to leave this time out to 1 second or higher
    * if using an unstable network.
    */
-  int destination_connect_timeout_;
+  std::atomic<int> destination_connect_timeout_;
   /** @brief Max connect errors blocking hosts when handshake not completed */
-  unsigned long long max_connect_errors_;
+  std::atomic<unsigned long long> max_connect_errors_;
   /** @brief Timeout waiting for handshake response from client */
-  unsigned int client_connect_timeout_;
+  std::atomic<unsigned int> client_connect_timeout_;
+  /** @brief Timeout of idle sessions (0 for none) */
+  std::atomic<unsigned int> wait_timeout_{routing::kDefaultWaitTimeout};
+  /** @brief Maximum lifetime of sessions (0 for none) */
+  std::atomic<unsigned int> max_session_lifetime_{routing::kDefaultMaxSessionLifetime};
   /** @brief Size of buffer to store receiving packets */
   unsigned int net_buffer_length_;
   /** @brief IP address and TCP port for setting up TCP service */
   const TCPAddress bind_address_;
-  /** @brief Socket descriptor of the service */
-  int sock_server_;
-  /** @brief Destination object to use when getting next connection */
-  std::unique_ptr<RouteDestination> destination_;
+  /** @brief Socket descriptor of the service; -1 when not listening */
+  int sock_server_ = -1;
+  /** @brief Signals stop() that the socket of the service was closed */
+  std::mutex mutex_server_;
+  std::condition_variable cond_server_;
+  /** @brief Destination object to use when getting next connection
+   *
+   * Accessed with std::atomic_load() and std::atomic_store(), as it is
+   * replaced on reload. Each connection keeps the destinations it was
+   * routed with.
+   */
+  std::shared_ptr<RouteDestination> destination_;
+  /** @brief Serializes replacing and starting the destinations */
+  std::mutex mutex_destination_;
+  /** @brief Whether the destinations were started */
+  bool destination_started_ = false;
   /** @brief Whether we were asked to stop */
   std::atomic<bool> stopping_;
   /** @brief Number of active routes */
   std::atomic<uint16_t> info_active_routes_;
+  /** @brief Signals start() that the last active route ended */
+  std::mutex mutex_active_routes_;
+  std::condition_variable cond_active_routes_;
   /** @brief Number of handled routes */
   std::atomic<uint64_t> info_handled_routes_;
 
@@ -329,6 +465,15 @@ private:
   std::map<std::array<uint8_t, 16>, size_t> auth_error_counters_;
   std::vector<std::array<uint8_t, 16>> blocked_client_hosts_;
 
+  /** @brief Outlier detection settings applied on destinations */
+  OutlierDetector::Settings outlier_settings_;
+
+  /** @brief Executor running the periodic tasks of the destinations */
+  mysql_harness::Executor *executor_ = nullptr;
+
+  /** @brief Timers of the handshake, idle and lifetime timeouts of sessions */
+  mysql_harness::TimerWheel timer_wheel_;
+
   /** @brief object handling the operations on network sockets */
   routing::SocketOperationsBase* socket_operations_;
 };
@@ -0,0 +1,141 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "outlier_detector.h"
+#include "logger.h"
+
+#include <algorithm>
+
+using std::chrono::duration_cast;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+void OutlierDetector::set_settings(const Settings &settings) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  settings_ = settings;
+  enabled_.store(settings.error_rate > 0, std::memory_order_relaxed);
+  stats_.clear();
+  ejected_count_ = 0;
+}
+
+uint64_t OutlierDetector::epoch_of(clock_type::time_point now) const noexcept {
+  // Each bucket covers 1/kWindowBuckets of the interval
+  auto bucket_ms = std::max<uint64_t>(1, settings_.interval * 1000ULL / kWindowBuckets);
+  auto now_ms = duration_cast<milliseconds>(now.time_since_epoch()).count();
+  // epoch 0 marks unused buckets
+  return static_cast<uint64_t>(now_ms) / bucket_ms + 1;
+}
+
+bool OutlierDetector::check_ejected(Stats &stats, clock_type::time_point now) noexcept {
+  if (stats.ejected && now >= stats.ejected_until) {
+    stats.ejected = false;
+    stats.buckets.fill(Bucket());
+    --ejected_count_;
+  }
+  return stats.ejected;
+}
+
+bool OutlierDetector::report(const TCPAddress &addr, bool failed, size_t pool_size,
+                             clock_type::time_point now) noexcept {
+  if (!enabled()) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto found = stats_.find(addr);
+  if (found == stats_.end()) {
+    found = stats_.emplace(addr, Stats()).first;
+  }
+  auto &stats = found->second;
+
+  if (check_ejected(stats, now)) {
+    // sessions started before the ejection do not count
+    return false;
+  }
+
+  auto epoch = epoch_of(now);
+  auto &bucket = stats.buckets[epoch % kWindowBuckets];
+  if (bucket.epoch != epoch) {
+    bucket = Bucket();
+    bucket.epoch = epoch;
+  }
+  ++bucket.sessions;
+  if (!failed) {
+    return false;
+  }
+  ++bucket.errors;
+
+  uint64_t sessions = 0;
+  uint64_t errors = 0;
+  for (auto &it: stats.buckets) {
+    if (it.epoch > 0 && it.epoch + kWindowBuckets > epoch) {
+      sessions += it.sessions;
+      errors += it.errors;
+    }
+  }
+
+  if (sessions < settings_.min_requests || errors * 100 < sessions * settings_.error_rate) {
+    return false;
+  }
+
+  // bring back destinations of which ejection time passed before checking the limit
+  for (auto &it: stats_) {
+    check_ejected(it.second, now);
+  }
+  // small pools can always eject one destination, unless ejecting is disabled
+  size_t max_ejected = 0;
+  if (settings_.max_ejection_percent > 0) {
+    max_ejected = std::max<size_t>(1, pool_size * settings_.max_ejection_percent / 100);
+  }
+  if (ejected_count_ >= max_ejected) {
+    LOG_DEBUG("Not ejecting destination %s; %u%% of destinations already ejected",
+              addr.str().c_str(), settings_.max_ejection_percent);
+    return false;
+  }
+
+  stats.ejected = true;
+  stats.ejected_until = now + seconds(settings_.ejection_time);
+  ++ejected_count_;
+  log_warning("Ejecting destination %s for %u seconds (%u of %u sessions failed)",
+              addr.str().c_str(), settings_.ejection_time,
+              static_cast<unsigned int>(errors), static_cast<unsigned int>(sessions));
+  return true;
+}
+
+bool OutlierDetector::is_ejected(const TCPAddress &addr, clock_type::time_point now) noexcept {
+  if (!enabled()) {
+    return false;
+  }
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (ejected_count_ == 0) {
+    return false;
+  }
+  auto found = stats_.find(addr);
+  if (found == stats_.end()) {
+    return false;
+  }
+  return check_ejected(found->second, now);
+}
+
+size_t OutlierDetector::size_ejected(clock_type::time_point now) noexcept {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &it: stats_) {
+    check_ejected(it.second, now);
+  }
+  return ejected_count_;
+}
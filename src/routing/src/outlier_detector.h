@@ -0,0 +1,176 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#ifndef ROUTING_OUTLIER_DETECTOR_INCLUDED
+#define ROUTING_OUTLIER_DETECTOR_INCLUDED
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+#include "mysqlrouter/datatypes.h"
+#include "mysqlrouter/routing.h"
+
+using mysqlrouter::TCPAddress;
+
+/** @class OutlierDetector
+ * @brief Ejects destinations which misbehave while relaying
+ *
+ * Quarantine only catches destinations which refuse connections. The
+ * OutlierDetector keeps, for each destination, the number of relayed
+ * sessions and how many of those failed in-band (for example, an error
+ * packet sent by the server during the handshake, or the server resetting
+ * the connection in the middle of a session) within a sliding window.
+ *
+ * When the error rate of a destination reaches the configured threshold,
+ * the destination is ejected for the configured ejection time. Not more
+ * than max_ejection_percent of the destinations can be ejected at the
+ * same time, so that a faulty network does not empty the whole pool.
+ *
+ * Outlier detection is disabled when the error rate threshold is 0.
+ */
+class OutlierDetector {
+public:
+  using clock_type = std::chrono::steady_clock;
+
+  /** @brief Number of buckets the sliding window is divided in */
+  static const size_t kWindowBuckets = 10;
+
+  /** @brief Settings of the outlier detection */
+  struct Settings {
+    /** @brief Error rate (percentage) ejecting a destination; 0 disables */
+    unsigned int error_rate = routing::kDefaultOutlierErrorRate;
+    /** @brief Minimum number of sessions in window before checking rate */
+    unsigned int min_requests = routing::kDefaultOutlierMinRequests;
+    /** @brief Length of sliding window in seconds */
+    unsigned int interval = routing::kDefaultOutlierInterval;
+    /** @brief Seconds a destination stays ejected */
+    unsigned int ejection_time = routing::kDefaultOutlierEjectionTime;
+    /** @brief Maximum percentage of destinations ejected at once */
+    unsigned int max_ejection_percent = routing::kDefaultOutlierMaxEjectionPercent;
+  };
+
+  /** @brief Default constructor; outlier detection is disabled */
+  OutlierDetector() : enabled_(settings_.error_rate > 0) {}
+
+  /** @overload
+   *
+   * @param settings outlier detection settings
+   */
+  explicit OutlierDetector(const Settings &settings)
+      : settings_(settings), enabled_(settings.error_rate > 0) {}
+
+  OutlierDetector(const OutlierDetector &) = delete;
+  OutlierDetector &operator=(const OutlierDetector &) = delete;
+
+  /** @brief Replaces the settings
+   *
+   * Replacing the settings resets all gathered statistics and brings
+   * ejected destinations back.
+   *
+   * @param settings outlier detection settings
+   */
+  void set_settings(const Settings &settings);
+
+  /** @brief Returns whether outlier detection is enabled
+   *
+   * Does not lock `mutex_`, so that disabled outlier detection costs
+   * nothing to sessions.
+   *
+   * @return true when the error rate threshold is not 0
+   */
+  bool enabled() const noexcept {
+    return enabled_.load(std::memory_order_relaxed);
+  }
+
+  /** @brief Records the outcome of a relayed session
+   *
+   * Records whether the session relayed to given destination failed. When
+   * the error rate of the destination reaches the threshold it is ejected,
+   * unless too many destinations of the pool are already ejected. At
+   * least one destination can be ejected, unless max_ejection_percent is 0.
+   *
+   * @param addr destination the session was relayed to
+   * @param failed whether the destination failed the session
+   * @param pool_size number of destinations in the pool
+   * @param now current time (default: now)
+   * @return true when the destination got ejected by this report
+   */
+  bool report(const TCPAddress &addr, bool failed, size_t pool_size,
+              clock_type::time_point now = clock_type::now()) noexcept;
+
+  /** @brief Returns whether destination is ejected
+   *
+   * Destinations of which the ejection time passed are brought back
+   * and get a clean window.
+   *
+   * @param addr destination to check
+   * @param now current time (default: now)
+   * @return true when destination is currently ejected
+   */
+  bool is_ejected(const TCPAddress &addr, clock_type::time_point now = clock_type::now()) noexcept;
+
+  /** @brief Returns number of currently ejected destinations
+   *
+   * @param now current time (default: now)
+   * @return size_t
+   */
+  size_t size_ejected(clock_type::time_point now = clock_type::now()) noexcept;
+
+private:
+  /** @brief Counters for one slice of the sliding window */
+  struct Bucket {
+    uint64_t epoch = 0;
+    uint32_t sessions = 0;
+    uint32_t errors = 0;
+  };
+
+  /** @brief Statistics kept for each destination */
+  struct Stats {
+    std::array<Bucket, kWindowBuckets> buckets;
+    bool ejected = false;
+    clock_type::time_point ejected_until;
+  };
+
+  /** @brief Brings back destination when its ejection time passed
+   *
+   * The caller is responsible for locking `mutex_`.
+   */
+  bool check_ejected(Stats &stats, clock_type::time_point now) noexcept;
+
+  /** @brief Returns the window epoch of given time */
+  uint64_t epoch_of(clock_type::time_point now) const noexcept;
+
+  /** @brief Orders destinations without building strings */
+  struct AddressLess {
+    bool operator()(const TCPAddress &left, const TCPAddress &right) const {
+      return left.port < right.port || (left.port == right.port && left.addr < right.addr);
+    }
+  };
+
+  Settings settings_;
+  /** @brief Whether error_rate of settings_ is not 0 */
+  std::atomic<bool> enabled_{false};
+  std::map<TCPAddress, Stats, AddressLess> stats_;
+  size_t ejected_count_ = 0;
+  std::mutex mutex_;
+};
+
+#endif // ROUTING_OUTLIER_DETECTOR_INCLUDED
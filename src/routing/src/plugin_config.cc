@@ -39,7 +39,14 @@ string RoutingPluginConfig::get_default(const string &option) {
       {"max_connections", to_string(routing::kDefaultMaxConnections)},
       {"max_connect_errors", to_string(routing::kDefaultMaxConnectErrors)},
       {"client_connect_timeout", to_string(routing::kDefaultClientConnectTimeout)},
+      {"wait_timeout", to_string(routing::kDefaultWaitTimeout)},
+      {"max_session_lifetime", to_string(routing::kDefaultMaxSessionLifetime)},
       {"net_buffer_length", to_string(routing::kDefaultNetBufferLength)},
+      {"outlier_error_rate", to_string(routing::kDefaultOutlierErrorRate)},
+      {"outlier_min_requests", to_string(routing::kDefaultOutlierMinRequests)},
+      {"outlier_interval", to_string(routing::kDefaultOutlierInterval)},
+      {"outlier_ejection_time", to_string(routing::kDefaultOutlierEjectionTime)},
+      {"outlier_max_ejection_percent", to_string(routing::kDefaultOutlierMaxEjectionPercent)},
   };
 
   auto it = defaults.find(option);
@@ -108,7 +115,7 @@ string RoutingPluginConfig::get_option_destinations(
     if (uri.scheme == "fabric+cache") {
       string fabric_cmd{uri.path.size() > 0 ? uri.path[0] : ""};
       std::transform(fabric_cmd.begin(), fabric_cmd.end(), fabric_cmd.begin(), ::tolower);
-      if (fabric_cmd != "group") {
+      if (fabric_cmd != "group" && fabric_cmd != "shard") {
         throw invalid_argument(
             get_log_prefix(option) + " has an invalid Fabric command in URI; was '" + fabric_cmd + "'");
       }
@@ -54,7 +54,14 @@ public:
         max_connections(get_uint_option<uint16_t>(section, "max_connections", 1)),
         max_connect_errors(get_uint_option<uint32_t>(section, "max_connect_errors", 1, UINT32_MAX)),
         client_connect_timeout(get_uint_option<uint32_t>(section, "client_connect_timeout", 2, 31536000)),
-        net_buffer_length(get_uint_option<uint32_t>(section, "net_buffer_length", 1024, 1048576)) { }
+        wait_timeout(get_uint_option<uint32_t>(section, "wait_timeout", 0, 31536000)),
+        max_session_lifetime(get_uint_option<uint32_t>(section, "max_session_lifetime", 0, 31536000)),
+        net_buffer_length(get_uint_option<uint32_t>(section, "net_buffer_length", 1024, 1048576)),
+        outlier_error_rate(get_uint_option<uint32_t>(section, "outlier_error_rate", 0, 100)),
+        outlier_min_requests(get_uint_option<uint32_t>(section, "outlier_min_requests", 1, UINT16_MAX)),
+        outlier_interval(get_uint_option<uint32_t>(section, "outlier_interval", 1, 3600)),
+        outlier_ejection_time(get_uint_option<uint32_t>(section, "outlier_ejection_time", 1, 86400)),
+        outlier_max_ejection_percent(get_uint_option<uint32_t>(section, "outlier_max_ejection_percent", 0, 100)) { }
 
   string get_default(const string &option);
 
@@ -76,8 +83,22 @@ public:
   const unsigned long long max_connect_errors;
   /** @brief `client_connect_timeout` option read from configuration section */
   const unsigned int client_connect_timeout;
+  /** @brief `wait_timeout` option read from configuration section */
+  const unsigned int wait_timeout;
+  /** @brief `max_session_lifetime` option read from configuration section */
+  const unsigned int max_session_lifetime;
   /** @brief Size of buffer to receive packets */
   const unsigned int net_buffer_length;
+  /** @brief `outlier_error_rate` option read from configuration section */
+  const unsigned int outlier_error_rate;
+  /** @brief `outlier_min_requests` option read from configuration section */
+  const unsigned int outlier_min_requests;
+  /** @brief `outlier_interval` option read from configuration section */
+  const unsigned int outlier_interval;
+  /** @brief `outlier_ejection_time` option read from configuration section */
+  const unsigned int outlier_ejection_time;
+  /** @brief `outlier_max_ejection_percent` option read from configuration section */
+  const unsigned int outlier_max_ejection_percent;
 
 protected:
 
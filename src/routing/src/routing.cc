@@ -21,7 +21,9 @@
 #include "logger.h"
 #include "utils.h"
 
+#include <chrono>
 #include <cstring>
+#include <vector>
 
 #ifndef _WIN32
 # ifdef __sun
@@ -29,6 +31,7 @@
 # else
 #  include <sys/fcntl.h>
 # endif
+# include <arpa/inet.h>
 # include <netdb.h>
 # include <netinet/tcp.h>
 # include <sys/socket.h>
@@ -77,103 +80,132 @@ SocketOperations* SocketOperations::instance() {
   return &instance_;
 }
 
-int SocketOperations::get_mysql_socket(TCPAddress addr, int connect_timeout, bool log) noexcept {
+int SocketOperations::get_mysql_socket(const TCPAddress &addr, int connect_timeout, bool log) noexcept {
+  // Connection threads only wait for names not cached
+  std::vector<mysql_harness::IPAddress> addresses;
+  try {
+    addresses = resolver_.hostname(addr.addr, std::chrono::seconds(connect_timeout));
+  } catch (const std::exception &exc) {
+    if (log) {
+      LOG_DEBUG("Failed getting address information for '%s' (%s)", addr.addr.c_str(), exc.what());
+    }
+    return -1;
+  }
+
+  int sock = -1;
+  for (auto &address: addresses) {
+    struct sockaddr_storage resolved;
+    size_t resolved_len;
+    memset(&resolved, 0, sizeof(resolved));
+    if (address.is_ipv4()) {
+      auto sin = reinterpret_cast<struct sockaddr_in *>(&resolved);
+      sin->sin_family = AF_INET;
+      sin->sin_port = htons(addr.port);
+      inet_pton(AF_INET, address.str().c_str(), &sin->sin_addr);
+      resolved_len = sizeof(struct sockaddr_in);
+    } else {
+      auto sin6 = reinterpret_cast<struct sockaddr_in6 *>(&resolved);
+      sin6->sin6_family = AF_INET6;
+      sin6->sin6_port = htons(addr.port);
+      inet_pton(AF_INET6, address.str().c_str(), &sin6->sin6_addr);
+      resolved_len = sizeof(struct sockaddr_in6);
+    }
+    sock = connect_address(addr, &resolved, resolved_len, connect_timeout, log);
+    if (sock != -1) {
+      break;
+    }
+  }
+
+  return sock;
+}
+
+void SocketOperations::prefetch(const TCPAddress &addr) noexcept {
+  try {
+    resolver_.prefetch(addr.addr);
+  } catch (const std::exception &exc) {
+    LOG_DEBUG("Failed resolving '%s' in the background (%s)", addr.addr.c_str(), exc.what());
+  }
+}
+
+int SocketOperations::get_mysql_socket(const TCPAddress &addr, const void *resolved, size_t resolved_len,
+                                       int connect_timeout, bool log) noexcept {
+  return connect_address(addr, resolved, resolved_len, connect_timeout, log);
+}
+
+int SocketOperations::connect_address(const TCPAddress &addr, const void *resolved, size_t resolved_len,
+                                      int connect_timeout, bool log) noexcept {
   fd_set readfds;
   fd_set writefds;
   fd_set errfds;
   struct timeval timeout_val;
 
-  struct addrinfo *servinfo, *info, hints;
+  auto address = reinterpret_cast<const struct sockaddr *>(resolved);
 
   int opt_nodelay = 1;
   int res;
+  int err;
   int so_error = 0;
   int sock = -1;
   socklen_t error_len = static_cast<socklen_t>(sizeof(so_error));
 
-  memset(&hints, 0, sizeof hints);
-  hints.ai_family = AF_UNSPEC;
-  hints.ai_socktype = SOCK_STREAM;
-
-  int err;
-  if ((err = getaddrinfo(addr.addr.c_str(), to_string(addr.port).c_str(), &hints, &servinfo)) != 0) {
-    if (log) {
-#ifndef _WIN32
-      std::string errstr{(err == EAI_SYSTEM) ? strerror(errno) : gai_strerror(err)};
-#else
-      std::string errstr = get_message_error(err);
-#endif
-      log_debug("Failed getting address information for '%s' (%s)", addr.addr.c_str(), errstr.c_str());
-    }
-    return -1;
-  }
-
 #ifdef _WIN32
   WSASetLastError(0);
 #else
   errno = 0;
 #endif
-  for (info = servinfo; info != nullptr; info = info->ai_next) {
-    if ((sock = socket(info->ai_family, info->ai_socktype, info->ai_protocol)) == -1) {
-      log_error("Failed opening socket: %s", get_message_error(errno).c_str());
-      continue;
-    }
-    FD_ZERO(&readfds);
-    FD_SET(sock, &readfds);
-    errfds = writefds = readfds;
-    timeout_val.tv_sec = connect_timeout;
-    timeout_val.tv_usec = 0;
-
-    // Set non-blocking so we can timeout using select()
-    set_socket_blocking(sock, false);
-    if (connect(sock, info->ai_addr, info->ai_addrlen) < 0) {
+  if ((sock = socket(address->sa_family, SOCK_STREAM, 0)) == -1) {
+    log_error("Failed opening socket: %s", get_message_error(errno).c_str());
+    return -1;
+  }
+  FD_ZERO(&readfds);
+  FD_SET(sock, &readfds);
+  errfds = writefds = readfds;
+  timeout_val.tv_sec = connect_timeout;
+  timeout_val.tv_usec = 0;
+
+  // Set non-blocking so we can timeout using select()
+  set_socket_blocking(sock, false);
+  if (connect(sock, address, static_cast<socklen_t>(resolved_len)) < 0) {
 #ifdef _WIN32
-      if (WSAGetLastError() != WSAEINPROGRESS && WSAGetLastError() != WSAEWOULDBLOCK) {
-        log_error("Error connecting socket to %s:%i (%s)", addr.addr.c_str(), addr.port, get_message_error(SOCKET_ERROR).c_str());
-        this->close(sock);
-        continue;
-      }
-#else
-      if (errno != EINPROGRESS) {
-        log_error("Error connecting socket to %s:%i (%s)", addr.addr.c_str(), addr.port, strerror(errno));
-        this->close(sock);
-        continue;
-      }
-#endif
+    if (WSAGetLastError() != WSAEINPROGRESS && WSAGetLastError() != WSAEWOULDBLOCK) {
+      log_error("Error connecting socket to %s:%i (%s)", addr.addr.c_str(), addr.port, get_message_error(SOCKET_ERROR).c_str());
+      this->close(sock);
+      return -1;
     }
-
-    res = select(sock + 1, &readfds, &writefds, &errfds, &timeout_val);
-    if (res <= 0) {
-      if (res == 0) {
-        this->shutdown(sock);
-        this->close(sock);
-
-        if (log) {
-          log_debug("Timeout reached trying to connect to MySQL Server %s", addr.str().c_str());
-        }
-        continue;
-      }
-      log_debug("select failed");
-      continue;
+#else
+    if (errno != EINPROGRESS) {
+      log_error("Error connecting socket to %s:%i (%s)", addr.addr.c_str(), addr.port, strerror(errno));
+      this->close(sock);
+      return -1;
     }
+#endif
+  }
 
-    if (FD_ISSET(sock, &readfds) || FD_ISSET(sock, &writefds) || FD_ISSET(sock, &errfds)) {
-      if (getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&so_error), &error_len) == -1) {
-        log_debug("Failed executing getsockopt on client socket: %s",
-          get_message_error(errno).c_str());
-        continue;
+  res = select(sock + 1, &readfds, &writefds, &errfds, &timeout_val);
+  if (res <= 0) {
+    if (res == 0) {
+      this->shutdown(sock);
+      if (log) {
+        LOG_DEBUG("Timeout reached trying to connect to MySQL Server %s", addr.str().c_str());
       }
     } else {
-      log_debug("Failed connecting with MySQL server %s", addr.str().c_str());
-      continue;
+      LOG_DEBUG("select failed");
     }
-    break;
-  } // for (info = servinfo; info != nullptr; info = info->ai_next)
+    this->close(sock);
+    return -1;
+  }
 
-  if (info == nullptr) {
+  if (FD_ISSET(sock, &readfds) || FD_ISSET(sock, &writefds) || FD_ISSET(sock, &errfds)) {
+    if (getsockopt(sock, SOL_SOCKET, SO_ERROR, reinterpret_cast<char *>(&so_error), &error_len) == -1) {
+      LOG_DEBUG("Failed executing getsockopt on client socket: %s",
+        get_message_error(errno).c_str());
+      this->close(sock);
+      return -1;
+    }
+  } else {
+    LOG_DEBUG("Failed connecting with MySQL server %s", addr.str().c_str());
+    this->close(sock);
     return -1;
-  } else if (servinfo) {
-    freeaddrinfo(servinfo);
   }
 
   // Handle remaining errors
@@ -183,7 +215,7 @@ int SocketOperations::get_mysql_socket(TCPAddress addr, int connect_timeout, boo
     this->close(sock);
     err = so_error ? so_error : SOCKET_ERROR;
     if (log) {
-      log_debug("MySQL Server %s: %s (%d)", addr.str().c_str(), get_message_error(err).c_str(), err);
+      LOG_DEBUG("MySQL Server %s: %s (%d)", addr.str().c_str(), get_message_error(err).c_str(), err);
     }
     return -1;
   }
@@ -193,7 +225,7 @@ int SocketOperations::get_mysql_socket(TCPAddress addr, int connect_timeout, boo
     this->close(sock);
     err = so_error ? so_error : errno;
     if (log) {
-      log_debug("MySQL Server %s: %s (%d)", addr.str().c_str(), strerror(err), err);
+      LOG_DEBUG("MySQL Server %s: %s (%d)", addr.str().c_str(), strerror(err), err);
     }
     return -1;
   }
@@ -206,7 +238,8 @@ int SocketOperations::get_mysql_socket(TCPAddress addr, int connect_timeout, boo
   if (setsockopt(sock, IPPROTO_TCP, TCP_NODELAY,
                  reinterpret_cast<const char*>(&opt_nodelay), // cast keeps Windows happy (const void* on Unix)
                  static_cast<socklen_t>(sizeof(int))) == -1) {
-    log_debug("Failed setting TCP_NODELAY on client socket");
+    LOG_DEBUG("Failed setting TCP_NODELAY on client socket");
+    this->close(sock);
     return -1;
   }
 
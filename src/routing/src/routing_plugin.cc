@@ -23,7 +23,10 @@
 #include "config_parser.h"
 
 #include <atomic>
+#include <chrono>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <mutex>
 #include <vector>
 
@@ -39,6 +42,68 @@ const char *kRoutingRequires[1] = {
     "logger",
 };
 
+/** @brief Running route, with the configuration it was started or reloaded with */
+struct Route {
+  std::shared_ptr<MySQLRouting> routing;
+  std::shared_ptr<const RoutingPluginConfig> config;
+};
+
+/** @brief Running routes by section name, to stop and reload them */
+static std::map<string, Route> g_routes;
+static std::mutex g_routes_mutex;
+
+/** @brief Interval between logging the activity of the destination resolver */
+static const std::chrono::minutes kResolverStatsInterval{5};
+
+/** @brief Timer logging the activity of the resolver; 0 when not scheduled */
+static mysql_harness::Executor::TimerId g_resolver_stats_timer = 0;
+
+/** @brief Lookups counted by the activity logged last */
+static uint64_t g_resolver_logged_lookups = 0;
+
+/** @brief Logs the activity of the destination resolver
+ *
+ * @param always whether to log even when nothing was resolved since logged last
+ */
+static void log_resolver_stats(bool always) {
+  auto stats = routing::SocketOperations::instance()->resolver().stats();
+  uint64_t lookups = stats.hits + stats.negative_hits + stats.misses + stats.refreshes;
+  if (!always && lookups == g_resolver_logged_lookups) {
+    return;
+  }
+  g_resolver_logged_lookups = lookups;
+  log_info("Resolved destinations: %llu hits, %llu negative hits, %llu misses, %llu refreshes, "
+           "%llu failures, %llu timeouts",
+           static_cast<unsigned long long>(stats.hits), static_cast<unsigned long long>(stats.negative_hits),
+           static_cast<unsigned long long>(stats.misses), static_cast<unsigned long long>(stats.refreshes),
+           static_cast<unsigned long long>(stats.failures), static_cast<unsigned long long>(stats.timeouts));
+}
+
+static string get_route_name(const ConfigSection *section) {
+  if (!section->key.empty()) {
+    return section->name + ":" + section->key;
+  }
+  return section->name;
+}
+
+static OutlierDetector::Settings get_outlier_settings(const RoutingPluginConfig &config) {
+  OutlierDetector::Settings outlier_settings;
+  outlier_settings.error_rate = config.outlier_error_rate;
+  outlier_settings.min_requests = config.outlier_min_requests;
+  outlier_settings.interval = config.outlier_interval;
+  outlier_settings.ejection_time = config.outlier_ejection_time;
+  outlier_settings.max_ejection_percent = config.outlier_max_ejection_percent;
+  return outlier_settings;
+}
+
+static void set_destinations(MySQLRouting &r, const string &destinations) {
+  try {
+    r.set_destinations_from_uri(URI(destinations));
+  } catch (URIError) {
+    r.set_destinations_from_csv(destinations);
+  }
+}
+
 static int init(const AppInfo *info) {
   if (info->config != nullptr) {
     bool have_fabric_cache = false;
@@ -110,35 +175,127 @@ static int init(const AppInfo *info) {
     }
   }
   g_app_info = info;
+
+  // The activity is logged while running, when there was some
+  if (info->executor != nullptr) {
+    g_resolver_stats_timer = info->executor->schedule_every(
+        "routing", kResolverStatsInterval, [] { log_resolver_stats(false); });
+  }
   return 0;
 }
 
-static void start(const ConfigSection *section) {
-  string name;
-  if (!section->key.empty()) {
-    name = section->name + ":" + section->key;
-  } else {
-    name = section->name;
+static int deinit(const AppInfo *) {
+  if (g_resolver_stats_timer != 0) {
+    g_app_info->executor->cancel(g_resolver_stats_timer);
+    g_resolver_stats_timer = 0;
   }
+  log_resolver_stats(true);
+  routing::SocketOperations::instance()->resolver().stop();
+  return 0;
+}
+
+static void start(const ConfigSection *section) {
+  string name = get_route_name(section);
+  std::shared_ptr<MySQLRouting> r;
 
   try {
-    RoutingPluginConfig config(section);
-    config.section_name = name;
-    MySQLRouting r(config.mode, config.bind_address.port,
-                   config.bind_address.addr, name, config.max_connections, config.connect_timeout,
-                   config.max_connect_errors, config.client_connect_timeout);
-    try {
-      r.set_destinations_from_uri(URI(config.destinations));
-    } catch (URIError) {
-      r.set_destinations_from_csv(config.destinations);
+    auto config = std::make_shared<RoutingPluginConfig>(section);
+    config->section_name = name;
+    r = std::make_shared<MySQLRouting>(config->mode, config->bind_address.port,
+                                       config->bind_address.addr, name, config->max_connections,
+                                       config->connect_timeout, config->max_connect_errors,
+                                       config->client_connect_timeout);
+    r->set_outlier_detection(get_outlier_settings(*config));
+    r->set_executor(g_app_info ? g_app_info->executor : nullptr);
+    r->set_session_timeouts(config->wait_timeout, config->max_session_lifetime);
+    set_destinations(*r, config->destinations);
+    {
+      std::lock_guard<std::mutex> lock(g_routes_mutex);
+      g_routes[name] = {r, config};
     }
-    r.start();
+    r->start();
   } catch (const std::invalid_argument &exc) {
-    log_error(exc.what());
-    return;
+    log_error("%s", exc.what());
   } catch (const std::runtime_error &exc) {
     log_error("%s: %s", name.c_str(), exc.what());
   }
+
+  // Unless the section was restarted meanwhile
+  std::lock_guard<std::mutex> lock(g_routes_mutex);
+  auto found = g_routes.find(name);
+  if (found != g_routes.end() && found->second.routing == r) {
+    g_routes.erase(found);
+  }
+}
+
+static void stop(const ConfigSection *section) {
+  std::shared_ptr<MySQLRouting> r;
+  {
+    std::lock_guard<std::mutex> lock(g_routes_mutex);
+    auto found = g_routes.find(get_route_name(section));
+    if (found == g_routes.end()) {
+      return;
+    }
+    r = found->second.routing;
+    g_routes.erase(found);
+  }
+  r->stop();
+}
+
+static int reload(const ConfigSection *section) {
+  string name = get_route_name(section);
+  std::lock_guard<std::mutex> lock(g_routes_mutex);
+  auto found = g_routes.find(name);
+  if (found == g_routes.end()) {
+    return 1;  // not running, e.g. failed to start
+  }
+  MySQLRouting &r = *found->second.routing;
+  const RoutingPluginConfig &previous = *found->second.config;
+
+  std::shared_ptr<RoutingPluginConfig> config;
+  try {
+    config = std::make_shared<RoutingPluginConfig>(section);
+    config->section_name = name;
+  } catch (const std::invalid_argument &exc) {
+    log_error("%s; configuration not reloaded", exc.what());
+    return -1;
+  }
+
+  // The service is bound and its sessions are set up on start
+  if (!(config->bind_address == previous.bind_address) || config->mode != previous.mode ||
+      config->net_buffer_length != previous.net_buffer_length) {
+    log_info("[%s] restarting to apply configuration", name.c_str());
+    return 1;
+  }
+
+  // Active sessions keep the destinations they were routed with
+  auto outlier_settings = get_outlier_settings(*config);
+  auto previous_outlier_settings = get_outlier_settings(previous);
+  bool same_outlier_settings =
+      outlier_settings.error_rate == previous_outlier_settings.error_rate &&
+      outlier_settings.min_requests == previous_outlier_settings.min_requests &&
+      outlier_settings.interval == previous_outlier_settings.interval &&
+      outlier_settings.ejection_time == previous_outlier_settings.ejection_time &&
+      outlier_settings.max_ejection_percent == previous_outlier_settings.max_ejection_percent;
+  if (config->destinations != previous.destinations || !same_outlier_settings) {
+    try {
+      r.set_outlier_detection(outlier_settings);
+      set_destinations(r, config->destinations);
+    } catch (const std::runtime_error &exc) {
+      r.set_outlier_detection(previous_outlier_settings);
+      log_error("[%s] %s; configuration not reloaded", name.c_str(), exc.what());
+      return -1;
+    }
+  }
+
+  r.set_max_connections(config->max_connections);
+  r.set_destination_connect_timeout(config->connect_timeout);
+  r.set_max_connect_errors(config->max_connect_errors);
+  r.set_client_connect_timeout(config->client_connect_timeout);
+  r.set_session_timeouts(config->wait_timeout, config->max_session_lifetime);
+  found->second.config = config;
+  log_info("[%s] configuration reloaded", name.c_str());
+  return 0;
 }
 
 extern "C" {
@@ -150,8 +307,9 @@ extern "C" {
       sizeof(kRoutingRequires) / sizeof(*kRoutingRequires), kRoutingRequires, // Requires
       0, nullptr, // Conflicts
       init,       // init
-      nullptr,    // deinit
+      deinit,     // deinit
       start,      // start
-      nullptr     // stop
+      stop,       // stop
+      reload      // reload
   };
 }
@@ -50,11 +50,13 @@ void *get_in_addr(struct sockaddr *addr) {
 std::pair<std::string, int > get_peer_name(int sock) {
   socklen_t sock_len;
   struct sockaddr_storage addr;
-  char result_addr[105];  // For IPv4, IPv6 and Unix socket
-  int port;
+  char result_addr[105] = "";  // For IPv4, IPv6 and Unix socket
+  int port = 0;
 
   sock_len = static_cast<socklen_t>(sizeof addr);
-  getpeername(sock, (struct sockaddr*)&addr, &sock_len);
+  if (getpeername(sock, (struct sockaddr*)&addr, &sock_len) == -1) {
+    return std::make_pair(std::string(), 0);
+  }
 
   if (addr.ss_family == AF_INET6) {
     // IPv6
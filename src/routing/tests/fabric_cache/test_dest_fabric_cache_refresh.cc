@@ -0,0 +1,132 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+/**
+ * Tests the Fabric Cache destinations of routes against a Fabric Cache
+ * fed by MockFabric.
+ */
+
+#include "dest_fabric_cache.h"
+#include "fabric_factory.h"
+#include "mock_fabric.h"
+#include "mysqlrouter/fabric_cache.h"
+
+#include "routing_mocks.h"
+
+#include <cerrno>
+#include <chrono>
+#include <thread>
+
+using fabric_cache::ManagedServer;
+
+const string kCacheName = "routing";
+
+class DestFabricCacheRefreshTest : public ::testing::Test {
+ protected:
+  static void SetUpTestCase() {
+    // Refreshes other than the first one are only the requested ones
+    mock_ = std::dynamic_pointer_cast<MockFabric>(get_instance("127.0.0.1", 32275, "admin", "", 1, 1));
+    mock_->ttl = 3600;
+    fabric_cache::cache_init(kCacheName, "127.0.0.1", 32275, "admin", "");
+    ASSERT_TRUE(wait_refreshed(0));
+  }
+
+  // Waits until the cache was refreshed after given generation
+  static bool wait_refreshed(uint64_t generation) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (fabric_cache::cache_generation(kCacheName) <= generation) {
+      if (std::chrono::steady_clock::now() > deadline) {
+        return false;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+  }
+
+  static std::shared_ptr<MockFabric> mock_;
+  MockSocketOperations sock_ops_;
+};
+
+std::shared_ptr<MockFabric> DestFabricCacheRefreshTest::mock_;
+
+/**
+ * Test that a failed connect to the primary of a group requests a refresh,
+ * after which the promoted server is used.
+ */
+TEST_F(DestFabricCacheRefreshTest, FailedConnectRequestsRefresh) {
+  DestFabricCacheGroup dest(kCacheName, "group-1", routing::AccessMode::kReadWrite, {}, &sock_ops_);
+  auto generation = fabric_cache::cache_generation(kCacheName);
+
+  // Primary fails and the secondary gets promoted
+  auto &servers = mock_->group_map["group-1"];
+  servers.front().status = static_cast<int>(ManagedServer::Status::kFaulty);
+  servers.back().status = static_cast<int>(ManagedServer::Status::kPrimary);
+  servers.back().mode = static_cast<int>(ManagedServer::Mode::kReadWrite);
+
+  int error = 0;
+  TCPAddress address;
+  sock_ops_.get_mysql_socket_fail(1);
+  ASSERT_EQ(-1, dest.get_server_socket(1, &error, &address));
+  EXPECT_EQ(ECONNREFUSED, error);
+  EXPECT_EQ(mock_->ms1.port, address.port);
+
+  ASSERT_TRUE(wait_refreshed(generation));
+  ASSERT_NE(-1, dest.get_server_socket(1, &error, &address));
+  EXPECT_EQ(mock_->ms2.port, address.port);
+}
+
+/**
+ * Test that the candidates of a group are shared by all connections while
+ * the Fabric Cache keeps its generation, and derived again after a
+ * refresh changed it.
+ */
+TEST_F(DestFabricCacheRefreshTest, CandidatesSharedWithinGeneration) {
+  DestFabricCacheGroup dest(kCacheName, "group-2", routing::AccessMode::kReadOnly, {}, &sock_ops_);
+  auto generation = fabric_cache::cache_generation(kCacheName);
+
+  auto candidates = dest.get_candidates(generation);
+  ASSERT_EQ(1u, candidates->addresses.size());
+  EXPECT_EQ(mock_->ms4.port, candidates->addresses.front().port);
+  EXPECT_EQ(candidates, dest.get_candidates(generation));
+
+  int error = 0;
+  TCPAddress address;
+  ASSERT_NE(-1, dest.get_server_socket(1, &error, &address));
+  EXPECT_EQ(candidates, dest.get_candidates(fabric_cache::cache_generation(kCacheName)));
+
+  // The primary becomes a read-only secondary
+  auto &servers = mock_->group_map["group-2"];
+  servers.front().status = static_cast<int>(ManagedServer::Status::kSecondary);
+  servers.front().mode = static_cast<int>(ManagedServer::Mode::kReadOnly);
+  fabric_cache::request_refresh(kCacheName);
+  ASSERT_TRUE(wait_refreshed(generation));
+
+  generation = fabric_cache::cache_generation(kCacheName);
+  auto refreshed = dest.get_candidates(generation);
+  EXPECT_NE(candidates, refreshed);
+  EXPECT_EQ(generation, refreshed->generation);
+  EXPECT_EQ(2u, refreshed->addresses.size());
+  EXPECT_EQ(refreshed, dest.get_candidates(generation));
+
+  // Connections holding the previous candidates keep them unchanged
+  EXPECT_EQ(1u, candidates->addresses.size());
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
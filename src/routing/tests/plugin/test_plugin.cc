@@ -151,13 +151,13 @@ TEST_F(RoutingPluginTests, PluginConstants) {
 }
 
 TEST_F(RoutingPluginTests, PluginObject) {
-  ASSERT_EQ(harness_plugin_routing.abi_version, 0x0101U);
+  ASSERT_EQ(harness_plugin_routing.abi_version, 0x0103U);
   ASSERT_EQ(harness_plugin_routing.plugin_version, static_cast<uint32_t>(VERSION_NUMBER(0, 0, 1)));
   ASSERT_EQ(harness_plugin_routing.requires_length, 1U);
   ASSERT_THAT(harness_plugin_routing.requires[0], StrEq("logger"));
   ASSERT_EQ(harness_plugin_routing.conflicts_length, 0U);
   ASSERT_THAT(harness_plugin_routing.conflicts, IsNull());
-  ASSERT_THAT(harness_plugin_routing.deinit, IsNull());
+  ASSERT_THAT(harness_plugin_routing.deinit, NotNull());
   ASSERT_THAT(harness_plugin_routing.brief,
               StrEq("Routing MySQL connections between MySQL clients/connectors and servers"));
 }
@@ -171,6 +171,7 @@ TEST_F(RoutingPluginTests, InitAppInfo) {
       logdir.c_str(),
       rundir.c_str(),
       cfgdir.c_str(),
+      nullptr,
       nullptr
   };
 
@@ -24,7 +24,7 @@
 
 class MockSocketOperations : public routing::SocketOperationsBase {
  public:
-  int get_mysql_socket(mysqlrouter::TCPAddress addr, int, bool = true) noexcept override {
+  int get_mysql_socket(const mysqlrouter::TCPAddress &addr, int, bool = true) noexcept override {
     get_mysql_socket_call_cnt_++;
     if (get_mysql_socket_fails_todo_) {
       set_errno(ECONNREFUSED);
@@ -39,6 +39,12 @@ class MockSocketOperations : public routing::SocketOperationsBase {
     }
   }
 
+  int get_mysql_socket(const mysqlrouter::TCPAddress &addr, const void *, size_t, int connect_timeout,
+                       bool log = true) noexcept override {
+    get_mysql_socket_resolved_call_cnt_++;
+    return get_mysql_socket(addr, connect_timeout, log);
+  }
+
   MOCK_METHOD3(read, ssize_t(int, void*, size_t));
   MOCK_METHOD3(write, ssize_t(int, void*, size_t));
   MOCK_METHOD1(close, void(int));
@@ -65,7 +71,14 @@ class MockSocketOperations : public routing::SocketOperationsBase {
     return cc;
   }
 
+  int get_mysql_socket_resolved_call_cnt() {
+    int cc = get_mysql_socket_resolved_call_cnt_;
+    get_mysql_socket_resolved_call_cnt_ = 0;
+    return cc;
+  }
+
  private:
   int get_mysql_socket_fails_todo_ = 0;
   int get_mysql_socket_call_cnt_   = 0;
+  int get_mysql_socket_resolved_call_cnt_ = 0;
 };
@@ -0,0 +1,91 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "dest_fabric_cache.h"
+
+#include "routing_mocks.h"
+
+using mysql_protocol::HandshakeResponsePacket;
+
+class DestFabricCacheShardTest : public ::testing::Test {
+ protected:
+  // Handshake response with initial schema and connection attributes
+  static HandshakeResponsePacket make_response(const string &database,
+                                               const std::map<string, string> &attributes) {
+    uint32_t capabilities = mysql_protocol::kClientProtocol41 | mysql_protocol::kClientSecureConnection |
+                            mysql_protocol::kClientConnectWithDB | mysql_protocol::kClientPluginAuth |
+                            mysql_protocol::kClientConnectAttrs;
+    mysql_protocol::Packet p(1);
+    p.assign({0x0, 0x0, 0x0, 0x1});
+    p.add_int<uint32_t>(capabilities);
+    p.add_int<uint32_t>(mysql_protocol::Packet::kMaxAllowedSize);
+    p.add_int<uint8_t>(33);
+    p.insert(p.end(), 23, 0x0);
+    p.add(string("app_user"));
+    p.push_back(0x0);
+    p.add_int<uint8_t>(0);
+    p.add(database);
+    p.push_back(0x0);
+    p.add(string("mysql_native_password"));
+    p.push_back(0x0);
+
+    mysql_protocol::Packet attrs;
+    for (auto &it: attributes) {
+      attrs.add_int<uint8_t>(static_cast<uint8_t>(it.first.size()));
+      attrs.add(it.first);
+      attrs.add_int<uint8_t>(static_cast<uint8_t>(it.second.size()));
+      attrs.add(it.second);
+    }
+    p.add_int<uint8_t>(static_cast<uint8_t>(attrs.size()));
+    p.add(attrs);
+    mysql_protocol::Packet::write_int<uint32_t>(p, 0, static_cast<uint32_t>(p.size() - 4), 3);
+    return HandshakeResponsePacket(p);
+  }
+
+  MockSocketOperations sock_ops_;
+};
+
+TEST_F(DestFabricCacheShardTest, ShardKeyFromAttribute) {
+  DestFabricCacheShard dest("ham", "shop.orders", routing::AccessMode::kReadWrite, {}, &sock_ops_);
+  string shard_key;
+
+  ASSERT_TRUE(dest.get_shard_key(make_response("shop", {{"shard_key", "1234"}, {"_pid", "42"}}), &shard_key));
+  ASSERT_EQ("1234", shard_key);
+}
+
+TEST_F(DestFabricCacheShardTest, ShardKeyFromDatabase) {
+  DestFabricCacheShard dest("ham", "shop.orders", routing::AccessMode::kReadWrite, {}, &sock_ops_);
+  string shard_key;
+
+  ASSERT_TRUE(dest.get_shard_key(make_response("1234", {{"_pid", "42"}}), &shard_key));
+  ASSERT_EQ("1234", shard_key);
+  ASSERT_FALSE(dest.get_shard_key(make_response("", {{"_pid", "42"}}), &shard_key));
+}
+
+TEST_F(DestFabricCacheShardTest, ShardKeyAttributeOption) {
+  DestFabricCacheShard dest("ham", "shop.orders", routing::AccessMode::kReadWrite,
+                            {{"shard_key_attribute", "customer"}}, &sock_ops_);
+  string shard_key;
+
+  ASSERT_TRUE(dest.get_shard_key(make_response("shop", {{"shard_key", "1"}, {"customer", "2"}}), &shard_key));
+  ASSERT_EQ("2", shard_key);
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -17,7 +17,6 @@
 
 // TODO REFACTORING: "first-available" needs to be renamed to something that better describes its function.
 //                   All related filenames and identifiers should be renamed.
-//                   Also while at it, get_mysql_socket() should probably take TCPAddress by const reference
 
 #include "dest_first_available.h"
 
@@ -0,0 +1,181 @@
+/*
+  Copyright (c) 2016, Oracle and/or its affiliates. All rights reserved.
+
+  This program is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation; version 2 of the License.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+#include "destination.h"
+#include "mysql_routing.h"
+#include "outlier_detector.h"
+
+#include "routing_mocks.h"
+
+using std::chrono::seconds;
+
+class OutlierDetectorTest : public ::testing::Test {
+ protected:
+  OutlierDetectorTest() : now_(OutlierDetector::clock_type::now()) {
+    settings_.error_rate = 50;
+    settings_.min_requests = 4;
+    settings_.interval = 10;
+    settings_.ejection_time = 30;
+    settings_.max_ejection_percent = 50;
+  }
+
+  OutlierDetector::Settings settings_;
+  OutlierDetector::clock_type::time_point now_;
+  TCPAddress addr1_{"41", 1};
+  TCPAddress addr2_{"42", 2};
+};
+
+TEST_F(OutlierDetectorTest, DisabledByDefault) {
+  OutlierDetector detector;
+  ASSERT_FALSE(detector.enabled());
+  for (int i = 0; i < 100; ++i) {
+    ASSERT_FALSE(detector.report(addr1_, true, 2, now_));
+  }
+  ASSERT_FALSE(detector.is_ejected(addr1_, now_));
+}
+
+TEST_F(OutlierDetectorTest, EjectOnErrorRate) {
+  OutlierDetector detector(settings_);
+
+  ASSERT_FALSE(detector.report(addr1_, false, 4, now_));
+  ASSERT_FALSE(detector.report(addr1_, true, 4, now_));
+  ASSERT_FALSE(detector.report(addr1_, false, 4, now_));
+  // 2 out of 4 failed
+  ASSERT_TRUE(detector.report(addr1_, true, 4, now_));
+  ASSERT_TRUE(detector.is_ejected(addr1_, now_));
+  ASSERT_FALSE(detector.is_ejected(addr2_, now_));
+  ASSERT_EQ(1u, detector.size_ejected(now_));
+}
+
+TEST_F(OutlierDetectorTest, MinRequests) {
+  OutlierDetector detector(settings_);
+
+  // 100% errors, but not enough sessions
+  ASSERT_FALSE(detector.report(addr1_, true, 4, now_));
+  ASSERT_FALSE(detector.report(addr1_, true, 4, now_));
+  ASSERT_FALSE(detector.report(addr1_, true, 4, now_));
+  ASSERT_FALSE(detector.is_ejected(addr1_, now_));
+  ASSERT_TRUE(detector.report(addr1_, true, 4, now_));
+}
+
+TEST_F(OutlierDetectorTest, SlidingWindow) {
+  OutlierDetector detector(settings_);
+
+  ASSERT_FALSE(detector.report(addr1_, true, 4, now_));
+  ASSERT_FALSE(detector.report(addr1_, true, 4, now_));
+  ASSERT_FALSE(detector.report(addr1_, true, 4, now_));
+
+  // errors reported before are out of the window
+  auto later = now_ + seconds(settings_.interval + 1);
+  ASSERT_FALSE(detector.report(addr1_, true, 4, later));
+  ASSERT_FALSE(detector.is_ejected(addr1_, later));
+}
+
+TEST_F(OutlierDetectorTest, EjectionTimeExpires) {
+  OutlierDetector detector(settings_);
+
+  for (int i = 0; i < 4; ++i) {
+    detector.report(addr1_, true, 4, now_);
+  }
+  ASSERT_TRUE(detector.is_ejected(addr1_, now_ + seconds(settings_.ejection_time - 1)));
+  ASSERT_FALSE(detector.is_ejected(addr1_, now_ + seconds(settings_.ejection_time)));
+  ASSERT_EQ(0u, detector.size_ejected(now_ + seconds(settings_.ejection_time)));
+}
+
+TEST_F(OutlierDetectorTest, MaxEjectionPercent) {
+  OutlierDetector detector(settings_);
+
+  for (int i = 0; i < 4; ++i) {
+    detector.report(addr1_, true, 2, now_);
+    detector.report(addr2_, true, 2, now_);
+  }
+
+  // only 50% of a pool of 2 can be ejected
+  ASSERT_TRUE(detector.is_ejected(addr1_, now_));
+  ASSERT_FALSE(detector.is_ejected(addr2_, now_));
+  ASSERT_EQ(1u, detector.size_ejected(now_));
+}
+
+TEST_F(OutlierDetectorTest, MaxEjectionPercentSmallPool) {
+  settings_.max_ejection_percent = 10;
+  OutlierDetector detector(settings_);
+
+  for (int i = 0; i < 4; ++i) {
+    detector.report(addr1_, true, 3, now_);
+    detector.report(addr2_, true, 3, now_);
+  }
+
+  // 10% of a pool of 3 is less than one destination; one is ejected anyway
+  ASSERT_TRUE(detector.is_ejected(addr1_, now_));
+  ASSERT_FALSE(detector.is_ejected(addr2_, now_));
+  ASSERT_EQ(1u, detector.size_ejected(now_));
+}
+
+TEST_F(OutlierDetectorTest, MaxEjectionPercentZero) {
+  settings_.max_ejection_percent = 0;
+  OutlierDetector detector(settings_);
+
+  for (int i = 0; i < 4; ++i) {
+    ASSERT_FALSE(detector.report(addr1_, true, 3, now_));
+  }
+  ASSERT_FALSE(detector.is_ejected(addr1_, now_));
+}
+
+TEST_F(OutlierDetectorTest, SetSettingsEnables) {
+  OutlierDetector detector;
+  ASSERT_FALSE(detector.enabled());
+
+  detector.set_settings(settings_);
+  ASSERT_TRUE(detector.enabled());
+
+  settings_.error_rate = 0;
+  detector.set_settings(settings_);
+  ASSERT_FALSE(detector.enabled());
+}
+
+TEST_F(OutlierDetectorTest, RouteDestinationSkipsEjected) {
+  MockSocketOperations sock_ops;
+  RouteDestination dest(&sock_ops);
+  dest.add("41", 1);
+  dest.add("42", 2);
+  dest.set_outlier_detection(settings_);
+
+  for (int i = 0; i < 4; ++i) {
+    dest.report_relay_result(addr1_, true);
+  }
+  ASSERT_EQ(1u, dest.size_ejected());
+
+  int error;
+  TCPAddress addr;
+  ASSERT_EQ(42, dest.get_server_socket(0, &error, &addr));
+  ASSERT_EQ(addr2_, addr);
+  ASSERT_EQ(42, dest.get_server_socket(0, &error, &addr));
+  ASSERT_EQ(42, dest.get_server_socket(0, &error, &addr));
+  ASSERT_EQ(3, sock_ops.get_mysql_socket_call_cnt());
+}
+
+TEST_F(OutlierDetectorTest, ClientErrorsAreNotDestinationErrors) {
+  ASSERT_FALSE(MySQLRouting::is_destination_error(1045));  // access denied
+  ASSERT_FALSE(MySQLRouting::is_destination_error(1049));  // unknown database
+  ASSERT_TRUE(MySQLRouting::is_destination_error(1040));  // too many connections
+  ASSERT_TRUE(MySQLRouting::is_destination_error(1053));  // shutdown in progress
+}
+
+int main(int argc, char *argv[]) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -20,6 +20,8 @@
 
 #include "routing_mocks.h"
 
+#include <cstring>
+
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -99,6 +101,26 @@ TEST_F(RoutingTests, SetSocketBlocking) {
   ASSERT_EQ(fcntl(s, F_GETFL, nullptr) & O_NONBLOCK, O_NONBLOCK);
   ASSERT_EQ(fcntl(s, F_GETFL, nullptr) & O_RDONLY, O_RDONLY);
 }
+
+TEST_F(RoutingTests, GetMySQLSocketResolved) {
+  int server = socket(PF_INET, SOCK_STREAM, 6);
+  struct sockaddr_in sin;
+  memset(&sin, 0, sizeof(sin));
+  sin.sin_family = AF_INET;
+  sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  socklen_t sin_len = static_cast<socklen_t>(sizeof(sin));
+  ASSERT_EQ(0, bind(server, reinterpret_cast<struct sockaddr *>(&sin), sin_len));
+  ASSERT_EQ(0, listen(server, 1));
+  ASSERT_EQ(0, getsockname(server, reinterpret_cast<struct sockaddr *>(&sin), &sin_len));
+
+  // the host name is only used for logging; it is never resolved
+  mysqlrouter::TCPAddress addr("host.invalid", ntohs(sin.sin_port));
+  auto sock_ops = routing::SocketOperations::instance();
+  int client = sock_ops->get_mysql_socket(addr, &sin, sizeof(sin), 1);
+  ASSERT_GE(client, 0);
+  sock_ops->close(client);
+  sock_ops->close(server);
+}
 #endif
 
 TEST_F(RoutingTests, CopyPacketsSingleWrite) {